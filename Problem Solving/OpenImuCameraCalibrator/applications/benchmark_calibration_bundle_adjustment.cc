@@ -0,0 +1,99 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/io/reconstruction_reader.h>
+#include <theia/sfm/bundle_adjustment/bundle_adjustment.h>
+#include <theia/util/timer.h>
+
+#include <thread>
+
+#include "OpenCameraCalibrator/core/calibration_bundle_adjuster.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
+
+using namespace OpenICC;
+using namespace OpenICC::core;
+
+DEFINE_string(input_calibration_dataset,
+              "",
+              "Path to the .calibdata file written by calibrate_camera.");
+DEFINE_int32(nr_runs, 5, "Number of runs per bundle adjustment path.");
+
+namespace {
+
+theia::BundleAdjustmentOptions GetFullCalibrationOptions() {
+  theia::BundleAdjustmentOptions ba_options;
+  ba_options.verbose = false;
+  ba_options.loss_function_type = theia::LossFunctionType::HUBER;
+  ba_options.robust_loss_width = 1.345;
+  ba_options.num_threads = std::thread::hardware_concurrency();
+  ba_options.constant_camera_orientation = false;
+  ba_options.constant_camera_position = false;
+  ba_options.intrinsics_to_optimize =
+      theia::OptimizeIntrinsicsType::PRINCIPAL_POINTS |
+      theia::OptimizeIntrinsicsType::FOCAL_LENGTH |
+      theia::OptimizeIntrinsicsType::ASPECT_RATIO |
+      theia::OptimizeIntrinsicsType::RADIAL_DISTORTION;
+  return ba_options;
+}
+
+double MeanReprojError(const theia::Reconstruction& recon) {
+  double reproj_error = 0.0;
+  for (const auto& stats : utils::ComputeViewStatistics(
+           recon, recon.ViewIds(), std::thread::hardware_concurrency())) {
+    reproj_error += stats.mean_error;
+  }
+  return reproj_error / recon.NumViews();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  const theia::BundleAdjustmentOptions ba_options = GetFullCalibrationOptions();
+  double time_theia = 0.0, time_calib = 0.0;
+  double error_theia = 0.0, error_calib = 0.0;
+  for (int r = 0; r < FLAGS_nr_runs; ++r) {
+    theia::Reconstruction recon_theia, recon_calib;
+    CHECK(theia::ReadReconstruction(FLAGS_input_calibration_dataset,
+                                    &recon_theia))
+        << "Could not read " << FLAGS_input_calibration_dataset;
+    CHECK(theia::ReadReconstruction(FLAGS_input_calibration_dataset,
+                                    &recon_calib));
+
+    theia::Timer timer;
+    theia::BundleAdjustViews(ba_options, recon_theia.ViewIds(), &recon_theia);
+    time_theia += timer.ElapsedTimeInSeconds();
+    error_theia = MeanReprojError(recon_theia);
+
+    timer.Reset();
+    CalibrationBundleAdjuster bundle_adjuster(&recon_calib);
+    bundle_adjuster.Optimize(ba_options);
+    time_calib += timer.ElapsedTimeInSeconds();
+    error_calib = MeanReprojError(recon_calib);
+  }
+
+  std::cout << "theia::BundleAdjustViews: "
+            << time_theia / FLAGS_nr_runs * 1e3
+            << "ms per run, reprojection error: " << error_theia << "px\n";
+  std::cout << "CalibrationBundleAdjuster: "
+            << time_calib / FLAGS_nr_runs * 1e3
+            << "ms per run, reprojection error: " << error_calib << "px\n";
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/util/timer.h>
+
+#include <random>
+
+#include "OpenCameraCalibrator/io/read_camera_calibration.h"
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+
+using namespace OpenICC;
+
+DEFINE_string(camera_calibration_json,
+              "",
+              "FISHEYE or KB4 camera calibration. If empty, the parameters of "
+              "Analytical/KB4.py on a 1920x1200 image are used.");
+DEFINE_int32(nr_points, 1000000, "Number of random points to (un)project.");
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  theia::Camera camera;
+  if (FLAGS_camera_calibration_json.empty()) {
+    utils::KB4Parameters params;
+    params << 622.0, 622.0, 965.0, 631.0, -0.256, -0.0015, 0.0007, -0.0002;
+    utils::SetKB4Parameters(params, camera);
+    camera.SetImageSize(1920, 1200);
+  } else {
+    double fps;
+    CHECK(io::read_camera_calibration(
+        FLAGS_camera_calibration_json, camera, fps))
+        << "Could not read camera calibration: "
+        << FLAGS_camera_calibration_json;
+  }
+  CHECK(utils::IsKB4Camera(camera)) << "Camera is not a KB4 camera.";
+  const utils::KB4Parameters params = utils::KB4ParametersFromCamera(camera);
+
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> dist_x(0.0, camera.ImageWidth());
+  std::uniform_real_distribution<double> dist_y(0.0, camera.ImageHeight());
+  Eigen::Matrix2Xd pixels(2, FLAGS_nr_points);
+  for (int i = 0; i < FLAGS_nr_points; ++i) {
+    pixels.col(i) = Eigen::Vector2d(dist_x(generator), dist_y(generator));
+  }
+
+  // unprojection
+  theia::Timer timer;
+  Eigen::Matrix2Xd normalized_batch;
+  utils::UnprojectKB4(params, pixels, normalized_batch);
+  const double time_unproject_batch = timer.ElapsedTimeInSeconds();
+
+  timer.Reset();
+  Eigen::Matrix2Xd normalized_theia(2, FLAGS_nr_points);
+  for (int i = 0; i < FLAGS_nr_points; ++i) {
+    normalized_theia.col(i) =
+        camera.PixelToNormalizedCoordinates(pixels.col(i)).hnormalized();
+  }
+  const double time_unproject_theia = timer.ElapsedTimeInSeconds();
+
+  // projection of the unprojected pixels at random depths
+  std::uniform_real_distribution<double> dist_depth(0.1, 10.0);
+  Eigen::Matrix3Xd points(3, FLAGS_nr_points);
+  for (int i = 0; i < FLAGS_nr_points; ++i) {
+    points.col(i) =
+        dist_depth(generator) * normalized_theia.col(i).homogeneous();
+  }
+
+  timer.Reset();
+  Eigen::Matrix2Xd pixels_batch;
+  utils::ProjectKB4(params, points, pixels_batch);
+  const double time_project_batch = timer.ElapsedTimeInSeconds();
+
+  timer.Reset();
+  const auto intrinsics = camera.CameraIntrinsics();
+  Eigen::Matrix2Xd pixels_theia(2, FLAGS_nr_points);
+  for (int i = 0; i < FLAGS_nr_points; ++i) {
+    pixels_theia.col(i) = intrinsics->CameraToImageCoordinates(points.col(i));
+  }
+  const double time_project_theia = timer.ElapsedTimeInSeconds();
+
+  // differences scaled to pixel by the focal length
+  const double max_unproject_diff =
+      (normalized_batch - normalized_theia).colwise().norm().maxCoeff() *
+      params[0];
+  const double max_project_diff =
+      (pixels_batch - pixels_theia).colwise().norm().maxCoeff();
+  const double max_roundtrip_error =
+      (pixels_batch - pixels).colwise().norm().maxCoeff();
+
+  std::cout << "KB4 [fx, fy, cx, cy, k1, k2, k3, k4]: " << params.transpose()
+            << "\n"
+            << "  project: batch " << time_project_batch * 1e3 << "ms, theia "
+            << time_project_theia * 1e3 << "ms, max difference "
+            << max_project_diff << "px\n"
+            << "  unproject: batch " << time_unproject_batch * 1e3
+            << "ms, theia " << time_unproject_theia * 1e3
+            << "ms, max difference " << max_unproject_diff << "px\n"
+            << "  max round trip error: " << max_roundtrip_error << "px\n";
+
+  return 0;
+}
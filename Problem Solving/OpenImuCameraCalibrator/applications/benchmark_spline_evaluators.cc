@@ -0,0 +1,151 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/util/timer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "OpenCameraCalibrator/basalt_spline/se3_spline.h"
+
+DEFINE_int32(nr_knots, 200, "Number of knots of the random trajectory.");
+DEFINE_double(knot_distance_s, 0.1, "Knot distance of the spline in s.");
+DEFINE_double(sample_rate_hz, 400.0, "Rate of the sequential queries in Hz.");
+DEFINE_int32(nr_random_queries, 1000, "Number of out of order queries.");
+DEFINE_int32(nr_runs, 5, "Number of timed passes over the queries.");
+
+namespace {
+
+constexpr int SPLINE_ORDER = 6;
+
+using Spline = Se3Spline<SPLINE_ORDER>;
+
+// largest difference between the evaluators and the direct spline calls
+struct Differences {
+  double rotation = 0.0;
+  double rot_velocity = 0.0;
+  double rot_acceleration = 0.0;
+  double position = 0.0;
+  double trans_acceleration = 0.0;
+  double imu = 0.0;
+};
+
+Differences Compare(const Spline& spline,
+                    const std::vector<int64_t>& times_ns) {
+  const auto& so3 = spline.getSo3Spline();
+  const auto& pos = spline.getPosSpline();
+  Se3SplineEvaluator<SPLINE_ORDER> se3_eval(spline);
+  So3SplineEvaluator<SPLINE_ORDER> so3_eval(so3);
+  RdSplineEvaluator<3, SPLINE_ORDER> pos_eval(pos);
+  const Eigen::Vector3d gravity(0.0, 0.0, -9.81);
+
+  Differences diff;
+  for (const int64_t t_ns : times_ns) {
+    Eigen::Vector3d vel, accel;
+    const Sophus::SO3d R = so3_eval.evaluate(t_ns, &vel, &accel);
+    diff.rotation = std::max(
+        diff.rotation, (R.inverse() * so3.evaluate(t_ns)).log().norm());
+    diff.rot_velocity = std::max(diff.rot_velocity,
+                                 (vel - so3.velocityBody(t_ns)).norm());
+    diff.rot_acceleration =
+        std::max(diff.rot_acceleration,
+                 (accel - so3.accelerationBody(t_ns)).norm());
+    diff.position = std::max(
+        diff.position, (pos_eval.evaluate(t_ns) - pos.evaluate(t_ns)).norm());
+    diff.trans_acceleration = std::max(
+        diff.trans_acceleration,
+        (pos_eval.acceleration(t_ns) - pos.acceleration(t_ns)).norm());
+
+    Eigen::Vector3d gyro, accl;
+    se3_eval.imuMeasurements(t_ns, gravity, gyro, accl);
+    const Eigen::Vector3d true_accl =
+        so3.evaluate(t_ns).inverse() *
+        (spline.transAccelWorld(t_ns) + gravity);
+    diff.imu = std::max({diff.imu,
+                         (gyro - so3.velocityBody(t_ns)).norm(),
+                         (accl - true_accl).norm()});
+  }
+  return diff;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  // genRandomTrajectory draws from rand()
+  std::srand(42);
+  const int64_t dt_ns = static_cast<int64_t>(FLAGS_knot_distance_s * 1e9);
+  Spline spline(dt_ns);
+  spline.genRandomTrajectory(FLAGS_nr_knots);
+
+  std::vector<int64_t> times_ns;
+  const int64_t sample_dt_ns =
+      static_cast<int64_t>(1e9 / FLAGS_sample_rate_hz);
+  for (int64_t t_ns = spline.minTimeNs(); t_ns < spline.maxTimeNs();
+       t_ns += sample_dt_ns) {
+    times_ns.push_back(t_ns);
+  }
+  const size_t nr_sequential = times_ns.size();
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<int64_t> random_time(spline.minTimeNs(),
+                                                     spline.maxTimeNs() - 1);
+  for (int i = 0; i < FLAGS_nr_random_queries; ++i) {
+    times_ns.push_back(random_time(rng));
+  }
+
+  const Differences diff = Compare(spline, times_ns);
+  std::cout << "Max difference to the direct evaluation (sequential and out "
+               "of order queries):\n"
+            << "rotation: " << diff.rotation
+            << " rad, angular velocity: " << diff.rot_velocity
+            << ", angular acceleration: " << diff.rot_acceleration
+            << "\nposition: " << diff.position
+            << ", acceleration: " << diff.trans_acceleration
+            << ", IMU measurements: " << diff.imu << "\n";
+
+  // sequential pose, angular velocity and acceleration queries
+  times_ns.resize(nr_sequential);
+  Eigen::Vector3d checksum = Eigen::Vector3d::Zero();
+  theia::Timer timer;
+  for (int r = 0; r < FLAGS_nr_runs; ++r) {
+    for (const int64_t t_ns : times_ns) {
+      checksum += spline.rotVelBody(t_ns) + spline.transAccelWorld(t_ns) +
+                  spline.pose(t_ns).translation();
+    }
+  }
+  const double direct_s = timer.ElapsedTimeInSeconds();
+  Se3SplineEvaluator<SPLINE_ORDER> evaluator(spline);
+  timer.Reset();
+  for (int r = 0; r < FLAGS_nr_runs; ++r) {
+    for (const int64_t t_ns : times_ns) {
+      checksum += evaluator.rotVelBody(t_ns) +
+                  evaluator.transAccelWorld(t_ns) +
+                  evaluator.pose(t_ns).translation();
+    }
+  }
+  const double evaluator_s = timer.ElapsedTimeInSeconds();
+  std::cout << nr_sequential << " sequential queries, direct: "
+            << direct_s / FLAGS_nr_runs * 1e3
+            << "ms, evaluator: " << evaluator_s / FLAGS_nr_runs * 1e3
+            << "ms (checksum " << checksum.norm() << ")\n";
+
+  return 0;
+}
@@ -0,0 +1,203 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ceres/ceres.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/sfm/reconstruction.h>
+#include <theia/util/timer.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "OpenCameraCalibrator/basalt_spline/ceres_calib_split_residuals.h"
+#include "OpenCameraCalibrator/core/imu_camera_calibrator.h"
+
+using namespace OpenICC;
+using namespace OpenICC::core;
+
+DEFINE_int32(board_cols, 10, "Number of board corners in x.");
+DEFINE_int32(board_rows, 8, "Number of board corners in y.");
+DEFINE_int32(nr_evaluations, 2000, "Number of evaluations per residual.");
+
+namespace {
+
+const double BOARD_SQUARE_SIZE = 0.04;
+const double LINE_DELAY_S = 1e-5;
+
+// residuals and Jacobians of all parameter blocks of a cost function
+struct Evaluation {
+  explicit Evaluation(const ceres::CostFunction& cost_function) {
+    residuals.resize(cost_function.num_residuals());
+    for (const int block_size : cost_function.parameter_block_sizes()) {
+      jacobian_storage.emplace_back(cost_function.num_residuals() * block_size);
+      jacobians.push_back(jacobian_storage.back().data());
+    }
+  }
+
+  double MaxDifference(const Evaluation& other) const {
+    double max_diff = 0.0;
+    for (size_t i = 0; i < residuals.size(); ++i) {
+      max_diff =
+          std::max(max_diff, std::abs(residuals[i] - other.residuals[i]));
+    }
+    for (size_t b = 0; b < jacobian_storage.size(); ++b) {
+      for (size_t i = 0; i < jacobian_storage[b].size(); ++i) {
+        max_diff = std::max(max_diff,
+                            std::abs(jacobian_storage[b][i] -
+                                     other.jacobian_storage[b][i]));
+      }
+    }
+    return max_diff;
+  }
+
+  std::vector<double> residuals;
+  std::vector<std::vector<double>> jacobian_storage;
+  std::vector<double*> jacobians;
+};
+
+double TimeEvaluations(const ceres::CostFunction& cost_function,
+                       const std::vector<double*>& parameters,
+                       Evaluation& evaluation) {
+  theia::Timer timer;
+  for (int i = 0; i < FLAGS_nr_evaluations; ++i) {
+    CHECK(cost_function.Evaluate(parameters.data(),
+                                 evaluation.residuals.data(),
+                                 evaluation.jacobians.data()));
+  }
+  return timer.ElapsedTimeInSeconds() / FLAGS_nr_evaluations;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> small(-0.05, 0.05);
+  std::normal_distribution<double> pixel_noise(0.0, 0.5);
+
+  // one view of a board 0.5m in front of the camera
+  theia::Reconstruction recon;
+  const theia::ViewId view_id = recon.AddView("0", 0, 0.0);
+  theia::View* view = recon.MutableView(view_id);
+  theia::Camera* camera = view->MutableCamera();
+  camera->SetCameraIntrinsicsModelType(
+      theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION);
+  camera->SetImageSize(1920, 1080);
+  camera->SetFocalLength(1000.0);
+  camera->SetPrincipalPoint(960.0, 540.0);
+  camera->CameraIntrinsics()->SetParameter(
+      theia::DivisionUndistortionCameraModel::RADIAL_DISTORTION_1, -1e-7);
+
+  std::vector<theia::TrackId> track_ids;
+  aligned_vector<Eigen::Vector4d> points;
+  for (int r = 0; r < FLAGS_board_rows; ++r) {
+    for (int c = 0; c < FLAGS_board_cols; ++c) {
+      const Eigen::Vector4d point(
+          (c - 0.5 * FLAGS_board_cols) * BOARD_SQUARE_SIZE,
+          (r - 0.5 * FLAGS_board_rows) * BOARD_SQUARE_SIZE,
+          0.0,
+          1.0);
+      const theia::TrackId track_id = recon.AddTrack();
+      *recon.MutableTrack(track_id)->MutablePoint() = point;
+      Eigen::Vector2d pixel;
+      camera->ProjectPoint(point - Eigen::Vector4d(0.0, 0.0, -0.5, 0.0),
+                           &pixel);
+      pixel += Eigen::Vector2d(pixel_noise(rng), pixel_noise(rng));
+      recon.AddObservation(view_id,
+                           track_id,
+                           theia::Feature(pixel, Eigen::Matrix2d::Identity()));
+      track_ids.push_back(track_id);
+    }
+  }
+  for (const theia::TrackId track_id : track_ids) {
+    points.push_back(*recon.MutableTrack(track_id)->MutablePoint());
+  }
+
+  // knots around the pose of the board view
+  aligned_vector<Sophus::SO3d> so3_knots(SPLINE_N);
+  aligned_vector<Eigen::Vector3d> r3_knots(SPLINE_N);
+  for (int i = 0; i < SPLINE_N; ++i) {
+    so3_knots[i] = Sophus::SO3d::exp(
+        Eigen::Vector3d(small(rng), small(rng), small(rng)));
+    r3_knots[i] =
+        Eigen::Vector3d(small(rng), small(rng), -0.5 + small(rng));
+  }
+  Sophus::SE3d T_i_c;
+  double line_delay_s = LINE_DELAY_S;
+
+  std::vector<double*> gs_parameters;
+  for (int i = 0; i < SPLINE_N; ++i) {
+    gs_parameters.push_back(so3_knots[i].data());
+  }
+  for (int i = 0; i < SPLINE_N; ++i) {
+    gs_parameters.push_back(r3_knots[i].data());
+  }
+  gs_parameters.push_back(T_i_c.data());
+  std::vector<double*> rs_parameters = gs_parameters;
+  rs_parameters.push_back(&line_delay_s);
+  for (size_t i = 0; i < points.size(); ++i) {
+    gs_parameters.push_back(points[i].data());
+    rs_parameters.push_back(points[i].data());
+  }
+
+  const double u = 0.4, inv_dt = 20.0;
+  // the dynamic autodiff functor the rolling shutter residual replaced
+  using FunctorT = RSReprojectionCostFunctorSplit<SPLINE_N>;
+  ceres::DynamicAutoDiffCostFunction<FunctorT> autodiff_rs(
+      new FunctorT(view, &recon, u, u, inv_dt, inv_dt, track_ids));
+  for (int i = 0; i < SPLINE_N; ++i) {
+    autodiff_rs.AddParameterBlock(4);
+  }
+  for (int i = 0; i < SPLINE_N; ++i) {
+    autodiff_rs.AddParameterBlock(3);
+  }
+  autodiff_rs.AddParameterBlock(7);
+  autodiff_rs.AddParameterBlock(1);
+  for (size_t i = 0; i < track_ids.size(); ++i) {
+    autodiff_rs.AddParameterBlock(4);
+  }
+  autodiff_rs.SetNumResiduals(2 * track_ids.size());
+
+  const std::unique_ptr<ceres::CostFunction> chained_rs(
+      CreateSplineReprojectionCostFunction<SPLINE_N, true>(
+          view, track_ids, u, u, inv_dt, inv_dt));
+  const std::unique_ptr<ceres::CostFunction> chained_gs(
+      CreateSplineReprojectionCostFunction<SPLINE_N, false>(
+          view, track_ids, u, u, inv_dt, inv_dt));
+
+  Evaluation eval_autodiff_rs(autodiff_rs), eval_chained_rs(*chained_rs),
+      eval_chained_gs(*chained_gs);
+  const double time_autodiff_rs =
+      TimeEvaluations(autodiff_rs, rs_parameters, eval_autodiff_rs);
+  const double time_chained_rs =
+      TimeEvaluations(*chained_rs, rs_parameters, eval_chained_rs);
+  const double time_chained_gs =
+      TimeEvaluations(*chained_gs, gs_parameters, eval_chained_gs);
+
+  std::cout << "Spline order " << SPLINE_N << ", " << track_ids.size()
+            << " observations per view, time per Evaluate with Jacobians:\n";
+  std::cout << "rolling shutter, dynamic autodiff: " << time_autodiff_rs * 1e6
+            << "us\n";
+  std::cout << "rolling shutter, chained:          " << time_chained_rs * 1e6
+            << "us, max. difference: "
+            << eval_chained_rs.MaxDifference(eval_autodiff_rs) << "\n";
+  std::cout << "global shutter, chained:           " << time_chained_gs * 1e6
+            << "us\n";
+  return 0;
+}
@@ -0,0 +1,199 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/sfm/reconstruction.h>
+#include <theia/util/timer.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/core/imu_camera_calibrator.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+using namespace OpenICC;
+using namespace OpenICC::core;
+
+DEFINE_double(duration_s, 60.0, "Length of the synthetic recording in s.");
+DEFINE_double(knot_distance_s, 0.05, "Knot distance of the spline in s.");
+DEFINE_double(imu_rate_hz, 200.0, "IMU sampling rate in Hz.");
+DEFINE_double(cam_rate_hz, 30.0, "Camera frame rate in Hz.");
+DEFINE_double(pose_noise, 0.01,
+              "Noise of the initial camera poses in rad / m.");
+DEFINE_int32(board_cols, 10, "Number of board corners in x.");
+DEFINE_int32(board_rows, 8, "Number of board corners in y.");
+DEFINE_int32(nr_iterations, 10, "Number of solver iterations per run.");
+DEFINE_int32(nr_runs, 3, "Number of runs per solver.");
+
+namespace {
+
+const double ACCL_NOISE = 0.02;
+const double GYRO_NOISE = 0.002;
+const double PIXEL_NOISE = 0.5;
+const double BOARD_SQUARE_SIZE = 0.04;
+const double LINE_DELAY_S = 1e-5;
+
+// smooth motion of a handheld camera in front of a board
+Sophus::SE3d TrueCameraPose(const double t) {
+  const Eigen::Vector3d rot(0.3 * std::sin(0.7 * t),
+                            0.2 * std::sin(1.1 * t + 0.5),
+                            0.4 * std::sin(0.5 * t + 1.0));
+  const Eigen::Vector3d pos(0.3 * std::sin(0.9 * t),
+                            0.2 * std::cos(0.6 * t),
+                            -0.8 + 0.1 * std::sin(1.3 * t));
+  return Sophus::SE3d(Sophus::SO3d::exp(rot), pos);
+}
+
+// views with noisy poses that observe the board corners from the true poses
+void MakeViews(const double pose_noise,
+               std::mt19937& rng,
+               theia::Reconstruction* recon) {
+  std::vector<theia::TrackId> track_ids;
+  for (int r = 0; r < FLAGS_board_rows; ++r) {
+    for (int c = 0; c < FLAGS_board_cols; ++c) {
+      const theia::TrackId track_id = recon->AddTrack();
+      *recon->MutableTrack(track_id)->MutablePoint() =
+          Eigen::Vector4d((c - 0.5 * FLAGS_board_cols) * BOARD_SQUARE_SIZE,
+                          (r - 0.5 * FLAGS_board_rows) * BOARD_SQUARE_SIZE,
+                          0.0,
+                          1.0);
+      track_ids.push_back(track_id);
+    }
+  }
+
+  std::normal_distribution<double> noise(0.0, pose_noise);
+  std::normal_distribution<double> pixel_noise(0.0, PIXEL_NOISE);
+  const double dt = 1.0 / FLAGS_cam_rate_hz;
+  for (double t = 0.0; t < FLAGS_duration_s; t += dt) {
+    const theia::ViewId vid =
+        recon->AddView(std::to_string(static_cast<int64_t>(t * S_TO_NS)),
+                       0,
+                       t);
+    theia::Camera* camera = recon->MutableView(vid)->MutableCamera();
+    camera->SetCameraIntrinsicsModelType(
+        theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION);
+    camera->SetImageSize(1920, 1080);
+    camera->SetFocalLength(1000.0);
+    camera->SetPrincipalPoint(960.0, 540.0);
+
+    const Sophus::SE3d T_w_c = TrueCameraPose(t);
+    camera->SetOrientationFromRotationMatrix(
+        T_w_c.rotationMatrix().transpose());
+    camera->SetPosition(T_w_c.translation());
+    for (const theia::TrackId track_id : track_ids) {
+      Eigen::Vector2d pixel;
+      if (camera->ProjectPoint(recon->Track(track_id)->Point(), &pixel) <=
+          0.0) {
+        continue;
+      }
+      pixel += Eigen::Vector2d(pixel_noise(rng), pixel_noise(rng));
+      recon->AddObservation(
+          vid, track_id, theia::Feature(pixel, Eigen::Matrix2d::Identity()));
+    }
+
+    const Sophus::SE3d T_w_c_noisy =
+        T_w_c *
+        Sophus::SE3d::exp((Sophus::Vector6d() << noise(rng), noise(rng),
+                           noise(rng), noise(rng), noise(rng), noise(rng))
+                              .finished());
+    camera->SetOrientationFromRotationMatrix(
+        T_w_c_noisy.rotationMatrix().transpose());
+    camera->SetPosition(T_w_c_noisy.translation());
+  }
+}
+
+void InitEstimator(const theia::Reconstruction& views,
+                   SplineTrajectoryEstimator<SPLINE_N>& estimator) {
+  const int64_t dt_ns = static_cast<int64_t>(FLAGS_knot_distance_s * S_TO_NS);
+  estimator.SetT_i_c(Sophus::SE3d());
+  estimator.SetTimes(
+      dt_ns, dt_ns, 0, static_cast<int64_t>(FLAGS_duration_s * S_TO_NS));
+  estimator.SetImageData(views);
+  estimator.BatchInitSO3R3VisPoses();
+  estimator.InitBiasSplines(Eigen::Vector3d::Zero(),
+                            Eigen::Vector3d::Zero(),
+                            static_cast<int64_t>(10.0 * S_TO_NS),
+                            static_cast<int64_t>(10.0 * S_TO_NS),
+                            1.0,
+                            1e-1);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::mt19937 rng(42);
+
+  // IMU measurements from the spline through the true camera poses, the
+  // rolling shutter of the camera is not simulated
+  theia::Reconstruction true_views;
+  MakeViews(0.0, rng, &true_views);
+  SplineTrajectoryEstimator<SPLINE_N> truth;
+  InitEstimator(true_views, truth);
+
+  std::normal_distribution<double> accl_noise(0.0, ACCL_NOISE);
+  std::normal_distribution<double> gyro_noise(0.0, GYRO_NOISE);
+  std::vector<SplineTrajectoryEstimator<SPLINE_N>::ImuMeasurement> accl_meas,
+      gyro_meas;
+  const int64_t imu_dt_ns = static_cast<int64_t>(S_TO_NS / FLAGS_imu_rate_hz);
+  for (int64_t t_ns = 0; t_ns < truth.GetMaxTimeNs(); t_ns += imu_dt_ns) {
+    Eigen::Vector3d accl, gyro;
+    if (!truth.GetAcceleration(t_ns, accl) ||
+        !truth.GetAngularVelocity(t_ns, gyro)) {
+      continue;
+    }
+    accl += Eigen::Vector3d(accl_noise(rng), accl_noise(rng), accl_noise(rng));
+    gyro += Eigen::Vector3d(gyro_noise(rng), gyro_noise(rng), gyro_noise(rng));
+    accl_meas.push_back({accl, t_ns, 1.0 / ACCL_NOISE});
+    gyro_meas.push_back({gyro, t_ns, 1.0 / GYRO_NOISE});
+  }
+
+  theia::Reconstruction noisy_views;
+  MakeViews(FLAGS_pose_noise, rng, &noisy_views);
+
+  const int flags = SplineOptimFlags::SPLINE | SplineOptimFlags::IMU_BIASES |
+                    SplineOptimFlags::GRAVITY_DIR | SplineOptimFlags::T_I_C |
+                    SplineOptimFlags::CAM_LINE_DELAY;
+  const std::vector<std::pair<std::string, SplineSolverType>> solvers = {
+      {"ceres", SplineSolverType::CERES},
+      {"banded", SplineSolverType::BANDED}};
+  for (const auto& solver : solvers) {
+    double time_s = 0.0, final_cost = 0.0;
+    for (int r = 0; r < FLAGS_nr_runs; ++r) {
+      SplineTrajectoryEstimator<SPLINE_N> estimator;
+      InitEstimator(noisy_views, estimator);
+      estimator.SetSolverType(solver.second);
+      estimator.AddAccelerometerMeasurements(accl_meas);
+      estimator.AddGyroscopeMeasurements(gyro_meas);
+      estimator.SetCameraLineDelay(LINE_DELAY_S);
+      for (const theia::ViewId vid : noisy_views.ViewIds()) {
+        estimator.AddRSCameraMeasurement(noisy_views.View(vid));
+      }
+
+      theia::Timer timer;
+      const ceres::Solver::Summary summary =
+          estimator.Optimize(FLAGS_nr_iterations, flags);
+      time_s += timer.ElapsedTimeInSeconds();
+      final_cost = summary.final_cost;
+    }
+    std::cout << solver.first << " solver: " << time_s / FLAGS_nr_runs * 1e3
+              << "ms per run, final cost: " << final_cost << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/util/timer.h>
+
+#include <random>
+#include <sstream>
+
+#include "OpenCameraCalibrator/io/read_camera_calibration.h"
+#include "OpenCameraCalibrator/utils/undistortion_lookup.h"
+
+using namespace OpenICC;
+
+DEFINE_string(camera_calibration_jsons,
+              "",
+              "Comma separated list of camera calibration jsons, e.g. one per "
+              "camera model.");
+DEFINE_int32(nr_points, 100000, "Number of random pixels to undistort.");
+DEFINE_int32(grid_step_px,
+             utils::UNDISTORTION_GRID_STEP_PX,
+             "Distance between the lookup grid nodes in pixel.");
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::stringstream json_list(FLAGS_camera_calibration_jsons);
+  std::string calib_json;
+  while (std::getline(json_list, calib_json, ',')) {
+    theia::Camera camera;
+    double fps;
+    CHECK(io::read_camera_calibration(calib_json, camera, fps))
+        << "Could not read camera calibration: " << calib_json;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> dist_x(0.0, camera.ImageWidth());
+    std::uniform_real_distribution<double> dist_y(0.0, camera.ImageHeight());
+    Eigen::Matrix2Xd pixels(2, FLAGS_nr_points);
+    for (int i = 0; i < FLAGS_nr_points; ++i) {
+      pixels.col(i) = Eigen::Vector2d(dist_x(generator), dist_y(generator));
+    }
+
+    theia::Timer timer;
+    const utils::UndistortionLookup lookup(camera, FLAGS_grid_step_px);
+    const double time_build = timer.ElapsedTimeInSeconds();
+
+    timer.Reset();
+    Eigen::Matrix2Xd undist_lookup;
+    lookup.Undistort(pixels, undist_lookup);
+    const double time_lookup = timer.ElapsedTimeInSeconds();
+
+    timer.Reset();
+    Eigen::Matrix2Xd undist_exact(2, FLAGS_nr_points);
+    for (int i = 0; i < FLAGS_nr_points; ++i) {
+      undist_exact.col(i) =
+          camera.PixelToNormalizedCoordinates(pixels.col(i)).hnormalized();
+    }
+    const double time_exact = timer.ElapsedTimeInSeconds();
+
+    // difference to the exact solution, scaled to pixel by the focal length
+    const Eigen::VectorXd errors =
+        (undist_lookup - undist_exact).colwise().norm().transpose() *
+        camera.FocalLength();
+
+    std::cout << calib_json << ":\n"
+              << "  grid build: " << time_build * 1e3 << "ms\n"
+              << "  lookup: " << time_lookup * 1e3 << "ms, exact: "
+              << time_exact * 1e3 << "ms for " << FLAGS_nr_points
+              << " points\n"
+              << "  sampled error bound: " << lookup.MaxErrorPx()
+              << "px, using lookup: " << lookup.UsesLookup() << "\n"
+              << "  error to exact: mean " << errors.mean() << "px, max "
+              << errors.maxCoeff() << "px\n";
+  }
+
+  return 0;
+}
@@ -28,7 +28,7 @@ DEFINE_string(camera_model_to_calibrate,
               "DOUBLE_SPHERE",
               "What camera model do you want to calibrate. Options:"
               "PINHOLE,PINHOLE_RADIAL_TANGENTIAL,DIVISION_UNDISTORTION,DOUBLE_"
-              "SPHERE,EXTENDED_UNIFIED,FISHEYE");
+              "SPHERE,EXTENDED_UNIFIED,FISHEYE,KB4 (same as FISHEYE)");
 DEFINE_string(save_path_calib_dataset,
               "",
               "Where to save the recon dataset to.");
@@ -39,6 +39,10 @@ DEFINE_bool(optimize_board_points,
             false,
             "If in the end also the scene points should be adjusted. (if the "
             "board is not planar)");
+DEFINE_string(calibration_state,
+              "",
+              "Optional *_state.json of a previous calibration of this camera. "
+              "The new recording is then added to it incrementally.");
 DEFINE_bool(verbose, false, "If more stuff should be printed");
 
 int main(int argc, char* argv[]) {
@@ -55,6 +59,10 @@ int main(int argc, char* argv[]) {
   if (FLAGS_verbose) {
     camera_calibrator.SetVerbose();
   }
+  if (FLAGS_calibration_state != "") {
+    CHECK(camera_calibrator.LoadCalibrationState(FLAGS_calibration_state))
+        << "Failed to load " << FLAGS_calibration_state;
+  }
   camera_calibrator.CalibrateCameraFromJson(scene_json,
                                             FLAGS_save_path_calib_dataset);
   camera_calibrator.PrintResult();
@@ -0,0 +1,145 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gflags/gflags.h>
+
+#include "OpenCameraCalibrator/core/board_extractor.h"
+#include "OpenCameraCalibrator/core/live_camera_calibrator.h"
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+using namespace OpenICC;
+using namespace OpenICC::utils;
+using namespace OpenICC::core;
+
+DEFINE_string(input_path, "", "Input video or image folder.");
+DEFINE_string(board_type, "charuco", "Board type. (charuco, radon, apriltag)");
+DEFINE_string(aruco_detector_params, "", "Path detector yaml.");
+DEFINE_double(downsample_factor,
+              1.0,
+              "Downsample factor for images. I_new = 1/factor * I");
+DEFINE_string(save_corners_json_path,
+              "",
+              "Optional path to also save the extracted corners to.");
+DEFINE_double(checker_square_length_m,
+              0.022,
+              "Size of one square on the checkerboard in [m].");
+DEFINE_int32(num_squares_x, 9, "Number of squares in x.");
+DEFINE_int32(num_squares_y, 7, "Number of squares in y");
+DEFINE_int32(aruco_dict,
+             cv::aruco::DICT_ARUCO_ORIGINAL,
+             "Aruco dictionary id.");
+DEFINE_string(camera_model_to_calibrate,
+              "DOUBLE_SPHERE",
+              "What camera model do you want to calibrate. Options:"
+              "PINHOLE,PINHOLE_RADIAL_TANGENTIAL,DIVISION_UNDISTORTION,DOUBLE_"
+              "SPHERE,EXTENDED_UNIFIED,FISHEYE,KB4 (same as FISHEYE)");
+DEFINE_string(save_path_calib_dataset,
+              "",
+              "Where to save the recon dataset to.");
+DEFINE_double(grid_size,
+              0.04,
+              "Only take images that are at least grid_size apart");
+DEFINE_bool(optimize_board_points,
+            false,
+            "If in the end also the scene points should be adjusted. (if the "
+            "board is not planar)");
+DEFINE_string(calibration_state,
+              "",
+              "Optional *_state.json of a previous calibration of this camera. "
+              "The new recording is then added to it incrementally.");
+DEFINE_int32(refine_interval,
+             10,
+             "Refine the running intrinsics estimate every n accepted views.");
+DEFINE_bool(verbose, false, "If more stuff should be printed");
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  BoardExtractor board_extractor;
+  BoardType board_type = StringToBoardType(FLAGS_board_type);
+  if (board_type == BoardType::CHARUCO) {
+    const float aruco_marker_length = FLAGS_checker_square_length_m / 2.0f;
+    board_extractor.InitializeCharucoBoard(FLAGS_aruco_detector_params,
+                                           aruco_marker_length,
+                                           FLAGS_checker_square_length_m,
+                                           FLAGS_num_squares_x,
+                                           FLAGS_num_squares_y,
+                                           FLAGS_aruco_dict);
+  } else if (board_type == BoardType::RADON) {
+    board_extractor.InitializeRadonBoard(FLAGS_checker_square_length_m,
+                                         FLAGS_num_squares_x,
+                                         FLAGS_num_squares_y);
+  } else if (board_type == BoardType::APRILTAG) {
+    board_extractor.InitializeAprilBoard(FLAGS_checker_square_length_m,
+                                         0.3,
+                                         FLAGS_num_squares_x,
+                                         FLAGS_num_squares_y);
+  } else {
+    LOG(ERROR) << "This board type does not exist! Choose Charuco or Radon";
+    return -1;
+  }
+
+  LiveCameraCalibrator live_calibrator(FLAGS_camera_model_to_calibrate,
+                                       FLAGS_optimize_board_points);
+  live_calibrator.SetRefineInterval(FLAGS_refine_interval);
+  live_calibrator.Calibrator().SetGridSize(FLAGS_grid_size);
+  if (FLAGS_verbose) {
+    live_calibrator.Calibrator().SetVerbose();
+  }
+  if (FLAGS_calibration_state != "") {
+    CHECK(live_calibrator.Calibrator().LoadCalibrationState(
+        FLAGS_calibration_state))
+        << "Failed to load " << FLAGS_calibration_state;
+  }
+
+  nlohmann::json board_json;
+  board_extractor.BoardToJson(board_json);
+  live_calibrator.Start(board_json);
+
+  // the calibration runs in the background while the corners are extracted
+  board_extractor.SetDetectionCallback(
+      [&live_calibrator](const double timestamp_s,
+                         const cv::Size& image_size,
+                         const aligned_vector<Eigen::Vector2d>& corners,
+                         const std::vector<int>& object_pt_ids) {
+        BoardDetection detection;
+        detection.timestamp_s = timestamp_s;
+        detection.image_width = image_size.width;
+        detection.image_height = image_size.height;
+        detection.corners = corners;
+        detection.object_pt_ids = object_pt_ids;
+        live_calibrator.PushDetection(detection);
+      });
+
+  LOG(INFO) << "Starting live calibration.";
+  if (IsPathAFile(FLAGS_input_path)) {
+    board_extractor.ExtractVideoToJson(FLAGS_input_path,
+                                       FLAGS_save_corners_json_path,
+                                       FLAGS_downsample_factor);
+  } else {
+    board_extractor.ExtractImageFolderToJson(FLAGS_input_path,
+                                             FLAGS_save_corners_json_path,
+                                             FLAGS_downsample_factor);
+  }
+
+  CHECK(live_calibrator.Finish(FLAGS_save_path_calib_dataset,
+                               board_extractor.GetCameraFps()))
+      << "Live calibration failed.";
+  live_calibrator.Calibrator().PrintResult();
+
+  return 0;
+}
@@ -23,9 +23,11 @@
 #include "OpenCameraCalibrator/io/read_gopro_imu_json.h"
 #include "OpenCameraCalibrator/io/read_misc.h"
 #include "OpenCameraCalibrator/io/read_telemetry.h"
+#include "OpenCameraCalibrator/io/write_trajectory.h"
 
 #include "OpenCameraCalibrator/io/read_scene.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/spline_error_weighting.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
@@ -33,6 +35,7 @@
 #include "theia/io/reconstruction_writer.h"
 #include "theia/io/write_ply_file.h"
 #include "theia/sfm/reconstruction.h"
+#include "theia/util/timer.h"
 
 // Input/output files.
 DEFINE_string(
@@ -57,7 +60,18 @@ DEFINE_bool(global_shutter, false, "If camera has a global shutter.");
 
 DEFINE_string(spline_error_weighting_json,
               "",
-              "Path to spline error weighting data");
+              "Path to spline error weighting data. If empty, the knot "
+              "spacings and weighting factors are computed from the "
+              "telemetry.");
+DEFINE_double(sew_quality_so3,
+              0.98,
+              "Spline error weighting quality of the rotation spline "
+              "(gyroscope), only used without spline_error_weighting_json.");
+DEFINE_double(sew_quality_r3,
+              0.96,
+              "Spline error weighting quality of the position spline "
+              "(accelerometer), only used without "
+              "spline_error_weighting_json.");
 DEFINE_string(output_path, "", "");
 DEFINE_bool(calibrate_cam_line_delay,
             false,
@@ -78,6 +92,55 @@ DEFINE_string(known_grav_dir_axis,
 DEFINE_string(debug_video_path,
               "",
               "Load the video to display the reprojection error.");
+DEFINE_int32(imu_collocation_points_per_knot,
+             0,
+             "If > 0, IMU samples are averaged to this many residuals per "
+             "knot interval instead of one residual per sample. Reduces the "
+             "problem size for high rate IMUs.");
+DEFINE_bool(compare_dense_imu,
+            false,
+            "With imu_collocation_points_per_knot > 0, also run the "
+            "calibration with one residual per IMU sample and report the "
+            "differences.");
+DEFINE_double(spline_window_s,
+              0.0,
+              "If > 0, the spline is optimized in windows of this length "
+              "[s] instead of one problem over the whole recording. Bounds "
+              "the solver memory for long recordings.");
+DEFINE_double(spline_window_overlap_s,
+              2.0,
+              "Overlap of consecutive spline windows [s]. Increased to at "
+              "least the support of one spline segment.");
+DEFINE_string(spline_solver,
+              "ceres",
+              "Solver of the spline problem: ceres or banded (block-banded "
+              "Cholesky of the knots with a Schur complement onto the "
+              "calibration parameters).");
+DEFINE_double(camera_robust_loss_width,
+              0.0,
+              "Huber loss width of the spline reprojection residuals, 0 "
+              "disables the robust loss.");
+DEFINE_int32(outlier_rejection_rounds,
+             0,
+             "Number of rounds that remove reprojection outliers and "
+             "re-optimize the spline after each optimization stage. 0 "
+             "disables the outlier rejection.");
+DEFINE_double(outlier_max_reproj_error,
+              3.0,
+              "Observations with a (information weighted) reprojection "
+              "error above this are removed as outliers.");
+DEFINE_int32(outlier_min_view_observations,
+             10,
+             "Views with fewer inlier observations are removed completely.");
+DEFINE_bool(adaptive_knots,
+            false,
+            "Place the spline knots non-uniformly by the local IMU "
+            "bandwidth. The spline error weighting spacing is kept in "
+            "dynamic parts, slow parts get sparser knots.");
+DEFINE_double(adaptive_knots_max_dt_factor,
+              4.0,
+              "Maximum knot spacing of the adaptive knots relative to the "
+              "spline error weighting spacing.");
 
 using json = nlohmann::json;
 
@@ -88,6 +151,9 @@ using namespace OpenICC::core;
 using namespace OpenICC::utils;
 using namespace OpenICC::io;
 
+// samples per block of the streamed trajectory export
+const size_t kExportBlockSize = 8192;
+
 int main(int argc, char* argv[]) {
   GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
 
@@ -175,53 +241,107 @@ int main(int argc, char* argv[]) {
       FLAGS_imu_intrinsics, FLAGS_imu_bias_file, acc_intr, gyr_intr))
       << "Could not open " << FLAGS_imu_intrinsics;
   std::cout << "Loaded IMU intrinsics.\n";
-  CHECK(FLAGS_spline_error_weighting_json != "")
-      << "You need to provide spline error weighting factors. Create with "
-         "get_sew_for_dataset.py.";
   SplineWeightingData weight_data;
-  CHECK(
-      ReadSplineErrorWeighting(FLAGS_spline_error_weighting_json, weight_data))
-      << "Could not open " << FLAGS_spline_error_weighting_json;
+  if (FLAGS_spline_error_weighting_json != "") {
+    CHECK(ReadSplineErrorWeighting(FLAGS_spline_error_weighting_json,
+                                   weight_data))
+        << "Could not open " << FLAGS_spline_error_weighting_json;
+  } else {
+    SplineErrorWeightingOptions sew_options;
+    sew_options.quality_so3 = FLAGS_sew_quality_so3;
+    sew_options.quality_r3 = FLAGS_sew_quality_r3;
+    theia::Timer sew_timer;
+    CHECK(ComputeSplineErrorWeighting(telemetry_data, sew_options, weight_data))
+        << "Not enough IMU measurements for the spline error weighting.";
+    weight_data.cam_fps = fps;
+    LOG(INFO) << "Spline error weighting computed in "
+              << sew_timer.ElapsedTimeInSeconds() * S_TO_MS << "ms.";
+  }
+  std::cout << "Knot spacing SO3/R3: " << weight_data.dt_so3 << "/"
+            << weight_data.dt_r3 << "s, weighting factors: "
+            << 1. / weight_data.std_so3 << "/" << 1. / weight_data.std_r3
+            << "\n";
 
   double init_line_delay_us = 1. / fps / camera.ImageHeight();
   if (FLAGS_global_shutter) {
     init_line_delay_us = 0.0;
   }
 
-  ImuCameraCalibrator imu_cam_calibrator;
-  imu_cam_calibrator.BatchInitSpline(recon_calib_dataset,
-                                     T_i_c_init,
-                                     weight_data,
-                                     time_offset_imu_to_cam,
-                                     telemetry_data,
-                                     init_line_delay_us,
-                                     acc_intr,
-                                     gyr_intr);
   const int grav_dir_axis = GravDirStringToInt(FLAGS_known_grav_dir_axis);
   int flags = SplineOptimFlags::SPLINE | SplineOptimFlags::T_I_C;
   if (FLAGS_reestimate_biases) {
     flags |= SplineOptimFlags::IMU_BIASES;
   }
-  if (grav_dir_axis != -1) {
-    Eigen::Vector3d grav_dir(0, 0, 0);
-    grav_dir[grav_dir_axis] = FLAGS_gravity_const;
-    imu_cam_calibrator.SetKnownGravityDir(grav_dir);
-    std::cout << "Setting a-priori gravity direction supplied by the user to: "
-              << grav_dir.transpose() << "\n";
-  } else {
+  if (grav_dir_axis == -1) {
     flags |= SplineOptimFlags::GRAVITY_DIR;
   }
+  // all estimated parameters, used for the uncertainty of the calibration
+  int covariance_flags = flags;
+  const bool optimize_line_delay =
+      FLAGS_calibrate_cam_line_delay && !FLAGS_global_shutter;
+  if (optimize_line_delay) {
+    covariance_flags |= SplineOptimFlags::CAM_LINE_DELAY;
+  }
 
-  double reproj_error = imu_cam_calibrator.Optimize(50, flags);
+  // returns the reprojection errors after the spline and line delay stage
+  auto calibrate = [&](ImuCameraCalibrator& calibrator,
+                       const int imu_collocation_points_per_knot,
+                       double& reproj_error,
+                       double& reproj_error_after_ld) {
+    calibrator.SetImuCollocationPointsPerKnot(imu_collocation_points_per_knot);
+    calibrator.SetSplineWindow(FLAGS_spline_window_s,
+                               FLAGS_spline_window_overlap_s);
+    calibrator.trajectory_.SetSolverType(FLAGS_spline_solver == "banded"
+                                             ? SplineSolverType::BANDED
+                                             : SplineSolverType::CERES);
+    calibrator.SetCameraRobustLossWidth(FLAGS_camera_robust_loss_width);
+    calibrator.SetOutlierRejection(FLAGS_outlier_rejection_rounds,
+                                   FLAGS_outlier_max_reproj_error,
+                                   FLAGS_outlier_min_view_observations);
+    calibrator.SetAdaptiveKnots(FLAGS_adaptive_knots,
+                                FLAGS_adaptive_knots_max_dt_factor);
+    calibrator.BatchInitSpline(recon_calib_dataset,
+                               T_i_c_init,
+                               weight_data,
+                               time_offset_imu_to_cam,
+                               telemetry_data,
+                               init_line_delay_us,
+                               acc_intr,
+                               gyr_intr);
+    if (grav_dir_axis != -1) {
+      Eigen::Vector3d grav_dir(0, 0, 0);
+      grav_dir[grav_dir_axis] = FLAGS_gravity_const;
+      calibrator.SetKnownGravityDir(grav_dir);
+      std::cout
+          << "Setting a-priori gravity direction supplied by the user to: "
+          << grav_dir.transpose() << "\n";
+    }
+    reproj_error = calibrator.Optimize(50, flags);
+    reproj_error_after_ld = reproj_error;
+    if (optimize_line_delay) {
+      reproj_error_after_ld =
+          calibrator.Optimize(10, SplineOptimFlags::CAM_LINE_DELAY);
+    }
+  };
+
+  ImuCameraCalibrator imu_cam_calibrator;
+  double reproj_error = 0.0, reproj_error_after_ld = 0.0;
+  theia::Timer timer;
+  calibrate(imu_cam_calibrator,
+            FLAGS_imu_collocation_points_per_knot,
+            reproj_error,
+            reproj_error_after_ld);
+  const double calibration_time_s = timer.ElapsedTimeInSeconds();
 
-  double reproj_error_after_ld = reproj_error;
-  if (FLAGS_calibrate_cam_line_delay && !FLAGS_global_shutter) {
-    flags = SplineOptimFlags::CAM_LINE_DELAY;
-    reproj_error_after_ld = imu_cam_calibrator.Optimize(10, flags);
-  }
   LOG(INFO) << "Mean reprojection error " << reproj_error << "px\n";
   LOG(INFO) << "Mean reprojection error after line delay optim "
             << reproj_error_after_ld << "px\n";
+  if (FLAGS_outlier_rejection_rounds > 0) {
+    std::cout << "Removed outliers: "
+              << imu_cam_calibrator.GetNumRemovedObservations()
+              << " observations, " << imu_cam_calibrator.GetNumRemovedViews()
+              << " views.\n";
+  }
 
   std::cout << "g: " << imu_cam_calibrator.trajectory_.GetGravity().transpose()
             << std::endl;
@@ -256,87 +376,181 @@ int main(int argc, char* argv[]) {
   json_calibspline_results_out["final_reproj_error"] = reproj_error;
   json_calibspline_results_out["r3_dt"] = weight_data.dt_r3;
   json_calibspline_results_out["so3_dt"] = weight_data.dt_so3;
+  json_calibspline_results_out["nr_so3_knots"] =
+      imu_cam_calibrator.GetNumSO3Knots();
+  json_calibspline_results_out["nr_r3_knots"] =
+      imu_cam_calibrator.GetNumR3Knots();
   json_calibspline_results_out["init_line_delay_us"] =
       init_line_delay_us * S_TO_US;
   json_calibspline_results_out["calib_line_delay_us"] = calib_line_delay_us;
   json_calibspline_results_out["time_offset_imu_to_cam_s"] =
       time_offset_imu_to_cam;
 
+  json_calibspline_results_out["nr_imu_residuals"] =
+      imu_cam_calibrator.GetNumImuResiduals();
+  json_calibspline_results_out["calibration_time_s"] = calibration_time_s;
+  json_calibspline_results_out["nr_removed_observations"] =
+      imu_cam_calibrator.GetNumRemovedObservations();
+  json_calibspline_results_out["nr_removed_views"] =
+      imu_cam_calibrator.GetNumRemovedViews();
+
+  if (FLAGS_compare_dense_imu && FLAGS_imu_collocation_points_per_knot > 0) {
+    std::cout << "Running the calibration with one residual per IMU sample "
+                 "for comparison.\n";
+    ImuCameraCalibrator dense_calibrator;
+    double dense_reproj_error = 0.0, dense_reproj_error_after_ld = 0.0;
+    timer.Reset();
+    calibrate(dense_calibrator,
+              0,
+              dense_reproj_error,
+              dense_reproj_error_after_ld);
+    const double dense_time_s = timer.ElapsedTimeInSeconds();
+
+    const Sophus::SE3d T_dense_collocated =
+        dense_calibrator.trajectory_.GetT_i_c().inverse() *
+        imu_cam_calibrator.trajectory_.GetT_i_c();
+    const double delta_t_i_c_m = T_dense_collocated.translation().norm();
+    const double delta_r_i_c_deg = T_dense_collocated.so3().log().norm() * R2D;
+    const double delta_line_delay_us =
+        (imu_cam_calibrator.GetCalibratedRSLineDelay() -
+         dense_calibrator.GetCalibratedRSLineDelay()) *
+        S_TO_US;
+    std::cout << "IMU residuals collocated/dense: "
+              << imu_cam_calibrator.GetNumImuResiduals() << "/"
+              << dense_calibrator.GetNumImuResiduals() << "\n";
+    std::cout << "Calibration time collocated/dense [s]: "
+              << calibration_time_s << "/" << dense_time_s << "\n";
+    std::cout << "Reprojection error collocated/dense [px]: "
+              << reproj_error_after_ld << "/" << dense_reproj_error_after_ld
+              << "\n";
+    std::cout << "T_i_c difference translation [m]: " << delta_t_i_c_m
+              << " rotation [deg]: " << delta_r_i_c_deg << "\n";
+    std::cout << "Line delay difference [us]: " << delta_line_delay_us << "\n";
+
+    auto& comparison = json_calibspline_results_out["dense_imu_comparison"];
+    comparison["nr_imu_residuals"] = dense_calibrator.GetNumImuResiduals();
+    comparison["calibration_time_s"] = dense_time_s;
+    comparison["final_reproj_error"] = dense_reproj_error;
+    comparison["delta_t_i_c_m"] = delta_t_i_c_m;
+    comparison["delta_r_i_c_deg"] = delta_r_i_c_deg;
+    comparison["delta_line_delay_us"] = delta_line_delay_us;
+  }
+
+  Eigen::Matrix<double, 6, 6> cov_T_i_c;
+  double var_line_delay;
+  if (imu_cam_calibrator.trajectory_.GetCalibrationCovariance(
+          covariance_flags, cov_T_i_c, var_line_delay)) {
+    // SE3 tangent order: translation, rotation
+    const Eigen::Matrix<double, 6, 1> std_T_i_c =
+        cov_T_i_c.diagonal().cwiseMax(0.0).cwiseSqrt();
+    const double std_line_delay_us =
+        std::sqrt(std::max(var_line_delay, 0.0)) * S_TO_US;
+    std::cout << "T_i_c std translation [m]: "
+              << std_T_i_c.head<3>().transpose() << " rotation [deg]: "
+              << std_T_i_c.tail<3>().transpose() * R2D << "\n";
+    std::cout << "Line delay std [us]: " << std_line_delay_us << "\n";
+    std::vector<std::vector<double>> cov_rows(6);
+    for (int r = 0; r < 6; ++r) {
+      for (int c = 0; c < 6; ++c) {
+        cov_rows[r].push_back(cov_T_i_c(r, c));
+      }
+    }
+    json_calibspline_results_out["T_i_c_covariance"] = cov_rows;
+    json_calibspline_results_out["t_i_c_std_m"] = {
+        std_T_i_c[0], std_T_i_c[1], std_T_i_c[2]};
+    json_calibspline_results_out["r_i_c_std_deg"] = {std_T_i_c[3] * R2D,
+                                                     std_T_i_c[4] * R2D,
+                                                     std_T_i_c[5] * R2D};
+    json_calibspline_results_out["calib_line_delay_std_us"] =
+        std_line_delay_us;
+  } else {
+    LOG(WARNING) << "Could not compute the calibration covariance.";
+  }
+
   std::vector<double> cam_timestamps_s = imu_cam_calibrator.GetCamTimestamps();
   std::sort(cam_timestamps_s.begin(), cam_timestamps_s.end(), std::less<>());
 
-  aligned_map<double, Eigen::Vector3d> gyro_meas =
-      imu_cam_calibrator.GetGyroMeasurements();
-  aligned_map<double, Eigen::Vector3d> accl_meas =
-      imu_cam_calibrator.GetAcclMeasurements();
-
-  // Evaluate spline for all accelerometer and gyro and output them
-  for (auto& g : gyro_meas) {
-    const int64_t t_ns = g.first * S_TO_NS;
-    const std::string t_ns_s = std::to_string(t_ns);
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_imu"]["x"] =
-        g.second[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_imu"]["y"] =
-        g.second[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_imu"]["z"] =
-        g.second[2];
-    // write out spline estimates
-    Eigen::Vector3d gyro_spline;
-    imu_cam_calibrator.trajectory_.GetAngularVelocity(t_ns, gyro_spline);
-
-    const auto bias = imu_cam_calibrator.trajectory_.GetGyroBias(t_ns);
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_spline"]["x"] =
-        gyro_spline[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_spline"]["y"] =
-        gyro_spline[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_spline"]["z"] =
-        gyro_spline[2];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_bias"]["x"] =
-        bias[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_bias"]["y"] =
-        bias[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["gyro_bias"]["z"] =
-        bias[2];
+  const timed_vec3_vector& gyro_meas = imu_cam_calibrator.GetGyroMeasurements();
+  const timed_vec3_vector& accl_meas = imu_cam_calibrator.GetAcclMeasurements();
+
+  // Evaluate the spline at all accelerometer and gyro timestamps and stream
+  // the results block-wise to binary tables next to the result json
+  std::string result_stem = FLAGS_result_output_json;
+  const size_t ext_pos = result_stem.rfind(".json");
+  if (ext_pos != std::string::npos) {
+    result_stem = result_stem.substr(0, ext_pos);
   }
-  for (auto& a : accl_meas) {
-    const int64_t t_ns = a.first * S_TO_NS;
-    const std::string t_ns_s = std::to_string(t_ns);
-    // accelerometer
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_imu"]["x"] =
-        a.second[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_imu"]["y"] =
-        a.second[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_imu"]["z"] =
-        a.second[2];
-    // write out spline estimates
-    Eigen::Vector3d accl_spline;
-    imu_cam_calibrator.trajectory_.GetAcceleration(t_ns, accl_spline);
-    const auto bias = imu_cam_calibrator.trajectory_.GetAcclBias(t_ns);
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_spline"]["x"] =
-        accl_spline[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_spline"]["y"] =
-        accl_spline[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_spline"]["z"] =
-        accl_spline[2];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_bias"]["x"] =
-        bias[0];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_bias"]["y"] =
-        bias[1];
-    json_calibspline_results_out["trajectory"][t_ns_s]["accl_bias"]["z"] =
-        bias[2];
+  const auto file_name = [](const std::string& path) {
+    return path.substr(path.find_last_of('/') + 1);
+  };
+  const auto export_imu_trajectory = [&](const timed_vec3_vector& meas,
+                                         const std::string& sensor,
+                                         const std::string& output_file) {
+    io::TrajectoryTableWriter writer;
+    CHECK(writer.Open(output_file,
+                      {{sensor + "_imu", 3},
+                       {sensor + "_spline", 3},
+                       {sensor + "_bias", 3}}))
+        << "Could not write " << output_file;
+    const bool is_gyro = sensor == "gyro";
+    TrajectorySamples samples;
+    std::vector<int64_t> times_ns;
+    Eigen::Matrix3Xd meas_block;
+    for (size_t start = 0; start < meas.size(); start += kExportBlockSize) {
+      const size_t nr_samples =
+          std::min(kExportBlockSize, meas.size() - start);
+      times_ns.resize(nr_samples);
+      meas_block.resize(3, nr_samples);
+      for (size_t i = 0; i < nr_samples; ++i) {
+        times_ns[i] = meas[start + i].first * S_TO_NS;
+        meas_block.col(i) = meas[start + i].second;
+      }
+      imu_cam_calibrator.trajectory_.EvaluateTrajectory(times_ns, samples);
+      CHECK(writer.WriteBlock(
+          times_ns,
+          {meas_block,
+           is_gyro ? samples.angular_velocities : samples.accelerations,
+           is_gyro ? samples.gyro_biases : samples.accl_biases}))
+          << "Could not write " << output_file;
+    }
+    CHECK(writer.Close()) << "Could not write " << output_file;
+    json_calibspline_results_out[sensor + "_trajectory_file"] =
+        file_name(output_file);
+  };
+  export_imu_trajectory(
+      gyro_meas, "gyro", result_stem + "_gyro_trajectory.bin");
+  export_imu_trajectory(
+      accl_meas, "accl", result_stem + "_accl_trajectory.bin");
+
+  // read camera calibration
+  theia::Reconstruction output_spline_recon;
+  std::vector<int64_t> cam_times_ns(cam_timestamps_s.size());
+  for (size_t i = 0; i < cam_timestamps_s.size(); ++i) {
+    cam_times_ns[i] = cam_timestamps_s[i] * S_TO_NS;
   }
+  TrajectorySamples cam_samples;
+  imu_cam_calibrator.trajectory_.EvaluateTrajectory(cam_times_ns,
+                                                    cam_samples);
+  // IMU poses at the camera timestamps, q_w_i as x, y, z, w
+  const std::string cam_trajectory_file =
+      result_stem + "_cam_trajectory.bin";
+  io::TrajectoryTableWriter cam_writer;
+  CHECK(cam_writer.Open(cam_trajectory_file, {{"q_w_i", 4}, {"p_w_i", 3}}) &&
+        cam_writer.WriteBlock(
+            cam_times_ns, {cam_samples.orientations, cam_samples.positions}) &&
+        cam_writer.Close())
+      << "Could not write " << cam_trajectory_file;
+  json_calibspline_results_out["cam_trajectory_file"] =
+      file_name(cam_trajectory_file);
 
   std::ofstream calibspline_output_json_file(FLAGS_result_output_json);
   calibspline_output_json_file << std::setw(4) << json_calibspline_results_out
                                << std::endl;
   calibspline_output_json_file.close();
 
-  // read camera calibration
-  theia::Reconstruction output_spline_recon;
-  for (size_t i = 0; i < cam_timestamps_s.size(); ++i) {
-    const int64_t t_ns = cam_timestamps_s[i] * S_TO_NS;
-    Sophus::SE3d T_w_i;
-    imu_cam_calibrator.trajectory_.GetPose(t_ns, T_w_i);
+  for (size_t i = 0; i < cam_times_ns.size(); ++i) {
+    const int64_t t_ns = cam_times_ns[i];
+    const Sophus::SE3d T_w_i = cam_samples.Pose(i);
     Sophus::SE3d T_w_c = T_w_i * imu_cam_calibrator.trajectory_.GetT_i_c();
     theia::ViewId v_id_theia =
         output_spline_recon.AddView(std::to_string(t_ns), 0, t_ns);
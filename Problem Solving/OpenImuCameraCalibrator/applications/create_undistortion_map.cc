@@ -0,0 +1,110 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <theia/util/timer.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <Eigen/Geometry>
+
+#include <sstream>
+#include <thread>
+
+#include "OpenCameraCalibrator/io/read_camera_calibration.h"
+#include "OpenCameraCalibrator/io/undistortion_map.h"
+#include "OpenCameraCalibrator/utils/undistortion_map.h"
+
+using namespace OpenICC;
+
+DEFINE_string(camera_calibration_json,
+              "",
+              "Camera calibration written by calibrate_camera.");
+DEFINE_string(output_map, "", "Path of the binary undistortion map.");
+DEFINE_int32(output_width, 0, "Width of the undistorted image, 0 = camera.");
+DEFINE_int32(output_height, 0, "Height of the undistorted image, 0 = camera.");
+DEFINE_double(horizontal_fov_deg,
+              0.0,
+              "Horizontal field of view of the undistorted image in degree. 0 "
+              "keeps the focal length of the camera.");
+DEFINE_string(rectify_rotation,
+              "",
+              "Optional rotation from the undistorted to the camera frame as "
+              "comma separated angle axis (rx,ry,rz) in radian.");
+DEFINE_string(test_image,
+              "",
+              "Optional image of the camera that is undistorted with the map "
+              "and written next to the map for inspection.");
+
+int main(int argc, char* argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  theia::Camera camera;
+  double fps;
+  CHECK(io::read_camera_calibration(FLAGS_camera_calibration_json, camera, fps))
+      << "Could not read camera calibration: "
+      << FLAGS_camera_calibration_json;
+
+  utils::UndistortionMapOptions options;
+  options.width = FLAGS_output_width;
+  options.height = FLAGS_output_height;
+  options.horizontal_fov_deg = FLAGS_horizontal_fov_deg;
+  options.num_threads = std::thread::hardware_concurrency();
+  if (!FLAGS_rectify_rotation.empty()) {
+    std::stringstream rotation_list(FLAGS_rectify_rotation);
+    std::string value;
+    Eigen::Vector3d angle_axis;
+    for (int i = 0; i < 3; ++i) {
+      CHECK(std::getline(rotation_list, value, ','))
+          << "rectify_rotation needs three values.";
+      angle_axis[i] = std::stod(value);
+    }
+    if (angle_axis.norm() > 0.0) {
+      options.rotation =
+          Eigen::AngleAxisd(angle_axis.norm(), angle_axis.normalized())
+              .toRotationMatrix();
+    }
+  }
+
+  theia::Timer timer;
+  utils::UndistortionMap map;
+  CHECK(utils::ComputeUndistortionMap(camera, options, map))
+      << "Invalid output size or field of view.";
+  const double time_map = timer.ElapsedTimeInSeconds();
+
+  CHECK(io::write_undistortion_map(FLAGS_output_map, map))
+      << "Could not write undistortion map: " << FLAGS_output_map;
+
+  std::cout << "Undistortion map " << map.width << "x" << map.height
+            << " (focal length " << map.focal_length << "px) computed in "
+            << time_map * 1e3 << "ms\n";
+
+  if (!FLAGS_test_image.empty()) {
+    const cv::Mat image = cv::imread(FLAGS_test_image);
+    CHECK(!image.empty()) << "Could not read: " << FLAGS_test_image;
+    const cv::Mat map_xy(
+        map.height, map.width, CV_16SC2, map.map_xy.data());
+    const cv::Mat map_interp(
+        map.height, map.width, CV_16UC1, map.map_interp.data());
+    cv::Mat undistorted;
+    cv::remap(image, undistorted, map_xy, map_interp, cv::INTER_LINEAR);
+    cv::imwrite(FLAGS_output_map + "_undistorted.png", undistorted);
+  }
+
+  return 0;
+}
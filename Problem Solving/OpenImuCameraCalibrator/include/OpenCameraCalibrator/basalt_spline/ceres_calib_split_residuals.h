@@ -18,8 +18,79 @@
 
 #include <sophus/so3.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <vector>
+
 static constexpr int BIAS_SPLINE_N = 3;
 
+//! Cost function for spline functors with parameter block sizes that are
+//! known at compile time, e.g. the IMU residuals. The functor has the
+//! signature of a ceres::DynamicAutoDiffCostFunction functor. In contrast to
+//! the dynamic version, which evaluates the functor once per stride of
+//! derivatives with heap allocated Jets, the Jacobians of all
+//! kNumParameters are computed in one pass with a fixed-size Jet on the
+//! stack.
+template <class Functor, int kNumResiduals, int kNumParameters>
+class FixedSizeSplineCostFunction : public ceres::CostFunction {
+ public:
+  using JetT = ceres::Jet<double, kNumParameters>;
+
+  //! takes ownership of functor
+  FixedSizeSplineCostFunction(Functor* functor,
+                              const std::vector<int>& block_sizes)
+      : functor_(functor) {
+    CHECK_EQ(std::accumulate(block_sizes.begin(), block_sizes.end(), 0),
+             kNumParameters);
+    set_num_residuals(kNumResiduals);
+    *mutable_parameter_block_sizes() = block_sizes;
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    if (jacobians == nullptr) {
+      return (*functor_)(parameters, residuals);
+    }
+
+    const std::vector<int32_t>& block_sizes = parameter_block_sizes();
+    const int num_blocks = static_cast<int>(block_sizes.size());
+    JetT jets[kNumParameters];
+    const JetT* jet_blocks[kNumParameters];
+    for (int b = 0, offset = 0; b < num_blocks; offset += block_sizes[b++]) {
+      jet_blocks[b] = jets + offset;
+      for (int i = 0; i < block_sizes[b]; ++i) {
+        jets[offset + i] = JetT(parameters[b][i], offset + i);
+      }
+    }
+
+    JetT jet_residuals[kNumResiduals];
+    if (!(*functor_)(jet_blocks, jet_residuals)) {
+      return false;
+    }
+
+    for (int r = 0; r < kNumResiduals; ++r) {
+      residuals[r] = jet_residuals[r].a;
+    }
+    for (int b = 0, offset = 0; b < num_blocks; offset += block_sizes[b++]) {
+      if (jacobians[b] == nullptr) {
+        continue;
+      }
+      for (int r = 0; r < kNumResiduals; ++r) {
+        for (int i = 0; i < block_sizes[b]; ++i) {
+          jacobians[b][r * block_sizes[b] + i] = jet_residuals[r].v[offset + i];
+        }
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::unique_ptr<Functor> functor_;
+};
+
 template <int _N>
 struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
   static constexpr int N = _N;        // Order of the spline.
@@ -31,6 +102,21 @@ struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
   using Vec3 = Eigen::Matrix<double, 3, 1>;
   using Mat3 = Eigen::Matrix<double, 3, 3>;
 
+  //! so3 knots, r3 knots, bias knots, gravity, accelerometer intrinsics
+  static constexpr int kNumParameters =
+      N * 4 + N * 3 + BIAS_SPLINE_N * 3 + 3 + 6;
+
+  static std::vector<int> BlockSizes() {
+    std::vector<int> block_sizes(N, 4);
+    block_sizes.insert(block_sizes.end(), N, 3);
+    block_sizes.insert(block_sizes.end(), BIAS_SPLINE_N, 3);
+    block_sizes.push_back(3);
+    block_sizes.push_back(6);
+    return block_sizes;
+  }
+
+  //! so3_blending and r3_blending are the blending matrices of the spline
+  //! segments for non-uniform knots (not owned), nullptr for uniform knots
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   AccelerationCostFunctorSplit(const Eigen::Vector3d& measurement,
                                double u_r3,
@@ -39,7 +125,9 @@ struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
                                double inv_so3_dt,
                                double inv_std,
                                double u_bias,
-                               double inv_bias_dt)
+                               double inv_bias_dt,
+                               const double* so3_blending = nullptr,
+                               const double* r3_blending = nullptr)
       : measurement(measurement),
         u_r3(u_r3),
         inv_r3_dt(inv_r3_dt),
@@ -47,7 +135,9 @@ struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
         inv_so3_dt(inv_so3_dt),
         inv_std(inv_std),
         u_bias(u_bias),
-        inv_bias_dt(inv_bias_dt) {}
+        inv_bias_dt(inv_bias_dt),
+        so3_blending(so3_blending),
+        r3_blending(r3_blending) {}
 
   template <class T>
   bool operator()(T const* const* sKnots, T* sResiduals) const {
@@ -57,12 +147,12 @@ struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
     Eigen::Map<Vector3> residuals(sResiduals);
 
     Sophus::SO3<T> R_w_i;
-    CeresSplineHelper<T, N>::template evaluate_lie<Sophus::SO3>(
-        sKnots, T(u_so3), T(inv_so3_dt), &R_w_i);
+    CeresSplineHelper<T, N>::template evaluate_lie_segment<Sophus::SO3>(
+        sKnots, T(u_so3), T(inv_so3_dt), so3_blending, &R_w_i);
 
     Vector3 accel_w;
-    CeresSplineHelper<T, N>::template evaluate<3, 2>(
-        sKnots + N, T(u_r3), T(inv_r3_dt), &accel_w);
+    CeresSplineHelper<T, N>::template evaluate_segment<3, 2>(
+        sKnots + N, T(u_r3), T(inv_r3_dt), r3_blending, &accel_w);
 
     Vector3 bias_spline;
     CeresSplineHelper<T, BIAS_SPLINE_N>::template evaluate<3, 0>(
@@ -101,6 +191,8 @@ struct AccelerationCostFunctorSplit : public CeresSplineHelper<double, _N> {
   // bias spline
   double u_bias;
   double inv_bias_dt;
+  const double* so3_blending;
+  const double* r3_blending;
 };
 
 template <int _N, template <class> class GroupT, bool OLD_TIME_DERIV>
@@ -116,19 +208,33 @@ struct GyroCostFunctorSplit : public CeresSplineHelper<double, _N> {
 
   using Tangentd = typename GroupT<double>::Tangent;
 
+  //! so3 knots, bias knots, gyroscope intrinsics
+  static constexpr int kNumParameters = N * 4 + BIAS_SPLINE_N * 3 + 9;
+
+  static std::vector<int> BlockSizes() {
+    std::vector<int> block_sizes(N, 4);
+    block_sizes.insert(block_sizes.end(), BIAS_SPLINE_N, 3);
+    block_sizes.push_back(9);
+    return block_sizes;
+  }
+
+  //! so3_blending is the cumulative blending matrix of the spline segment
+  //! for non-uniform knots (not owned), nullptr for uniform knots
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   GyroCostFunctorSplit(const Eigen::Vector3d& measurement,
                        double u_so3,
                        double inv_so3_dt,
                        double inv_std,
                        double u_bias,
-                       double inv_bias_dt)
+                       double inv_bias_dt,
+                       const double* so3_blending = nullptr)
       : measurement(measurement),
         u_so3(u_so3),
         inv_so3_dt(inv_so3_dt),
         inv_std(inv_std),
         u_bias(u_bias),
-        inv_bias_dt(inv_bias_dt) {}
+        inv_bias_dt(inv_bias_dt),
+        so3_blending(so3_blending) {}
 
   template <class T>
   bool operator()(T const* const* sKnots, T* sResiduals) const {
@@ -140,8 +246,8 @@ struct GyroCostFunctorSplit : public CeresSplineHelper<double, _N> {
 
     Tangent rot_vel;
 
-    CeresSplineHelper<T, N>::template evaluate_lie<GroupT>(
-        sKnots, T(u_so3), T(inv_so3_dt), nullptr, &rot_vel);
+    CeresSplineHelper<T, N>::template evaluate_lie_segment<GroupT>(
+        sKnots, T(u_so3), T(inv_so3_dt), so3_blending, nullptr, &rot_vel);
 
     Vector3 bias_spline;
     CeresSplineHelper<T, BIAS_SPLINE_N>::template evaluate<3, 0>(
@@ -175,10 +281,11 @@ struct GyroCostFunctorSplit : public CeresSplineHelper<double, _N> {
   // bias
   double u_bias, inv_std_bias;
   double inv_bias_dt;
+  const double* so3_blending;
 };
 
 template <int _N>
-struct GSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
+struct RSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
   static constexpr int N = _N;        // Order of the spline.
   static constexpr int DEG = _N - 1;  // Degree of the spline.
 
@@ -189,7 +296,7 @@ struct GSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
   using Mat3 = Eigen::Matrix<double, 3, 3>;
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-  GSReprojectionCostFunctorSplit(const theia::View* view,
+  RSReprojectionCostFunctorSplit(const theia::View* view,
                                  const theia::Reconstruction* image_data,
                                  const double u_so3,
                                  const double u_r3,
@@ -207,10 +314,12 @@ struct GSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
   bool operator()(T const* const* sKnots, T* sResiduals) const {
     using Vector3 = Eigen::Matrix<T, 3, 1>;
     using Vector4 = Eigen::Matrix<T, 4, 1>;
+    using Vector1 = Eigen::Matrix<T, 1, 1>;
     using Matrix4 = Eigen::Matrix<T, 4, 4>;
 
     const int N2 = 2 * N;
     Eigen::Map<Sophus::SE3<T> const> const T_i_c(sKnots[N2]);
+    Eigen::Map<Vector1 const> const line_delay(sKnots[N2 + 1]);
 
     const auto cam = view->Camera();
     const auto cam_model = cam.GetCameraIntrinsicsModelType();
@@ -220,25 +329,29 @@ struct GSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
       intr[i] = T(cam.intrinsics()[i]);
     }
 
-    const T t_so3_row = T(u_so3);
-    const T t_r3_row = T(u_r3);
+    // if we have a rolling shutter cam we will always need to evaluate with
+    // line delay
+    for (size_t i = 0; i < track_ids.size(); ++i) {
+      const auto feature = *view->GetFeature(track_ids[i]);
 
-    Sophus::SO3<T> R_w_i;
-    CeresSplineHelper<T, N>::template evaluate_lie<Sophus::SO3>(
-        sKnots, t_so3_row, T(inv_so3_dt), &R_w_i);
+      // get time for respective RS line
+      const T y_coord = T(feature.y()) * line_delay[0];
+      const T t_so3_row = T(u_so3) + y_coord;
+      const T t_r3_row = T(u_r3) + y_coord;
 
-    Vector3 t_w_i;
-    CeresSplineHelper<T, N>::template evaluate<3, 0>(
-        sKnots + N, t_r3_row, T(inv_r3_dt), &t_w_i);
+      Sophus::SO3<T> R_w_i;
+      CeresSplineHelper<T, N>::template evaluate_lie<Sophus::SO3>(
+          sKnots, t_so3_row, T(inv_so3_dt), &R_w_i);
 
-    Sophus::SE3<T> T_w_c = Sophus::SE3<T>(R_w_i, t_w_i) * T_i_c;
-    Matrix4 T_c_w_matrix = T_w_c.inverse().matrix();
+      Vector3 t_w_i;
+      CeresSplineHelper<T, N>::template evaluate<3, 0>(
+          sKnots + N, t_r3_row, T(inv_r3_dt), &t_w_i);
 
-    for (size_t i = 0; i < track_ids.size(); ++i) {
-      const auto feature = *view->GetFeature(track_ids[i]);
+      Sophus::SE3<T> T_w_c = Sophus::SE3<T>(R_w_i, t_w_i) * T_i_c;
+      Matrix4 T_c_w_matrix = T_w_c.inverse().matrix();
 
       // get corresponding 3d point
-      Eigen::Map<Vector4 const> const scene_point(sKnots[N2 + i]);
+      Eigen::Map<Vector4 const> const scene_point(sKnots[N2 + 2 + i]);
 
       Vector3 p3d = (T_c_w_matrix * scene_point).hnormalized();
 
@@ -290,123 +403,439 @@ struct GSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
   double inv_r3_dt;
 };
 
-template <int _N>
-struct RSReprojectionCostFunctorSplit : public CeresSplineHelper<double, _N> {
-  static constexpr int N = _N;        // Order of the spline.
-  static constexpr int DEG = _N - 1;  // Degree of the spline.
-
-  using MatN = Eigen::Matrix<double, _N, _N>;
-  using VecN = Eigen::Matrix<double, _N, 1>;
+//! Reprojection residuals of all board observations of one view for a
+//! global (kRollingShutter = false) or rolling shutter camera. Parameter
+//! blocks: N so3 knots, N r3 knots, T_i_c, [line delay,] one homogeneous
+//! board point per observation.
+//!
+//! The camera model is a template parameter, see
+//! CreateSplineReprojectionCostFunction. Intrinsics, features and their
+//! information weights are copied once at construction. Derivatives of the
+//! camera pose w.r.t. the spline knots, T_i_c (and line delay) are computed
+//! in a single pass of a fixed-size Jet, once per view for a global shutter
+//! and once per observation for a rolling shutter camera. They are chained
+//! with the analytic derivatives of the point transformation and a 3-dim Jet
+//! of the projection, which also gives the board point Jacobians.
+template <int _N, class CameraModel, bool kRollingShutter>
+class SplineReprojectionCostFunction : public ceres::CostFunction {
+ public:
+  static constexpr int N = _N;
+  static constexpr int kIntrinsicsSize = CameraModel::kIntrinsicsSize;
+  //! so3 knots, r3 knots, T_i_c and the line delay
+  static constexpr int kNumPoseBlocks = 2 * N + 1 + (kRollingShutter ? 1 : 0);
+  static constexpr int kNumPoseParameters =
+      N * 4 + N * 3 + 7 + (kRollingShutter ? 1 : 0);
+  using PoseJetT = ceres::Jet<double, kNumPoseParameters>;
+  using ProjJetT = ceres::Jet<double, 3>;
 
   using Vec3 = Eigen::Matrix<double, 3, 1>;
   using Mat3 = Eigen::Matrix<double, 3, 3>;
 
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-  RSReprojectionCostFunctorSplit(const theia::View* view,
-                                 const theia::Reconstruction* image_data,
+  SplineReprojectionCostFunction(const theia::View* view,
+                                 const std::vector<theia::TrackId>& track_ids,
                                  const double u_so3,
                                  const double u_r3,
                                  const double inv_so3_dt,
                                  const double inv_r3_dt,
-                                 std::vector<theia::TrackId> track_ids)
-      : view(view),
-        image_data(image_data),
-        u_so3(u_so3),
-        u_r3(u_r3),
-        inv_so3_dt(inv_so3_dt),
-        inv_r3_dt(inv_r3_dt),
-        track_ids(track_ids) {}
-  template <class T>
-  bool operator()(T const* const* sKnots, T* sResiduals) const {
-    using Vector3 = Eigen::Matrix<T, 3, 1>;
-    using Vector4 = Eigen::Matrix<T, 4, 1>;
-    using Vector1 = Eigen::Matrix<T, 1, 1>;
-    using Matrix4 = Eigen::Matrix<T, 4, 4>;
+                                 const double* so3_blending = nullptr,
+                                 const double* r3_blending = nullptr)
+      : u_so3_(u_so3),
+        u_r3_(u_r3),
+        inv_so3_dt_(inv_so3_dt),
+        inv_r3_dt_(inv_r3_dt),
+        so3_blending_(so3_blending),
+        r3_blending_(r3_blending) {
+    const theia::Camera& camera = view->Camera();
+    CHECK_EQ(camera.CameraIntrinsics()->NumParameters(), kIntrinsicsSize);
+    std::copy(camera.intrinsics(),
+              camera.intrinsics() + kIntrinsicsSize,
+              intrinsics_);
+
+    const int nr_obs = static_cast<int>(track_ids.size());
+    features_.resize(2, nr_obs);
+    sqrt_information_.resize(2, nr_obs);
+    for (int i = 0; i < nr_obs; ++i) {
+      const theia::Feature& feature = *view->GetFeature(track_ids[i]);
+      features_.col(i) = Eigen::Vector2d(feature.x(), feature.y());
+      sqrt_information_(0, i) = 1. / std::sqrt(feature.covariance_(0, 0));
+      sqrt_information_(1, i) = 1. / std::sqrt(feature.covariance_(1, 1));
+    }
 
-    const int N2 = 2 * N;
-    Eigen::Map<Sophus::SE3<T> const> const T_i_c(sKnots[N2]);
-    Eigen::Map<Vector1 const> const line_delay(sKnots[N2 + 1]);
+    set_num_residuals(2 * nr_obs);
+    for (int i = 0; i < N; ++i) {
+      mutable_parameter_block_sizes()->push_back(4);
+    }
+    for (int i = 0; i < N; ++i) {
+      mutable_parameter_block_sizes()->push_back(3);
+    }
+    mutable_parameter_block_sizes()->push_back(7);
+    if (kRollingShutter) {
+      mutable_parameter_block_sizes()->push_back(1);
+    }
+    for (int i = 0; i < nr_obs; ++i) {
+      mutable_parameter_block_sizes()->push_back(4);
+    }
+  }
 
-    const auto cam = view->Camera();
-    const auto cam_model = cam.GetCameraIntrinsicsModelType();
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    const int nr_obs = static_cast<int>(features_.cols());
 
-    T intr[10];
-    for (int i = 0; i < cam.CameraIntrinsics()->NumParameters(); ++i) {
-      intr[i] = T(cam.intrinsics()[i]);
+    bool pose_jacobians = false;
+    if (jacobians != nullptr) {
+      for (int b = 0; b < kNumPoseBlocks; ++b) {
+        pose_jacobians |= jacobians[b] != nullptr;
+      }
+      // a point only has rows for its own observation
+      for (int i = 0; i < nr_obs; ++i) {
+        if (jacobians[kNumPoseBlocks + i] != nullptr) {
+          std::fill_n(jacobians[kNumPoseBlocks + i], 2 * nr_obs * 4, 0.0);
+        }
+      }
     }
 
-    // if we have a rolling shutter cam we will always need to evaluate with
-    // line delay
-    for (size_t i = 0; i < track_ids.size(); ++i) {
-      const auto feature = *view->GetFeature(track_ids[i]);
+    // pose parameters as Jets, the derivative of each is its index
+    PoseJetT pose_jets[kNumPoseParameters];
+    const PoseJetT* pose_jet_blocks[kNumPoseBlocks];
+    if (pose_jacobians) {
+      for (int b = 0, offset = 0; b < kNumPoseBlocks;
+           offset += parameter_block_sizes()[b++]) {
+        pose_jet_blocks[b] = pose_jets + offset;
+        for (int i = 0; i < parameter_block_sizes()[b]; ++i) {
+          pose_jets[offset + i] = PoseJetT(parameters[b][i], offset + i);
+        }
+      }
+    }
 
-      // get time for respective RS line
-      const T y_coord = T(feature.y()) * line_delay[0];
-      const T t_so3_row = T(u_so3) + y_coord;
-      const T t_r3_row = T(u_r3) + y_coord;
+    // the pose of a global shutter camera is the same for all observations
+    Mat3 R_c_w;
+    Vec3 t_c_w;
+    Eigen::Matrix<PoseJetT, 3, 3> R_c_w_jet;
+    Eigen::Matrix<PoseJetT, 3, 1> t_c_w_jet;
+    if (!kRollingShutter) {
+      if (pose_jacobians) {
+        CameraPose<PoseJetT>(
+            pose_jet_blocks, PoseJetT(0.0), R_c_w_jet, t_c_w_jet);
+        PoseValues(R_c_w_jet, t_c_w_jet, R_c_w, t_c_w);
+      } else {
+        CameraPose<double>(parameters, 0.0, R_c_w, t_c_w);
+      }
+    }
 
-      Sophus::SO3<T> R_w_i;
-      CeresSplineHelper<T, N>::template evaluate_lie<Sophus::SO3>(
-          sKnots, t_so3_row, T(inv_so3_dt), &R_w_i);
+    for (int i = 0; i < nr_obs; ++i) {
+      const double* X = parameters[kNumPoseBlocks + i];
+      const Vec3 X_xyz(X[0], X[1], X[2]);
+
+      if (kRollingShutter) {
+        // time of the image row of this observation
+        const double line_delay = parameters[kNumPoseBlocks - 1][0];
+        if (pose_jacobians) {
+          const PoseJetT row_time =
+              features_(1, i) * pose_jet_blocks[kNumPoseBlocks - 1][0];
+          CameraPose<PoseJetT>(
+              pose_jet_blocks, row_time, R_c_w_jet, t_c_w_jet);
+          PoseValues(R_c_w_jet, t_c_w_jet, R_c_w, t_c_w);
+        } else {
+          CameraPose<double>(
+              parameters, features_(1, i) * line_delay, R_c_w, t_c_w);
+        }
+      }
 
-      Vector3 t_w_i;
-      CeresSplineHelper<T, N>::template evaluate<3, 0>(
-          sKnots + N, t_r3_row, T(inv_r3_dt), &t_w_i);
+      const Vec3 R_X = R_c_w * X_xyz;
+      const Vec3 p3d = (R_X + t_c_w * X[3]) / X[3];
 
-      Sophus::SE3<T> T_w_c = Sophus::SE3<T>(R_w_i, t_w_i) * T_i_c;
-      Matrix4 T_c_w_matrix = T_w_c.inverse().matrix();
+      // projection and its derivative w.r.t. the point in the camera frame
+      double reprojection[2];
+      Eigen::Matrix<double, 2, 3> J_proj;
+      bool success = false;
+      if (jacobians == nullptr) {
+        success = CameraModel::CameraToPixelCoordinates(
+            intrinsics_, p3d.data(), reprojection);
+      } else {
+        ProjJetT intrinsics[kIntrinsicsSize];
+        for (int k = 0; k < kIntrinsicsSize; ++k) {
+          intrinsics[k] = ProjJetT(intrinsics_[k]);
+        }
+        const ProjJetT p3d_jet[3] = {
+            ProjJetT(p3d[0], 0), ProjJetT(p3d[1], 1), ProjJetT(p3d[2], 2)};
+        ProjJetT reprojection_jet[2];
+        success = CameraModel::CameraToPixelCoordinates(
+            intrinsics, p3d_jet, reprojection_jet);
+        for (int r = 0; r < 2; ++r) {
+          reprojection[r] = reprojection_jet[r].a;
+          J_proj.row(r) = reprojection_jet[r].v.transpose();
+        }
+      }
 
-      // get corresponding 3d point
-      Eigen::Map<Vector4 const> const scene_point(sKnots[N2 + 2 + i]);
+      if (!success) {
+        residuals[2 * i + 0] = 1e10;
+        residuals[2 * i + 1] = 1e10;
+        if (jacobians != nullptr) {
+          for (int b = 0; b < kNumPoseBlocks; ++b) {
+            if (jacobians[b] != nullptr) {
+              std::fill_n(jacobians[b] + 2 * i * parameter_block_sizes()[b],
+                          2 * parameter_block_sizes()[b],
+                          0.0);
+            }
+          }
+        }
+        continue;
+      }
+      for (int r = 0; r < 2; ++r) {
+        residuals[2 * i + r] = sqrt_information_(r, i) *
+                               (reprojection[r] - features_(r, i));
+      }
+      if (jacobians == nullptr) {
+        continue;
+      }
 
-      Vector3 p3d = (T_c_w_matrix * scene_point).hnormalized();
+      const Eigen::Matrix<double, 2, 3> J_res_p3d =
+          sqrt_information_.col(i).asDiagonal() * J_proj;
+
+      // p3d = (R * X_xyz + t * X_w) / X_w
+      double* J_point = jacobians[kNumPoseBlocks + i];
+      if (J_point != nullptr) {
+        Eigen::Matrix<double, 3, 4> J_p3d_X;
+        J_p3d_X.leftCols<3>() = R_c_w / X[3];
+        J_p3d_X.col(3) = -R_X / (X[3] * X[3]);
+        Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>(
+            J_point + 2 * i * 4) = J_res_p3d * J_p3d_X;
+      }
 
-      T reprojection[2];
-      bool success = false;
-      if (theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION ==
-          cam.GetCameraIntrinsicsModelType()) {
-        success =
-            theia::DivisionUndistortionCameraModel::CameraToPixelCoordinates(
-                intr, p3d.data(), reprojection);
-      } else if (theia::CameraIntrinsicsModelType::DOUBLE_SPHERE == cam_model) {
-        success = theia::DoubleSphereCameraModel::CameraToPixelCoordinates(
-            intr, p3d.data(), reprojection);
-      } else if (theia::CameraIntrinsicsModelType::PINHOLE == cam_model) {
-        success = theia::PinholeCameraModel::CameraToPixelCoordinates(
-            intr, p3d.data(), reprojection);
-      } else if (theia::CameraIntrinsicsModelType::FISHEYE == cam_model) {
-        success = theia::FisheyeCameraModel::CameraToPixelCoordinates(
-            intr, p3d.data(), reprojection);
-      } else if (theia::CameraIntrinsicsModelType::EXTENDED_UNIFIED ==
-                 cam_model) {
-        success = theia::ExtendedUnifiedCameraModel::CameraToPixelCoordinates(
-            intr, p3d.data(), reprojection);
-      } else if (theia::CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL ==
-                 cam_model) {
-        success =
-            theia::PinholeRadialTangentialCameraModel::CameraToPixelCoordinates(
-                intr, p3d.data(), reprojection);
+      if (!pose_jacobians) {
+        continue;
+      }
+      Eigen::Matrix<double, 3, kNumPoseParameters> J_p3d_pose;
+      for (int r = 0; r < 3; ++r) {
+        PoseJetT p_r = t_c_w_jet[r];
+        for (int c = 0; c < 3; ++c) {
+          p_r += R_c_w_jet(r, c) * (X_xyz[c] / X[3]);
+        }
+        J_p3d_pose.row(r) = p_r.v.transpose();
       }
+      const Eigen::Matrix<double, 2, kNumPoseParameters> J_res_pose =
+          J_res_p3d * J_p3d_pose;
+      for (int b = 0, offset = 0; b < kNumPoseBlocks;
+           offset += parameter_block_sizes()[b++]) {
+        if (jacobians[b] == nullptr) {
+          continue;
+        }
+        const int size = parameter_block_sizes()[b];
+        for (int r = 0; r < 2; ++r) {
+          for (int k = 0; k < size; ++k) {
+            jacobians[b][(2 * i + r) * size + k] = J_res_pose(r, offset + k);
+          }
+        }
+      }
+    }
+    return true;
+  }
 
-      if (!success) {
-        sResiduals[2 * i + 0] = T(1e10);
-        sResiduals[2 * i + 1] = T(1e10);
-      } else {
-        const T inv_info_x = T(1. / ceres::sqrt(feature.covariance_(0, 0)));
-        const T inv_info_y = T(1. / ceres::sqrt(feature.covariance_(1, 1)));
-        sResiduals[2 * i + 0] = inv_info_x * (reprojection[0] - T(feature.x()));
-        sResiduals[2 * i + 1] = inv_info_y * (reprojection[1] - T(feature.y()));
+ private:
+  //! camera pose at the spline time plus time_offset (line delay * row)
+  template <class T>
+  void CameraPose(T const* const* pose_blocks,
+                  const T& time_offset,
+                  Eigen::Matrix<T, 3, 3>& R_c_w,
+                  Eigen::Matrix<T, 3, 1>& t_c_w) const {
+    Sophus::SO3<T> R_w_i;
+    CeresSplineHelper<T, N>::template evaluate_lie_segment<Sophus::SO3>(
+        pose_blocks,
+        T(u_so3_) + time_offset,
+        T(inv_so3_dt_),
+        so3_blending_,
+        &R_w_i);
+    Eigen::Matrix<T, 3, 1> t_w_i;
+    CeresSplineHelper<T, N>::template evaluate_segment<3, 0>(
+        pose_blocks + N,
+        T(u_r3_) + time_offset,
+        T(inv_r3_dt_),
+        r3_blending_,
+        &t_w_i);
+    Eigen::Map<Sophus::SE3<T> const> const T_i_c(pose_blocks[2 * N]);
+
+    const Sophus::SE3<T> T_c_w =
+        (Sophus::SE3<T>(R_w_i, t_w_i) * T_i_c).inverse();
+    R_c_w = T_c_w.so3().matrix();
+    t_c_w = T_c_w.translation();
+  }
+
+  static void PoseValues(const Eigen::Matrix<PoseJetT, 3, 3>& R_c_w_jet,
+                         const Eigen::Matrix<PoseJetT, 3, 1>& t_c_w_jet,
+                         Mat3& R_c_w,
+                         Vec3& t_c_w) {
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        R_c_w(r, c) = R_c_w_jet(r, c).a;
+      }
+      t_c_w[r] = t_c_w_jet[r].a;
+    }
+  }
+
+  double intrinsics_[kIntrinsicsSize];
+
+  Eigen::Matrix2Xd features_;
+
+  //! 1 / sqrt of the feature covariance diagonal
+  Eigen::Matrix2Xd sqrt_information_;
+
+  double u_so3_;
+  double u_r3_;
+  double inv_so3_dt_;
+  double inv_r3_dt_;
+
+  //! blending matrices of non-uniform spline segments, not owned
+  const double* so3_blending_;
+  const double* r3_blending_;
+};
+
+//! Reprojection cost function of a view for its camera model, nullptr if the
+//! model is not supported.
+template <int N, bool kRollingShutter>
+ceres::CostFunction* CreateSplineReprojectionCostFunction(
+    const theia::View* view,
+    const std::vector<theia::TrackId>& track_ids,
+    const double u_so3,
+    const double u_r3,
+    const double inv_so3_dt,
+    const double inv_r3_dt,
+    const double* so3_blending = nullptr,
+    const double* r3_blending = nullptr) {
+  switch (view->Camera().GetCameraIntrinsicsModelType()) {
+    case theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION:
+      return new SplineReprojectionCostFunction<
+          N,
+          theia::DivisionUndistortionCameraModel,
+          kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    case theia::CameraIntrinsicsModelType::DOUBLE_SPHERE:
+      return new SplineReprojectionCostFunction<N,
+                                                theia::DoubleSphereCameraModel,
+                                                kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    case theia::CameraIntrinsicsModelType::PINHOLE:
+      return new SplineReprojectionCostFunction<N,
+                                                theia::PinholeCameraModel,
+                                                kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    case theia::CameraIntrinsicsModelType::FISHEYE:
+      return new SplineReprojectionCostFunction<N,
+                                                theia::FisheyeCameraModel,
+                                                kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    case theia::CameraIntrinsicsModelType::EXTENDED_UNIFIED:
+      return new SplineReprojectionCostFunction<
+          N,
+          theia::ExtendedUnifiedCameraModel,
+          kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    case theia::CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL:
+      return new SplineReprojectionCostFunction<
+          N,
+          theia::PinholeRadialTangentialCameraModel,
+          kRollingShutter>(
+          view,
+          track_ids,
+          u_so3,
+          u_r3,
+          inv_so3_dt,
+          inv_r3_dt,
+          so3_blending,
+          r3_blending);
+    default:
+      return nullptr;
+  }
+}
+
+//! Gaussian prior on the global calibration parameters of a spline window,
+//! r = sqrt_information * delta, from the marginal information of the
+//! previous window. The first parameter block is T_i_c if has_T_i_c, with
+//! delta = log(T_i_c_mean^-1 * T_i_c) in the tangent space of the
+//! LieLocalParameterization. All other blocks are Euclidean with
+//! delta = x - mean. Used with a ceres::DynamicAutoDiffCostFunction.
+struct GlobalParameterPriorFunctor {
+  GlobalParameterPriorFunctor(const bool has_T_i_c,
+                              const Sophus::SE3d& T_i_c_mean,
+                              const std::vector<int>& euclidean_block_sizes,
+                              const Eigen::VectorXd& euclidean_mean,
+                              const Eigen::MatrixXd& sqrt_information)
+      : has_T_i_c(has_T_i_c),
+        T_i_c_mean_inv(T_i_c_mean.inverse()),
+        euclidean_block_sizes(euclidean_block_sizes),
+        euclidean_mean(euclidean_mean),
+        sqrt_information(sqrt_information) {}
+
+  template <class T>
+  bool operator()(T const* const* params, T* residuals) const {
+    const int dim = sqrt_information.cols();
+    std::vector<T> delta(dim);
+    int block = 0, offset = 0;
+    if (has_T_i_c) {
+      Eigen::Map<Sophus::SE3<T> const> const T_i_c(params[0]);
+      const Eigen::Matrix<T, 6, 1> tangent =
+          (T_i_c_mean_inv.cast<T>() * T_i_c).log();
+      for (int i = 0; i < 6; ++i) {
+        delta[offset++] = tangent[i];
+      }
+      ++block;
+    }
+    int mean_idx = 0;
+    for (const int block_size : euclidean_block_sizes) {
+      for (int i = 0; i < block_size; ++i) {
+        delta[offset++] = params[block][i] - T(euclidean_mean[mean_idx++]);
+      }
+      ++block;
+    }
+    for (int r = 0; r < sqrt_information.rows(); ++r) {
+      residuals[r] = T(0.0);
+      for (int c = 0; c < dim; ++c) {
+        residuals[r] += T(sqrt_information(r, c)) * delta[c];
       }
     }
     return true;
   }
-  const theia::View* view;
-  const theia::Reconstruction* image_data;
-  std::vector<theia::TrackId> track_ids;
-  double u_so3;
-  double inv_so3_dt;
-  double u_r3;
-  double inv_r3_dt;
+
+  bool has_T_i_c;
+  Sophus::SE3d T_i_c_mean_inv;
+  std::vector<int> euclidean_block_sizes;
+  Eigen::VectorXd euclidean_mean;
+  Eigen::MatrixXd sqrt_information;
 };
 
 // template <int _N>
@@ -86,6 +86,33 @@ struct CeresSplineHelper {
     }
   }
 
+  /// @brief Blending coefficients of a time derivative.
+  ///
+  /// @param[in] uniform_blending blending matrix of the uniform spline
+  /// @param[in] segment_blending if not nullptr column major N x N blending
+  /// matrix of one segment of a non-uniform spline, used instead of
+  /// uniform_blending
+  /// @param[in] u normalized time in the segment
+  /// @param[out] coeff blending coefficients (without the inv_dt factor)
+  template <int Derivative>
+  static inline void blendingCoeffs(const MatN& uniform_blending,
+                                    const double* segment_blending,
+                                    const T u,
+                                    VecN& coeff) {
+    VecN p;
+    baseCoeffsWithTime<Derivative>(p, u);
+    if (segment_blending == nullptr) {
+      coeff = uniform_blending * p;
+      return;
+    }
+    for (int i = 0; i < N; i++) {
+      coeff[i] = T(0);
+      for (int j = 0; j < N; j++) {
+        coeff[i] += segment_blending[j * N + i] * p[j];
+      }
+    }
+  }
+
   /// @brief Evaluate Lie group cummulative B-spline and time derivatives.
   ///
   /// @param[in] sKnots array of pointers of the spline knots. The size of each
@@ -107,29 +134,55 @@ struct CeresSplineHelper {
       typename GroupT<T>::Tangent* vel_out = nullptr,
       typename GroupT<T>::Tangent* accel_out = nullptr,
       typename GroupT<T>::Tangent* jerk_out = nullptr) {
+    evaluate_lie_segment<GroupT>(sKnots,
+                                 u,
+                                 inv_dt,
+                                 nullptr,
+                                 transform_out,
+                                 vel_out,
+                                 accel_out,
+                                 jerk_out);
+  }
+
+  /// @brief Evaluate a segment of a Lie group cummulative B-spline with
+  /// non-uniform knots and its time derivatives.
+  ///
+  /// @param[in] u normalized time in the segment
+  /// @param[in] inv_dt inverse of the segment length in seconds
+  /// @param[in] cumulative_blending column major N x N cumulative blending
+  /// matrix of the segment, nullptr for a uniform spline
+  ///
+  /// See evaluate_lie for the other parameters.
+  template <template <class> class GroupT>
+  static inline void evaluate_lie_segment(
+      T const* const* sKnots,
+      const T u,
+      const T inv_dt,
+      const double* cumulative_blending,
+      GroupT<T>* transform_out = nullptr,
+      typename GroupT<T>::Tangent* vel_out = nullptr,
+      typename GroupT<T>::Tangent* accel_out = nullptr,
+      typename GroupT<T>::Tangent* jerk_out = nullptr) {
     using Group = GroupT<T>;
     using Tangent = typename GroupT<T>::Tangent;
     using Adjoint = typename GroupT<T>::Adjoint;
 
-    VecN p, coeff, dcoeff, ddcoeff, dddcoeff;
+    VecN coeff, dcoeff, ddcoeff, dddcoeff;
+    const MatN& M = CeresSplineHelper<T, N>::cumulative_blending_matrix_;
 
-    CeresSplineHelper<T, N>::template baseCoeffsWithTime<0>(p, u);
-    coeff = CeresSplineHelper<T, N>::cumulative_blending_matrix_ * p;
+    blendingCoeffs<0>(M, cumulative_blending, u, coeff);
 
     if (vel_out || accel_out || jerk_out) {
-      CeresSplineHelper<T, N>::template baseCoeffsWithTime<1>(p, u);
-      dcoeff =
-          inv_dt * CeresSplineHelper<T, N>::cumulative_blending_matrix_ * p;
+      blendingCoeffs<1>(M, cumulative_blending, u, dcoeff);
+      dcoeff *= inv_dt;
 
       if (accel_out || jerk_out) {
-        CeresSplineHelper<T, N>::template baseCoeffsWithTime<2>(p, u);
-        ddcoeff = inv_dt * inv_dt *
-                  CeresSplineHelper<T, N>::cumulative_blending_matrix_ * p;
+        blendingCoeffs<2>(M, cumulative_blending, u, ddcoeff);
+        ddcoeff *= inv_dt * inv_dt;
 
         if (jerk_out) {
-          CeresSplineHelper<T, N>::template baseCoeffsWithTime<3>(p, u);
-          dddcoeff = inv_dt * inv_dt * inv_dt *
-                     CeresSplineHelper<T, N>::cumulative_blending_matrix_ * p;
+          blendingCoeffs<3>(M, cumulative_blending, u, dddcoeff);
+          dddcoeff *= inv_dt * inv_dt * inv_dt;
         }
       }
     }
@@ -200,15 +253,33 @@ struct CeresSplineHelper {
                               const T u,
                               const T inv_dt,
                               Eigen::Matrix<T, DIM, 1>* vec_out) {
+    evaluate_segment<DIM, DERIV>(sKnots, u, inv_dt, nullptr, vec_out);
+  }
+
+  /// @brief Evaluate a segment of a Euclidean B-spline with non-uniform
+  /// knots or its time derivatives.
+  ///
+  /// @param[in] u normalized time in the segment
+  /// @param[in] inv_dt inverse of the segment length in seconds
+  /// @param[in] blending column major N x N blending matrix of the segment,
+  /// nullptr for a uniform spline
+  ///
+  /// See evaluate for the other parameters.
+  template <int DIM, int DERIV>
+  static inline void evaluate_segment(T const* const* sKnots,
+                                      const T u,
+                                      const T inv_dt,
+                                      const double* blending,
+                                      Eigen::Matrix<T, DIM, 1>* vec_out) {
     if (!vec_out) return;
 
     using VecD = Eigen::Matrix<T, DIM, 1>;
 
-    VecN p, coeff;
+    VecN coeff;
 
-    CeresSplineHelper<T, N>::template baseCoeffsWithTime<DERIV>(p, u);
-    coeff = ceres::pow(inv_dt, DERIV) *
-            CeresSplineHelper<T, N>::blending_matrix_ * p;
+    blendingCoeffs<DERIV>(
+        CeresSplineHelper<T, N>::blending_matrix_, blending, u, coeff);
+    coeff *= ceres::pow(inv_dt, DERIV);
 
     vec_out->setZero();
 
@@ -218,6 +289,60 @@ struct CeresSplineHelper {
       (*vec_out) += coeff[i] * p;
     }
   }
+
+  /// @brief Evaluate a segment of a Euclidean B-spline and its first and
+  /// second time derivative from one set of powers of u.
+  ///
+  /// @param[out] value_out value of the spline
+  /// @param[out] vel_out first time derivative
+  /// @param[out] accel_out second time derivative
+  ///
+  /// See evaluate_segment for the other parameters.
+  template <int DIM>
+  static inline void evaluate_segment_derivatives(
+      T const* const* sKnots,
+      const T u,
+      const T inv_dt,
+      const double* blending,
+      Eigen::Matrix<T, DIM, 1>* value_out,
+      Eigen::Matrix<T, DIM, 1>* vel_out,
+      Eigen::Matrix<T, DIM, 1>* accel_out) {
+    using Mat3 = Eigen::Matrix<T, N, 3>;
+    using MatD3 = Eigen::Matrix<T, DIM, 3>;
+
+    VecN powers;
+    powers[0] = T(1);
+    for (int j = 1; j < N; j++) {
+      powers[j] = powers[j - 1] * u;
+    }
+    // column d holds the derivative d of (1, u, ..., u^(N-1))
+    Mat3 p = Mat3::Zero();
+    for (int d = 0; d < 3 && d < N; d++) {
+      for (int j = d; j < N; j++) {
+        p(j, d) = base_coefficients_(d, j) * powers[j - d];
+      }
+    }
+
+    Mat3 coeff;
+    if (blending == nullptr) {
+      coeff = CeresSplineHelper<T, N>::blending_matrix_ * p;
+    } else {
+      coeff = Eigen::Map<const Eigen::Matrix<double, N, N>>(blending)
+                  .template cast<T>() *
+              p;
+    }
+    coeff.col(1) *= inv_dt;
+    coeff.col(2) *= inv_dt * inv_dt;
+
+    MatD3 out = MatD3::Zero();
+    for (int i = 0; i < N; i++) {
+      Eigen::Map<Eigen::Matrix<T, DIM, 1> const> const knot(sKnots[i]);
+      out += knot * coeff.row(i);
+    }
+    *value_out = out.col(0);
+    *vel_out = out.col(1);
+    *accel_out = out.col(2);
+  }
 };
 
 template <class T, int _N>
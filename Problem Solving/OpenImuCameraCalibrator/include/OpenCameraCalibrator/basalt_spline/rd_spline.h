@@ -42,6 +42,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sophus_utils.h"
 #include "spline_common.h"
 
+#include "OpenCameraCalibrator/utils/types.h"
+
 #include <Eigen/Dense>
 
 #include <array>
@@ -224,7 +226,7 @@ class RdSpline {
   /// @brief Return const reference to deque with knots
   ///
   /// @return const reference to deque with knots
-  const Eigen::aligned_deque<VecD>& getKnots() const { return knots; }
+  const OpenICC::aligned_deque<VecD>& getKnots() const { return knots; }
 
   /// @brief Return time interval in nanoseconds
   ///
@@ -328,7 +330,7 @@ class RdSpline {
   static const MatN base_coefficients_;  ///< Base coefficients matrix.
                                          ///< See \ref computeBaseCoefficients.
 
-  Eigen::aligned_deque<VecD> knots;    ///< Knots
+  OpenICC::aligned_deque<VecD> knots;    ///< Knots
   int64_t dt_ns;                       ///< Knot interval in nanoseconds
   int64_t start_t_ns;                  ///< Start time in nanoseconds
   std::array<_Scalar, _N> pow_inv_dt;  ///< Array with inverse powers of dt
@@ -343,3 +345,141 @@ template <int _DIM, int _N, typename _Scalar>
 const typename RdSpline<_DIM, _N, _Scalar>::MatN
     RdSpline<_DIM, _N, _Scalar>::blending_matrix_ =
         computeBlendingMatrix<_N, _Scalar, false>();
+
+/// @brief Evaluator for sequential queries of a \ref RdSpline
+///
+/// The value and each derivative of the spline are polynomials in the
+/// normalized time \f$ u \f$ on a knot interval. The evaluator caches the
+/// knots of the current interval and, per derivative, the polynomial
+/// coefficients \f$ C_d = (p_i, \dots, p_{i+N-1}) A_d \f$, where \f$ A_d \f$
+/// is the blending matrix premultiplied with the derivative coefficients of
+/// the time polynomial and the inverse power of the knot interval. A query in
+/// a cached interval only evaluates \f$ C_d (1, u, \dots, u^{N-1})^T \f$.
+/// When the next query falls into the following interval, the knots are
+/// shifted and one new knot is read, so monotone queries are amortized O(1).
+///
+/// The evaluator keeps a reference to the spline. Call \ref reset after the
+/// knots of the spline were changed.
+template <int _DIM, int _N, typename _Scalar = double>
+class RdSplineEvaluator {
+ public:
+  static constexpr int N = _N;        ///< Order of the spline.
+  static constexpr int DEG = _N - 1;  ///< Degree of the spline.
+
+  static constexpr int DIM = _DIM;  ///< Dimension of euclidean vector space.
+
+  using Spline = RdSpline<_DIM, _N, _Scalar>;
+
+  using MatN = Eigen::Matrix<_Scalar, _N, _N>;
+  using VecN = Eigen::Matrix<_Scalar, _N, 1>;
+
+  using VecD = Eigen::Matrix<_Scalar, _DIM, 1>;
+  using MatDN = Eigen::Matrix<_Scalar, _DIM, _N>;
+
+  /// @brief Constructor
+  ///
+  /// @param[in] spline spline to evaluate, has to outlive the evaluator
+  explicit RdSplineEvaluator(const Spline& spline) : spline_(spline) {
+    const MatN blending = computeBlendingMatrix<_N, _Scalar, false>();
+    const MatN base_coefficients = computeBaseCoefficients<_N, _Scalar>();
+    const _Scalar inv_dt = Spline::s_to_ns / spline_.getTimeIntervalNs();
+
+    _Scalar pow_inv_dt = 1.0;
+    for (int d = 0; d < N; d++) {
+      MatN shift;
+      shift.setZero();
+      for (int j = d; j < N; j++) shift(j, j - d) = base_coefficients(d, j);
+
+      A[d] = pow_inv_dt * blending * shift;
+      pow_inv_dt *= inv_dt;
+    }
+    coeffs_valid.fill(false);
+  }
+
+  /// @brief Invalidate the cached knot interval
+  inline void reset() {
+    segment = -1;
+    coeffs_valid.fill(false);
+  }
+
+  /// @brief Evaluate value or derivative of the spline
+  ///
+  /// @param Derivative derivative to evaluate (0 for value)
+  /// @param[in] time_ns time for evaluating of the spline in nanoseconds
+  /// @return value of the spline or derivative. Euclidean vector of dimention
+  /// DIM.
+  template <int Derivative = 0>
+  VecD evaluate(int64_t time_ns) {
+    static_assert(Derivative < N, "Derivative has to be smaller than N");
+
+    VecN powers;
+    seek(time_ns, powers);
+
+    if (!coeffs_valid[Derivative]) {
+      coeffs[Derivative] = segment_knots * A[Derivative];
+      coeffs_valid[Derivative] = true;
+    }
+    return coeffs[Derivative] * powers;
+  }
+
+  /// @brief Alias for first derivative of spline. See \ref evaluate.
+  inline VecD velocity(int64_t time_ns) { return evaluate<1>(time_ns); }
+
+  /// @brief Alias for second derivative of spline. See \ref evaluate.
+  inline VecD acceleration(int64_t time_ns) { return evaluate<2>(time_ns); }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  /// @brief Find the knot interval of time_ns and update the cache
+  ///
+  /// @param[in] time_ns time in nanoseconds
+  /// @param[out] powers powers of the normalized time in the interval
+  void seek(int64_t time_ns, VecN& powers) {
+    const int64_t dt_ns = spline_.getTimeIntervalNs();
+    const int64_t st_ns = (time_ns - spline_.minTimeNs());
+
+    BASALT_ASSERT_STREAM(st_ns >= 0,
+                         "st_ns " << st_ns << " time_ns " << time_ns
+                                  << " start_t_ns " << spline_.minTimeNs());
+
+    const int64_t s = st_ns / dt_ns;
+    const _Scalar u = _Scalar(st_ns % dt_ns) / _Scalar(dt_ns);
+
+    BASALT_ASSERT_STREAM(
+        size_t(s + N) <= spline_.getKnots().size(),
+        "s " << s << " N " << N << " knots.size() "
+             << spline_.getKnots().size());
+
+    if (s != segment) {
+      int first_new = 0;
+      if (segment >= 0 && s == segment + 1) {
+        // consecutive interval, reuse all but one knot
+        for (int i = 0; i < DEG; i++) {
+          segment_knots.col(i) = segment_knots.col(i + 1);
+        }
+        first_new = DEG;
+      }
+      for (int i = first_new; i < N; i++) {
+        segment_knots.col(i) = spline_.getKnot(s + i);
+      }
+      coeffs_valid.fill(false);
+      segment = s;
+    }
+
+    powers[0] = 1.0;
+    for (int j = 1; j < N; j++) powers[j] = powers[j - 1] * u;
+  }
+
+  const Spline& spline_;  ///< Evaluated spline
+
+  /// Blending matrices for all derivatives
+  std::array<MatN, _N> A;
+
+  int64_t segment = -1;  ///< Cached knot interval, -1 if none
+  MatDN segment_knots;   ///< Knots of the cached interval
+
+  /// Polynomial coefficients of the cached interval per derivative
+  std::array<MatDN, _N> coeffs;
+  std::array<bool, _N> coeffs_valid;  ///< If coeffs was computed
+};
@@ -42,8 +42,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rd_spline.h"
 #include "so3_spline.h"
 
-#include "calib_bias.h"
-
 #include <array>
 
 /// @brief Uniform B-spline for SE(3) of order N. Internally uses an SO(3) (\ref
@@ -362,122 +360,6 @@ class Se3Spline {
     J.template tail<3>() = rotVelBody(time_ns);
   }
 
-  /// @brief Evaluate gyroscope residual.
-  ///
-  /// @param[in] time_ns time of the measurement
-  /// @param[in] measurement gyroscope measurement
-  /// @param[in] gyro_bias_full gyroscope calibration
-  /// @return gyroscope residual
-  Vec3 gyroResidual(int64_t time_ns,
-                    const Vec3& measurement,
-                    const CalibGyroBias<_Scalar>& gyro_bias_full) const {
-    return so3_spline.velocityBody(time_ns) -
-           gyro_bias_full.getCalibrated(measurement);
-  }
-
-  /// @brief Evaluate gyroscope residual and compute Jacobians.
-  ///
-  /// @param[in] time_ns time of the measurement
-  /// @param[in] measurement gyroscope measurement
-  /// @param[in] gyro_bias_full gyroscope calibration
-  /// @param[out] J_knots Jacobian with respect to SO(3) spline knots
-  /// @param[out] J_bias Jacobian with respect to gyroscope calibration
-  /// @return gyroscope residual
-  Vec3 gyroResidual(int64_t time_ns,
-                    const Vec3& measurement,
-                    const CalibGyroBias<_Scalar>& gyro_bias_full,
-                    SO3JacobianStruct* J_knots,
-                    Mat312* J_bias = nullptr) const {
-    if (J_bias) {
-      J_bias->setZero();
-      J_bias->template block<3, 3>(0, 0).diagonal().array() = 1.0;
-      J_bias->template block<3, 3>(0, 3).diagonal().array() = -measurement[0];
-      J_bias->template block<3, 3>(0, 6).diagonal().array() = -measurement[1];
-      J_bias->template block<3, 3>(0, 9).diagonal().array() = -measurement[2];
-    }
-
-    return so3_spline.velocityBody(time_ns, J_knots) -
-           gyro_bias_full.getCalibrated(measurement);
-  }
-
-  /// @brief Evaluate accelerometer residual.
-  ///
-  /// @param[in] time_ns time of the measurement
-  /// @param[in] measurement accelerometer measurement
-  /// @param[in] accel_bias_full accelerometer calibration
-  /// @param[in] g gravity
-  /// @return accelerometer residual
-  Vec3 accelResidual(int64_t time_ns,
-                     const Eigen::Vector3d& measurement,
-                     const CalibAccelBias<_Scalar>& accel_bias_full,
-                     const Eigen::Vector3d& g) const {
-    Sophus::SO3d R = so3_spline.evaluate(time_ns);
-    Eigen::Vector3d accel_world = pos_spline.acceleration(time_ns);
-
-    return R.inverse() * (accel_world + g) -
-           accel_bias_full.getCalibrated(measurement);
-  }
-
-  /// @brief Evaluate accelerometer residual and Jacobians.
-  ///
-  /// @param[in] time_ns time of the measurement
-  /// @param[in] measurement accelerometer measurement
-  /// @param[in] accel_bias_full accelerometer calibration
-  /// @param[in] g gravity
-  /// @param[out] J_knots Jacobian with respect to spline knots
-  /// @param[out] J_bias Jacobian with respect to accelerometer calibration
-  /// @param[out] J_g Jacobian with respect to gravity
-  /// @return accelerometer residual
-  Vec3 accelResidual(int64_t time_ns,
-                     const Vec3& measurement,
-                     const CalibAccelBias<_Scalar>& accel_bias_full,
-                     const Vec3& g,
-                     AccelPosSO3JacobianStruct* J_knots,
-                     Mat39* J_bias = nullptr,
-                     Mat3* J_g = nullptr) const {
-    typename So3Spline<_N, _Scalar>::JacobianStruct Jr;
-    typename RdSpline<3, N, _Scalar>::JacobianStruct Jp;
-
-    Sophus::SO3d R = so3_spline.evaluate(time_ns, &Jr);
-    Eigen::Vector3d accel_world = pos_spline.acceleration(time_ns, &Jp);
-
-    Eigen::Matrix3d RT = R.inverse().matrix();
-    Eigen::Matrix3d tmp = RT * Sophus::SO3d::hat(accel_world + g);
-
-    BASALT_ASSERT_STREAM(
-        Jr.start_idx == Jp.start_idx,
-        "Jr.start_idx " << Jr.start_idx << " Jp.start_idx " << Jp.start_idx);
-
-    BASALT_ASSERT_STREAM(
-        so3_spline.getKnots().size() == pos_spline.getKnots().size(),
-        "so3_spline.getKnots().size() " << so3_spline.getKnots().size()
-                                        << " pos_spline.getKnots().size() "
-                                        << pos_spline.getKnots().size());
-
-    J_knots->start_idx = Jp.start_idx;
-    for (int i = 0; i < N; i++) {
-      J_knots->d_val_d_knot[i].template topLeftCorner<3, 3>() =
-          RT * Jp.d_val_d_knot[i];
-      J_knots->d_val_d_knot[i].template bottomRightCorner<3, 3>() =
-          tmp * Jr.d_val_d_knot[i];
-    }
-
-    if (J_bias) {
-      J_bias->setZero();
-      J_bias->template block<3, 3>(0, 0).diagonal().array() = 1.0;
-      J_bias->template block<3, 3>(0, 3).diagonal().array() = -measurement[0];
-      (*J_bias)(1, 6) = -measurement[1];
-      (*J_bias)(2, 7) = -measurement[1];
-      (*J_bias)(2, 8) = -measurement[2];
-    }
-    if (J_g) (*J_g) = RT;
-
-    Vec3 res =
-        RT * (accel_world + g) - accel_bias_full.getCalibrated(measurement);
-
-    return res;
-  }
-
   /// @brief Evaluate position residual.
   ///
   /// @param[in] time_ns time of the measurement
@@ -536,6 +418,16 @@ class Se3Spline {
   /// @brief Knot time interval in nanoseconds.
   inline int64_t getDtNs() const { return dt_ns; }
 
+  /// @brief Return const reference to the position spline
+  inline const RdSpline<3, _N, _Scalar>& getPosSpline() const {
+    return pos_spline;
+  }
+
+  /// @brief Return const reference to the SO(3) spline
+  inline const So3Spline<_N, _Scalar>& getSo3Spline() const {
+    return so3_spline;
+  }
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
@@ -544,3 +436,88 @@ class Se3Spline {
 
   int64_t dt_ns;  ///< Knot interval in nanoseconds
 };
+
+/// @brief Evaluator for sequential queries of a \ref Se3Spline
+///
+/// Combines \ref So3SplineEvaluator and \ref RdSplineEvaluator, which cache
+/// the data of the current knot interval. Monotone queries, e.g. for dense
+/// evaluation or IMU simulation, are amortized O(1) per knot interval.
+///
+/// The evaluator keeps a reference to the spline. Call \ref reset after the
+/// knots of the spline were changed.
+template <int _N, typename _Scalar = double>
+class Se3SplineEvaluator {
+ public:
+  static constexpr int N = _N;        ///< Order of the spline.
+  static constexpr int DEG = _N - 1;  ///< Degree of the spline.
+
+  using Spline = Se3Spline<_N, _Scalar>;
+
+  using Vec3 = Eigen::Matrix<_Scalar, 3, 1>;
+
+  using SO3 = Sophus::SO3<_Scalar>;
+  using SE3 = Sophus::SE3<_Scalar>;
+
+  /// @brief Constructor
+  ///
+  /// @param[in] spline spline to evaluate, has to outlive the evaluator
+  explicit Se3SplineEvaluator(const Spline& spline)
+      : so3_eval(spline.getSo3Spline()), pos_eval(spline.getPosSpline()) {}
+
+  /// @brief Invalidate the cached knot interval
+  inline void reset() {
+    so3_eval.reset();
+    pos_eval.reset();
+  }
+
+  /// @brief Evaluate pose.
+  ///
+  /// @param[in] time_ns time to evaluate pose in nanoseconds
+  /// @return SE(3) pose at time_ns
+  SE3 pose(int64_t time_ns) {
+    return SE3(so3_eval.evaluate(time_ns), pos_eval.evaluate(time_ns));
+  }
+
+  /// @brief Linear velocity in the world frame.
+  ///
+  /// @param[in] time_ns time to evaluate linear velocity in nanoseconds
+  inline Vec3 transVelWorld(int64_t time_ns) {
+    return pos_eval.velocity(time_ns);
+  }
+
+  /// @brief Linear acceleration in the world frame.
+  ///
+  /// @param[in] time_ns time to evaluate linear acceleration in nanoseconds
+  inline Vec3 transAccelWorld(int64_t time_ns) {
+    return pos_eval.acceleration(time_ns);
+  }
+
+  /// @brief Rotational velocity in the body frame.
+  ///
+  /// @param[in] time_ns time to evaluate rotational velocity in nanoseconds
+  inline Vec3 rotVelBody(int64_t time_ns) {
+    return so3_eval.velocityBody(time_ns);
+  }
+
+  /// @brief Ideal IMU measurements, the rotational velocity and the specific
+  /// force in the body frame.
+  ///
+  /// @param[in] time_ns time of the measurement in nanoseconds
+  /// @param[in] g gravity in the world frame
+  /// @param[out] gyro rotational velocity in the body frame
+  /// @param[out] accel acceleration minus gravity in the body frame, see
+  /// \ref Se3Spline::accelResidual
+  void imuMeasurements(int64_t time_ns,
+                       const Vec3& g,
+                       Vec3& gyro,
+                       Vec3& accel) {
+    const SO3 R = so3_eval.evaluate(time_ns, &gyro);
+    accel = R.inverse() * (pos_eval.acceleration(time_ns) + g);
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  So3SplineEvaluator<_N, _Scalar> so3_eval;    ///< Orientation evaluator
+  RdSplineEvaluator<3, _N, _Scalar> pos_eval;  ///< Position evaluator
+};
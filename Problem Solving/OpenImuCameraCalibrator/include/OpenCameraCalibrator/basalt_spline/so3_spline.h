@@ -42,6 +42,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sophus_utils.h"
 #include "spline_common.h"
 
+#include "OpenCameraCalibrator/utils/types.h"
+
 #include "sophus/so3.hpp"
 #include <Eigen/Dense>
 
@@ -185,7 +187,7 @@ class So3Spline {
   /// @brief Return const reference to deque with knots
   ///
   /// @return const reference to deque with knots
-  const Eigen::aligned_deque<SO3>& getKnots() const { return knots; }
+  const OpenICC::aligned_deque<SO3>& getKnots() const { return knots; }
 
   /// @brief Return time interval in nanoseconds
   ///
@@ -748,7 +750,7 @@ class So3Spline {
   static const MatN base_coefficients_;  ///< Base coefficients matrix.
   ///< See \ref computeBaseCoefficients.
 
-  Eigen::aligned_deque<SO3> knots;    ///< Knots
+  OpenICC::aligned_deque<SO3> knots;    ///< Knots
   int64_t dt_ns;                      ///< Knot interval in nanoseconds
   int64_t start_t_ns;                 ///< Start time in nanoseconds
   std::array<_Scalar, 4> pow_inv_dt;  ///< Array with inverse powers of dt
@@ -763,3 +765,220 @@ template <int _N, typename _Scalar>
 const typename So3Spline<_N, _Scalar>::MatN
     So3Spline<_N, _Scalar>::blending_matrix_ =
         computeBlendingMatrix<_N, _Scalar, true>();
+
+/// @brief Evaluator for sequential queries of a \ref So3Spline
+///
+/// Dense evaluation (e.g. at all IMU timestamps) queries the spline many times
+/// per knot interval. The evaluator caches the data of the current interval:
+/// the first knot \f$ R_i \f$ and the logs \f$ d_j =
+/// \log(R_{i+j-1}^{-1}R_{i+j}) \f$ of the knot differences. If the next query
+/// falls into the following interval, the logs are shifted and only one new
+/// log is computed, so monotone queries need amortized O(1) logs. Other
+/// queries recompute the cache, so arbitrary times are still evaluated
+/// correctly.
+///
+/// The cumulative blending matrix is premultiplied with the derivative
+/// coefficients of the time polynomial and the inverse powers of the knot
+/// interval, \f$ A_d \f$. All derivatives are then computed from one vector
+/// \f$ (1, u, \dots, u^{N-1})^T \f$ as \f$ A_d (1, u, \dots, u^{N-1})^T \f$.
+///
+/// The evaluator keeps a reference to the spline. Call \ref reset after the
+/// knots of the spline were changed.
+template <int _N, typename _Scalar = double>
+class So3SplineEvaluator {
+ public:
+  static constexpr int N = _N;        ///< Order of the spline.
+  static constexpr int DEG = _N - 1;  ///< Degree of the spline.
+
+  using Spline = So3Spline<_N, _Scalar>;
+
+  using MatN = Eigen::Matrix<_Scalar, _N, _N>;
+  using VecN = Eigen::Matrix<_Scalar, _N, 1>;
+
+  using Vec3 = Eigen::Matrix<_Scalar, 3, 1>;
+
+  using SO3 = Sophus::SO3<_Scalar>;
+
+  /// @brief Constructor
+  ///
+  /// @param[in] spline spline to evaluate, has to outlive the evaluator
+  explicit So3SplineEvaluator(const Spline& spline) : spline_(spline) {
+    const MatN blending = computeBlendingMatrix<_N, _Scalar, true>();
+    const MatN base_coefficients = computeBaseCoefficients<_N, _Scalar>();
+    const _Scalar inv_dt = Spline::s_to_ns / spline_.getTimeIntervalNs();
+
+    _Scalar pow_inv_dt = 1.0;
+    for (int d = 0; d < 3; d++) {
+      MatN shift;
+      shift.setZero();
+      for (int j = d; j < N; j++) shift(j, j - d) = base_coefficients(d, j);
+
+      A[d] = pow_inv_dt * blending * shift;
+      pow_inv_dt *= inv_dt;
+    }
+  }
+
+  /// @brief Invalidate the cached knot interval
+  inline void reset() { segment = -1; }
+
+  /// @brief Evaluate SO(3) B-spline and optionally its time derivatives
+  ///
+  /// @param[in] time_ns time for evaluating the spline in nanoseconds
+  /// @param[out] vel_body if not nullptr, return the rotational velocity in
+  /// the body frame (see \ref So3Spline::velocityBody)
+  /// @param[out] accel_body if not nullptr, return the rotational
+  /// acceleration in the body frame (see \ref So3Spline::accelerationBody)
+  /// @return SO(3) value of the spline
+  SO3 evaluate(int64_t time_ns,
+               Vec3* vel_body = nullptr,
+               Vec3* accel_body = nullptr) {
+    VecN powers;
+    seek(time_ns, powers);
+
+    const bool need_vel = vel_body || accel_body;
+
+    const VecN coeff = A[0] * powers;
+    VecN dcoeff, ddcoeff;
+    if (need_vel) dcoeff = A[1] * powers;
+    if (accel_body) ddcoeff = A[2] * powers;
+
+    SO3 res = first_knot;
+
+    Vec3 rot_vel;
+    rot_vel.setZero();
+
+    Vec3 rot_accel;
+    rot_accel.setZero();
+
+    for (int i = 0; i < DEG; i++) {
+      const SO3 exp_k_delta = SO3::exp(coeff[i + 1] * deltas[i]);
+      res *= exp_k_delta;
+
+      if (need_vel) {
+        const SO3 rot = exp_k_delta.inverse();
+
+        rot_vel = rot * rot_vel;
+        const Vec3 vel_current = dcoeff[i + 1] * deltas[i];
+        rot_vel += vel_current;
+
+        if (accel_body) {
+          rot_accel = rot * rot_accel;
+          rot_accel += ddcoeff[i + 1] * deltas[i] + rot_vel.cross(vel_current);
+        }
+      }
+    }
+
+    if (vel_body) *vel_body = rot_vel;
+    if (accel_body) *accel_body = rot_accel;
+    return res;
+  }
+
+  /// @brief Evaluate rotational velocity in the body frame
+  ///
+  /// @param[in] time_ns time for evaluating the spline in nanoseconds
+  /// @return rotational velocity (3x1 vector)
+  Vec3 velocityBody(int64_t time_ns) {
+    VecN powers;
+    seek(time_ns, powers);
+
+    const VecN coeff = A[0] * powers;
+    const VecN dcoeff = A[1] * powers;
+
+    Vec3 rot_vel;
+    rot_vel.setZero();
+
+    for (int i = 0; i < DEG; i++) {
+      rot_vel = SO3::exp(-coeff[i + 1] * deltas[i]) * rot_vel;
+      rot_vel += dcoeff[i + 1] * deltas[i];
+    }
+
+    return rot_vel;
+  }
+
+  /// @brief Evaluate rotational acceleration in the body frame
+  ///
+  /// @param[in] time_ns time for evaluating the spline in nanoseconds
+  /// @param[out] vel_body if not nullptr, return the rotational velocity in
+  /// the body frame (3x1 vector) (side computation)
+  /// @return rotational acceleration (3x1 vector)
+  Vec3 accelerationBody(int64_t time_ns, Vec3* vel_body = nullptr) {
+    VecN powers;
+    seek(time_ns, powers);
+
+    const VecN coeff = A[0] * powers;
+    const VecN dcoeff = A[1] * powers;
+    const VecN ddcoeff = A[2] * powers;
+
+    Vec3 rot_vel;
+    rot_vel.setZero();
+
+    Vec3 rot_accel;
+    rot_accel.setZero();
+
+    for (int i = 0; i < DEG; i++) {
+      const SO3 rot = SO3::exp(-coeff[i + 1] * deltas[i]);
+
+      rot_vel = rot * rot_vel;
+      const Vec3 vel_current = dcoeff[i + 1] * deltas[i];
+      rot_vel += vel_current;
+
+      rot_accel = rot * rot_accel;
+      rot_accel += ddcoeff[i + 1] * deltas[i] + rot_vel.cross(vel_current);
+    }
+
+    if (vel_body) *vel_body = rot_vel;
+    return rot_accel;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  /// @brief Find the knot interval of time_ns and update the cache
+  ///
+  /// @param[in] time_ns time in nanoseconds
+  /// @param[out] powers powers of the normalized time in the interval
+  void seek(int64_t time_ns, VecN& powers) {
+    const int64_t dt_ns = spline_.getTimeIntervalNs();
+    const int64_t st_ns = (time_ns - spline_.minTimeNs());
+
+    BASALT_ASSERT_STREAM(st_ns >= 0,
+                         "st_ns " << st_ns << " time_ns " << time_ns
+                                  << " start_t_ns " << spline_.minTimeNs());
+
+    const int64_t s = st_ns / dt_ns;
+    const _Scalar u = _Scalar(st_ns % dt_ns) / _Scalar(dt_ns);
+
+    BASALT_ASSERT_STREAM(
+        size_t(s + N) <= spline_.getKnots().size(),
+        "s " << s << " N " << N << " knots.size() "
+             << spline_.getKnots().size());
+
+    if (s != segment) {
+      int first_new = 0;
+      if (segment >= 0 && s == segment + 1) {
+        // consecutive interval, reuse all but one log
+        for (int i = 0; i < DEG - 1; i++) deltas[i] = deltas[i + 1];
+        first_new = DEG - 1;
+      }
+      for (int i = first_new; i < DEG; i++) {
+        deltas[i] = (spline_.getKnot(s + i).inverse() *
+                     spline_.getKnot(s + i + 1))
+                        .log();
+      }
+      first_knot = spline_.getKnot(s);
+      segment = s;
+    }
+
+    powers[0] = 1.0;
+    for (int j = 1; j < N; j++) powers[j] = powers[j - 1] * u;
+  }
+
+  const Spline& spline_;  ///< Evaluated spline
+
+  /// Blending matrices for value, first and second derivative
+  std::array<MatN, 3> A;
+
+  int64_t segment = -1;          ///< Cached knot interval, -1 if none
+  SO3 first_knot;                ///< First knot of the cached interval
+  std::array<Vec3, DEG> deltas;  ///< Logs of the knot differences
+};
@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <dirent.h>
+#include <functional>
 #include <vector>
 
 namespace OpenICC {
@@ -47,6 +48,14 @@ inline BoardType StringToBoardType(const std::string& board_type) {
 
 class BoardExtractor {
  public:
+  //! Called for every frame with a detected board while extracting a video or
+  //! an image folder, e.g. to calibrate while the extraction is running.
+  using DetectionCallback =
+      std::function<void(const double timestamp_s,
+                         const cv::Size& image_size,
+                         const aligned_vector<Eigen::Vector2d>& corners,
+                         const std::vector<int>& object_pt_ids)>;
+
   BoardExtractor();
 
   //! Extracts an initialized board type from an image
@@ -92,9 +101,17 @@ class BoardExtractor {
   //! Set verbose plot
   void SetVerbosePlot() { verbose_plot_ = true; }
 
- private:
+  void SetDetectionCallback(const DetectionCallback& callback) {
+    detection_callback_ = callback;
+  }
+
+  //! Frame rate of the last extracted video or image folder
+  double GetCameraFps() const { return camera_fps_; }
+
+  //! Writes the 3d board points to "scene_pts"
   void BoardToJson(nlohmann::json& output_json);
 
+ private:
   //! Board type
   BoardType board_type_;
 
@@ -128,6 +145,10 @@ class BoardExtractor {
 
   //! display extracted corners
   bool verbose_plot_ = false;
+
+  DetectionCallback detection_callback_;
+
+  double camera_fps_ = 0.0;
 };
 
 }  // namespace core
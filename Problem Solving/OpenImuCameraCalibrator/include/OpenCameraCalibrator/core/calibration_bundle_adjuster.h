@@ -0,0 +1,168 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <ceres/ceres.h>
+#include <theia/sfm/bundle_adjustment/bundle_adjustment.h>
+#include <theia/sfm/reconstruction.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "OpenCameraCalibrator/utils/view_statistics.h"
+
+namespace OpenICC {
+namespace core {
+
+//! Bundle adjuster for planar board calibration datasets.
+//! The ceres problem is built once from the reconstruction. The calibration
+//! stages only switch parameter blocks between constant and variable, and
+//! outlier views are removed by dropping their residual blocks instead of
+//! rebuilding the whole problem.
+//! Each view contributes a single residual block that holds all of its board
+//! observations (see CalibViewReprojectionCostFunction).
+class CalibrationBundleAdjuster {
+ public:
+  explicit CalibrationBundleAdjuster(theia::Reconstruction* recon);
+
+  //! Adds all views, board points and observations of the reconstruction.
+  //! The robust loss is taken from options and kept for all stages.
+  void Build(const theia::BundleAdjustmentOptions& options);
+
+  //! Adds the residual blocks of the estimated views of the reconstruction
+  //! that are not part of the built problem yet, e.g. the views added since
+  //! the last refinement of an incremental calibration. Returns the number of
+  //! added views.
+  int AddNewViews();
+
+  //! Runs one stage. Cameras and intrinsics are constant/variable as given in
+  //! options. If optimize_points is set, only the board points are optimized
+  //! with all cameras and intrinsics fixed.
+  theia::BundleAdjustmentSummary Optimize(
+      const theia::BundleAdjustmentOptions& options,
+      const bool optimize_points = false);
+
+  //! Mean reprojection error of a view from the statistics of the last
+  //! Optimize call.
+  double GetViewReprojError(const theia::ViewId view_id) const;
+
+  //! Reprojection statistics of a view, filled from one evaluation of all
+  //! view residual blocks at the end of each Optimize call. nullptr if the
+  //! view is not part of the problem or was not optimized yet.
+  const utils::ViewStatistics* GetViewStatistics(
+      const theia::ViewId view_id) const;
+
+  //! Removes all views with a mean reprojection error above max_reproj_error
+  //! from the problem and the reconstruction. Returns removed view ids and
+  //! their errors.
+  std::map<theia::ViewId, double> RemoveViewsReprojError(
+      const double max_reproj_error);
+
+  //! Adds a Gaussian prior (mean, information matrix in the theia parameter
+  //! order) to all intrinsics blocks, e.g. from a previous calibration.
+  //! A prior that was set before is replaced.
+  void SetIntrinsicsPrior(const Eigen::VectorXd& mean,
+                          const Eigen::MatrixXd& information);
+
+  //! Marginal information matrix of the intrinsics block of view_id at the
+  //! current estimate, the Schur complement of the intrinsics with all view
+  //! poses eliminated (see utils::ComputeMarginalInformation). Parameters that
+  //! are constant in the last stage get no information.
+  bool GetIntrinsicsInformation(const theia::ViewId view_id,
+                                Eigen::MatrixXd& information);
+
+  //! Covariance of the intrinsics block of view_id in the theia parameter
+  //! order, the pseudo inverse of the marginal information scaled with the
+  //! a-posteriori variance of the reprojection residuals.
+  bool GetIntrinsicsCovariance(const theia::ViewId view_id,
+                               Eigen::MatrixXd& covariance);
+
+  bool IsBuilt() const { return is_built_; }
+
+ private:
+  struct ViewResiduals {
+    ceres::ResidualBlockId residual_id = nullptr;
+    ceres::CostFunction* cost_function = nullptr;
+    std::vector<double*> points;
+    Eigen::Matrix2Xd features;
+    theia::CameraIntrinsicsModelType camera_model;
+    double* extrinsics = nullptr;
+    double* intrinsics = nullptr;
+  };
+
+  void SetCameraParametersConstness(
+      const theia::BundleAdjustmentOptions& options);
+
+  //! one residual per observation with the board point as parameter block,
+  //! only present during a board point stage
+  void AddPointResiduals();
+
+  void RemovePointResiduals();
+
+  //! false if the view is not estimated or has no observations
+  bool AddView(const theia::ViewId view_id);
+
+  void RemoveView(const theia::ViewId view_id);
+
+  void AddIntrinsicsPrior(double* intrinsics);
+
+  bool ComputeIntrinsicsInformation(const theia::ViewId view_id,
+                                    Eigen::MatrixXd& information,
+                                    double& variance_factor);
+
+  void UpdateViewStatistics();
+
+  //! reconstruction that holds the parameters, not owned
+  theia::Reconstruction* recon_;
+
+  std::unique_ptr<ceres::Problem> problem_;
+
+  //! loss function is shared by all residual blocks and owned by us
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+
+  std::unordered_map<theia::ViewId, ViewResiduals> view_residuals_;
+
+  //! shared intrinsics blocks -> a view that uses them
+  std::unordered_map<double*, theia::ViewId> intrinsics_blocks_;
+
+  //! constant parameters of each intrinsics block in the current stage
+  std::unordered_map<double*, std::vector<int>> constant_intrinsics_;
+
+  //! residual block of the intrinsics prior of each intrinsics block
+  std::unordered_map<double*, ceres::ResidualBlockId> prior_residual_ids_;
+
+  std::vector<ceres::ResidualBlockId> point_residual_ids_;
+
+  //! reprojection statistics after the last Optimize call
+  utils::ViewStatisticsMap view_stats_;
+
+  int num_threads_ = 1;
+
+  //! prior on the intrinsics, empty if not used
+  Eigen::VectorXd prior_mean_;
+
+  Eigen::MatrixXd prior_sqrt_information_;
+
+  bool is_built_ = false;
+
+  bool points_parameterized_ = false;
+};
+
+}  // namespace core
+}  // namespace OpenICC
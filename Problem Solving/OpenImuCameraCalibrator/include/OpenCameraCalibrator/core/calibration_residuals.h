@@ -0,0 +1,307 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ceres/ceres.h>
+#include <ceres/rotation.h>
+#include <theia/sfm/camera/camera.h>
+
+#include <Eigen/Core>
+
+#include <cmath>
+#include <vector>
+
+namespace OpenICC {
+namespace core {
+
+//! Reprojection error of a single board observation. Used for the stage that
+//! optimizes the (homogeneous) board points.
+template <class CameraModel>
+struct CalibReprojectionError {
+  explicit CalibReprojectionError(const Eigen::Vector2d& feature)
+      : feature(feature) {}
+
+  template <typename T>
+  bool operator()(const T* extrinsics,
+                  const T* intrinsics,
+                  const T* point,
+                  T* residuals) const {
+    // remove the translation
+    T adjusted_point[3];
+    for (int i = 0; i < 3; ++i) {
+      adjusted_point[i] =
+          point[i] - point[3] * extrinsics[theia::Camera::POSITION + i];
+    }
+    // rotate point to camera frame
+    T rotated_point[3];
+    ceres::AngleAxisRotatePoint(
+        extrinsics + theia::Camera::ORIENTATION, adjusted_point, rotated_point);
+
+    T reprojection[2];
+    if (!CameraModel::CameraToPixelCoordinates(
+            intrinsics, rotated_point, reprojection)) {
+      return false;
+    }
+    residuals[0] = reprojection[0] - T(feature[0]);
+    residuals[1] = reprojection[1] - T(feature[1]);
+    return true;
+  }
+
+  Eigen::Vector2d feature;
+};
+
+//! Reprojection error of a board observation of one camera of a rig.
+//! frame_extrinsics is the board pose in the reference camera and
+//! rig_extrinsics the pose of the camera relative to the reference camera
+//! (position in the reference camera frame, rotation reference to camera),
+//! both in the theia extrinsics layout.
+template <class CameraModel>
+struct RigReprojectionError {
+  RigReprojectionError(const Eigen::Vector2d& feature,
+                       const Eigen::Vector3d& point)
+      : feature(feature), point(point) {}
+
+  template <typename T>
+  bool operator()(const T* frame_extrinsics,
+                  const T* rig_extrinsics,
+                  const T* intrinsics,
+                  T* residuals) const {
+    // board to reference camera
+    T adjusted_point[3];
+    for (int i = 0; i < 3; ++i) {
+      adjusted_point[i] =
+          T(point[i]) - frame_extrinsics[theia::Camera::POSITION + i];
+    }
+    T ref_point[3];
+    ceres::AngleAxisRotatePoint(frame_extrinsics + theia::Camera::ORIENTATION,
+                                adjusted_point,
+                                ref_point);
+    // reference camera to this camera
+    for (int i = 0; i < 3; ++i) {
+      adjusted_point[i] =
+          ref_point[i] - rig_extrinsics[theia::Camera::POSITION + i];
+    }
+    T rotated_point[3];
+    ceres::AngleAxisRotatePoint(rig_extrinsics + theia::Camera::ORIENTATION,
+                                adjusted_point,
+                                rotated_point);
+
+    T reprojection[2];
+    if (!CameraModel::CameraToPixelCoordinates(
+            intrinsics, rotated_point, reprojection)) {
+      return false;
+    }
+    residuals[0] = reprojection[0] - T(feature[0]);
+    residuals[1] = reprojection[1] - T(feature[1]);
+    return true;
+  }
+
+  Eigen::Vector2d feature;
+  Eigen::Vector3d point;
+};
+
+//! All board observations of one view in a single residual block with the
+//! parameter blocks [extrinsics, intrinsics]. The board points are read
+//! through pointers, so they are constant for this cost function but pick up
+//! changes made by a board point optimization.
+//!
+//! Jacobians are computed with one fixed-size Jet over the 6 + kIntrinsicsSize
+//! camera parameters. The rotation matrix and its derivatives are computed
+//! once per view instead of once per observation.
+//! A robust loss has to be given here and not to the residual block, as ceres
+//! would apply it to the squared norm of the whole view. Each observation r
+//! is scaled to sqrt(rho(|r|^2)) * r / |r|, which keeps the cost identical to
+//! one robustified residual block per corner.
+template <class CameraModel>
+class CalibViewReprojectionCostFunction : public ceres::CostFunction {
+ public:
+  static constexpr int kExtrinsicsSize = theia::Camera::kExtrinsicsSize;
+  static constexpr int kIntrinsicsSize = CameraModel::kIntrinsicsSize;
+  static constexpr int kNumParameters = kExtrinsicsSize + kIntrinsicsSize;
+  using JetT = ceres::Jet<double, kNumParameters>;
+
+  CalibViewReprojectionCostFunction(
+      const std::vector<const double*>& points,
+      const Eigen::Matrix2Xd& features,
+      const ceres::LossFunction* loss_function = nullptr)
+      : points_(points), features_(features), loss_function_(loss_function) {
+    CHECK_EQ(points_.size(), static_cast<size_t>(features_.cols()));
+    set_num_residuals(2 * points_.size());
+    mutable_parameter_block_sizes()->push_back(kExtrinsicsSize);
+    mutable_parameter_block_sizes()->push_back(kIntrinsicsSize);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    if (jacobians == nullptr) {
+      return ProjectAll<double>(parameters[0], parameters[1], residuals, true);
+    }
+
+    JetT extrinsics[kExtrinsicsSize];
+    JetT intrinsics[kIntrinsicsSize];
+    for (int i = 0; i < kExtrinsicsSize; ++i) {
+      extrinsics[i] = JetT(parameters[0][i], i);
+    }
+    for (int i = 0; i < kIntrinsicsSize; ++i) {
+      intrinsics[i] = JetT(parameters[1][i], kExtrinsicsSize + i);
+    }
+
+    std::vector<JetT> jet_residuals(num_residuals());
+    if (!ProjectAll<JetT>(
+            extrinsics, intrinsics, jet_residuals.data(), true)) {
+      return false;
+    }
+
+    for (int r = 0; r < num_residuals(); ++r) {
+      residuals[r] = jet_residuals[r].a;
+      if (jacobians[0] != nullptr) {
+        Eigen::Map<Eigen::Matrix<double, 1, kExtrinsicsSize>>(
+            jacobians[0] + r * kExtrinsicsSize) =
+            jet_residuals[r].v.template head<kExtrinsicsSize>().transpose();
+      }
+      if (jacobians[1] != nullptr) {
+        Eigen::Map<Eigen::Matrix<double, 1, kIntrinsicsSize>>(
+            jacobians[1] + r * kIntrinsicsSize) =
+            jet_residuals[r].v.template tail<kIntrinsicsSize>().transpose();
+      }
+    }
+    return true;
+  }
+
+  //! Reprojection residuals without the robust loss, e.g. to compute the
+  //! reprojection error of the view. residuals has 2 * NumObservations().
+  bool EvaluateReprojections(const double* extrinsics,
+                             const double* intrinsics,
+                             double* residuals) const {
+    return ProjectAll<double>(extrinsics, intrinsics, residuals, false);
+  }
+
+  int NumObservations() const { return static_cast<int>(points_.size()); }
+
+ private:
+  void Robustify(double* residual) const {
+    const double sq_norm =
+        residual[0] * residual[0] + residual[1] * residual[1];
+    if (sq_norm < kMinSqNorm) {
+      return;
+    }
+    double rho[3];
+    loss_function_->Evaluate(sq_norm, rho);
+    const double scale = std::sqrt(rho[0] / sq_norm);
+    residual[0] *= scale;
+    residual[1] *= scale;
+  }
+
+  void Robustify(JetT* residual) const {
+    const JetT sq_norm = residual[0] * residual[0] + residual[1] * residual[1];
+    if (sq_norm.a < kMinSqNorm) {
+      return;
+    }
+    double rho[3];
+    loss_function_->Evaluate(sq_norm.a, rho);
+    // scale(s) = sqrt(rho(s) / s), chain rule through the Jet of s
+    const double scale = std::sqrt(rho[0] / sq_norm.a);
+    const double d_scale = (rho[1] * sq_norm.a - rho[0]) /
+                           (2.0 * sq_norm.a * sq_norm.a * scale);
+    JetT scale_jet(scale);
+    scale_jet.v = d_scale * sq_norm.v;
+    residual[0] *= scale_jet;
+    residual[1] *= scale_jet;
+  }
+
+  template <typename T>
+  bool ProjectAll(const T* extrinsics,
+                  const T* intrinsics,
+                  T* residuals,
+                  const bool apply_loss) const {
+    // column major rotation world to camera
+    Eigen::Matrix<T, 3, 3> R;
+    ceres::AngleAxisToRotationMatrix(extrinsics + theia::Camera::ORIENTATION,
+                                     R.data());
+    const Eigen::Matrix<T, 3, 1> position(
+        extrinsics[theia::Camera::POSITION + 0],
+        extrinsics[theia::Camera::POSITION + 1],
+        extrinsics[theia::Camera::POSITION + 2]);
+
+    for (size_t i = 0; i < points_.size(); ++i) {
+      const double* X = points_[i];
+      const Eigen::Matrix<T, 3, 1> adjusted_point =
+          Eigen::Matrix<T, 3, 1>(T(X[0]), T(X[1]), T(X[2])) -
+          T(X[3]) * position;
+      const Eigen::Matrix<T, 3, 1> rotated_point = R * adjusted_point;
+      T reprojection[2];
+      if (!CameraModel::CameraToPixelCoordinates(
+              intrinsics, rotated_point.data(), reprojection)) {
+        return false;
+      }
+      residuals[2 * i + 0] = reprojection[0] - features_(0, i);
+      residuals[2 * i + 1] = reprojection[1] - features_(1, i);
+      if (apply_loss && loss_function_) {
+        Robustify(residuals + 2 * i);
+      }
+    }
+    return true;
+  }
+
+  //! below this squared norm every loss is quadratic
+  static constexpr double kMinSqNorm = 1e-16;
+
+  //! homogeneous board points, not owned
+  std::vector<const double*> points_;
+
+  Eigen::Matrix2Xd features_;
+
+  //! robust loss per observation, not owned
+  const ceres::LossFunction* loss_function_;
+};
+
+//! Gaussian prior on an intrinsics block, r = sqrt_information * (x - mean).
+//! Used to carry the information of previous calibration sessions.
+class IntrinsicsPriorCostFunction : public ceres::CostFunction {
+ public:
+  IntrinsicsPriorCostFunction(const Eigen::VectorXd& mean,
+                              const Eigen::MatrixXd& sqrt_information)
+      : mean_(mean), sqrt_information_(sqrt_information) {
+    CHECK_EQ(mean_.size(), sqrt_information_.cols());
+    set_num_residuals(sqrt_information_.rows());
+    mutable_parameter_block_sizes()->push_back(mean_.size());
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    const Eigen::Map<const Eigen::VectorXd> x(parameters[0], mean_.size());
+    Eigen::Map<Eigen::VectorXd>(residuals, num_residuals()) =
+        sqrt_information_ * (x - mean_);
+    if (jacobians != nullptr && jacobians[0] != nullptr) {
+      Eigen::Map<Eigen::Matrix<double,
+                               Eigen::Dynamic,
+                               Eigen::Dynamic,
+                               Eigen::RowMajor>>(
+          jacobians[0], num_residuals(), mean_.size()) = sqrt_information_;
+    }
+    return true;
+  }
+
+ private:
+  Eigen::VectorXd mean_;
+
+  Eigen::MatrixXd sqrt_information_;
+};
+
+}  // namespace core
+}  // namespace OpenICC
@@ -18,7 +18,13 @@
 #include <theia/sfm/reconstruction.h>
 #include <theia/solvers/ransac.h>
 
+#include <memory>
+
+#include "OpenCameraCalibrator/core/calibration_bundle_adjuster.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+#include "OpenCameraCalibrator/utils/undistortion_lookup.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
 
 namespace OpenICC {
 namespace core {
@@ -33,8 +39,46 @@ class CameraCalibrator {
   bool CalibrateCameraFromJson(const nlohmann::json& scene_json,
                                const std::string& output_path);
 
+  //! Board points ("scene_pts" of the scene json) and image size, has to be
+  //! called before the first AddFrame.
+  void InitializeScene(const nlohmann::json& scene_json,
+                       const int image_width,
+                       const int image_height);
+
+  //! Initializes the pose of one board detection and adds it as a view if
+  //! no other view is close by. Views are initialized with calibrated poses
+  //! once a running estimate (RefineIntrinsics) or a loaded state exists, the
+  //! running estimate is preferred.
+  bool AddFrame(const double timestamp_s,
+                const std::vector<int>& board_pt3_ids,
+                const aligned_vector<Eigen::Vector2d>& corners);
+
+  //! Short refinement of the current views and intrinsics without removing
+  //! outliers, it updates the running estimate used by AddFrame. The problem
+  //! is kept between calls and only extended by the new views. Returns false
+  //! if there are not enough views yet.
+  bool RefineIntrinsics(const int max_iterations);
+
+  //! Running intrinsics estimate, only valid after a RefineIntrinsics call
+  bool GetRunningEstimate(theia::Camera& camera) const {
+    camera = running_camera_;
+    return has_running_estimate_;
+  }
+
+  //! Full calibration of all added views and writing of the results
+  bool FinishCalibration(const std::string& output_path, const double fps);
+
   bool WriteCalibration(const std::string& output_path);
 
+  //! Loads the state of a previous calibration of the same camera. New views
+  //! are then initialized with its intrinsics, and the previous views enter
+  //! the optimization only through a prior on the intrinsics.
+  bool LoadCalibrationState(const std::string& state_file);
+
+  //! Writes intrinsics, their marginal information and the used view
+  //! positions (including the ones of a loaded state).
+  bool WriteCalibrationState(const std::string& state_file);
+
   void RemoveViewsReprojError(const double max_reproj_error = 2.0);
 
   bool AddObservation(const theia::ViewId& view_id,
@@ -62,10 +106,50 @@ class CameraCalibrator {
   //! Print result
   void PrintResult();
 
+  //! Calibrated camera, only valid after a successful calibration
+  bool GetCalibratedCamera(theia::Camera& camera) const {
+    if (recon_calib_dataset_.NumViews() == 0) {
+      return false;
+    }
+    camera =
+        recon_calib_dataset_.View(recon_calib_dataset_.ViewIds()[0])->Camera();
+    return true;
+  }
+
  private:
+  //! number of views of this and all previous calibration sessions
+  int NumCalibrationViews() const {
+    return recon_calib_dataset_.NumViews() + prior_nr_views_;
+  }
+
+  //! Reprojection statistics of view_ids, taken from the last optimization
+  //! if all views are cached, otherwise reprojected in one batch.
+  std::vector<utils::ViewStatistics> GetViewStatistics(
+      const std::vector<theia::ViewId>& view_ids) const;
+
+  //! Calibrated pose of a view from known intrinsics, e.g. of a loaded
+  //! state or the running estimate.
+  bool EstimateCalibratedPose(
+      const theia::Camera& camera,
+      const utils::UndistortionLookup& undistortion_lookup,
+      const std::vector<int>& board_pt3_ids,
+      const aligned_vector<Eigen::Vector2d>& corners,
+      Eigen::Matrix3d& rotation,
+      Eigen::Vector3d& position);
+
+  //! Poses of the new views followed by a short refinement of everything
+  //! against the intrinsics prior of a loaded state.
+  bool RunIncrementalCalibration(theia::BundleAdjustmentOptions& ba_options);
+
   //! holds all calibration information like views and features
   theia::Reconstruction recon_calib_dataset_;
 
+  //! bundle adjuster that is built once and shared by all calibration stages
+  std::unique_ptr<CalibrationBundleAdjuster> bundle_adjuster_;
+
+  //! problem of RefineIntrinsics, new views are added to it incrementally
+  std::unique_ptr<CalibrationBundleAdjuster> refine_adjuster_;
+
   //! Ransac parameters for initial pose estimation
   theia::RansacParameters ransac_params_;
 
@@ -83,6 +167,35 @@ class CameraCalibrator {
 
   //! min number views for calibration
   int min_num_view_ = 10;
+
+  //! state of a previous calibration, only used if has_prior_ is set
+  bool has_prior_ = false;
+
+  theia::Camera prior_camera_;
+
+  Eigen::MatrixXd prior_information_;
+
+  vec3_vector prior_view_positions_;
+
+  int prior_nr_views_ = 0;
+
+  //! iterations of the global refinement of an incremental calibration
+  int incremental_max_iterations_ = 10;
+
+  //! image size and accepted view positions of the current recording
+  int image_width_ = 0;
+
+  int image_height_ = 0;
+
+  vec3_vector saved_poses_;
+
+  //! intrinsics of RefineIntrinsics, only used if has_running_estimate_ is set
+  bool has_running_estimate_ = false;
+
+  theia::Camera running_camera_;
+
+  //! undistortion of the camera new views are initialized with
+  std::unique_ptr<utils::UndistortionLookup> undistortion_lookup_;
 };
 
 }  // namespace core
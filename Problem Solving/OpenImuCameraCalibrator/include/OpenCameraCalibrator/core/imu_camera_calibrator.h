@@ -16,6 +16,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 
 #include "OpenCameraCalibrator/utils/types.h"
 
@@ -50,13 +51,13 @@ class ImuCameraCalibrator {
   //! camera timestamps in seconds
   std::vector<double> GetCamTimestamps() { return cam_timestamps_; }
 
-  //! get gyroscope measurements
-  aligned_map<double, Eigen::Vector3d> GetGyroMeasurements() {
+  //! gyroscope measurements in the spline time range, sorted by time
+  const timed_vec3_vector& GetGyroMeasurements() const {
     return gyro_measurements_;
   }
 
-  //! get accelerometer measurements
-  aligned_map<double, Eigen::Vector3d> GetAcclMeasurements() {
+  //! accelerometer measurements in the spline time range, sorted by time
+  const timed_vec3_vector& GetAcclMeasurements() const {
     return accl_measurements_;
   }
 
@@ -76,17 +77,90 @@ class ImuCameraCalibrator {
                         ThreeAxisSensorCalibParams<double>& gyr_intrinsics,
                         const int64_t time_ns = 0);
 
+  //! Instead of one accelerometer and gyroscope residual per IMU sample, the
+  //! samples are averaged in nr_points bins per knot interval and one
+  //! residual per bin is added at the mean sample time. The weight of a bin
+  //! is sqrt(nr_samples) / std, the standard deviation of the mean of white
+  //! measurement noise. 0 (default) adds every sample. Has to be set before
+  //! BatchInitSpline.
+  void SetImuCollocationPointsPerKnot(const int nr_points) {
+    imu_collocation_points_per_knot_ = nr_points;
+  }
+
+  //! Optimizes the spline in windows of window_s seconds that overlap by
+  //! overlap_s instead of one problem over the whole recording (see
+  //! SplineTrajectoryEstimator::SetWindowedOptimization). 0 (default) solves
+  //! the full problem. Has to be set before BatchInitSpline.
+  void SetSplineWindow(const double window_s, const double overlap_s) {
+    spline_window_s_ = window_s;
+    spline_window_overlap_s_ = overlap_s;
+  }
+
+  //! Places the SO3 and R3 knots non-uniformly by the local bandwidth of the
+  //! gyroscope and accelerometer (see utils::AdaptiveKnotTimes). The SEW knot
+  //! spacing is used in the most dynamic parts, slow parts get up to
+  //! max_dt_factor times sparser knots. Has to be set before BatchInitSpline.
+  void SetAdaptiveKnots(const bool adaptive_knots,
+                        const double max_dt_factor = 4.0) {
+    adaptive_knots_ = adaptive_knots;
+    adaptive_knots_max_dt_factor_ = max_dt_factor;
+  }
+
+  //! Number of SO3 and R3 knots of the spline
+  uint64_t GetNumSO3Knots() const { return nr_knots_so3_; }
+  uint64_t GetNumR3Knots() const { return nr_knots_r3_; }
+
+  //! Number of accelerometer and gyroscope residuals added by BatchInitSpline
+  size_t GetNumImuResiduals() const { return nr_imu_residuals_; }
+
+  //! Huber loss width of the camera residuals, 0 (default) disables the
+  //! robust loss. Has to be set before BatchInitSpline.
+  void SetCameraRobustLossWidth(const double robust_loss_width) {
+    camera_robust_loss_width_ = robust_loss_width;
+  }
+
+  //! After each Optimize, observations with a reprojection error above
+  //! max_reproj_error are removed (views with fewer than
+  //! min_view_observations remaining ones completely) and the spline is
+  //! optimized again, for at most nr_rounds or until no outlier is left.
+  //! nr_rounds = 0 (default) disables the outlier rejection.
+  void SetOutlierRejection(const int nr_rounds,
+                           const double max_reproj_error,
+                           const int min_view_observations) {
+    outlier_rounds_ = nr_rounds;
+    outlier_max_reproj_error_ = max_reproj_error;
+    outlier_min_view_observations_ = min_view_observations;
+  }
+
+  //! Number of observations and views removed as outliers by all Optimize
+  //! calls
+  size_t GetNumRemovedObservations() const { return nr_removed_observations_; }
+  size_t GetNumRemovedViews() const { return nr_removed_views_; }
+
  private:
   void InitializeGravity(const OpenICC::CameraTelemetryData& telemetry_data);
 
+  using ImuMeasurements =
+      std::vector<SplineTrajectoryEstimator<SPLINE_N>::ImuMeasurement>;
+
+  void AppendImuMeasurement(const Eigen::Vector3d& accl,
+                            const Eigen::Vector3d& gyro,
+                            const double t_s,
+                            const double weight_scale,
+                            ImuMeasurements& accl_meas,
+                            ImuMeasurements& gyro_meas) const;
+
+  void CollocateImuMeasurements(ImuMeasurements& accl_meas,
+                                ImuMeasurements& gyro_meas) const;
+
   //! camera timestamps
   std::vector<double> cam_timestamps_;
 
-  //! accl measurements
-  aligned_map<double, Eigen::Vector3d> gyro_measurements_;
-
   //! gyro measurements
-  aligned_map<double, Eigen::Vector3d> accl_measurements_;
+  timed_vec3_vector gyro_measurements_;
+
+  //! accl measurements
+  timed_vec3_vector accl_measurements_;
 
   //! spline know spacing in R3 and SO3 in seconds
   SplineWeightingData spline_weight_data_;
@@ -114,6 +188,32 @@ class ImuCameraCalibrator {
   //! is gravity direction in sensor frame is initialized
   bool reestimate_biases_ = false;
 
+  //! IMU bins per knot interval, 0 adds one residual per sample
+  int imu_collocation_points_per_knot_ = 0;
+
+  size_t nr_imu_residuals_ = 0;
+
+  //! spline window length and overlap [s], 0 optimizes the full problem
+  double spline_window_s_ = 0.0;
+  double spline_window_overlap_s_ = 0.0;
+
+  //! non-uniform knots from the IMU bandwidth
+  bool adaptive_knots_ = false;
+  double adaptive_knots_max_dt_factor_ = 4.0;
+  //! union of the SO3 and R3 segment boundaries [ns] of adaptive knots, the
+  //! IMU collocation bins split these segments. Empty for uniform knots.
+  std::vector<int64_t> adaptive_knot_times_ns_;
+
+  double camera_robust_loss_width_ = 0.0;
+
+  //! outlier rejection after each Optimize, disabled with 0 rounds
+  int outlier_rounds_ = 0;
+  double outlier_max_reproj_error_ = 3.0;
+  int outlier_min_view_observations_ = 10;
+
+  size_t nr_removed_observations_ = 0;
+  size_t nr_removed_views_ = 0;
+
   theia::Reconstruction image_data_;
 };
 
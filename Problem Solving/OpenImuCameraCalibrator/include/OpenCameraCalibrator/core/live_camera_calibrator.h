@@ -0,0 +1,128 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "OpenCameraCalibrator/core/camera_calibrator.h"
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace core {
+
+//! Board corners of one frame as they come from the extractor
+struct BoardDetection {
+  double timestamp_s = 0.0;
+  int image_width = 0;
+  int image_height = 0;
+  std::vector<int> object_pt_ids;
+  aligned_vector<Eigen::Vector2d> corners;
+};
+
+//! Cells per image side of the coverage map
+const int LIVE_COVERAGE_GRID_SIZE = 8;
+
+//! Online camera calibration. Detections are pushed into a queue by the
+//! extraction thread and consumed by a background thread that initializes
+//! the views and regularly refines a running intrinsics estimate
+//! (CameraCalibrator::RefineIntrinsics). New views are then initialized with
+//! calibrated poses, so the final calibration in Finish starts close to the
+//! solution and only has to run once after the last frame.
+class LiveCameraCalibrator {
+ public:
+  LiveCameraCalibrator(const std::string& camera_model,
+                       const bool optimize_board_pts);
+
+  ~LiveCameraCalibrator();
+
+  //! To configure the calibration (grid size, calibration state, ...) before
+  //! Start. Must not be used while the background thread is running.
+  CameraCalibrator& Calibrator() { return calibrator_; }
+
+  //! Refine the running estimate every nr_views accepted views
+  void SetRefineInterval(const int nr_views) { refine_interval_ = nr_views; }
+
+  //! Starts the background thread, scene_json holds the board points
+  void Start(const nlohmann::json& scene_json);
+
+  //! Thread safe, returns immediately
+  void PushDetection(const BoardDetection& detection);
+
+  //! Processes the remaining detections, stops the background thread and runs
+  //! the final calibration.
+  bool Finish(const std::string& output_path, const double fps);
+
+  //! Thread safe copy of the running estimate, false if there is none yet
+  bool GetRunningEstimate(theia::Camera& camera) const;
+
+  //! Number of corners of accepted views per image cell (row major
+  //! LIVE_COVERAGE_GRID_SIZE^2) and the fraction of cells that have corners.
+  Eigen::MatrixXi GetCoverageMap() const;
+
+  double GetCoverage() const;
+
+ private:
+  void Run();
+
+  void UpdateCoverage(const BoardDetection& detection);
+
+  CameraCalibrator calibrator_;
+
+  nlohmann::json scene_json_;
+
+  std::thread worker_;
+
+  //! detection queue between the extraction and the calibration thread
+  std::mutex queue_mutex_;
+
+  std::condition_variable queue_cond_;
+
+  std::deque<BoardDetection> queue_;
+
+  bool stop_ = false;
+
+  //! running estimate and coverage, read by other threads
+  mutable std::mutex estimate_mutex_;
+
+  bool has_running_estimate_ = false;
+
+  theia::Camera running_camera_;
+
+  Eigen::MatrixXi coverage_map_;
+
+  //! only touched by the background thread
+  bool scene_initialized_ = false;
+
+  int nr_accepted_views_ = 0;
+
+  int views_at_last_refinement_ = 0;
+
+  int refine_interval_ = 10;
+
+  //! iterations of a refinement of the running estimate
+  int refine_max_iterations_ = 5;
+};
+
+}  // namespace core
+}  // namespace OpenICC
@@ -59,6 +59,20 @@ class PoseEstimator {
   void FilterBadPoses();
 
  private:
+  //! Pose from the board homography or, if use_ransac is set and the
+  //! closed form fails, from PnP RANSAC. Only reads member state, so it can
+  //! be called for several views in parallel as long as use_ransac is false.
+  bool EstimatePlanarPose(
+      const std::vector<theia::FeatureCorrespondence2D3D>&
+          correspondences_undist,
+      const bool use_ransac,
+      theia::CalibratedAbsolutePose& pose,
+      std::vector<int>& inliers) const;
+
+  //! Refines the pose of a view from its observations with the fixed-size
+  //! Gauss-Newton solver. Only touches the camera of view_id.
+  bool RefineViewPose(const theia::ViewId view_id);
+
   //! Pose datasets
   theia::Reconstruction pose_dataset_;
 
@@ -79,6 +93,12 @@ class PoseEstimator {
 
   //! PnP type
   theia::PnPType pnp_type_ = theia::PnPType::DLS;
+
+  //! Minimum number of pose inliers
+  size_t min_num_inliers_ = 6;
+
+  //! Threads for the independent per-view pose estimation and refinement
+  int num_threads_ = 1;
 };
 
 }  // namespace core
@@ -0,0 +1,133 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <theia/sfm/camera/camera.h>
+#include <theia/sfm/reconstruction.h>
+
+#include <Eigen/Core>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace core {
+
+//! Calibration of a rig of synchronized cameras that observe the same board.
+//! 1. The intrinsics of all cameras are calibrated in parallel, each with its
+//!    own CameraCalibrator.
+//! 2. Board poses of all detections are estimated per camera in parallel from
+//!    the calibrated intrinsics.
+//! 3. Detections of different cameras within the sync tolerance form a frame.
+//!    The camera to reference camera extrinsics are initialized from the
+//!    frames that two cameras share.
+//! 4. One joint bundle adjustment over frame poses, rig extrinsics and
+//!    intrinsics. Frame poses are eliminated first (Schur complement), so the
+//!    reduced system only holds the rig extrinsics and intrinsics.
+//! Camera 0 is the reference camera of the rig.
+class RigCalibrator {
+ public:
+  RigCalibrator(const std::string& camera_model,
+                const bool optimize_board_pts);
+
+  //! One scene json (see extract_board_to_json) per camera
+  bool CalibrateRigFromJsons(const std::vector<nlohmann::json>& scene_jsons,
+                             const std::string& output_path);
+
+  //! Detections of different cameras are simultaneous if their timestamps
+  //! are closer than this
+  void SetSyncTolerance(const double sync_tolerance_s = 0.005) {
+    sync_tolerance_s_ = sync_tolerance_s;
+  }
+
+  //! frames will only be used if there is no other frame in a voxel
+  void SetGridSize(const double grid_size = 0.04) { grid_size_ = grid_size; }
+
+  void SetVerbose() { verbose_ = true; }
+
+  void PrintResult() const;
+
+ private:
+  using Vector6d = Eigen::Matrix<double, 6, 1>;
+
+  struct BoardObservation {
+    double timestamp_s;
+    std::vector<int> board_pt3_ids;
+    Eigen::Matrix2Xd corners;
+    //! world to camera
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d position;
+    bool success = false;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  bool CalibrateCameras(const std::vector<nlohmann::json>& scene_jsons,
+                        const std::string& output_path);
+
+  void EstimateBoardPoses(const std::vector<nlohmann::json>& scene_jsons);
+
+  void GroupSynchronizedFrames();
+
+  bool InitializeRigExtrinsics();
+
+  void InitializeFramePoses();
+
+  double OptimizeRig();
+
+  bool WriteRigCalibration(const std::string& output_path,
+                           const std::vector<nlohmann::json>& scene_jsons,
+                           const double total_reproj_error);
+
+  //! camera model of all cameras
+  std::string camera_model_;
+
+  //! also optimize board points in the per camera calibration
+  bool optimize_board_pts_ = false;
+
+  double sync_tolerance_s_ = 0.005;
+
+  double grid_size_ = 0.04;
+
+  bool verbose_ = false;
+
+  //! min number of frames two cameras need to share to relate them
+  int min_num_shared_frames_ = 3;
+
+  //! board points, the same board is seen by all cameras
+  theia::Reconstruction board_;
+
+  //! calibrated camera of each rig camera
+  std::vector<theia::Camera> cameras_;
+
+  //! detections and board poses per camera
+  std::vector<aligned_vector<BoardObservation>> observations_;
+
+  //! frame -> (camera -> index into observations_)
+  std::vector<std::map<int, size_t>> frames_;
+
+  //! board pose in the reference camera per frame (theia extrinsics layout)
+  aligned_vector<Vector6d> frame_extrinsics_;
+
+  //! pose of camera i in the reference camera (theia extrinsics layout)
+  aligned_vector<Vector6d> rig_extrinsics_;
+};
+
+}  // namespace core
+}  // namespace OpenICC
@@ -5,10 +5,17 @@
 
 #include "OpenCameraCalibrator/basalt_spline/ceres_calib_split_residuals.h"
 #include "OpenCameraCalibrator/basalt_spline/ceres_local_param.h"
+#include "OpenCameraCalibrator/utils/adaptive_knots.h"
+#include "OpenCameraCalibrator/utils/banded_arrowhead_solver.h"
+#include "OpenCameraCalibrator/utils/marginal_covariance.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
 
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 namespace OpenICC {
@@ -26,8 +33,53 @@ enum SplineOptimFlags {
   GYR_BIAS = 1 << 8
 };
 
+//! CERES: sparse normal Cholesky of ceres. BANDED: Levenberg-Marquardt with
+//! a block-banded Cholesky of the knots and a Schur complement onto the
+//! global parameters (see utils::SolveBandedProblem), falls back to ceres if
+//! the problem does not fit.
+enum class SplineSolverType { CERES, BANDED };
+
 const double GRAVITY_MAGN = 9.81;
 
+//! Spline states at a batch of timestamps in a structure of arrays layout,
+//! one column per timestamp (see SplineTrajectoryEstimator::
+//! EvaluateTrajectory). Samples outside of the spline have valid[i] = 0, an
+//! identity orientation and zero columns otherwise.
+struct TrajectorySamples {
+  std::vector<int64_t> time_ns;
+  std::vector<uint8_t> valid;
+
+  //! orientation R_w_i as quaternion coefficients x, y, z, w
+  Eigen::Matrix4Xd orientations;
+
+  //! position and velocity of the IMU in the world frame
+  Eigen::Matrix3Xd positions;
+  Eigen::Matrix3Xd velocities;
+
+  //! angular velocity and specific force in the IMU frame, what an ideal
+  //! gyroscope and accelerometer without bias would measure
+  Eigen::Matrix3Xd angular_velocities;
+  Eigen::Matrix3Xd accelerations;
+
+  Eigen::Matrix3Xd gyro_biases;
+  Eigen::Matrix3Xd accl_biases;
+
+  size_t Size() const { return time_ns.size(); }
+
+  Sophus::SE3d Pose(const size_t i) const {
+    return Sophus::SE3d(
+        Eigen::Map<const Eigen::Quaterniond>(orientations.col(i).data()),
+        positions.col(i));
+  }
+};
+
+//! residual blocks of outlier views get replaced between the solves
+inline ceres::Problem::Options SplineProblemOptions() {
+  ceres::Problem::Options options;
+  options.enable_fast_removal = true;
+  return options;
+}
+
 template <int _N>
 class SplineTrajectoryEstimator {
  public:
@@ -45,6 +97,16 @@ class SplineTrajectoryEstimator {
                 int64_t start_time_ns,
                 int64_t end_time_ns);
 
+  //! Switches the SO3 and R3 splines to non-uniform knots. The times are the
+  //! segment boundaries [ns] from the start to the end time of SetTimes (see
+  //! utils::AdaptiveKnotTimes), the number of knots and the blending matrices
+  //! of all segments follow from them. Has to be called after SetTimes and
+  //! before the knots are initialized.
+  void SetKnotTimes(const std::vector<int64_t>& so3_segment_times_ns,
+                    const std::vector<int64_t>& r3_segment_times_ns);
+
+  bool HasUniformKnots() const { return so3_segment_times_ns_.empty(); }
+
   void InitSpline(const int flags, const double end_time_s = 0.0);
 
   void InitBiasSplines(const Eigen::Vector3d& accl_init_bias,
@@ -60,14 +122,31 @@ class SplineTrajectoryEstimator {
 
   void SetFixedParams(const int flags);
 
+  //! Optimizes the full problem, or all windows in sequence if windowed
+  //! optimization is enabled. Returns the summary of the last solve.
   ceres::Solver::Summary Optimize(const int max_iters, const int flags);
 
-  // keep the rest constant and only optimize a window
+  //! Optimizes only the measurements in [start_time, end_time) [ns] in their
+  //! own problem, the rest of the trajectory is kept constant. Knots shared
+  //! with the previous window are fixed and the global parameters (T_i_c,
+  //! gravity, line delay, IMU intrinsics) get the marginal information of the
+  //! previous window as prior. Requires windowed optimization.
   ceres::Solver::Summary Optimize(const int max_iters,
                                   const int flags,
                                   const int64_t start_time,
                                   const int64_t end_time);
 
+  //! Windowed optimization for long recordings: measurements are only stored
+  //! by the Add* functions and each Optimize call solves windows of window_s
+  //! seconds that overlap by overlap_s, so the solver memory is bounded by
+  //! the window size. The overlap has to span at least N knots. Has to be
+  //! called before any measurement is added, window_s = 0 disables it.
+  void SetWindowedOptimization(const double window_s, const double overlap_s);
+
+  void SetSolverType(const SplineSolverType solver_type) {
+    solver_type_ = solver_type;
+  }
+
   bool AddGPSMeasurement(const Eigen::Vector3d& meas,
                          const int64_t time_ns,
                          const double weight_gps);
@@ -80,6 +159,23 @@ class SplineTrajectoryEstimator {
                                const int64_t time_ns,
                                const double weight_se3);
 
+  struct ImuMeasurement {
+    Eigen::Vector3d meas;
+    int64_t time_ns;
+    //! inverse standard deviation
+    double weight;
+  };
+
+  //! Adds many IMU samples at once. Knot indices, normalized spline times
+  //! and cost functions are computed in parallel, the residual blocks are
+  //! registered afterwards in one serial pass. Samples outside of the spline
+  //! are skipped, returns the number of added residuals.
+  size_t AddAccelerometerMeasurements(
+      const std::vector<ImuMeasurement>& measurements);
+
+  size_t AddGyroscopeMeasurements(
+      const std::vector<ImuMeasurement>& measurements);
+
   bool AddGSCameraMeasurement(const theia::View* view,
                               const double robust_loss_width);
   bool AddRSCameraMeasurement(const theia::View* view,
@@ -127,18 +223,61 @@ class SplineTrajectoryEstimator {
 
   int64_t GetMinTimeNs() const;
 
-  Eigen::Vector3d GetGyroBias(const int64_t& time_ns);
-
-  Eigen::Vector3d GetAcclBias(const int64_t& time_ns);
-
+  Eigen::Vector3d GetGyroBias(const int64_t& time_ns) const;
+
+  Eigen::Vector3d GetAcclBias(const int64_t& time_ns) const;
+
+  //! Evaluates pose, velocities, acceleration and IMU biases at all sorted
+  //! timestamps times_ns in one pass. The samples are split into chunks that
+  //! are evaluated on num_threads threads. Within a chunk the knots of a
+  //! segment, including the bias knots, are gathered once for all of its
+  //! samples. The rotation is evaluated once for pose, angular velocity and
+  //! acceleration, position and its derivatives share the powers of u.
+  //! Returns the number of samples inside of the spline.
+  size_t EvaluateTrajectory(
+      const std::vector<int64_t>& times_ns,
+      TrajectorySamples& samples,
+      const int num_threads = std::thread::hardware_concurrency()) const;
+
+  //! Mean reprojection error of all camera measurements (weighted with the
+  //! feature information, without robust loss). The residuals are evaluated
+  //! in parallel with cost functions that are created once per measurement
+  //! and reused by later calls.
   double GetMeanReprojectionError();
 
+  //! Reprojection statistics of each camera measurement, including the
+  //! error of every observation, e.g. for outlier rejection.
+  utils::ViewStatisticsMap GetReprojectionStatistics();
+
+  struct OutlierStatistics {
+    //! including the observations of removed views
+    size_t nr_removed_observations = 0;
+    size_t nr_removed_views = 0;
+  };
+
+  //! Removes all observations with a reprojection error above
+  //! max_reproj_error (weighted with the feature information as in
+  //! GetMeanReprojectionError) at the current estimate. The residual block of
+  //! an affected view is replaced by one with its inliers, views with fewer
+  //! than min_observations inliers are removed completely. The knots and
+  //! points are kept, so the next Optimize call is warm started.
+  OutlierStatistics RemoveReprojectionOutliers(const double max_reproj_error,
+                                               const size_t min_observations);
+
   Eigen::Vector3d GetGravity() const;
 
   Sophus::SE3d GetT_i_c() const;
 
   double GetRSLineDelay() const;
 
+  // Marginal covariance of T_i_c (6x6, in the tangent space of the SE3 local
+  // parameterization) and the line delay [s^2] with all parameters in flags
+  // eliminated through their Schur complement. Parameters that are not in
+  // flags are treated as known and get zero covariance.
+  bool GetCalibrationCovariance(const int flags,
+                                Eigen::Matrix<double, 6, 6>& cov_T_i_c,
+                                double& var_line_delay);
+
   ThreeAxisSensorCalibParams<double> GetAcclIntrinsics(const int64_t& time_ns);
 
   ThreeAxisSensorCalibParams<double> GetGyroIntrinsics(const int64_t& time_ns);
@@ -148,14 +287,121 @@ class SplineTrajectoryEstimator {
   void ConvertInvDepthPointsToHom();
 
  private:
-  bool CalcSO3Times(const int64_t sensor_time, double& u_so3, int64_t& s_so3);
-  bool CalcR3Times(const int64_t sensor_time, double& u_r3, int64_t& s_r3);
+  struct CameraMeasurement {
+    //! view in image_data_
+    theia::ViewId view_id;
+    int64_t time_ns;
+    //! observations that are used, all of the view until outliers are removed
+    std::vector<theia::TrackId> track_ids;
+    double robust_loss_width;
+    bool rolling_shutter;
+    //! residual block in problem_, nullptr in windowed optimization
+    ceres::ResidualBlockId residual_id = nullptr;
+  };
+
+  void SetFixedParams(ceres::Problem& problem, const int flags);
+
+  ceres::Solver::Options GetSolverOptions(const int max_iters) const;
+
+  //! solves problem with the selected solver type
+  ceres::Solver::Summary Solve(ceres::Problem& problem, const int max_iters);
+
+  //! SO3 and R3 knots interleaved by their time, the band of the problem
+  std::vector<double*> GetKnotBlocksInTimeOrder();
+
+  //! first knot of the spline segments of an IMU residual
+  struct KnotIndices {
+    int64_t s_so3 = 0;
+    int64_t s_r3 = 0;
+    int64_t s_bias = 0;
+  };
+
+  //! nullptr if the measurement is outside of the spline, thread safe
+  ceres::CostFunction* CreateAccelerometerCostFunction(
+      const ImuMeasurement& m, KnotIndices& knots) const;
+
+  ceres::CostFunction* CreateGyroscopeCostFunction(const ImuMeasurement& m,
+                                                   KnotIndices& knots) const;
+
+  void AddAccelerometerResidualBlock(ceres::Problem& problem,
+                                     ceres::CostFunction* cost_function,
+                                     const KnotIndices& knots);
+
+  void AddGyroscopeResidualBlock(ceres::Problem& problem,
+                                 ceres::CostFunction* cost_function,
+                                 const KnotIndices& knots);
+
+  //! returns the number of added residuals
+  size_t AddImuResiduals(ceres::Problem& problem,
+                         const std::vector<ImuMeasurement>& measurements,
+                         const bool accelerometer);
+
+  //! one residual block with all observations of measurement.track_ids,
+  //! nullptr if the view is outside of the spline
+  ceres::ResidualBlockId AddCameraResidual(
+      ceres::Problem& problem, const CameraMeasurement& measurement);
+
+  //! fixes all spline and bias spline knots that are shared with
+  //! measurements before start_time_ns
+  void FixWindowBoundaryKnots(ceres::Problem& problem,
+                              const int64_t start_time_ns);
+
+  //! Fills the residuals of all reprojection evaluations at the current
+  //! estimate.
+  bool EvaluateReprojectionResiduals();
+
+  bool AddCameraMeasurement(const theia::View* view,
+                            const double robust_loss_width,
+                            const bool rolling_shutter);
+
+  //! global parameter blocks in a fixed order: T_i_c, gravity, line delay,
+  //! accelerometer and gyroscope intrinsics
+  std::vector<double*> GetGlobalParameterBlocks();
+
+  void AddGlobalParameterPrior(ceres::Problem& problem);
+
+  //! Stores the marginal information of the variable global parameters of a
+  //! solved window as prior for the next one. The overlap residuals are added
+  //! to the next window again and left out of the prior, so that they are
+  //! not counted twice.
+  bool UpdateGlobalParameterPrior(
+      ceres::Problem& problem,
+      const std::vector<ceres::ResidualBlockId>& overlap_residual_ids);
+
+  bool CalcSO3Times(const int64_t sensor_time,
+                    double& u_so3,
+                    int64_t& s_so3) const;
+  bool CalcR3Times(const int64_t sensor_time,
+                   double& u_r3,
+                   int64_t& s_r3) const;
   bool CalcTimes(const int64_t sensor_time,
                  double& u,
                  int64_t& s,
                  int64_t dt_ns,
                  size_t nr_knots,
-                 const int N = N_);
+                 const int N = N_) const;
+
+  //! segment s and normalized time u in the non-uniform segments
+  bool CalcSegmentTimes(const int64_t sensor_time,
+                        const std::vector<int64_t>& segment_times_ns,
+                        size_t nr_knots,
+                        double& u,
+                        int64_t& s) const;
+
+  //! inverse segment length [1/s] and column major blending matrix of
+  //! segment s, nullptr for uniform knots
+  double InvSO3Dt(const int64_t s) const;
+  double InvR3Dt(const int64_t s) const;
+  const double* SO3Blending(const int64_t s) const;
+  const double* R3Blending(const int64_t s) const;
+
+  //! time of knot i relative to the start time [ns], used to place the
+  //! knots along the trajectory
+  int64_t SO3KnotTimeNs(const size_t i) const;
+  int64_t R3KnotTimeNs(const size_t i) const;
+  int64_t KnotTimeNs(const size_t i,
+                     const std::vector<int64_t>& segment_times_ns,
+                     const int64_t dt_ns) const;
 
   int64_t start_t_ns_;
   int64_t end_t_ns_;
@@ -170,6 +416,13 @@ class SplineTrajectoryEstimator {
   size_t nr_knots_so3_;
   size_t nr_knots_r3_;
 
+  //! non-uniform knots: absolute segment boundaries [ns] and the N x N
+  //! blending matrices of all segments, empty for uniform knots
+  std::vector<int64_t> so3_segment_times_ns_;
+  std::vector<int64_t> r3_segment_times_ns_;
+  std::vector<double> so3_blending_;
+  std::vector<double> r3_blending_;
+
   so3_vector so3_knots_;
   vec3_vector r3_knots_;
 
@@ -214,6 +467,42 @@ class SplineTrajectoryEstimator {
 
   ceres::Problem problem_;
 
+  SplineSolverType solver_type_ = SplineSolverType::CERES;
+
+  //! windowed optimization, IMU measurements are only recorded if
+  //! window_ns_ > 0
+  int64_t window_ns_ = 0;
+  int64_t window_overlap_ns_ = 0;
+
+  std::vector<ImuMeasurement> accl_measurements_;
+  std::vector<ImuMeasurement> gyro_measurements_;
+
+  //! all added camera measurements, also used for the reprojection errors
+  std::vector<CameraMeasurement> camera_measurements_;
+
+  //! reprojection residuals of a camera measurement for reporting, the cost
+  //! function is null if the measurement is outside of the spline or its
+  //! camera model is not supported
+  struct ReprojectionEvaluation {
+    std::unique_ptr<ceres::CostFunction> cost_function;
+    int64_t s_so3 = 0;
+    int64_t s_r3 = 0;
+    std::vector<double*> parameters;
+    Eigen::Matrix2Xd residuals;
+  };
+
+  //! one per camera measurement, in the same order
+  std::vector<ReprojectionEvaluation> reprojection_evaluations_;
+
+  //! prior on the global parameters from the last window: blocks, their mean
+  //! (tangent mean for T_i_c) and the marginal information
+  std::vector<double*> prior_blocks_;
+  std::vector<int> prior_block_sizes_;
+  Sophus::SE3d prior_T_i_c_;
+  Eigen::VectorXd prior_mean_;
+  Eigen::MatrixXd prior_information_;
+  double prior_variance_factor_ = 1.0;
+
   bool spline_initialized_with_gps_ = false;
 };
 
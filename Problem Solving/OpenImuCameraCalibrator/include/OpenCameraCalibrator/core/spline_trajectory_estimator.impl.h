@@ -2,6 +2,11 @@
 
 #include <theia/theia.h>
 
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <unordered_set>
+
 namespace OpenICC {
 namespace core {
 
@@ -10,7 +15,8 @@ SplineTrajectoryEstimator<_T>::SplineTrajectoryEstimator()
     : dt_so3_ns_(0.1 * S_TO_NS),
       dt_r3_ns_(0.1 * S_TO_NS),
       start_t_ns_(0.0),
-      gravity_(Eigen::Vector3d(0, 0, GRAVITY_MAGN)) {
+      gravity_(Eigen::Vector3d(0, 0, GRAVITY_MAGN)),
+      problem_(SplineProblemOptions()) {
   inv_so3_dt_ = S_TO_NS / dt_so3_ns_;
   inv_r3_dt_ = S_TO_NS / dt_r3_ns_;
 
@@ -26,7 +32,8 @@ SplineTrajectoryEstimator<_T>::SplineTrajectoryEstimator(
     : dt_so3_ns_(time_interval_so3_ns),
       dt_r3_ns_(time_interval_r3_ns),
       start_t_ns_(start_time_ns),
-      gravity_(Eigen::Vector3d(0, 0, GRAVITY_MAGN)) {
+      gravity_(Eigen::Vector3d(0, 0, GRAVITY_MAGN)),
+      problem_(SplineProblemOptions()) {
   inv_so3_dt_ = S_TO_NS / dt_so3_ns_;
   inv_r3_dt_ = S_TO_NS / dt_r3_ns_;
 
@@ -48,6 +55,40 @@ void SplineTrajectoryEstimator<_T>::SetTimes(int64_t time_interval_so3_ns,
   nr_knots_r3_ = duration / dt_r3_ns_ + _T;
   inv_so3_dt_ = S_TO_NS / dt_so3_ns_;
   inv_r3_dt_ = S_TO_NS / dt_r3_ns_;
+  so3_segment_times_ns_.clear();
+  r3_segment_times_ns_.clear();
+  so3_blending_.clear();
+  r3_blending_.clear();
+}
+
+template <int _T>
+void SplineTrajectoryEstimator<_T>::SetKnotTimes(
+    const std::vector<int64_t>& so3_segment_times_ns,
+    const std::vector<int64_t>& r3_segment_times_ns) {
+  CHECK_GE(so3_segment_times_ns.size(), 2);
+  CHECK_GE(r3_segment_times_ns.size(), 2);
+  CHECK_EQ(so3_segment_times_ns.front(), start_t_ns_);
+  CHECK_EQ(r3_segment_times_ns.front(), start_t_ns_);
+  so3_segment_times_ns_ = so3_segment_times_ns;
+  r3_segment_times_ns_ = r3_segment_times_ns;
+  // segment s is supported by the knots s..s + N - 1
+  nr_knots_so3_ = so3_segment_times_ns_.size() + N_ - 2;
+  nr_knots_r3_ = r3_segment_times_ns_.size() + N_ - 2;
+
+  const auto blending_matrices = [](const std::vector<int64_t>& times_ns,
+                                    const bool cumulative) {
+    std::vector<double> blending;
+    blending.reserve((times_ns.size() - 1) * N_ * N_);
+    for (size_t s = 0; s + 1 < times_ns.size(); ++s) {
+      const Eigen::MatrixXd M =
+          utils::NonUniformBlendingMatrix(times_ns, s, N_, cumulative);
+      blending.insert(blending.end(), M.data(), M.data() + N_ * N_);
+    }
+    return blending;
+  };
+  // the rotation spline is cumulative
+  so3_blending_ = blending_matrices(so3_segment_times_ns_, true);
+  r3_blending_ = blending_matrices(r3_segment_times_ns_, false);
 }
 
 template <int _T>
@@ -91,43 +132,49 @@ void SplineTrajectoryEstimator<_T>::InitBiasSplines(
 
 template <int _T>
 void SplineTrajectoryEstimator<_T>::SetFixedParams(const int flags) {
+  SetFixedParams(problem_, flags);
+}
+
+template <int _T>
+void SplineTrajectoryEstimator<_T>::SetFixedParams(ceres::Problem& problem,
+                                                   const int flags) {
   // if IMU to Cam trafo should be optimized
-  if (problem_.HasParameterBlock(T_i_c_.data())) {
+  if (problem.HasParameterBlock(T_i_c_.data())) {
     if (!(flags & SplineOptimFlags::T_I_C)) {
-      problem_.SetParameterBlockConstant(T_i_c_.data());
+      problem.SetParameterBlockConstant(T_i_c_.data());
       LOG(INFO) << "Keeping T_I_C constant.";
     } else {
       ceres::LocalParameterization* local_parameterization =
           new LieLocalParameterization<Sophus::SE3d>();
-      problem_.SetParameterization(T_i_c_.data(), local_parameterization);
-      problem_.SetParameterBlockVariable(T_i_c_.data());
+      problem.SetParameterization(T_i_c_.data(), local_parameterization);
+      problem.SetParameterBlockVariable(T_i_c_.data());
       LOG(INFO) << "Optimizing T_I_C.";
     }
   }
 
   // if IMU to Cam trafo should be optimized
-  if (problem_.HasParameterBlock(&cam_line_delay_s_) &&
+  if (problem.HasParameterBlock(&cam_line_delay_s_) &&
       cam_line_delay_s_ != 0.0) {
     if (!(flags & SplineOptimFlags::CAM_LINE_DELAY)) {
-      problem_.SetParameterBlockConstant(&cam_line_delay_s_);
+      problem.SetParameterBlockConstant(&cam_line_delay_s_);
       LOG(INFO) << "Keeping camera line delay constant at: "
                 << cam_line_delay_s_;
     } else {
-      problem_.SetParameterBlockVariable(&cam_line_delay_s_);
+      problem.SetParameterBlockVariable(&cam_line_delay_s_);
       LOG(INFO) << "Optimizing camera line delay.";
     }
   }
 
   // if IMU to Cam trafo should be optimized
-  if (problem_.HasParameterBlock(gravity_.data())) {
+  if (problem.HasParameterBlock(gravity_.data())) {
     if (!(flags & SplineOptimFlags::GRAVITY_DIR)) {
       LOG(INFO) << "Keeping gravity direction constant at: "
                 << gravity_.transpose();
 
-      problem_.SetParameterBlockConstant(gravity_.data());
+      problem.SetParameterBlockConstant(gravity_.data());
     } else {
-      if (problem_.HasParameterBlock(gravity_.data()))
-        problem_.SetParameterBlockVariable(gravity_.data());
+      if (problem.HasParameterBlock(gravity_.data()))
+        problem.SetParameterBlockVariable(gravity_.data());
       LOG(INFO) << "Optimizing gravity direction.";
     }
   }
@@ -137,68 +184,68 @@ void SplineTrajectoryEstimator<_T>::SetFixedParams(const int flags) {
     LOG(INFO) << "Keeping object points constant.";
     for (const auto& tid : tracks_in_problem_) {
       const auto track = image_data_.MutableTrack(tid)->MutablePoint()->data();
-      if (problem_.HasParameterBlock(track))
-        problem_.SetParameterBlockConstant(track);
+      if (problem.HasParameterBlock(track))
+        problem.SetParameterBlockConstant(track);
     }
   } else {
     for (const auto& tid : tracks_in_problem_) {
       const auto track = image_data_.MutableTrack(tid)->MutablePoint()->data();
-      if (problem_.HasParameterBlock(track)) {
-        problem_.SetParameterBlockVariable(track);
+      if (problem.HasParameterBlock(track)) {
+        problem.SetParameterBlockVariable(track);
         ceres::LocalParameterization* local_parameterization =
             new ceres::HomogeneousVectorParameterization(4);
-        problem_.SetParameterization(track, local_parameterization);
+        problem.SetParameterization(track, local_parameterization);
       }
     }
     LOG(INFO) << "Optimizing object points.";
   }
 
   // if imu intrinics should be optimized
-  if (problem_.HasParameterBlock(accl_intrinsics_.data()) &&
-      problem_.HasParameterBlock(gyro_intrinsics_.data())) {
+  if (problem.HasParameterBlock(accl_intrinsics_.data()) &&
+      problem.HasParameterBlock(gyro_intrinsics_.data())) {
     if (!(flags & SplineOptimFlags::IMU_INTRINSICS)) {
       LOG(INFO) << "Keeping IMU intrinsics constant.";
-      problem_.SetParameterBlockConstant(accl_intrinsics_.data());
-      problem_.SetParameterBlockConstant(gyro_intrinsics_.data());
+      problem.SetParameterBlockConstant(accl_intrinsics_.data());
+      problem.SetParameterBlockConstant(gyro_intrinsics_.data());
     } else {
-      problem_.SetParameterBlockVariable(accl_intrinsics_.data());
-      problem_.SetParameterBlockVariable(gyro_intrinsics_.data());
+      problem.SetParameterBlockVariable(accl_intrinsics_.data());
+      problem.SetParameterBlockVariable(gyro_intrinsics_.data());
       LOG(INFO) << "Optimizing IMU intrinsics.";
     }
   }
 
   // add local parametrization for SO(3)
   for (size_t i = 0; i < so3_knots_.size(); ++i) {
-    if (problem_.HasParameterBlock(so3_knots_[i].data())) {
+    if (problem.HasParameterBlock(so3_knots_[i].data())) {
       ceres::LocalParameterization* local_parameterization =
           new LieLocalParameterization<Sophus::SO3d>();
 
-      problem_.SetParameterization(so3_knots_[i].data(),
-                                   local_parameterization);
+      problem.SetParameterization(so3_knots_[i].data(),
+                                  local_parameterization);
     }
   }
   if (!(flags & SplineOptimFlags::SPLINE)) {
     // set knots constant if asked
     for (size_t i = 0; i < r3_knots_.size(); ++i) {
-      if (problem_.HasParameterBlock(r3_knots_[i].data())) {
-        problem_.SetParameterBlockConstant(r3_knots_[i].data());
+      if (problem.HasParameterBlock(r3_knots_[i].data())) {
+        problem.SetParameterBlockConstant(r3_knots_[i].data());
       }
     }
     for (size_t i = 0; i < so3_knots_.size(); ++i) {
-      if (problem_.HasParameterBlock(so3_knots_[i].data())) {
-        problem_.SetParameterBlockConstant(so3_knots_[i].data());
+      if (problem.HasParameterBlock(so3_knots_[i].data())) {
+        problem.SetParameterBlockConstant(so3_knots_[i].data());
       }
     }
   } else {
     // set knots constant if asked
     for (size_t i = 0; i < r3_knots_.size(); ++i) {
-      if (problem_.HasParameterBlock(r3_knots_[i].data())) {
-        problem_.SetParameterBlockVariable(r3_knots_[i].data());
+      if (problem.HasParameterBlock(r3_knots_[i].data())) {
+        problem.SetParameterBlockVariable(r3_knots_[i].data());
       }
     }
     for (size_t i = 0; i < so3_knots_.size(); ++i) {
-      if (problem_.HasParameterBlock(so3_knots_[i].data())) {
-        problem_.SetParameterBlockVariable(so3_knots_[i].data());
+      if (problem.HasParameterBlock(so3_knots_[i].data())) {
+        problem.SetParameterBlockVariable(so3_knots_[i].data());
       }
     }
   }
@@ -209,21 +256,21 @@ void SplineTrajectoryEstimator<_T>::SetFixedParams(const int flags) {
        flags & SplineOptimFlags::IMU_BIASES)) {
     LOG(INFO) << "Optimizing accelerometer bias spline.";
     for (int i = 0; i < accl_bias_spline_.size(); ++i) {
-      if (problem_.HasParameterBlock(accl_bias_spline_[i].data())) {
+      if (problem.HasParameterBlock(accl_bias_spline_[i].data())) {
         for (int d = 0; d < 3; ++d) {
-          problem_.SetParameterLowerBound(
+          problem.SetParameterLowerBound(
               accl_bias_spline_[i].data(), d, -max_accl_bias_range_);
-          problem_.SetParameterUpperBound(
+          problem.SetParameterUpperBound(
               accl_bias_spline_[i].data(), d, max_accl_bias_range_);
         }
-        problem_.SetParameterBlockVariable(accl_bias_spline_[i].data());
+        problem.SetParameterBlockVariable(accl_bias_spline_[i].data());
       }
     }
   } else {
     LOG(INFO) << "Fixing accelerometer bias spline.";
     for (int i = 0; i < accl_bias_spline_.size(); ++i) {
-      if (problem_.HasParameterBlock(accl_bias_spline_[i].data())) {
-        problem_.SetParameterBlockConstant(accl_bias_spline_[i].data());
+      if (problem.HasParameterBlock(accl_bias_spline_[i].data())) {
+        problem.SetParameterBlockConstant(accl_bias_spline_[i].data());
       }
     }
   }
@@ -231,29 +278,29 @@ void SplineTrajectoryEstimator<_T>::SetFixedParams(const int flags) {
        flags & SplineOptimFlags::IMU_BIASES)) {
     LOG(INFO) << "Optimizing gyroscope bias spline.";
     for (int i = 0; i < gyro_bias_spline_.size(); ++i) {
-      if (problem_.HasParameterBlock(gyro_bias_spline_[i].data())) {
+      if (problem.HasParameterBlock(gyro_bias_spline_[i].data())) {
         for (int d = 0; d < 3; ++d) {
-          problem_.SetParameterLowerBound(
+          problem.SetParameterLowerBound(
               gyro_bias_spline_[i].data(), d, -max_gyro_bias_range_);
-          problem_.SetParameterUpperBound(
+          problem.SetParameterUpperBound(
               gyro_bias_spline_[i].data(), d, max_gyro_bias_range_);
         }
-        problem_.SetParameterBlockVariable(gyro_bias_spline_[i].data());
+        problem.SetParameterBlockVariable(gyro_bias_spline_[i].data());
       }
     }
   } else {
     LOG(INFO) << "Fixing gyroscope bias spline.";
     for (int i = 0; i < gyro_bias_spline_.size(); ++i) {
-      if (problem_.HasParameterBlock(gyro_bias_spline_[i].data())) {
-        problem_.SetParameterBlockConstant(gyro_bias_spline_[i].data());
+      if (problem.HasParameterBlock(gyro_bias_spline_[i].data())) {
+        problem.SetParameterBlockConstant(gyro_bias_spline_[i].data());
       }
     }
   }
 }
 
 template <int _T>
-ceres::Solver::Summary SplineTrajectoryEstimator<_T>::Optimize(
-    const int max_iters, const int flags) {
+ceres::Solver::Options SplineTrajectoryEstimator<_T>::GetSolverOptions(
+    const int max_iters) const {
   ceres::Solver::Options options;
   options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
   options.max_num_iterations = max_iters;
@@ -264,17 +311,403 @@ ceres::Solver::Summary SplineTrajectoryEstimator<_T>::Optimize(
   options.parameter_tolerance = 1e-7;
   options.preconditioner_type = ceres::CLUSTER_TRIDIAGONAL;
   options.use_inner_iterations = true;
+  return options;
+}
+
+template <int _T>
+ceres::Solver::Summary SplineTrajectoryEstimator<_T>::Optimize(
+    const int max_iters, const int flags) {
+  ceres::Solver::Summary summary;
+  if (window_ns_ > 0) {
+    const int64_t step_ns = window_ns_ - window_overlap_ns_;
+    // every stage starts without prior, otherwise the data of the previous
+    // stage would be counted twice
+    prior_blocks_.clear();
+    for (int64_t t_ns = start_t_ns_; t_ns < end_t_ns_; t_ns += step_ns) {
+      summary = Optimize(max_iters, flags, t_ns, t_ns + window_ns_);
+      if (t_ns + window_ns_ >= end_t_ns_) {
+        break;
+      }
+    }
+    return summary;
+  }
 
   SetFixedParams(flags);
 
   // Solve
-  ceres::Solver::Summary summary;
-  ceres::Solve(options, &problem_, &summary);
+  summary = Solve(problem_, max_iters);
   std::cout << summary.FullReport() << std::endl;
 
   return summary;
 }
 
+template <int _T>
+ceres::Solver::Summary SplineTrajectoryEstimator<_T>::Solve(
+    ceres::Problem& problem, const int max_iters) {
+  const ceres::Solver::Options options = GetSolverOptions(max_iters);
+  ceres::Solver::Summary summary;
+  if (solver_type_ == SplineSolverType::BANDED) {
+    utils::BandedSolverOptions banded_options;
+    banded_options.max_num_iterations = options.max_num_iterations;
+    banded_options.function_tolerance = options.function_tolerance;
+    banded_options.parameter_tolerance = options.parameter_tolerance;
+    banded_options.num_threads = options.num_threads;
+    banded_options.minimizer_progress_to_stdout =
+        options.minimizer_progress_to_stdout;
+    if (utils::SolveBandedProblem(
+            banded_options, GetKnotBlocksInTimeOrder(), &problem, &summary)) {
+      return summary;
+    }
+    LOG(WARNING) << "Banded solver failed, falling back to ceres.";
+  }
+  ceres::Solve(options, &problem, &summary);
+  return summary;
+}
+
+template <int _T>
+std::vector<double*> SplineTrajectoryEstimator<_T>::GetKnotBlocksInTimeOrder() {
+  std::vector<double*> blocks;
+  blocks.reserve(so3_knots_.size() + r3_knots_.size());
+  size_t i_so3 = 0, i_r3 = 0;
+  while (i_so3 < so3_knots_.size() || i_r3 < r3_knots_.size()) {
+    const bool take_so3 =
+        i_r3 == r3_knots_.size() ||
+        (i_so3 < so3_knots_.size() &&
+         SO3KnotTimeNs(i_so3) <= R3KnotTimeNs(i_r3));
+    if (take_so3) {
+      blocks.push_back(so3_knots_[i_so3++].data());
+    } else {
+      blocks.push_back(r3_knots_[i_r3++].data());
+    }
+  }
+  return blocks;
+}
+
+template <int _T>
+ceres::Solver::Summary SplineTrajectoryEstimator<_T>::Optimize(
+    const int max_iters,
+    const int flags,
+    const int64_t start_time,
+    const int64_t end_time) {
+  CHECK_GT(window_ns_, 0) << "Windowed optimization is not enabled.";
+  LOG(INFO) << "Optimizing spline window [" << start_time * NS_TO_S << ", "
+            << end_time * NS_TO_S << ") s.";
+
+  const auto in_range = [](const std::vector<ImuMeasurement>& all,
+                            const int64_t from_ns,
+                            const int64_t to_ns) {
+    std::vector<ImuMeasurement> range;
+    for (const auto& m : all) {
+      if (m.time_ns >= from_ns && m.time_ns < to_ns) {
+        range.push_back(m);
+      }
+    }
+    return range;
+  };
+  // the measurements after the start of the next window are part of it as
+  // well, their residuals are kept apart for the prior
+  const int64_t next_start_time =
+      end_time < end_t_ns_ ? end_time - window_overlap_ns_ : end_time;
+  ceres::Problem problem;
+  const auto add_residuals = [&](const int64_t from_ns, const int64_t to_ns) {
+    AddImuResiduals(
+        problem, in_range(accl_measurements_, from_ns, to_ns), true);
+    AddImuResiduals(
+        problem, in_range(gyro_measurements_, from_ns, to_ns), false);
+    for (const auto& m : camera_measurements_) {
+      if (m.time_ns < from_ns || m.time_ns >= to_ns) {
+        continue;
+      }
+      AddCameraResidual(problem, m);
+    }
+  };
+  add_residuals(start_time, next_start_time);
+  std::vector<ceres::ResidualBlockId> residual_ids;
+  problem.GetResidualBlocks(&residual_ids);
+  const std::unordered_set<ceres::ResidualBlockId> window_residual_ids(
+      residual_ids.begin(), residual_ids.end());
+  add_residuals(next_start_time, end_time);
+  std::vector<ceres::ResidualBlockId> overlap_residual_ids;
+  problem.GetResidualBlocks(&residual_ids);
+  for (const ceres::ResidualBlockId residual_id : residual_ids) {
+    if (!window_residual_ids.count(residual_id)) {
+      overlap_residual_ids.push_back(residual_id);
+    }
+  }
+
+  ceres::Solver::Summary summary;
+  if (problem.NumResidualBlocks() == 0) {
+    LOG(WARNING) << "No measurements in spline window.";
+    return summary;
+  }
+
+  // the prior can add global blocks that have no measurement in the window
+  AddGlobalParameterPrior(problem);
+  SetFixedParams(problem, flags);
+  if (start_time > start_t_ns_) {
+    FixWindowBoundaryKnots(problem, start_time);
+  }
+
+  if (max_iters > 0) {
+    summary = Solve(problem, max_iters);
+    std::cout << summary.BriefReport() << std::endl;
+  }
+
+  if (!UpdateGlobalParameterPrior(problem, overlap_residual_ids)) {
+    LOG(WARNING) << "Could not compute the marginal information of the "
+                    "window, the next window has no prior.";
+  }
+  return summary;
+}
+
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::AddCameraMeasurement(
+    const theia::View* view,
+    const double robust_loss_width,
+    const bool rolling_shutter) {
+  CameraMeasurement measurement;
+  measurement.view_id = image_data_.ViewIdFromName(view->Name());
+  if (measurement.view_id == theia::kInvalidViewId) {
+    LOG(ERROR) << "View " << view->Name() << " is not in the image data.";
+    return false;
+  }
+  measurement.time_ns = view->GetTimestamp() * S_TO_NS;
+  measurement.track_ids = view->TrackIds();
+  measurement.robust_loss_width = robust_loss_width;
+  measurement.rolling_shutter = rolling_shutter;
+  // windows get their own problem in Optimize
+  if (window_ns_ <= 0) {
+    measurement.residual_id = AddCameraResidual(problem_, measurement);
+    if (measurement.residual_id == nullptr) {
+      return false;
+    }
+  }
+  camera_measurements_.push_back(std::move(measurement));
+  return true;
+}
+
+template <int _T>
+typename SplineTrajectoryEstimator<_T>::OutlierStatistics
+SplineTrajectoryEstimator<_T>::RemoveReprojectionOutliers(
+    const double max_reproj_error, const size_t min_observations) {
+  OutlierStatistics stats;
+  if (!EvaluateReprojectionResiduals()) {
+    LOG(WARNING) << "Could not evaluate all reprojection residuals.";
+  }
+
+  const double sq_max_reproj_error = max_reproj_error * max_reproj_error;
+  std::vector<CameraMeasurement> inlier_measurements;
+  inlier_measurements.reserve(camera_measurements_.size());
+  for (size_t m = 0; m < camera_measurements_.size(); ++m) {
+    CameraMeasurement& meas = camera_measurements_[m];
+    const ReprojectionEvaluation& eval = reprojection_evaluations_[m];
+    if (!eval.cost_function) {
+      inlier_measurements.push_back(std::move(meas));
+      continue;
+    }
+    // failed projections (residual 1e10) are outliers as well
+    std::vector<theia::TrackId> inlier_tracks;
+    inlier_tracks.reserve(meas.track_ids.size());
+    for (int i = 0; i < eval.residuals.cols(); ++i) {
+      if (eval.residuals.col(i).squaredNorm() <= sq_max_reproj_error) {
+        inlier_tracks.push_back(meas.track_ids[i]);
+      }
+    }
+    if (inlier_tracks.size() == meas.track_ids.size()) {
+      inlier_measurements.push_back(std::move(meas));
+      continue;
+    }
+
+    // the view residual holds all observations, replace it by one with the
+    // inliers only
+    if (meas.residual_id != nullptr) {
+      problem_.RemoveResidualBlock(meas.residual_id);
+      meas.residual_id = nullptr;
+    }
+    if (inlier_tracks.size() < min_observations) {
+      stats.nr_removed_observations += meas.track_ids.size();
+      ++stats.nr_removed_views;
+      continue;
+    }
+    stats.nr_removed_observations +=
+        meas.track_ids.size() - inlier_tracks.size();
+    meas.track_ids = std::move(inlier_tracks);
+    if (window_ns_ <= 0) {
+      meas.residual_id = AddCameraResidual(problem_, meas);
+    }
+    inlier_measurements.push_back(std::move(meas));
+  }
+  camera_measurements_ = std::move(inlier_measurements);
+  // the cost functions are rebuilt for the remaining observations
+  reprojection_evaluations_.clear();
+  return stats;
+}
+
+template <int _T>
+void SplineTrajectoryEstimator<_T>::SetWindowedOptimization(
+    const double window_s, const double overlap_s) {
+  window_ns_ = window_s * S_TO_NS;
+  window_overlap_ns_ = overlap_s * S_TO_NS;
+  if (window_ns_ <= 0) {
+    window_ns_ = 0;
+    return;
+  }
+  // the knots shared with the previous window are fixed, the previous window
+  // has to cover their whole support
+  int64_t max_dt_ns = std::max(dt_so3_ns_, dt_r3_ns_);
+  for (const auto* times : {&so3_segment_times_ns_, &r3_segment_times_ns_}) {
+    for (size_t i = 1; i < times->size(); ++i) {
+      max_dt_ns = std::max(max_dt_ns, (*times)[i] - (*times)[i - 1]);
+    }
+  }
+  const int64_t min_overlap_ns = N_ * max_dt_ns;
+  if (window_overlap_ns_ < min_overlap_ns) {
+    LOG(WARNING) << "Spline window overlap has to span " << N_
+                 << " knots, increasing it to " << min_overlap_ns * NS_TO_S
+                 << " s.";
+    window_overlap_ns_ = min_overlap_ns;
+  }
+  CHECK_GT(window_ns_, window_overlap_ns_)
+      << "Spline window has to be longer than its overlap.";
+}
+
+template <int _T>
+void SplineTrajectoryEstimator<_T>::FixWindowBoundaryKnots(
+    ceres::Problem& problem, const int64_t start_time_ns) {
+  // measurements before start_time_ns touch the knots up to s + N - 1
+  double u;
+  int64_t s_so3, s_r3;
+  if (!CalcSO3Times(start_time_ns, u, s_so3)) {
+    s_so3 = so3_knots_.size();
+  }
+  if (!CalcR3Times(start_time_ns, u, s_r3)) {
+    s_r3 = r3_knots_.size();
+  }
+  // the bias splines are shared with the previous window as well
+  int64_t s_accl_bias, s_gyro_bias;
+  if (!CalcTimes(start_time_ns,
+                 u,
+                 s_accl_bias,
+                 dt_accl_bias_ns_,
+                 nr_knots_accl_bias_,
+                 BIAS_SPLINE_N)) {
+    s_accl_bias = accl_bias_spline_.size();
+  }
+  if (!CalcTimes(start_time_ns,
+                 u,
+                 s_gyro_bias,
+                 dt_gyro_bias_ns_,
+                 nr_knots_gyro_bias_,
+                 BIAS_SPLINE_N)) {
+    s_gyro_bias = gyro_bias_spline_.size();
+  }
+  const auto fix_knots = [&problem](auto& knots, const int64_t last) {
+    for (int64_t i = 0; i <= last && i < int64_t(knots.size()); ++i) {
+      if (problem.HasParameterBlock(knots[i].data())) {
+        problem.SetParameterBlockConstant(knots[i].data());
+      }
+    }
+  };
+  fix_knots(so3_knots_, s_so3 + N_ - 1);
+  fix_knots(r3_knots_, s_r3 + N_ - 1);
+  fix_knots(accl_bias_spline_, s_accl_bias + BIAS_SPLINE_N - 1);
+  fix_knots(gyro_bias_spline_, s_gyro_bias + BIAS_SPLINE_N - 1);
+}
+
+template <int _T>
+std::vector<double*>
+SplineTrajectoryEstimator<_T>::GetGlobalParameterBlocks() {
+  return {T_i_c_.data(),
+          gravity_.data(),
+          &cam_line_delay_s_,
+          accl_intrinsics_.data(),
+          gyro_intrinsics_.data()};
+}
+
+template <int _T>
+void SplineTrajectoryEstimator<_T>::AddGlobalParameterPrior(
+    ceres::Problem& problem) {
+  if (prior_blocks_.empty()) {
+    return;
+  }
+  // information = V D V^T -> sqrt_information = D^1/2 V^T
+  const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(
+      prior_information_);
+  const Eigen::MatrixXd sqrt_information =
+      solver.eigenvalues().cwiseMax(0.0).cwiseSqrt().asDiagonal() *
+      solver.eigenvectors().transpose();
+
+  const bool has_T_i_c = prior_blocks_[0] == T_i_c_.data();
+  GlobalParameterPriorFunctor* functor = new GlobalParameterPriorFunctor(
+      has_T_i_c, prior_T_i_c_, prior_block_sizes_, prior_mean_,
+      sqrt_information);
+  ceres::DynamicAutoDiffCostFunction<GlobalParameterPriorFunctor>*
+      cost_function =
+          new ceres::DynamicAutoDiffCostFunction<GlobalParameterPriorFunctor>(
+              functor);
+  if (has_T_i_c) {
+    cost_function->AddParameterBlock(Sophus::SE3d::num_parameters);
+  }
+  for (const int block_size : prior_block_sizes_) {
+    cost_function->AddParameterBlock(block_size);
+  }
+  cost_function->SetNumResiduals(sqrt_information.rows());
+  problem.AddResidualBlock(cost_function, NULL, prior_blocks_);
+}
+
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::UpdateGlobalParameterPrior(
+    ceres::Problem& problem,
+    const std::vector<ceres::ResidualBlockId>& overlap_residual_ids) {
+  prior_blocks_.clear();
+  prior_block_sizes_.clear();
+  std::vector<double*> variable_blocks;
+  for (double* block : GetGlobalParameterBlocks()) {
+    if (problem.HasParameterBlock(block) &&
+        !problem.IsParameterBlockConstant(block)) {
+      variable_blocks.push_back(block);
+    }
+  }
+  if (variable_blocks.empty()) {
+    return true;
+  }
+  std::vector<ceres::ResidualBlockId> prior_residual_ids;
+  if (!overlap_residual_ids.empty()) {
+    const std::unordered_set<ceres::ResidualBlockId> overlap(
+        overlap_residual_ids.begin(), overlap_residual_ids.end());
+    std::vector<ceres::ResidualBlockId> residual_ids;
+    problem.GetResidualBlocks(&residual_ids);
+    for (const ceres::ResidualBlockId residual_id : residual_ids) {
+      if (!overlap.count(residual_id)) {
+        prior_residual_ids.push_back(residual_id);
+      }
+    }
+  }
+  Eigen::MatrixXd information;
+  if (!utils::ComputeMarginalInformation(&problem,
+                                         variable_blocks,
+                                         information,
+                                         &prior_variance_factor_,
+                                         prior_residual_ids)) {
+    return false;
+  }
+
+  std::vector<double> mean;
+  for (double* block : variable_blocks) {
+    if (block == T_i_c_.data()) {
+      continue;
+    }
+    const int block_size = problem.ParameterBlockSize(block);
+    prior_block_sizes_.push_back(block_size);
+    mean.insert(mean.end(), block, block + block_size);
+  }
+  prior_mean_ = Eigen::Map<const Eigen::VectorXd>(mean.data(), mean.size());
+  prior_T_i_c_ = T_i_c_;
+  prior_information_ = information;
+  prior_blocks_ = variable_blocks;
+  return true;
+}
+
 template <int _T>
 void SplineTrajectoryEstimator<_T>::BatchInitSO3R3VisPoses() {
   so3_knots_ = OpenICC::so3_vector(nr_knots_so3_);
@@ -314,12 +747,12 @@ void SplineTrajectoryEstimator<_T>::BatchInitSO3R3VisPoses() {
   // get time at which we want to interpolate
   std::vector<double> t_so3_spline, t_r3_spline;
   for (int i = 0; i < nr_knots_so3_; ++i) {
-    const double t = i * dt_so3_ns_ * NS_TO_S;
+    const double t = SO3KnotTimeNs(i) * NS_TO_S;
     t_so3_spline.push_back(t);
   }
 
   for (int i = 0; i < nr_knots_r3_; ++i) {
-    const double t = i * dt_r3_ns_ * NS_TO_S;
+    const double t = R3KnotTimeNs(i) * NS_TO_S;
     t_r3_spline.push_back(t);
   }
 
@@ -339,21 +772,21 @@ void SplineTrajectoryEstimator<_T>::BatchInitSO3R3VisPoses() {
 }
 
 template <int _T>
-bool SplineTrajectoryEstimator<_T>::AddAccelerometerMeasurement(
-    const Eigen::Vector3d& meas,
-    const int64_t time_ns,
-    const double weight_se3) {
+ceres::CostFunction*
+SplineTrajectoryEstimator<_T>::CreateAccelerometerCostFunction(
+    const ImuMeasurement& m, KnotIndices& knots) const {
+  const int64_t time_ns = m.time_ns;
   double u_r3, u_so3, u_bias;
   int64_t s_r3, s_so3, s_bias;
   if (!CalcR3Times(time_ns, u_r3, s_r3)) {
     LOG(INFO) << "Wrong time adding r3 accelerometer measurements. time_ns: "
               << time_ns << " u_r3: " << u_r3 << " s_r3:" << s_r3;
-    return false;
+    return nullptr;
   }
   if (!CalcSO3Times(time_ns, u_so3, s_so3)) {
     LOG(INFO) << "Wrong time adding so3 accelerometer measurements. time_ns: "
               << time_ns << " u_r3: " << u_r3 << " s_r3:" << s_r3;
-    return false;
+    return nullptr;
   }
   if (!CalcTimes(time_ns,
                  u_bias,
@@ -363,73 +796,75 @@ bool SplineTrajectoryEstimator<_T>::AddAccelerometerMeasurement(
                  BIAS_SPLINE_N)) {
     LOG(INFO) << "Wrong time adding accelerometer bias measurements. time_ns: "
               << time_ns << " u_r3: " << u_bias << " s_r3:" << s_bias;
-    return false;
+    return nullptr;
   }
+  knots.s_so3 = s_so3;
+  knots.s_r3 = s_r3;
+  knots.s_bias = s_bias;
 
   using FunctorT = AccelerationCostFunctorSplit<N_>;
-  FunctorT* functor = new FunctorT(meas,
+  FunctorT* functor = new FunctorT(m.meas,
                                    u_r3,
-                                   inv_r3_dt_,
+                                   InvR3Dt(s_r3),
                                    u_so3,
-                                   inv_so3_dt_,
-                                   weight_se3,
+                                   InvSO3Dt(s_so3),
+                                   m.weight,
                                    u_bias,
-                                   inv_accl_bias_dt_);
+                                   inv_accl_bias_dt_,
+                                   SO3Blending(s_so3),
+                                   R3Blending(s_r3));
 
-  ceres::DynamicAutoDiffCostFunction<FunctorT>* cost_function =
-      new ceres::DynamicAutoDiffCostFunction<FunctorT>(functor);
+  return new FixedSizeSplineCostFunction<FunctorT, 3, FunctorT::kNumParameters>(
+      functor, FunctorT::BlockSizes());
+}
 
+template <int _T>
+void SplineTrajectoryEstimator<_T>::AddAccelerometerResidualBlock(
+    ceres::Problem& problem,
+    ceres::CostFunction* cost_function,
+    const KnotIndices& knots) {
+  // parameter blocks in the order of AccelerationCostFunctorSplit::BlockSizes
   std::vector<double*> vec;
+  vec.reserve(2 * N_ + BIAS_SPLINE_N + 2);
   // so3 spline
   for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(4);
-    const int t = s_so3 + i;
+    const int t = knots.s_so3 + i;
     vec.emplace_back(so3_knots_[t].data());
     so3_knot_in_problem_[t] = true;
   }
 
   // R3 spline
   for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(3);
-    const int t = s_r3 + i;
+    const int t = knots.s_r3 + i;
     vec.emplace_back(r3_knots_[t].data());
     r3_knot_in_problem_[t] = true;
   }
 
   // bias spline
   for (int i = 0; i < BIAS_SPLINE_N; i++) {
-    cost_function->AddParameterBlock(3);
-    const int t = s_bias + i;
+    const int t = knots.s_bias + i;
     vec.emplace_back(accl_bias_spline_[t].data());
   }
 
   // gravity
-  cost_function->AddParameterBlock(3);
   vec.emplace_back(gravity_.data());
 
   // imu intrinsics and bias
-  cost_function->AddParameterBlock(6);
   vec.emplace_back(accl_intrinsics_.data());
 
-  // number of residuals
-  cost_function->SetNumResiduals(3);
-
-  problem_.AddResidualBlock(cost_function, NULL, vec);
-
-  return true;
+  problem.AddResidualBlock(cost_function, NULL, vec);
 }
 
 template <int _T>
-bool SplineTrajectoryEstimator<_T>::AddGyroscopeMeasurement(
-    const Eigen::Vector3d& meas,
-    const int64_t time_ns,
-    const double weight_so3) {
+ceres::CostFunction* SplineTrajectoryEstimator<_T>::CreateGyroscopeCostFunction(
+    const ImuMeasurement& m, KnotIndices& knots) const {
+  const int64_t time_ns = m.time_ns;
   double u_so3, u_bias;
   int64_t s_so3, s_bias;
   if (!CalcSO3Times(time_ns, u_so3, s_so3)) {
     LOG(INFO) << "Wrong time adding so3 gyroscope measurements. time_ns: "
               << time_ns << " u_r3: " << u_so3 << " s_r3:" << s_so3;
-    return false;
+    return nullptr;
   }
 
   if (!CalcTimes(time_ns,
@@ -440,176 +875,223 @@ bool SplineTrajectoryEstimator<_T>::AddGyroscopeMeasurement(
                  BIAS_SPLINE_N)) {
     LOG(INFO) << "Wrong time adding so3 gyroscope bias measurements. time_ns: "
               << time_ns << " u_r3: " << u_bias << " s_r3:" << s_bias;
-    return false;
+    return nullptr;
   }
+  knots.s_so3 = s_so3;
+  knots.s_bias = s_bias;
 
   using FunctorT = GyroCostFunctorSplit<N_, Sophus::SO3, false>;
-  FunctorT* functor = new FunctorT(
-      meas, u_so3, inv_so3_dt_, weight_so3, u_bias, inv_gyro_bias_dt_);
+  FunctorT* functor = new FunctorT(m.meas,
+                                   u_so3,
+                                   InvSO3Dt(s_so3),
+                                   m.weight,
+                                   u_bias,
+                                   inv_gyro_bias_dt_,
+                                   SO3Blending(s_so3));
 
-  ceres::DynamicAutoDiffCostFunction<FunctorT>* cost_function =
-      new ceres::DynamicAutoDiffCostFunction<FunctorT>(functor);
+  return new FixedSizeSplineCostFunction<FunctorT, 3, FunctorT::kNumParameters>(
+      functor, FunctorT::BlockSizes());
+}
 
-  // SO3 spline
+template <int _T>
+void SplineTrajectoryEstimator<_T>::AddGyroscopeResidualBlock(
+    ceres::Problem& problem,
+    ceres::CostFunction* cost_function,
+    const KnotIndices& knots) {
+  // parameter blocks in the order of GyroCostFunctorSplit::BlockSizes
   std::vector<double*> vec;
+  vec.reserve(N_ + BIAS_SPLINE_N + 1);
+  // SO3 spline
   for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(4);
-    const int t = s_so3 + i;
+    const int t = knots.s_so3 + i;
     vec.emplace_back(so3_knots_[t].data());
     so3_knot_in_problem_[t] = true;
   }
   // bias spline
   for (int i = 0; i < BIAS_SPLINE_N; ++i) {
-    cost_function->AddParameterBlock(3);
-    const int t = s_bias + i;
+    const int t = knots.s_bias + i;
     vec.emplace_back(gyro_bias_spline_[t].data());
   }
   // intrinsics
-  cost_function->AddParameterBlock(9);
   vec.emplace_back(gyro_intrinsics_.data());
 
-  cost_function->SetNumResiduals(3);
-
-  problem_.AddResidualBlock(cost_function, NULL, vec);
+  problem.AddResidualBlock(cost_function, NULL, vec);
+}
 
-  return true;
+template <int _T>
+size_t SplineTrajectoryEstimator<_T>::AddImuResiduals(
+    ceres::Problem& problem,
+    const std::vector<ImuMeasurement>& measurements,
+    const bool accelerometer) {
+  // knot indices, normalized times and cost functions are independent per
+  // sample and computed in parallel, ceres::Problem is not thread safe so
+  // the residual blocks are registered in one serial pass afterwards
+  constexpr size_t CHUNK_SIZE = 1024;
+  const size_t nr_meas = measurements.size();
+  std::vector<ceres::CostFunction*> cost_functions(nr_meas, nullptr);
+  std::vector<KnotIndices> knots(nr_meas);
+  utils::ParallelFor((nr_meas + CHUNK_SIZE - 1) / CHUNK_SIZE,
+                     std::thread::hardware_concurrency(),
+                     [&](const size_t chunk) {
+                       const size_t end =
+                           std::min((chunk + 1) * CHUNK_SIZE, nr_meas);
+                       for (size_t i = chunk * CHUNK_SIZE; i < end; ++i) {
+                         cost_functions[i] =
+                             accelerometer
+                                 ? CreateAccelerometerCostFunction(
+                                       measurements[i], knots[i])
+                                 : CreateGyroscopeCostFunction(
+                                       measurements[i], knots[i]);
+                       }
+                     });
+
+  size_t nr_added = 0;
+  for (size_t i = 0; i < nr_meas; ++i) {
+    if (cost_functions[i] == nullptr) {
+      continue;
+    }
+    if (accelerometer) {
+      AddAccelerometerResidualBlock(problem, cost_functions[i], knots[i]);
+    } else {
+      AddGyroscopeResidualBlock(problem, cost_functions[i], knots[i]);
+    }
+    ++nr_added;
+  }
+  return nr_added;
 }
 
 template <int _T>
-bool SplineTrajectoryEstimator<_T>::AddGSCameraMeasurement(
-    const theia::View* view, const double robust_loss_width) {
-  const int64_t image_obs_time_ns = view->GetTimestamp() * S_TO_NS;
-  const auto track_ids = view->TrackIds();
+ceres::ResidualBlockId SplineTrajectoryEstimator<_T>::AddCameraResidual(
+    ceres::Problem& problem, const CameraMeasurement& measurement) {
+  const theia::View* view = image_data_.View(measurement.view_id);
+  const int64_t image_obs_time_ns = measurement.time_ns;
+  const auto& track_ids = measurement.track_ids;
+  if (track_ids.empty()) {
+    return nullptr;
+  }
 
   double u_r3 = 0.0, u_so3 = 0.0;
   int64_t s_r3 = 0, s_so3 = 0;
   if (!CalcR3Times(image_obs_time_ns, u_r3, s_r3)) {
     LOG(INFO) << "Wrong time observation r3 vision measurements. time_ns: "
               << image_obs_time_ns << " u_r3: " << u_r3 << " s_r3:" << s_r3;
-    return false;
+    return nullptr;
   }
   if (!CalcSO3Times(image_obs_time_ns, u_so3, s_so3)) {
     LOG(INFO) << "Wrong time reference so3 vision measurements. time_ns: "
               << image_obs_time_ns << " u_r3: " << u_so3 << " s_r3:" << s_so3;
-    return false;
+    return nullptr;
   }
 
-  using FunctorT = GSReprojectionCostFunctorSplit<N_>;
-  FunctorT* functor = new FunctorT(
-      view, &image_data_, u_so3, u_r3, inv_so3_dt_, inv_r3_dt_, track_ids);
-
-  ceres::DynamicAutoDiffCostFunction<FunctorT>* cost_function =
-      new ceres::DynamicAutoDiffCostFunction<FunctorT>(functor);
+  ceres::CostFunction* cost_function =
+      measurement.rolling_shutter
+          ? CreateSplineReprojectionCostFunction<N_, true>(view,
+                                                           track_ids,
+                                                           u_so3,
+                                                           u_r3,
+                                                           InvSO3Dt(s_so3),
+                                                           InvR3Dt(s_r3),
+                                                           SO3Blending(s_so3),
+                                                           R3Blending(s_r3))
+          : CreateSplineReprojectionCostFunction<N_, false>(
+                view,
+                track_ids,
+                u_so3,
+                u_r3,
+                InvSO3Dt(s_so3),
+                InvR3Dt(s_r3),
+                SO3Blending(s_so3),
+                R3Blending(s_r3));
+  if (cost_function == nullptr) {
+    LOG(ERROR) << "Camera model of view " << view->Name()
+               << " is not supported.";
+    return nullptr;
+  }
 
   std::vector<double*> vec;
   for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(4);
     const int t = s_so3 + i;
     vec.emplace_back(so3_knots_[t].data());
     so3_knot_in_problem_[t] = true;
   }
   for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(3);
     const int t = s_r3 + i;
     vec.emplace_back(r3_knots_[t].data());
     r3_knot_in_problem_[t] = true;
   }
 
   // camera to imu transformation
-  cost_function->AddParameterBlock(7);
   vec.emplace_back(T_i_c_.data());
 
+  // line delay for rolling shutter cameras
+  if (measurement.rolling_shutter) {
+    vec.emplace_back(&cam_line_delay_s_);
+  }
+
   // object point
   for (size_t i = 0; i < track_ids.size(); ++i) {
-    cost_function->AddParameterBlock(4);
     vec.emplace_back(
         image_data_.MutableTrack(track_ids[i])->MutablePoint()->data());
     tracks_in_problem_.insert(track_ids[i]);
   }
 
-  cost_function->SetNumResiduals(track_ids.size() * 2);
-
-  ceres::LossFunction* loss_function = new ceres::HuberLoss(robust_loss_width);
-  problem_.AddResidualBlock(cost_function, loss_function, vec);
-
-  return true;
+  // a Huber loss of width 0 would have a zero cost
+  if (measurement.robust_loss_width == 0.0) {
+    return problem.AddResidualBlock(cost_function, NULL, vec);
+  }
+  ceres::LossFunction* loss_function =
+      new ceres::HuberLoss(measurement.robust_loss_width);
+  return problem.AddResidualBlock(cost_function, loss_function, vec);
 }
 
 template <int _T>
-bool SplineTrajectoryEstimator<_T>::AddRSCameraMeasurement(
-    const theia::View* view, const double robust_loss_width) {
-  const int64_t image_obs_time_ns = view->GetTimestamp() * S_TO_NS;
-  const auto track_ids = view->TrackIds();
-
-  double u_r3 = 0.0, u_so3 = 0.0;
-  int64_t s_r3 = 0, s_so3 = 0;
-  if (!CalcR3Times(image_obs_time_ns, u_r3, s_r3)) {
-    LOG(INFO) << "Wrong time observation r3 vision measurements. time_ns: "
-              << image_obs_time_ns << " u_r3: " << u_r3 << " s_r3:" << s_r3;
-    return false;
-  }
-  if (!CalcSO3Times(image_obs_time_ns, u_so3, s_so3)) {
-    LOG(INFO) << "Wrong time reference so3 vision measurements. time_ns: "
-              << image_obs_time_ns << " u_r3: " << u_so3 << " s_r3:" << s_so3;
-    return false;
-  }
-
-  using FunctorT = RSReprojectionCostFunctorSplit<N_>;
-  FunctorT* functor = new FunctorT(
-      view, &image_data_, u_so3, u_r3, inv_so3_dt_, inv_r3_dt_, track_ids);
-
-  ceres::DynamicAutoDiffCostFunction<FunctorT>* cost_function =
-      new ceres::DynamicAutoDiffCostFunction<FunctorT>(functor);
-
-  std::vector<double*> vec;
-  for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(4);
-    const int t = s_so3 + i;
-    vec.emplace_back(so3_knots_[t].data());
-    so3_knot_in_problem_[t] = true;
-  }
-  for (int i = 0; i < N_; i++) {
-    cost_function->AddParameterBlock(3);
-    const int t = s_r3 + i;
-    vec.emplace_back(r3_knots_[t].data());
-    r3_knot_in_problem_[t] = true;
-  }
-
-  // camera to imu transformation
-  cost_function->AddParameterBlock(7);
-  vec.emplace_back(T_i_c_.data());
-
-  // line delay for rolling shutter cameras
-  cost_function->AddParameterBlock(1);
-  vec.emplace_back(&cam_line_delay_s_);
+bool SplineTrajectoryEstimator<_T>::AddAccelerometerMeasurement(
+    const Eigen::Vector3d& meas,
+    const int64_t time_ns,
+    const double weight_se3) {
+  return AddAccelerometerMeasurements({{meas, time_ns, weight_se3}}) == 1;
+}
 
-  // object point
-  for (size_t i = 0; i < track_ids.size(); ++i) {
-    cost_function->AddParameterBlock(4);
-    vec.emplace_back(
-        image_data_.MutableTrack(track_ids[i])->MutablePoint()->data());
-    tracks_in_problem_.insert(track_ids[i]);
+template <int _T>
+size_t SplineTrajectoryEstimator<_T>::AddAccelerometerMeasurements(
+    const std::vector<ImuMeasurement>& measurements) {
+  if (window_ns_ > 0) {
+    accl_measurements_.insert(
+        accl_measurements_.end(), measurements.begin(), measurements.end());
+    return measurements.size();
   }
+  return AddImuResiduals(problem_, measurements, true);
+}
 
-  cost_function->SetNumResiduals(track_ids.size() * 2);
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::AddGyroscopeMeasurement(
+    const Eigen::Vector3d& meas,
+    const int64_t time_ns,
+    const double weight_so3) {
+  return AddGyroscopeMeasurements({{meas, time_ns, weight_so3}}) == 1;
+}
 
-  if (robust_loss_width == 0.0) {
-    problem_.AddResidualBlock(cost_function, NULL, vec);
-  } else {
-    ceres::LossFunction* loss_function =
-        new ceres::HuberLoss(robust_loss_width);
-    problem_.AddResidualBlock(cost_function, loss_function, vec);
+template <int _T>
+size_t SplineTrajectoryEstimator<_T>::AddGyroscopeMeasurements(
+    const std::vector<ImuMeasurement>& measurements) {
+  if (window_ns_ > 0) {
+    gyro_measurements_.insert(
+        gyro_measurements_.end(), measurements.begin(), measurements.end());
+    return measurements.size();
   }
+  return AddImuResiduals(problem_, measurements, false);
+}
 
-  // bound translation
-  //  problem_.SetParameterLowerBound(T_i_c_.data(), 4, -1e-2);
-  //  problem_.SetParameterUpperBound(T_i_c_.data(), 4, 1e-2);
-  //  problem_.SetParameterLowerBound(T_i_c_.data(), 5, -10e-2);
-  //  problem_.SetParameterUpperBound(T_i_c_.data(), 5, 10e-2);
-  //  problem_.SetParameterLowerBound(T_i_c_.data(), 6, -1e-2);
-  //  problem_.SetParameterUpperBound(T_i_c_.data(), 6, 1e-2);
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::AddGSCameraMeasurement(
+    const theia::View* view, const double robust_loss_width) {
+  return AddCameraMeasurement(view, robust_loss_width, false);
+}
 
-  return true;
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::AddRSCameraMeasurement(
+    const theia::View* view, const double robust_loss_width) {
+  return AddCameraMeasurement(view, robust_loss_width, true);
 }
 
 // template <int _T>
@@ -766,7 +1248,7 @@ bool SplineTrajectoryEstimator<_T>::CalcTimes(const int64_t sensor_time,
                                               int64_t& s,
                                               int64_t dt_ns,
                                               size_t nr_knots,
-                                              const int N) {
+                                              const int N) const {
   const int64_t st_ns = (sensor_time - start_t_ns_);
 
   if (st_ns < 0.0) {
@@ -787,20 +1269,105 @@ bool SplineTrajectoryEstimator<_T>::CalcTimes(const int64_t sensor_time,
   return true;
 }
 
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::CalcSegmentTimes(
+    const int64_t sensor_time,
+    const std::vector<int64_t>& segment_times_ns,
+    size_t nr_knots,
+    double& u,
+    int64_t& s) const {
+  u = 0.0;
+  const auto it = std::upper_bound(
+      segment_times_ns.begin(), segment_times_ns.end(), sensor_time);
+  if (it == segment_times_ns.begin() || it == segment_times_ns.end()) {
+    return false;
+  }
+  s = (it - segment_times_ns.begin()) - 1;
+  if (size_t(s + N_) > nr_knots) {
+    return false;
+  }
+  u = double(sensor_time - *(it - 1)) / double(*it - *(it - 1));
+  return true;
+}
+
 template <int _T>
 bool SplineTrajectoryEstimator<_T>::CalcSO3Times(const int64_t sensor_time,
                                                  double& u_so3,
-                                                 int64_t& s_so3) {
+                                                 int64_t& s_so3) const {
+  if (!HasUniformKnots()) {
+    return CalcSegmentTimes(
+        sensor_time, so3_segment_times_ns_, so3_knots_.size(), u_so3, s_so3);
+  }
   return CalcTimes(sensor_time, u_so3, s_so3, dt_so3_ns_, so3_knots_.size());
 }
 
 template <int _T>
 bool SplineTrajectoryEstimator<_T>::CalcR3Times(const int64_t sensor_time,
                                                 double& u_r3,
-                                                int64_t& s_r3) {
+                                                int64_t& s_r3) const {
+  if (!HasUniformKnots()) {
+    return CalcSegmentTimes(
+        sensor_time, r3_segment_times_ns_, r3_knots_.size(), u_r3, s_r3);
+  }
   return CalcTimes(sensor_time, u_r3, s_r3, dt_r3_ns_, r3_knots_.size());
 }
 
+template <int _T>
+double SplineTrajectoryEstimator<_T>::InvSO3Dt(const int64_t s) const {
+  if (HasUniformKnots()) {
+    return inv_so3_dt_;
+  }
+  return S_TO_NS /
+         double(so3_segment_times_ns_[s + 1] - so3_segment_times_ns_[s]);
+}
+
+template <int _T>
+double SplineTrajectoryEstimator<_T>::InvR3Dt(const int64_t s) const {
+  if (HasUniformKnots()) {
+    return inv_r3_dt_;
+  }
+  return S_TO_NS /
+         double(r3_segment_times_ns_[s + 1] - r3_segment_times_ns_[s]);
+}
+
+template <int _T>
+const double* SplineTrajectoryEstimator<_T>::SO3Blending(
+    const int64_t s) const {
+  return HasUniformKnots() ? nullptr : so3_blending_.data() + s * N_ * N_;
+}
+
+template <int _T>
+const double* SplineTrajectoryEstimator<_T>::R3Blending(const int64_t s) const {
+  return HasUniformKnots() ? nullptr : r3_blending_.data() + s * N_ * N_;
+}
+
+template <int _T>
+int64_t SplineTrajectoryEstimator<_T>::KnotTimeNs(
+    const size_t i,
+    const std::vector<int64_t>& segment_times_ns,
+    const int64_t dt_ns) const {
+  if (segment_times_ns.empty()) {
+    return int64_t(i) * dt_ns;
+  }
+  const size_t last = segment_times_ns.size() - 1;
+  if (i <= last) {
+    return segment_times_ns[i] - start_t_ns_;
+  }
+  return segment_times_ns[last] - start_t_ns_ +
+         int64_t(i - last) *
+             (segment_times_ns[last] - segment_times_ns[last - 1]);
+}
+
+template <int _T>
+int64_t SplineTrajectoryEstimator<_T>::SO3KnotTimeNs(const size_t i) const {
+  return KnotTimeNs(i, so3_segment_times_ns_, dt_so3_ns_);
+}
+
+template <int _T>
+int64_t SplineTrajectoryEstimator<_T>::R3KnotTimeNs(const size_t i) const {
+  return KnotTimeNs(i, r3_segment_times_ns_, dt_r3_ns_);
+}
+
 template <int _T>
 Sophus::SE3d SplineTrajectoryEstimator<_T>::GetKnot(int i) const {
   return Sophus::SE3d(so3_knots_[i], r3_knots_[i]);
@@ -818,6 +1385,9 @@ size_t SplineTrajectoryEstimator<_T>::GetNumR3Knots() const {
 
 template <int _T>
 int64_t SplineTrajectoryEstimator<_T>::GetMaxTimeNs() const {
+  if (!HasUniformKnots()) {
+    return so3_segment_times_ns_.back() - 1;
+  }
   return start_t_ns_ + (so3_knots_.size() - N_ + 1) * dt_so3_ns_ - 1;
 }
 
@@ -889,8 +1459,8 @@ bool SplineTrajectoryEstimator<_T>::GetPosition(const int64_t& time_ns,
     vec.emplace_back(r3_knots_[s_r3 + i].data());
   }
 
-  CeresSplineHelper<double, N_>::template evaluate<3, 0>(
-      &vec[0], u_r3, inv_r3_dt_, &position);
+  CeresSplineHelper<double, N_>::template evaluate_segment<3, 0>(
+      &vec[0], u_r3, InvR3Dt(s_r3), R3Blending(s_r3), &position);
 
   return true;
 }
@@ -915,8 +1485,8 @@ bool SplineTrajectoryEstimator<_T>::GetPose(const int64_t& time_ns,
       vec.emplace_back(so3_knots_[s_so3 + i].data());
     }
 
-    CeresSplineHelper<double, N_>::template evaluate_lie<Sophus::SO3>(
-        &vec[0], u_so3, inv_so3_dt_, &rot);
+    CeresSplineHelper<double, N_>::template evaluate_lie_segment<Sophus::SO3>(
+        &vec[0], u_so3, InvSO3Dt(s_so3), SO3Blending(s_so3), &rot);
   }
   {
     std::vector<const double*> vec;
@@ -924,8 +1494,8 @@ bool SplineTrajectoryEstimator<_T>::GetPose(const int64_t& time_ns,
       vec.emplace_back(r3_knots_[s_r3 + i].data());
     }
 
-    CeresSplineHelper<double, N_>::template evaluate<3, 0>(
-        &vec[0], u_r3, inv_r3_dt_, &trans);
+    CeresSplineHelper<double, N_>::template evaluate_segment<3, 0>(
+        &vec[0], u_r3, InvR3Dt(s_r3), R3Blending(s_r3), &trans);
   }
   pose = Sophus::SE3d(rot, trans);
 
@@ -947,8 +1517,8 @@ bool SplineTrajectoryEstimator<_T>::GetAngularVelocity(
     vec.emplace_back(so3_knots_[s_so3 + i].data());
   }
 
-  CeresSplineHelper<double, N_>::template evaluate_lie<Sophus::SO3>(
-      &vec[0], u_so3, inv_so3_dt_, nullptr, &velocity);
+  CeresSplineHelper<double, N_>::template evaluate_lie_segment<Sophus::SO3>(
+      &vec[0], u_so3, InvSO3Dt(s_so3), SO3Blending(s_so3), nullptr, &velocity);
 
   return true;
 }
@@ -973,8 +1543,8 @@ bool SplineTrajectoryEstimator<_T>::GetAcceleration(
       vec.emplace_back(so3_knots_[s_so3 + i].data());
     }
 
-    CeresSplineHelper<double, N_>::template evaluate_lie<Sophus::SO3>(
-        &vec[0], u_so3, inv_so3_dt_, &rot);
+    CeresSplineHelper<double, N_>::template evaluate_lie_segment<Sophus::SO3>(
+        &vec[0], u_so3, InvSO3Dt(s_so3), SO3Blending(s_so3), &rot);
   }
   {
     std::vector<const double*> vec;
@@ -982,8 +1552,8 @@ bool SplineTrajectoryEstimator<_T>::GetAcceleration(
       vec.emplace_back(r3_knots_[s_r3 + i].data());
     }
 
-    CeresSplineHelper<double, N_>::template evaluate<3, 2>(
-        &vec[0], u_r3, inv_r3_dt_, &trans_accel_world);
+    CeresSplineHelper<double, N_>::template evaluate_segment<3, 2>(
+        &vec[0], u_r3, InvR3Dt(s_r3), R3Blending(s_r3), &trans_accel_world);
   }
   acceleration = rot.inverse() * (trans_accel_world + gravity_);
 
@@ -991,79 +1561,244 @@ bool SplineTrajectoryEstimator<_T>::GetAcceleration(
 }
 
 template <int _T>
-double SplineTrajectoryEstimator<_T>::GetMeanReprojectionError() {
-  // ConvertInvDepthPointsToHom();
-  double sum_error = 0.0;
-  int num_points = 0;
-  for (const auto vid : image_data_.ViewIds()) {
-    const auto* view = image_data_.View(vid);
-    std::vector<theia::TrackId> tracks = view->TrackIds();
-    const size_t nr_obs = tracks.size();
-    if (nr_obs <= 0) {
-      return false;
-    }
+size_t SplineTrajectoryEstimator<_T>::EvaluateTrajectory(
+    const std::vector<int64_t>& times_ns,
+    TrajectorySamples& samples,
+    const int num_threads) const {
+  CHECK(std::is_sorted(times_ns.begin(), times_ns.end()))
+      << "Trajectory timestamps have to be sorted.";
+  const size_t n = times_ns.size();
+  samples.time_ns = times_ns;
+  samples.valid.assign(n, 0);
+  samples.orientations.setZero(4, n);
+  samples.orientations.row(3).setOnes();
+  samples.positions.setZero(3, n);
+  samples.velocities.setZero(3, n);
+  samples.angular_velocities.setZero(3, n);
+  samples.accelerations.setZero(3, n);
+  samples.gyro_biases.setZero(3, n);
+  samples.accl_biases.setZero(3, n);
+
+  constexpr size_t kChunkSize = 1024;
+  const size_t nr_chunks = (n + kChunkSize - 1) / kChunkSize;
+  std::atomic<size_t> nr_valid(0);
+  utils::ParallelFor(nr_chunks, num_threads, [&](const size_t c) {
+    const size_t end = std::min(n, (c + 1) * kChunkSize);
+    // the timestamps are sorted, so consecutive samples mostly stay in the
+    // same segment and keep its knots
+    int64_t cur_so3 = -1, cur_r3 = -1, cur_gyro_bias = -1, cur_accl_bias = -1;
+    std::array<const double*, N_> so3_knots, r3_knots;
+    std::array<const double*, BIAS_SPLINE_N> gyro_bias_knots, accl_bias_knots;
+    size_t chunk_valid = 0;
+    for (size_t i = c * kChunkSize; i < end; ++i) {
+      const int64_t t_ns = times_ns[i];
+      double u_so3, u_r3;
+      int64_t s_so3, s_r3;
+      if (!CalcSO3Times(t_ns, u_so3, s_so3) ||
+          !CalcR3Times(t_ns, u_r3, s_r3)) {
+        continue;
+      }
+      if (s_so3 != cur_so3) {
+        for (int j = 0; j < N_; ++j) {
+          so3_knots[j] = so3_knots_[s_so3 + j].data();
+        }
+        cur_so3 = s_so3;
+      }
+      if (s_r3 != cur_r3) {
+        for (int j = 0; j < N_; ++j) {
+          r3_knots[j] = r3_knots_[s_r3 + j].data();
+        }
+        cur_r3 = s_r3;
+      }
 
-    const int64_t image_time_ns = view->GetTimestamp() * S_TO_NS;
+      Sophus::SO3d R_w_i;
+      Eigen::Vector3d angular_velocity;
+      CeresSplineHelper<double, N_>::template evaluate_lie_segment<Sophus::SO3>(
+          so3_knots.data(),
+          u_so3,
+          InvSO3Dt(s_so3),
+          SO3Blending(s_so3),
+          &R_w_i,
+          &angular_velocity);
+
+      Eigen::Vector3d position, velocity, accel_world;
+      CeresSplineHelper<double, N_>::template evaluate_segment_derivatives<3>(
+          r3_knots.data(),
+          u_r3,
+          InvR3Dt(s_r3),
+          R3Blending(s_r3),
+          &position,
+          &velocity,
+          &accel_world);
+
+      // outside of a bias spline the bias is zero, as in GetGyroBias
+      double u_bias;
+      int64_t s_bias;
+      Eigen::Vector3d gyro_bias = Eigen::Vector3d::Zero();
+      if (CalcTimes(t_ns,
+                    u_bias,
+                    s_bias,
+                    dt_gyro_bias_ns_,
+                    nr_knots_gyro_bias_,
+                    BIAS_SPLINE_N)) {
+        if (s_bias != cur_gyro_bias) {
+          for (int j = 0; j < BIAS_SPLINE_N; ++j) {
+            gyro_bias_knots[j] = gyro_bias_spline_[s_bias + j].data();
+          }
+          cur_gyro_bias = s_bias;
+        }
+        CeresSplineHelper<double, BIAS_SPLINE_N>::template evaluate<3, 0>(
+            gyro_bias_knots.data(), u_bias, inv_gyro_bias_dt_, &gyro_bias);
+      }
+      Eigen::Vector3d accl_bias = Eigen::Vector3d::Zero();
+      if (CalcTimes(t_ns,
+                    u_bias,
+                    s_bias,
+                    dt_accl_bias_ns_,
+                    nr_knots_accl_bias_,
+                    BIAS_SPLINE_N)) {
+        if (s_bias != cur_accl_bias) {
+          for (int j = 0; j < BIAS_SPLINE_N; ++j) {
+            accl_bias_knots[j] = accl_bias_spline_[s_bias + j].data();
+          }
+          cur_accl_bias = s_bias;
+        }
+        CeresSplineHelper<double, BIAS_SPLINE_N>::template evaluate<3, 0>(
+            accl_bias_knots.data(), u_bias, inv_accl_bias_dt_, &accl_bias);
+      }
 
-    double u_r3, u_so3;
-    int64_t s_r3, s_so3;
-    if (!CalcR3Times(image_time_ns, u_r3, s_r3)) {
-      return 0.0;
-    }
-    if (!CalcSO3Times(image_time_ns, u_so3, s_so3)) {
-      return 0.0;
+      samples.valid[i] = 1;
+      samples.orientations.col(i) = R_w_i.unit_quaternion().coeffs();
+      samples.positions.col(i) = position;
+      samples.velocities.col(i) = velocity;
+      samples.angular_velocities.col(i) = angular_velocity;
+      samples.accelerations.col(i) = R_w_i.inverse() * (accel_world + gravity_);
+      samples.gyro_biases.col(i) = gyro_bias;
+      samples.accl_biases.col(i) = accl_bias;
+      ++chunk_valid;
     }
+    nr_valid += chunk_valid;
+  });
+  return nr_valid;
+}
 
-    using FunctorT = RSReprojectionCostFunctorSplit<N_>;
-    FunctorT* functor = new FunctorT(
-        view, &image_data_, u_so3, u_r3, inv_so3_dt_, inv_r3_dt_, tracks);
-
-    ceres::DynamicAutoDiffCostFunction<FunctorT>* cost_function =
-        new ceres::DynamicAutoDiffCostFunction<FunctorT>(functor);
-
-    std::vector<double*> vec;
-    for (int i = 0; i < N_; i++) {
-      cost_function->AddParameterBlock(4);
-      const int t = s_so3 + i;
-      vec.emplace_back(so3_knots_[t].data());
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::EvaluateReprojectionResiduals() {
+  // cost functions of new camera measurements, the parameter blocks are
+  // filled below as the knots can be reinitialized between calls
+  for (size_t m = reprojection_evaluations_.size();
+       m < camera_measurements_.size();
+       ++m) {
+    const CameraMeasurement& meas = camera_measurements_[m];
+    const theia::View* view = image_data_.View(meas.view_id);
+    const auto& track_ids = meas.track_ids;
+
+    ReprojectionEvaluation eval;
+    double u_so3 = 0.0, u_r3 = 0.0;
+    if (!CalcSO3Times(meas.time_ns, u_so3, eval.s_so3) ||
+        !CalcR3Times(meas.time_ns, u_r3, eval.s_r3)) {
+      reprojection_evaluations_.push_back(std::move(eval));
+      continue;
     }
-    for (int i = 0; i < N_; i++) {
-      cost_function->AddParameterBlock(3);
-      const int t = s_r3 + i;
-      vec.emplace_back(r3_knots_[t].data());
+    const double inv_so3_dt = InvSO3Dt(eval.s_so3);
+    const double inv_r3_dt = InvR3Dt(eval.s_r3);
+    const double* so3_blending = SO3Blending(eval.s_so3);
+    const double* r3_blending = R3Blending(eval.s_r3);
+    if (meas.rolling_shutter) {
+      eval.cost_function.reset(
+          CreateSplineReprojectionCostFunction<N_, true>(view,
+                                                         track_ids,
+                                                         u_so3,
+                                                         u_r3,
+                                                         inv_so3_dt,
+                                                         inv_r3_dt,
+                                                         so3_blending,
+                                                         r3_blending));
+    } else {
+      eval.cost_function.reset(
+          CreateSplineReprojectionCostFunction<N_, false>(view,
+                                                          track_ids,
+                                                          u_so3,
+                                                          u_r3,
+                                                          inv_so3_dt,
+                                                          inv_r3_dt,
+                                                          so3_blending,
+                                                          r3_blending));
     }
-
-    // camera to imu transformation
-    cost_function->AddParameterBlock(7);
-    vec.emplace_back(T_i_c_.data());
-
-    // line delay for rolling shutter cameras
-    cost_function->AddParameterBlock(1);
-    vec.emplace_back(&cam_line_delay_s_);
-
-    // all object points
-    for (size_t i = 0; i < nr_obs; ++i) {
-      cost_function->AddParameterBlock(4);
-      vec.emplace_back(
-          image_data_.MutableTrack(tracks[i])->MutablePoint()->data());
+    eval.parameters.resize(2 * N_ + (meas.rolling_shutter ? 2 : 1));
+    for (const auto& track_id : track_ids) {
+      eval.parameters.push_back(
+          image_data_.MutableTrack(track_id)->MutablePoint()->data());
     }
+    eval.residuals.setZero(2, track_ids.size());
+    reprojection_evaluations_.push_back(std::move(eval));
+  }
 
-    cost_function->SetNumResiduals(2 * nr_obs);
-    {
-      Eigen::VectorXd residual;
-      residual.setZero(nr_obs * 2);
+  std::atomic<bool> success(true);
+  utils::ParallelFor(
+      reprojection_evaluations_.size(),
+      std::thread::hardware_concurrency(),
+      [&](const size_t m) {
+        ReprojectionEvaluation& eval = reprojection_evaluations_[m];
+        if (!eval.cost_function || eval.residuals.cols() == 0) {
+          return;
+        }
+        for (int i = 0; i < N_; ++i) {
+          eval.parameters[i] = so3_knots_[eval.s_so3 + i].data();
+          eval.parameters[N_ + i] = r3_knots_[eval.s_r3 + i].data();
+        }
+        eval.parameters[2 * N_] = T_i_c_.data();
+        if (camera_measurements_[m].rolling_shutter) {
+          eval.parameters[2 * N_ + 1] = &cam_line_delay_s_;
+        }
+        if (!eval.cost_function->Evaluate(
+                eval.parameters.data(), eval.residuals.data(), nullptr)) {
+          success = false;
+        }
+      });
+  return success;
+}
 
-      cost_function->Evaluate(&vec[0], residual.data(), NULL);
+template <int _T>
+utils::ViewStatisticsMap
+SplineTrajectoryEstimator<_T>::GetReprojectionStatistics() {
+  utils::ViewStatisticsMap view_stats;
+  if (!EvaluateReprojectionResiduals()) {
+    LOG(WARNING) << "Could not evaluate all reprojection residuals.";
+  }
+  for (size_t m = 0; m < reprojection_evaluations_.size(); ++m) {
+    const ReprojectionEvaluation& eval = reprojection_evaluations_[m];
+    if (eval.cost_function && eval.residuals.cols() > 0) {
+      view_stats[camera_measurements_[m].view_id] =
+          utils::ViewStatisticsFromResiduals(eval.residuals);
+    }
+  }
+  return view_stats;
+}
 
-      for (size_t i = 0; i < nr_obs; i++) {
-        Eigen::Vector2d res_point = residual.segment<2>(2 * i);
-        if (res_point[0] != 0.0 && res_point[1] != 0.0) {
-          sum_error += res_point.norm();
-          num_points += 1;
-        }
+template <int _T>
+double SplineTrajectoryEstimator<_T>::GetMeanReprojectionError() {
+  if (!EvaluateReprojectionResiduals()) {
+    LOG(WARNING) << "Could not evaluate all reprojection residuals.";
+  }
+  double sum_error = 0.0;
+  int num_points = 0;
+  for (const auto& eval : reprojection_evaluations_) {
+    if (!eval.cost_function) {
+      continue;
+    }
+    for (int i = 0; i < eval.residuals.cols(); ++i) {
+      // failed projections are marked with a residual of 1e10
+      if (eval.residuals(0, i) == 1e10) {
+        continue;
       }
+      sum_error += eval.residuals.col(i).norm();
+      ++num_points;
     }
   }
+  if (num_points == 0) {
+    return 0.0;
+  }
 
   std::cout << "Mean reprojection error " << sum_error / num_points
             << " number residuals: " << num_points << std::endl;
@@ -1139,6 +1874,60 @@ double SplineTrajectoryEstimator<_T>::GetRSLineDelay() const {
   return cam_line_delay_s_;
 }
 
+template <int _T>
+bool SplineTrajectoryEstimator<_T>::GetCalibrationCovariance(
+    const int flags,
+    Eigen::Matrix<double, 6, 6>& cov_T_i_c,
+    double& var_line_delay) {
+  cov_T_i_c.setZero();
+  var_line_delay = 0.0;
+  if (window_ns_ > 0) {
+    // propagate the information through all windows without solving
+    Optimize(0, flags);
+    if (prior_blocks_.empty()) {
+      return true;
+    }
+    const Eigen::MatrixXd covariance =
+        prior_variance_factor_ *
+        utils::CovarianceFromInformation(prior_information_);
+    int offset = 0;
+    size_t euclidean_block = 0;
+    for (double* block : prior_blocks_) {
+      if (block == T_i_c_.data()) {
+        cov_T_i_c = covariance.block<6, 6>(offset, offset);
+        offset += 6;
+        continue;
+      }
+      if (block == &cam_line_delay_s_) {
+        var_line_delay = covariance(offset, offset);
+      }
+      offset += prior_block_sizes_[euclidean_block++];
+    }
+    return true;
+  }
+  SetFixedParams(flags);
+
+  const bool has_T_i_c = problem_.HasParameterBlock(T_i_c_.data());
+  const bool has_line_delay = problem_.HasParameterBlock(&cam_line_delay_s_);
+  Eigen::MatrixXd information;
+  double variance_factor = 1.0;
+  if (!utils::ComputeMarginalInformation(&problem_,
+                                         {T_i_c_.data(), &cam_line_delay_s_},
+                                         information,
+                                         &variance_factor)) {
+    return false;
+  }
+  const Eigen::MatrixXd covariance =
+      variance_factor * utils::CovarianceFromInformation(information);
+  if (has_T_i_c) {
+    cov_T_i_c = covariance.topLeftCorner<6, 6>();
+  }
+  if (has_line_delay) {
+    var_line_delay = covariance(covariance.rows() - 1, covariance.cols() - 1);
+  }
+  return true;
+}
+
 template <int _T>
 ThreeAxisSensorCalibParams<double>
 SplineTrajectoryEstimator<_T>::GetAcclIntrinsics(const int64_t& time_ns) {
@@ -1179,7 +1968,7 @@ SplineTrajectoryEstimator<_T>::GetGyroIntrinsics(const int64_t& time_ns) {
 
 template <int _T>
 Eigen::Vector3d SplineTrajectoryEstimator<_T>::GetGyroBias(
-    const int64_t& time_ns) {
+    const int64_t& time_ns) const {
   double u;
   int64_t s;
   Eigen::Vector3d gyro_bias;
@@ -1207,7 +1996,7 @@ Eigen::Vector3d SplineTrajectoryEstimator<_T>::GetGyroBias(
 
 template <int _T>
 Eigen::Vector3d SplineTrajectoryEstimator<_T>::GetAcclBias(
-    const int64_t& time_ns) {
+    const int64_t& time_ns) const {
   double u;
   int64_t s;
   Eigen::Vector3d accl_bias;
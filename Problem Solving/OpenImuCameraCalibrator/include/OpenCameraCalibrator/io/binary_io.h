@@ -0,0 +1,76 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace OpenICC {
+namespace io {
+
+//! The binary files we write (trajectory tables, undistortion maps) are little
+//! endian on every host. These helpers byte-swap on big endian hosts only.
+inline bool IsLittleEndianHost() {
+  const uint16_t value = 1;
+  char first_byte;
+  std::memcpy(&first_byte, &value, 1);
+  return first_byte == 1;
+}
+
+//! Writes n values in little endian.
+template <typename T>
+void WriteLittleEndian(std::ofstream& file, const T* values, const size_t n) {
+  if (IsLittleEndianHost()) {
+    file.write(reinterpret_cast<const char*>(values), n * sizeof(T));
+    return;
+  }
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < n; ++i) {
+    std::memcpy(bytes, values + i, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    file.write(bytes, sizeof(T));
+  }
+}
+
+template <typename T>
+void WriteLittleEndianValue(std::ofstream& file, const T value) {
+  WriteLittleEndian(file, &value, 1);
+}
+
+//! Reads n little endian values.
+template <typename T>
+void ReadLittleEndian(std::ifstream& file, T* values, const size_t n) {
+  file.read(reinterpret_cast<char*>(values), n * sizeof(T));
+  if (IsLittleEndianHost()) {
+    return;
+  }
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < n; ++i) {
+    std::memcpy(bytes, values + i, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    std::memcpy(values + i, bytes, sizeof(T));
+  }
+}
+
+template <typename T>
+void ReadLittleEndianValue(std::ifstream& file, T& value) {
+  ReadLittleEndian(file, &value, 1);
+}
+
+}  // namespace io
+}  // namespace OpenICC
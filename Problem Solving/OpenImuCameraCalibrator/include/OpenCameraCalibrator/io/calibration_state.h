@@ -0,0 +1,47 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <Eigen/Core>
+
+#include "OpenCameraCalibrator/utils/types.h"
+#include "theia/sfm/camera/camera.h"
+
+namespace OpenICC {
+namespace io {
+
+//! Calibration state to continue a calibration with new recordings.
+//! Holds the intrinsics, their marginal information matrix (in the theia
+//! intrinsics parameter order) and the positions of the views that were used,
+//! so new views can be filtered against them.
+bool write_calibration_state(const std::string& output_file,
+                             const theia::Camera& camera,
+                             const Eigen::MatrixXd& information,
+                             const int nr_calib_images,
+                             const double total_reproj_error,
+                             const vec3_vector& view_positions);
+
+bool read_calibration_state(const std::string& input_file,
+                            theia::Camera& camera,
+                            Eigen::MatrixXd& information,
+                            int& nr_calib_images,
+                            double& total_reproj_error,
+                            vec3_vector& view_positions);
+
+}  // namespace io
+}  // namespace OpenICC
@@ -0,0 +1,40 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "OpenCameraCalibrator/utils/undistortion_map.h"
+
+namespace OpenICC {
+namespace io {
+
+//! Binary remap tables for the runtime, meant to be mmapped. Little endian
+//! on every host (see binary_io.h):
+//!   64 byte header: char magic[8] "OICCMAP", uint32 version, width,
+//!                   height, source_width, source_height, inter_bits,
+//!                   double focal_length, principal_point_x,
+//!                   principal_point_y, 8 bytes padding
+//!   int16 map_xy[height][width][2]  at offset 64
+//!   uint16 map_interp[height][width] at offset 64 + 4 * width * height
+bool write_undistortion_map(const std::string& output_file,
+                            const utils::UndistortionMap& map);
+
+bool read_undistortion_map(const std::string& input_file,
+                           utils::UndistortionMap& map);
+
+}  // namespace io
+}  // namespace OpenICC
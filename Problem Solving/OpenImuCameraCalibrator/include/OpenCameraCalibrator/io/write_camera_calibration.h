@@ -19,15 +19,21 @@
 #include <ios>
 #include <iostream>
 
+#include <Eigen/Core>
+
 #include "theia/sfm/camera/camera.h"
 
 namespace OpenICC {
 namespace io {
 
-bool write_camera_calibration(const std::string& output_file,
-                              const theia::Camera& camera,
-                              const double fps,
-                              const int nr_calib_images,
-                              const double total_reproj_error);
+//! intrinsics_covariance (theia parameter order) is written together with
+//! the standard deviations of the parameters if it is not empty.
+bool write_camera_calibration(
+    const std::string& output_file,
+    const theia::Camera& camera,
+    const double fps,
+    const int nr_calib_images,
+    const double total_reproj_error,
+    const Eigen::MatrixXd& intrinsics_covariance = Eigen::MatrixXd());
 }  // namespace io
 }  // namespace OpenICC
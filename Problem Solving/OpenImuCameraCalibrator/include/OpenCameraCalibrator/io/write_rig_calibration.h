@@ -0,0 +1,37 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace io {
+
+//! Writes the extrinsics of a camera rig. Camera i is described by the
+//! rotation from the reference camera to camera i, its position in the
+//! reference camera frame and the file of its intrinsic calibration.
+bool write_rig_calibration(const std::string& output_file,
+                           const std::vector<std::string>& camera_calib_files,
+                           const quat_vector& rotations_cam_ref,
+                           const vec3_vector& positions_in_ref,
+                           const int nr_frames,
+                           const double total_reproj_error);
+
+}  // namespace io
+}  // namespace OpenICC
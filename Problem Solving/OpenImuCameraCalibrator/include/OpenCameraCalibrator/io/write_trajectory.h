@@ -0,0 +1,70 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace OpenICC {
+namespace io {
+
+//! Streaming writer of a columnar binary table with an int64 timestamp [ns]
+//! column and float32 columns of a fixed width (e.g. 3 for a vector). All
+//! values are written in little endian, also on big endian hosts.
+//!
+//! header: "OICCTAB1", uint32 nr_columns, per column uint32 name length, the
+//!         name and uint32 width
+//! blocks: uint64 nr_rows, int64 time_ns[nr_rows], then per column
+//!         float32[nr_rows * width] with the values of a row next to each
+//!         other
+//!
+//! Each WriteBlock call appends one block, so a trajectory can be written
+//! while it is evaluated. Every column of a block is a contiguous array, a
+//! reader concatenates the blocks (see python/print_result_stats.py).
+class TrajectoryTableWriter {
+ public:
+  struct Column {
+    std::string name;
+    uint32_t width;
+  };
+
+  bool Open(const std::string& output_file, const std::vector<Column>& columns);
+
+  //! values[c] is a width x nr_rows matrix of column c
+  bool WriteBlock(const std::vector<int64_t>& time_ns,
+                  const std::vector<Eigen::Ref<const Eigen::MatrixXd>>& values);
+
+  bool Close();
+
+  size_t NumRows() const { return nr_rows_; }
+
+ private:
+  std::ofstream file_;
+
+  std::vector<Column> columns_;
+
+  size_t nr_rows_ = 0;
+
+  //! conversion buffer, reused between the blocks
+  Eigen::MatrixXf buffer_;
+};
+
+}  // namespace io
+}  // namespace OpenICC
@@ -0,0 +1,73 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <vector>
+
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace utils {
+
+struct AdaptiveKnotOptions {
+  //! length of the windows in which the local bandwidth is estimated [s],
+  //! consecutive windows overlap by half
+  double window_s = 2.0;
+
+  //! fraction of the signal energy (without DC) below the bandwidth
+  double energy_quality = 0.99;
+
+  //! bounds of the knot spacing relative to the uniform spacing
+  double min_dt_factor = 1.0;
+  double max_dt_factor = 4.0;
+
+  //! maximum ratio of the lengths of neighbouring segments, keeps the
+  //! non-uniform basis well conditioned
+  double max_dt_ratio = 1.5;
+};
+
+//! Segment boundaries [ns] of a non-uniform spline over [start_ns, end_ns].
+//! The knot spacing of a window is the uniform spacing dt_s scaled with the
+//! ratio of the bandwidth of the whole signal to the bandwidth of the window
+//! (the frequency below which energy_quality of the energy lies), so slow
+//! segments get sparse knots. Neighbouring segments differ by at most
+//! max_dt_ratio, whether they grow or shrink. All segments are scaled by a
+//! common factor close to 1 to end exactly at end_ns. signal has to be
+//! sorted by time [s].
+std::vector<int64_t> AdaptiveKnotTimes(const timed_vec3_vector& signal,
+                                       const int64_t start_ns,
+                                       const int64_t end_ns,
+                                       const double dt_s,
+                                       const AdaptiveKnotOptions& options);
+
+//! Blending matrix of the segment [knot_times_ns[segment],
+//! knot_times_ns[segment + 1]) of a non-uniform B-spline of the given order
+//! in the layout of CeresSplineHelper::blending_matrix_: row i holds the
+//! coefficients of the basis function of control point segment + i as a
+//! polynomial in the normalized segment time u (1, u, u^2, ...). Knots
+//! outside of knot_times_ns are extrapolated with the first and last
+//! spacing. For a cumulative spline row i is the sum of the rows i..N-1.
+Eigen::MatrixXd NonUniformBlendingMatrix(
+    const std::vector<int64_t>& knot_times_ns,
+    const size_t segment,
+    const int order,
+    const bool cumulative);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,71 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <ceres/ceres.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Lower band of a symmetric positive definite matrix in LAPACK band
+//! storage, band(i - j, j) = A(i, j) for 0 <= i - j <= bandwidth.
+//! FactorizeBand replaces it with the band of its Cholesky factor L.
+bool FactorizeBand(Eigen::MatrixXd& band);
+
+//! Solves L * x = b in place with the factor of FactorizeBand.
+void SolveBandLower(const Eigen::MatrixXd& band, double* b);
+
+//! Solves L^T * x = b in place with the factor of FactorizeBand.
+void SolveBandUpper(const Eigen::MatrixXd& band, double* b);
+
+struct BandedSolverOptions {
+  int max_num_iterations = 50;
+  double function_tolerance = 1e-4;
+  double parameter_tolerance = 1e-7;
+  double gradient_tolerance = 1e-10;
+  int num_threads = 1;
+  bool minimizer_progress_to_stdout = false;
+  //! the arrow part is dense, larger problems should use ceres
+  int max_arrow_size = 1000;
+};
+
+//! Levenberg-Marquardt for problems with an arrowhead structure, e.g. a
+//! spline trajectory: every residual touches a few consecutive band_blocks
+//! (the knots in time order) and any of a small number of other blocks
+//! (extrinsics, gravity, intrinsics, ...).
+//! The normal equations are built from the Jacobian of problem->Evaluate, in
+//! the local parameterization of each block, in parallel. The band part is
+//! factorized with a block-banded Cholesky, O(n * bandwidth^2), and the
+//! other blocks are solved through their dense Schur complement, whose
+//! columns are computed in parallel. The coupling of the band with the other
+//! blocks is stored per band block, so memory stays linear in the band.
+//! band_blocks that are constant or not in the problem are ignored, all
+//! other variable blocks of the problem form the arrow. Parameter bounds are
+//! enforced by clamping. Returns false without changing the problem if its
+//! structure does not fit (e.g. the arrow is larger than max_arrow_size) or
+//! if the solve fails (termination type FAILURE), in which case the
+//! parameters are restored to their values at entry.
+bool SolveBandedProblem(const BandedSolverOptions& options,
+                        const std::vector<double*>& band_blocks,
+                        ceres::Problem* problem,
+                        ceres::Solver::Summary* summary);
+
+}  // namespace utils
+}  // namespace OpenICC
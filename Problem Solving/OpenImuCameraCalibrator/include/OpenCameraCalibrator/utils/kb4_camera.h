@@ -0,0 +1,62 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+#include <theia/sfm/camera/camera.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Kannala-Brandt parameters [fx, fy, cx, cy, k1, k2, k3, k4] with
+//! theta_d = theta * (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 + k4 theta^8),
+//! the parameterization of Analytical/KB4.py. It is the same model as theia's
+//! FISHEYE camera with fy = focal_length * aspect_ratio and zero skew.
+using KB4Parameters = Eigen::Matrix<double, 8, 1>;
+
+//! Model name accepted for the calibration, it is calibrated as FISHEYE
+const char KB4_CAMERA_MODEL[] = "KB4";
+
+//! Newton iterations of the unprojection, converges to machine precision
+//! within the field of view for all practical distortions
+const int KB4_NEWTON_ITERATIONS = 8;
+
+//! true if the camera is a FISHEYE camera without skew
+bool IsKB4Camera(const theia::Camera& camera);
+
+KB4Parameters KB4ParametersFromCamera(const theia::Camera& camera);
+
+//! Sets the camera to a FISHEYE camera with the KB4 parameters
+void SetKB4Parameters(const KB4Parameters& params, theia::Camera& camera);
+
+//! Projects all columns of camera frame points to pixels. The points are
+//! processed in fixed-size blocks with branch-free atan, so the compiler can
+//! vectorize the whole projection.
+void ProjectKB4(const KB4Parameters& params,
+                const Eigen::Matrix3Xd& points,
+                Eigen::Matrix2Xd& pixels);
+
+//! Normalized image coordinates (x/z, y/z) of all columns of pixels. theta is
+//! found with a fixed number of Newton steps on the distortion polynomial for
+//! all pixels at once.
+void UnprojectKB4(const KB4Parameters& params,
+                  const Eigen::Matrix2Xd& pixels,
+                  Eigen::Matrix2Xd& normalized,
+                  const int nr_newton_iterations = KB4_NEWTON_ITERATIONS);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,52 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <ceres/ceres.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Marginal information of some parameter blocks of a solved problem, i.e.
+//! the Schur complement
+//!   S = H_mm - H_mn H_nn^-1 H_nm,  H = J^T J
+//! where m are the given blocks and n all other variable blocks (poses,
+//! spline knots, ...). H_nn is factorized with a sparse LDLT, no dense
+//! inverse over the whole problem is formed.
+//! Rows and columns are in the local (tangent) parameterization of the
+//! blocks, concatenated in the given order. Blocks that are constant or not
+//! part of the problem get zero information.
+//! variance_factor (optional) is the a-posteriori residual variance
+//! 2 * cost / (nr_residuals - nr_parameters).
+//! If residual_blocks is not empty, only these residual blocks contribute and
+//! the nuisance blocks are the ones they depend on.
+bool ComputeMarginalInformation(
+    ceres::Problem* problem,
+    const std::vector<double*>& parameter_blocks,
+    Eigen::MatrixXd& information,
+    double* variance_factor = nullptr,
+    const std::vector<ceres::ResidualBlockId>& residual_blocks = {});
+
+//! Pseudo inverse of a (small) information matrix, directions without
+//! information get zero covariance.
+Eigen::MatrixXd CovarianceFromInformation(const Eigen::MatrixXd& information);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,101 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <theia/sfm/estimators/feature_correspondence_2d_3d.h>
+#include <theia/solvers/ransac.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Minimum homography inlier ratio for which the closed-form planar solution
+//! is accepted without running RANSAC.
+const double MIN_INLIER_RATIO_CLOSED_FORM = 0.95;
+
+//! Below this inlier ratio the RANSAC fallback uses local optimization.
+const double MIN_INLIER_RATIO_NO_LO = 0.8;
+
+//! Estimates the homography that maps the x/y coordinates of planar board
+//! points (z = 0) to the image features using a normalized DLT. Returns false
+//! if the world points are not planar or the system is degenerate.
+bool EstimatePlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    Eigen::Matrix3d& H);
+
+//! Transfers all board points with H and returns the inlier ratio for the
+//! given error threshold. As in theia::RansacParameters, error_thresh is a
+//! squared transfer error in the units of the features. Inlier indices are
+//! written to inliers.
+double EvaluatePlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const Eigen::Matrix3d& H,
+    const double error_thresh,
+    std::vector<int>& inliers);
+
+//! Fits a homography to all correspondences, refits it once on the inliers
+//! of the first fit and returns the final inlier ratio (0 on failure).
+//! error_thresh is a squared error, see EvaluatePlanarHomography.
+double FitPlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const double error_thresh,
+    Eigen::Matrix3d& H,
+    std::vector<int>& inliers);
+
+//! Closed-form focal length from a board homography (Zhang), assuming square
+//! pixels and the principal point at the origin of the feature coordinates.
+bool FocalLengthFromPlanarHomography(const Eigen::Matrix3d& H,
+                                     double& focal_length);
+
+//! Decomposes H = K * [r1 r2 t] into the theia camera orientation (world to
+//! camera) and position (camera center in world coordinates).
+bool PoseFromPlanarHomography(const Eigen::Matrix3d& H,
+                              const double focal_length,
+                              Eigen::Matrix3d& rotation,
+                              Eigen::Vector3d& position);
+
+//! Number of iterations needed to draw one all-inlier sample of size
+//! sample_size with the given inlier ratio and failure probability.
+int AdaptiveRansacIterations(const double inlier_ratio,
+                             const int sample_size,
+                             const double failure_probability,
+                             const int min_iterations,
+                             const int max_iterations);
+
+//! Caps the iteration count of ransac_params using the measured inlier ratio
+//! and enables LO-RANSAC only if the inlier ratio is low.
+void AdaptRansacParameters(const double inlier_ratio,
+                           const int sample_size,
+                           theia::RansacParameters& ransac_params);
+
+//! Calibrated pose of a planar board from normalized image coordinates.
+//! The homography fit is accepted directly on clean detections, otherwise
+//! false is returned and the inliers of the fit are stored in ransac_summary,
+//! so that the caller can adapt its RANSAC parameters. error_thresh is the
+//! squared error in normalized image coordinates, the value that is passed
+//! to theia::EstimateCalibratedAbsolutePose.
+bool EstimatePlanarCalibratedPose(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const double error_thresh,
+    Eigen::Matrix3d& rotation,
+    Eigen::Vector3d& position,
+    theia::RansacSummary& ransac_summary);
+
+}  // namespace utils
+}  // namespace OpenICC
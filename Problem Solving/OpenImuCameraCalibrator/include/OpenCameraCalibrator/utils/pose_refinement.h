@@ -0,0 +1,42 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <theia/sfm/estimators/feature_correspondence_2d_3d.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Refines a single camera pose from normalized image coordinates with a
+//! fixed-size 6-DoF Gauss-Newton solver (Huber weighted, step halving).
+//! Meant for the many tiny single-view problems of the pose estimation where
+//! setting up a ceres problem costs more than solving it.
+//! Only the correspondences in indices are used, or all if indices is empty.
+//! rotation is world to camera, position the camera center.
+bool RefinePoseGaussNewton(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const std::vector<int>& indices,
+    const double robust_loss_width,
+    Eigen::Matrix3d& rotation,
+    Eigen::Vector3d& position,
+    const int max_iterations = 10);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,90 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace utils {
+
+//! Spline Error Weighting (Ovren and Forssen, CVPR 2018): the largest knot
+//! spacing of a cubic B-spline that keeps a given fraction of the signal
+//! energy and the variance of the remaining approximation error. C++ port of
+//! python/sew.py.
+//! The reference spectrum of the signal is computed once with a real FFT,
+//! every knot spacing candidate is then a single pass over the half
+//! spectrum.
+class SplineErrorWeighting {
+ public:
+  //! signal has to be sorted by time and sampled (roughly) uniformly
+  explicit SplineErrorWeighting(const ImuReadings& signal);
+
+  //! Ratio of the allowed removed energy (1 - quality of the total energy)
+  //! to the energy the spline removes with knot spacing dt [s]. >= 1 if dt
+  //! fulfills quality.
+  double Quality(const double dt, const double quality) const;
+
+  //! variance of the spline approximation error with knot spacing dt [s]
+  double Variance(const double dt) const;
+
+  //! Largest knot spacing in [min_dt, max_dt] [s] with Quality >= 1. If no
+  //! spacing reaches the quality the one with the best quality is returned.
+  double KnotSpacing(const double quality,
+                     const double min_dt,
+                     const double max_dt) const;
+
+  bool IsValid() const { return nr_samples_ > 1; }
+
+ private:
+  //! energy the spline removes with knot spacing dt, sum |(1 - H) X|^2 / n
+  double RemovedEnergy(const double dt) const;
+
+  size_t nr_samples_ = 0;
+
+  //! frequencies [Hz] of the half spectrum bins
+  Eigen::ArrayXd freqs_;
+
+  //! |X|^2 of the half spectrum bins, counted twice for the bins that
+  //! stand for a positive and a negative frequency
+  Eigen::ArrayXd power_;
+
+  //! sum |X|^2 / n over the full spectrum
+  double energy_ = 0.0;
+};
+
+struct SplineErrorWeightingOptions {
+  //! quality values and knot spacing bounds [s] of the rotation (gyroscope)
+  //! and position (accelerometer) spline, defaults of get_sew_for_dataset.py
+  double quality_so3 = 0.98;
+  double quality_r3 = 0.96;
+  double min_dt_so3 = 0.01;
+  double max_dt_so3 = 0.2;
+  double min_dt_r3 = 0.01;
+  double max_dt_r3 = 0.15;
+};
+
+//! Knot spacings and weighting factors (standard deviations of the
+//! approximation error) of the SO3 and R3 spline from the gyroscope and
+//! accelerometer of the telemetry. Replaces the spline error weighting json
+//! of get_sew_for_dataset.py, cam_fps is not touched.
+bool ComputeSplineErrorWeighting(const CameraTelemetryData& telemetry_data,
+                                 const SplineErrorWeightingOptions& options,
+                                 SplineWeightingData& spline_weighting);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -35,6 +35,8 @@ const double S_TO_US = 1e6;   ///< Second to museconds conversion
 const double MS_TO_S = 1e-3;  ///< Milliseconds to second conversion
 const double S_TO_MS = 1e3;   ///< Second to milliseconds conversion
 
+const double R2D = 180.0 / M_PI;  ///< Radian to degree conversion
+
 enum class CalibBoardGravDir { UNKOWN = -1, X = 0, Y = 1, Z = 2 };
 
 // alignment stuff
@@ -62,6 +64,8 @@ using vec3_vector = aligned_vector<Eigen::Vector3d>;
 using vec2_vector = aligned_vector<Eigen::Vector2d>;
 using quat_map = aligned_map<double, Eigen::Quaterniond>;
 using vec3_map = aligned_map<double, Eigen::Vector3d>;
+//! time series sorted by time [s]
+using timed_vec3_vector = aligned_vector<std::pair<double, Eigen::Vector3d>>;
 using so3_vector = aligned_vector<Sophus::SO3d>;
 
 struct GPXData {
@@ -110,7 +114,8 @@ using CameraGyroData = std::vector<ImuReading<double>>;
 using CameraAccData = std::vector<ImuReading<double>>;
 
 struct SplineWeightingData {
-  // create this with get_sew_for_dataset.py
+  // create this with get_sew_for_dataset.py or
+  // utils::ComputeSplineErrorWeighting
   double dt_r3;
   double dt_so3;
   double std_r3;
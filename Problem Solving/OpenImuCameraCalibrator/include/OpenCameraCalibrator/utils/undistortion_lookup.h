@@ -0,0 +1,118 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <theia/sfm/camera/camera.h>
+
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+
+namespace OpenICC {
+namespace utils {
+
+//! Default distance between two grid nodes in pixel
+const int UNDISTORTION_GRID_STEP_PX = 16;
+
+//! If the sampled error of the lookup is above this value, all points are
+//! undistorted with the exact (iterative) camera model instead.
+const double MAX_UNDISTORTION_LOOKUP_ERROR_PX = 1e-3;
+
+//! Batched undistortion for a calibrated camera.
+//! The exact normalized coordinates are computed once on a regular pixel grid.
+//! Each node also stores the inverse of the projection Jacobian. A pixel is
+//! undistorted by interpolating the nodes and their first order expansions in
+//! its grid cell, followed by one Newton step on the (closed-form) projection
+//! with the interpolated Jacobian, i.e. one projection per pixel. Pixels
+//! outside of the grid or in cells next to invalid nodes (e.g. beyond the
+//! field of view) use the exact camera model.
+//! KB4 (FISHEYE) cameras are undistorted directly with the batched Newton
+//! unprojection, no grid is built for them.
+class UndistortionLookup {
+ public:
+  UndistortionLookup(const theia::Camera& camera,
+                     const int grid_step_px = UNDISTORTION_GRID_STEP_PX,
+                     const int num_threads = 1);
+
+  //! Normalized image coordinates (x/z, y/z) of a pixel
+  Eigen::Vector2d Undistort(const Eigen::Vector2d& pixel) const;
+
+  //! Undistorts all columns of pixels. Cell indices, bilinear weights and the
+  //! interpolation are computed with array operations for blocks of columns,
+  //! only the Newton step evaluates the camera projection per pixel.
+  void Undistort(const Eigen::Matrix2Xd& pixels,
+                 Eigen::Matrix2Xd& normalized) const;
+
+  //! Largest reprojection error in pixel, sampled at all cell centers which
+  //! are the worst case for the interpolation.
+  double MaxErrorPx() const { return max_error_px_; }
+
+  //! false if the lookup was not accurate enough and is bypassed
+  bool UsesLookup() const { return use_lookup_; }
+
+ private:
+  bool Interpolate(const Eigen::Vector2d& pixel,
+                   Eigen::Vector2d& normalized,
+                   Eigen::Matrix2d& jacobian) const;
+
+  Eigen::Vector2d UndistortExact(const Eigen::Vector2d& pixel) const;
+
+  Eigen::Vector2d Project(const Eigen::Vector2d& normalized) const;
+
+  Eigen::Vector2d UndistortLookup(const Eigen::Vector2d& pixel) const;
+
+  //! batched lookup of a block of pixels that fits into the cache
+  void UndistortLookupBlock(const Eigen::Ref<const Eigen::Matrix2Xd>& pixels,
+                            Eigen::Ref<Eigen::Matrix2Xd> normalized) const;
+
+  //! refines an interpolated point with one Newton step on the projection
+  Eigen::Vector2d NewtonStep(const Eigen::Vector2d& pixel,
+                             const Eigen::Vector2d& normalized,
+                             const Eigen::Matrix2d& jacobian) const;
+
+  theia::Camera camera_;
+
+  int grid_step_px_;
+
+  int nr_cols_ = 0;
+
+  int nr_rows_ = 0;
+
+  //! normalized coordinates (x, y) and the inverse projection jacobian
+  //! (column major) of a grid node
+  using GridNode = Eigen::Matrix<double, 6, 1>;
+
+  //! all grid nodes, row major
+  Eigen::Matrix<double, 6, Eigen::Dynamic> grid_;
+
+  std::vector<char> valid_;
+
+  double max_error_px_ = 0.0;
+
+  bool use_lookup_ = false;
+
+  bool use_kb4_ = false;
+
+  KB4Parameters kb4_params_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,80 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <theia/sfm/camera/camera.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Fractional bits of the fixed-point maps, the same as OpenCV's INTER_BITS
+const int UNDISTORTION_MAP_INTER_BITS = 5;
+
+const int UNDISTORTION_MAP_INTER_TAB_SIZE = 1 << UNDISTORTION_MAP_INTER_BITS;
+
+struct UndistortionMapOptions {
+  //! size of the undistorted image, 0 to use the size of the camera
+  int width = 0;
+  int height = 0;
+
+  //! horizontal field of view of the undistorted pinhole camera in degree,
+  //! 0 to keep the focal length of the camera
+  double horizontal_fov_deg = 0.0;
+
+  //! rotation from the undistorted to the distorted camera frame, e.g. a
+  //! rectifying rotation of a rig camera
+  Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+
+  int num_threads = 1;
+};
+
+//! Remap tables from an ideal pinhole camera (focal_length, principal point,
+//! no skew) to the pixels of a calibrated camera, in the fixed-point layout
+//! of OpenCV's convertMaps (CV_16SC2 + CV_16UC1). They can be passed to
+//! cv::remap directly:
+//!   map_xy: integer source pixel (x, y) of every output pixel, row major
+//!   map_interp: fractional part as y_frac * INTER_TAB_SIZE + x_frac
+//! Output pixels that do not map into the source image point to (-1, -1).
+struct UndistortionMap {
+  int width = 0;
+  int height = 0;
+
+  double focal_length = 0.0;
+  double principal_point_x = 0.0;
+  double principal_point_y = 0.0;
+
+  int source_width = 0;
+  int source_height = 0;
+
+  std::vector<int16_t> map_xy;
+
+  std::vector<uint16_t> map_interp;
+};
+
+//! Projects the ray of every output pixel into the camera. KB4 cameras are
+//! projected a row at a time with the batched kernel, all other models per
+//! pixel. Rows are distributed over options.num_threads.
+bool ComputeUndistortionMap(const theia::Camera& camera,
+                            const UndistortionMapOptions& options,
+                            UndistortionMap& map);
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include <dirent.h>
+#include <functional>
 #include <sys/stat.h>
 #include <vector>
 
@@ -80,5 +81,11 @@ T average(const std::vector<T> datas) {
 
 bool IsPathAFile(const std::string& path);
 
+//! Calls func(i) for all i in [0, nr_items) on up to num_threads threads.
+//! Items are handed out one by one, so unevenly expensive items balance out.
+void ParallelFor(const size_t nr_items,
+                 const int num_threads,
+                 const std::function<void(const size_t)>& func);
+
 }  // namespace utils
 }  // namespace OpenICC
@@ -0,0 +1,56 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <theia/sfm/reconstruction.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Reprojection statistics of a view in pixel
+struct ViewStatistics {
+  //! mean norm of the reprojection errors (as GetReprojErrorOfView)
+  double mean_error = 0.0;
+
+  double rmse = 0.0;
+
+  double max_error = 0.0;
+
+  //! reprojection error of each observation in the order of the view's
+  //! track ids
+  Eigen::VectorXd point_errors;
+};
+
+using ViewStatisticsMap = std::unordered_map<theia::ViewId, ViewStatistics>;
+
+//! Statistics of the 2 x n reprojection residuals of a view
+ViewStatistics ViewStatisticsFromResiduals(const Eigen::Matrix2Xd& residuals);
+
+//! Reprojects all observations of a view in one batch (one rotation of all
+//! points, then the camera model per point) and returns the statistics of
+//! each view in view_ids. Views are processed in parallel.
+std::vector<ViewStatistics> ComputeViewStatistics(
+    const theia::Reconstruction& recon,
+    const std::vector<theia::ViewId>& view_ids,
+    const int num_threads = 1);
+
+}  // namespace utils
+}  // namespace OpenICC
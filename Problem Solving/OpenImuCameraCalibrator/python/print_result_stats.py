@@ -3,7 +3,6 @@ import json
 from matplotlib import pyplot as plt
 from argparse import ArgumentParser
 import numpy as np
-import natsort 
 
 def read_calib_json(file):
     with open(file, 'r') as f:
@@ -13,6 +12,41 @@ def read_calib_json(file):
     
 
 
+def read_trajectory_table(file):
+    # columnar table written by io::TrajectoryTableWriter
+    with open(file, 'rb') as f:
+        buf = f.read()
+    assert buf[0:8] == b'OICCTAB1', "Not a trajectory table: " + file
+    pos = 8
+    nr_columns = int(np.frombuffer(buf, '<u4', 1, pos)[0])
+    pos += 4
+    columns = []
+    for _ in range(nr_columns):
+        name_len = int(np.frombuffer(buf, '<u4', 1, pos)[0])
+        pos += 4
+        name = buf[pos:pos + name_len].decode()
+        pos += name_len
+        width = int(np.frombuffer(buf, '<u4', 1, pos)[0])
+        pos += 4
+        columns.append((name, width))
+
+    t_ns = []
+    values = {name: [] for name, _ in columns}
+    while pos < len(buf):
+        nr_rows = int(np.frombuffer(buf, '<u8', 1, pos)[0])
+        pos += 8
+        t_ns.append(np.frombuffer(buf, '<i8', nr_rows, pos))
+        pos += 8 * nr_rows
+        for name, width in columns:
+            values[name].append(np.frombuffer(
+                buf, '<f4', nr_rows * width, pos).reshape(nr_rows, width))
+            pos += 4 * nr_rows * width
+
+    table = {name: np.concatenate(v) for name, v in values.items()}
+    table["t_ns"] = np.concatenate(t_ns)
+    return table
+
+
 def main():
     parser = ArgumentParser("OpenICC")
     parser.add_argument('--path_results', 
@@ -22,33 +56,18 @@ def main():
 
 
     data = read_calib_json(args.path_results)
-    data = dict(data["trajectory"]) 
-    data = natsort.natsorted(data.items())
-
-    accl_spline = []
-    accl_imu = []
-    accl_bias = []
-    gyro_spline = []
-    gyro_imu = []
-    gyro_bias = []
-    t = []
-    for d in data:
-        t.append(d[0])
-        accl_spline.append([d[1]["accl_spline"]["x"], d[1]["accl_spline"]["y"],d[1]["accl_spline"]["z"]])
-        accl_imu.append([d[1]["accl_imu"]["x"], d[1]["accl_imu"]["y"],d[1]["accl_imu"]["z"]])
-        accl_bias.append([d[1]["accl_bias"]["x"], d[1]["accl_bias"]["y"],d[1]["accl_bias"]["z"]])
-
-        gyro_spline.append([d[1]["gyro_spline"]["x"], d[1]["gyro_spline"]["y"],d[1]["gyro_spline"]["z"]])
-        gyro_imu.append([d[1]["gyro_imu"]["x"], d[1]["gyro_imu"]["y"],d[1]["gyro_imu"]["z"]])
-        gyro_bias.append([d[1]["gyro_bias"]["x"], d[1]["gyro_bias"]["y"],d[1]["gyro_bias"]["z"]])
-
-    accl_spline_np = np.asarray(accl_spline)
-    accl_imu_np = np.asarray(accl_imu)
-    accl_bias_np = np.asarray(accl_bias)
-    gyro_spline_np = np.asarray(gyro_spline)
-    gyro_imu_np = np.asarray(gyro_imu)
-    gyro_bias_np = np.asarray(gyro_bias)
-    t_np = np.asarray(t)
+    base_dir = os.path.dirname(args.path_results)
+    gyro = read_trajectory_table(
+        os.path.join(base_dir, data["gyro_trajectory_file"]))
+    accl = read_trajectory_table(
+        os.path.join(base_dir, data["accl_trajectory_file"]))
+
+    accl_spline_np = accl["accl_spline"]
+    accl_imu_np = accl["accl_imu"]
+    accl_bias_np = accl["accl_bias"]
+    gyro_spline_np = gyro["gyro_spline"]
+    gyro_imu_np = gyro["gyro_imu"]
+    gyro_bias_np = gyro["gyro_bias"]
     skip = 4
 
     labels = ['spline x', 'imu y', 
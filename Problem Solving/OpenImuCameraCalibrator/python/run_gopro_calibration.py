@@ -116,7 +116,6 @@ def main():
     imu_cam_calibration_json = pjoin(cam_imu_path, "imu_to_cam_calibration_"+cam_imu_video_fn+".json")
 
     imu_bias_json =  pjoin(imu_bias_path, "imu_bias_"+bias_video_fn+".json")
-    spline_weighting_json = pjoin(cam_imu_path, "spline_info_"+cam_imu_video_fn+".json")
     cam_imu_result_json = pjoin(cam_imu_path, "cam_imu_calib_result_"+cam_imu_video_fn+".json")
     cam_imu_corners_json = pjoin(cam_imu_path, "cam_imu_corners_"+cam_imu_video_fn+".uson")
     cam_corners_json = pjoin(cam_calib_path, "cam_corners_"+cam_video_fn+".uson")
@@ -252,26 +251,8 @@ def main():
     print("Pose estimation estimation took {:.2f}s.".format(time.time()-start))
     print("==================================================================")
 
-    # 
-    # 6. Estimate spline error weighting parameters
-    #  
-    py_spline_file = pjoin(path_to_src,"python3","get_sew_for_dataset.py")
-    print("==================================================================")
-    print("Estimating Spline error weighting and knot spacing.")
-    print("==================================================================")
-    start = time.time()
-    spline_init = Popen(["python3", py_spline_file,
-                       "--input_json_path=" + gopro_telemetry_gen,
-                       "--output_path=" + spline_weighting_json,
-                       "--q_so3=" + str(0.99),
-                       "--q_r3=" + str(0.99)])
-    error_spline_init = spline_init.wait()  
-    print("==================================================================")
-    print("Spline weighting and knot spacing estimation took {:.2f}s.".format(time.time()-start))
-    print("==================================================================")
-
     #
-    # 7. Estimate IMU to cam rotation
+    # 6. Estimate IMU to cam rotation
     #   
     print("==================================================================")
     print("Initializing IMU to camera rotation.")
@@ -291,7 +272,7 @@ def main():
     print("==================================================================")
 
     #
-    # 8. Run IMU to Camera calibration using Spline Fusion
+    # 7. Run IMU to Camera calibration using Spline Fusion
     #  
     print("==================================================================")
     print("Optimizing IMU to Camera calibration using Spline Fusion.")
@@ -306,7 +287,8 @@ def main():
                        "--camera_calibration_json=" + calib_dataset_json,
                        "--imu_bias_file=" + imu_bias_json,
                        "--output_path=" + cam_imu_path,
-                       "--spline_error_weighting_json=" + spline_weighting_json,
+                       "--sew_quality_so3=" + str(0.99),
+                       "--sew_quality_r3=" + str(0.99),
                        "--result_output_json=" + cam_imu_result_json,
                        "--reestimate_biases="+str(args.reestimate_bias_spline_opt),
                        "--logtostderr=1",
@@ -321,7 +303,7 @@ def main():
     print("==================================================================")
 
     #
-    # 9. Print results
+    # 8. Print results
     #   
     py_spline_file = pjoin(path_to_src,"python3","print_result_stats.py")
     print("==================================================================")
@@ -114,7 +114,6 @@ def main():
     imu_cam_calibration_json = pjoin(cam_imu_path, "imu_to_cam_calibration_"+cam_imu_video_fn+".json")
 
     imu_bias_json =  pjoin(imu_bias_path, "imu_bias_"+bias_video_fn+".json")
-    spline_weighting_json = pjoin(cam_imu_path, "spline_info_"+cam_imu_video_fn+".json")
     cam_imu_result_json = pjoin(cam_imu_path, "cam_imu_calib_result_"+cam_imu_video_fn+".json")
     cam_imu_corners_json = pjoin(cam_imu_path, "cam_imu_corners_"+cam_imu_video_fn+".uson")
     cam_corners_json = pjoin(cam_calib_path, "cam_corners_"+cam_video_fn+".uson")
@@ -230,26 +229,8 @@ def main():
     print("Pose estimation estimation took {:.2f}s.".format(time.time()-start))
     print("==================================================================")
 
-    # 
-    # 6. Estimate spline error weighting parameters
-    #  
-    py_spline_file = pjoin(path_to_src,"python","get_sew_for_dataset.py")
-    print("==================================================================")
-    print("Estimating Spline error weighting and knot spacing.")
-    print("==================================================================")
-    start = time.time()
-    spline_init = Popen(["python", py_spline_file,
-                       "--input_json_path=" + zed_telemetry_gen,
-                       "--output_path=" + spline_weighting_json,
-                       "--q_so3=" + str(0.99),
-                       "--q_r3=" + str(0.99)])
-    error_spline_init = spline_init.wait()  
-    print("==================================================================")
-    print("Spline weighting and knot spacing estimation took {:.2f}s.".format(time.time()-start))
-    print("==================================================================")
-
     #
-    # 7. Estimate IMU to cam rotation
+    # 6. Estimate IMU to cam rotation
     #   
     print("==================================================================")
     print("Initializing IMU to camera rotation.")
@@ -270,7 +251,7 @@ def main():
     print("==================================================================")
 
     #
-    # 8. Run IMU to Camera calibration using Spline Fusion
+    # 7. Run IMU to Camera calibration using Spline Fusion
     #  
     print("==================================================================")
     print("Optimizing IMU to Camera calibration using Spline Fusion.")
@@ -285,7 +266,8 @@ def main():
                        "--camera_calibration_json=" + calib_dataset_json,
                        "--imu_bias_file=" + imu_bias_json,
                        "--output_path=" + cam_imu_path,
-                       "--spline_error_weighting_json=" + spline_weighting_json,
+                       "--sew_quality_so3=" + str(0.99),
+                       "--sew_quality_r3=" + str(0.99),
                        "--result_output_json=" + cam_imu_result_json,
                        "--reestimate_biases="+str(args.reestimate_bias_spline_opt),
                        "--logtostderr=1",
@@ -300,7 +282,7 @@ def main():
     print("==================================================================")
 
     #
-    # 9. Print results
+    # 8. Print results
     #   
     py_spline_file = pjoin(path_to_src,"python","print_result_stats.py")
     print("==================================================================")
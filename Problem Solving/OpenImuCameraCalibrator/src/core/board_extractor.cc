@@ -321,6 +321,9 @@ bool BoardExtractor::ExtractImageFolderToJson(
     std::vector<int> ids;
     cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
     ExtractBoard(image, corners, ids);
+    if (detection_callback_ && !ids.empty()) {
+      detection_callback_(timestamp_s, image.size(), corners, ids);
+    }
 
     for (size_t c = 0; c < ids.size(); ++c) {
       output_json["views"][view_us]["image_points"][std::to_string(ids[c])] = {
@@ -372,7 +375,8 @@ bool BoardExtractor::ExtractImageFolderToJson(
     delta_ts.push_back(times[i + 1] - times[i]);
   }
 
-  output_json["camera_fps"] = 1. / utils::MedianOfDoubleVec(delta_ts);
+  camera_fps_ = 1. / utils::MedianOfDoubleVec(delta_ts);
+  output_json["camera_fps"] = camera_fps_;
 
   std::vector<std::uint8_t> v_bson = nlohmann::json::to_ubjson(output_json);
   std::ofstream calib_txt_output(save_path, std::ios::out | std::ios::binary);
@@ -399,6 +403,7 @@ bool BoardExtractor::ExtractVideoToJson(const std::string& video_path,
   input_video.open(video_path);
   int cnt_wrong = 0;
   const double fps = input_video.get(cv::CAP_PROP_FPS);
+  camera_fps_ = fps;
 
   output_json["camera_fps"] = fps;
   output_json["calibration_board_type"] = board_type_;
@@ -418,8 +423,8 @@ bool BoardExtractor::ExtractVideoToJson(const std::string& video_path,
       continue;
     }
 
-    const double timstamp_s = input_video.get(cv::CAP_PROP_POS_MSEC) * 1e-3;
-    const std::string view_us = std::to_string(timstamp_s * S_TO_US);
+    const double timestamp_s = input_video.get(cv::CAP_PROP_POS_MSEC) * 1e-3;
+    const std::string view_us = std::to_string(timestamp_s * S_TO_US);
     ++frame_cnt;
 
     const double fxfy = 1. / img_downsample_factor;
@@ -429,6 +434,9 @@ bool BoardExtractor::ExtractVideoToJson(const std::string& video_path,
     std::vector<int> ids;
     cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
     ExtractBoard(image, corners, ids);
+    if (detection_callback_ && !ids.empty()) {
+      detection_callback_(timestamp_s, image.size(), corners, ids);
+    }
 
     for (size_t c = 0; c < ids.size(); ++c) {
       output_json["views"][view_us]["image_points"][std::to_string(ids[c])] = {
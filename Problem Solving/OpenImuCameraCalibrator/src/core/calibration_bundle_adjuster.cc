@@ -0,0 +1,538 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/core/calibration_bundle_adjuster.h"
+
+#include <theia/sfm/bundle_adjustment/create_loss_function.h>
+// camera types
+#include <theia/sfm/camera/division_undistortion_camera_model.h>
+#include <theia/sfm/camera/double_sphere_camera_model.h>
+#include <theia/sfm/camera/extended_unified_camera_model.h>
+#include <theia/sfm/camera/fisheye_camera_model.h>
+#include <theia/sfm/camera/pinhole_camera_model.h>
+#include <theia/sfm/camera/pinhole_radial_tangential_camera_model.h>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+#include "OpenCameraCalibrator/core/calibration_residuals.h"
+#include "OpenCameraCalibrator/utils/marginal_covariance.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+const int POINT_SIZE = 4;
+
+template <class CameraModel>
+ceres::CostFunction* CreatePointCostFunction(const Eigen::Vector2d& feature) {
+  return new ceres::AutoDiffCostFunction<CalibReprojectionError<CameraModel>,
+                                         2,
+                                         theia::Camera::kExtrinsicsSize,
+                                         CameraModel::kIntrinsicsSize,
+                                         POINT_SIZE>(
+      new CalibReprojectionError<CameraModel>(feature));
+}
+
+template <class CameraModel>
+ceres::CostFunction* CreateViewCostFunction(
+    const std::vector<const double*>& points,
+    const Eigen::Matrix2Xd& features,
+    const ceres::LossFunction* loss_function) {
+  return new CalibViewReprojectionCostFunction<CameraModel>(
+      points, features, loss_function);
+}
+
+// reprojection residuals of a view without the robust loss
+template <class CameraModel>
+bool ViewReprojections(const ceres::CostFunction* cost_function,
+                       const double* extrinsics,
+                       const double* intrinsics,
+                       Eigen::Matrix2Xd& residuals) {
+  const auto* view_cost =
+      static_cast<const CalibViewReprojectionCostFunction<CameraModel>*>(
+          cost_function);
+  residuals.resize(2, view_cost->NumObservations());
+  return residuals.cols() > 0 &&
+         view_cost->EvaluateReprojections(
+             extrinsics, intrinsics, residuals.data());
+}
+
+// dispatches to the cost function specialized for the camera model
+#define CALIB_COST_FUNCTION_SWITCH(cam_model, create_fn, ...)               \
+  switch (cam_model) {                                                      \
+    case theia::CameraIntrinsicsModelType::PINHOLE:                         \
+      return create_fn<theia::PinholeCameraModel>(__VA_ARGS__);             \
+    case theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION:           \
+      return create_fn<theia::DivisionUndistortionCameraModel>(__VA_ARGS__); \
+    case theia::CameraIntrinsicsModelType::DOUBLE_SPHERE:                   \
+      return create_fn<theia::DoubleSphereCameraModel>(__VA_ARGS__);        \
+    case theia::CameraIntrinsicsModelType::EXTENDED_UNIFIED:                \
+      return create_fn<theia::ExtendedUnifiedCameraModel>(__VA_ARGS__);     \
+    case theia::CameraIntrinsicsModelType::FISHEYE:                         \
+      return create_fn<theia::FisheyeCameraModel>(__VA_ARGS__);             \
+    case theia::CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL:       \
+      return create_fn<theia::PinholeRadialTangentialCameraModel>(          \
+          __VA_ARGS__);                                                     \
+    default:                                                                \
+      LOG(FATAL) << "Camera model type not supported for calibration.";     \
+      return {};                                                            \
+  }
+
+ceres::CostFunction* CreateCalibReprojectionCostFunction(
+    const theia::CameraIntrinsicsModelType& cam_model,
+    const Eigen::Vector2d& feature) {
+  CALIB_COST_FUNCTION_SWITCH(cam_model, CreatePointCostFunction, feature)
+}
+
+ceres::CostFunction* CreateCalibViewReprojectionCostFunction(
+    const theia::CameraIntrinsicsModelType& cam_model,
+    const std::vector<const double*>& points,
+    const Eigen::Matrix2Xd& features,
+    const ceres::LossFunction* loss_function) {
+  CALIB_COST_FUNCTION_SWITCH(
+      cam_model, CreateViewCostFunction, points, features, loss_function)
+}
+
+bool CalibViewReprojections(const theia::CameraIntrinsicsModelType& cam_model,
+                            const ceres::CostFunction* cost_function,
+                            const double* extrinsics,
+                            const double* intrinsics,
+                            Eigen::Matrix2Xd& residuals) {
+  CALIB_COST_FUNCTION_SWITCH(cam_model,
+                             ViewReprojections,
+                             cost_function,
+                             extrinsics,
+                             intrinsics,
+                             residuals)
+}
+
+#undef CALIB_COST_FUNCTION_SWITCH
+
+}  // namespace
+
+CalibrationBundleAdjuster::CalibrationBundleAdjuster(
+    theia::Reconstruction* recon)
+    : recon_(recon) {}
+
+void CalibrationBundleAdjuster::Build(
+    const theia::BundleAdjustmentOptions& options) {
+  ceres::Problem::Options problem_options;
+  // residual blocks of outlier views get removed between the stages
+  problem_options.enable_fast_removal = true;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_.reset(new ceres::Problem(problem_options));
+  loss_function_ = theia::CreateLossFunction(options.loss_function_type,
+                                             options.robust_loss_width);
+  num_threads_ = std::max(1, options.num_threads);
+  view_residuals_.clear();
+  view_stats_.clear();
+  intrinsics_blocks_.clear();
+  constant_intrinsics_.clear();
+  prior_residual_ids_.clear();
+  point_residual_ids_.clear();
+  points_parameterized_ = false;
+
+  is_built_ = true;
+  AddNewViews();
+}
+
+int CalibrationBundleAdjuster::AddNewViews() {
+  if (!is_built_) {
+    return 0;
+  }
+  int nr_added_views = 0;
+  for (const theia::ViewId view_id : recon_->ViewIds()) {
+    if (view_residuals_.count(view_id) == 0 && AddView(view_id)) {
+      ++nr_added_views;
+    }
+  }
+  return nr_added_views;
+}
+
+bool CalibrationBundleAdjuster::AddView(const theia::ViewId view_id) {
+  theia::View* view = recon_->MutableView(view_id);
+  const std::vector<theia::TrackId> track_ids = view->TrackIds();
+  if (!view->IsEstimated() || track_ids.empty()) {
+    return false;
+  }
+  theia::Camera* camera = view->MutableCamera();
+  ViewResiduals& view_res = view_residuals_[view_id];
+  view_res.extrinsics = camera->mutable_extrinsics();
+  view_res.intrinsics = camera->mutable_intrinsics();
+  view_res.camera_model = camera->GetCameraIntrinsicsModelType();
+  // views in the same intrinsics group share one parameter block
+  const bool new_intrinsics =
+      intrinsics_blocks_.emplace(view_res.intrinsics, view_id).second;
+
+  std::vector<const double*> points(track_ids.size());
+  view_res.points.resize(track_ids.size());
+  view_res.features.resize(2, track_ids.size());
+  for (size_t i = 0; i < track_ids.size(); ++i) {
+    view_res.points[i] =
+        recon_->MutableTrack(track_ids[i])->MutablePoint()->data();
+    points[i] = view_res.points[i];
+    view_res.features.col(i) = view->GetFeature(track_ids[i])->point_;
+  }
+  // the robust loss is applied per corner inside the cost function
+  view_res.cost_function = CreateCalibViewReprojectionCostFunction(
+      view_res.camera_model, points, view_res.features, loss_function_.get());
+  view_res.residual_id = problem_->AddResidualBlock(view_res.cost_function,
+                                                    nullptr,
+                                                    view_res.extrinsics,
+                                                    view_res.intrinsics);
+  if (new_intrinsics) {
+    AddIntrinsicsPrior(view_res.intrinsics);
+  }
+  return true;
+}
+
+void CalibrationBundleAdjuster::SetCameraParametersConstness(
+    const theia::BundleAdjustmentOptions& options) {
+  std::vector<int> constant_extrinsics;
+  if (options.constant_camera_position) {
+    for (int i = 0; i < 3; ++i) {
+      constant_extrinsics.push_back(theia::Camera::POSITION + i);
+    }
+  }
+  if (options.constant_camera_orientation) {
+    for (int i = 0; i < 3; ++i) {
+      constant_extrinsics.push_back(theia::Camera::ORIENTATION + i);
+    }
+  }
+
+  for (const auto& v : view_residuals_) {
+    double* extrinsics = v.second.extrinsics;
+    if (static_cast<int>(constant_extrinsics.size()) ==
+        theia::Camera::kExtrinsicsSize) {
+      problem_->SetParameterBlockConstant(extrinsics);
+      continue;
+    }
+    problem_->SetParameterBlockVariable(extrinsics);
+    if (constant_extrinsics.empty()) {
+      problem_->SetParameterization(extrinsics, nullptr);
+    } else {
+      problem_->SetParameterization(
+          extrinsics,
+          new ceres::SubsetParameterization(theia::Camera::kExtrinsicsSize,
+                                            constant_extrinsics));
+    }
+  }
+
+  for (const auto& intr : intrinsics_blocks_) {
+    const theia::View* view = recon_->View(intr.second);
+    const auto intrinsics_model = view->Camera().CameraIntrinsics();
+    const std::vector<int> constant_intrinsics =
+        intrinsics_model->GetSubsetFromOptimizeIntrinsicsType(
+            options.intrinsics_to_optimize);
+    constant_intrinsics_[intr.first] = constant_intrinsics;
+    if (static_cast<int>(constant_intrinsics.size()) ==
+        intrinsics_model->NumParameters()) {
+      problem_->SetParameterBlockConstant(intr.first);
+      continue;
+    }
+    problem_->SetParameterBlockVariable(intr.first);
+    if (constant_intrinsics.empty()) {
+      problem_->SetParameterization(intr.first, nullptr);
+    } else {
+      problem_->SetParameterization(
+          intr.first,
+          new ceres::SubsetParameterization(intrinsics_model->NumParameters(),
+                                            constant_intrinsics));
+    }
+  }
+}
+
+void CalibrationBundleAdjuster::AddPointResiduals() {
+  std::unordered_set<double*> points;
+  for (const auto& v : view_residuals_) {
+    const ViewResiduals& view_res = v.second;
+    for (size_t i = 0; i < view_res.points.size(); ++i) {
+      ceres::CostFunction* cost_function = CreateCalibReprojectionCostFunction(
+          view_res.camera_model, view_res.features.col(i));
+      point_residual_ids_.push_back(
+          problem_->AddResidualBlock(cost_function,
+                                     loss_function_.get(),
+                                     view_res.extrinsics,
+                                     view_res.intrinsics,
+                                     view_res.points[i]));
+      points.insert(view_res.points[i]);
+    }
+  }
+  for (double* point : points) {
+    if (!points_parameterized_) {
+      problem_->SetParameterization(
+          point, new ceres::HomogeneousVectorParameterization(POINT_SIZE));
+    }
+    problem_->SetParameterBlockVariable(point);
+  }
+  points_parameterized_ = true;
+}
+
+void CalibrationBundleAdjuster::RemovePointResiduals() {
+  for (const auto residual_id : point_residual_ids_) {
+    problem_->RemoveResidualBlock(residual_id);
+  }
+  point_residual_ids_.clear();
+}
+
+theia::BundleAdjustmentSummary CalibrationBundleAdjuster::Optimize(
+    const theia::BundleAdjustmentOptions& options,
+    const bool optimize_points) {
+  if (!is_built_) {
+    Build(options);
+  }
+  if (optimize_points) {
+    // the view residuals are constant in this stage, cameras stay fixed
+    theia::BundleAdjustmentOptions point_options = options;
+    point_options.constant_camera_orientation = true;
+    point_options.constant_camera_position = true;
+    point_options.intrinsics_to_optimize = theia::OptimizeIntrinsicsType::NONE;
+    SetCameraParametersConstness(point_options);
+    AddPointResiduals();
+  } else {
+    SetCameraParametersConstness(options);
+  }
+
+  ceres::Solver::Options solver_options;
+  solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  solver_options.max_num_iterations = options.max_num_iterations;
+  solver_options.num_threads = options.num_threads;
+  solver_options.minimizer_progress_to_stdout = options.verbose;
+  solver_options.function_tolerance = options.function_tolerance;
+  solver_options.gradient_tolerance = options.gradient_tolerance;
+  solver_options.parameter_tolerance = options.parameter_tolerance;
+  solver_options.logging_type =
+      options.verbose ? ceres::PER_MINIMIZER_ITERATION : ceres::SILENT;
+
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(solver_options, problem_.get(), &solver_summary);
+  if (options.verbose) {
+    LOG(INFO) << solver_summary.FullReport();
+  }
+  if (optimize_points) {
+    RemovePointResiduals();
+  }
+  UpdateViewStatistics();
+
+  theia::BundleAdjustmentSummary summary;
+  summary.success = solver_summary.IsSolutionUsable();
+  summary.initial_cost = solver_summary.initial_cost;
+  summary.final_cost = solver_summary.final_cost;
+  summary.setup_time_in_seconds =
+      solver_summary.preprocessor_time_in_seconds;
+  summary.solve_time_in_seconds = solver_summary.minimizer_time_in_seconds;
+  return summary;
+}
+
+void CalibrationBundleAdjuster::UpdateViewStatistics() {
+  std::vector<const std::pair<const theia::ViewId, ViewResiduals>*> views;
+  for (const auto& v : view_residuals_) {
+    views.push_back(&v);
+    view_stats_[v.first];
+  }
+  // entries exist already, the threads only write to their own view
+  utils::ParallelFor(views.size(), num_threads_, [&](const size_t i) {
+    const ViewResiduals& view_res = views[i]->second;
+    utils::ViewStatistics& stats = view_stats_.at(views[i]->first);
+    Eigen::Matrix2Xd residuals;
+    if (view_res.cost_function == nullptr ||
+        !CalibViewReprojections(view_res.camera_model,
+                                view_res.cost_function,
+                                view_res.extrinsics,
+                                view_res.intrinsics,
+                                residuals)) {
+      stats = utils::ViewStatistics();
+      stats.mean_error = stats.rmse = stats.max_error =
+          std::numeric_limits<double>::max();
+      return;
+    }
+    stats = utils::ViewStatisticsFromResiduals(residuals);
+  });
+}
+
+const utils::ViewStatistics* CalibrationBundleAdjuster::GetViewStatistics(
+    const theia::ViewId view_id) const {
+  const auto it = view_stats_.find(view_id);
+  return it == view_stats_.end() ? nullptr : &it->second;
+}
+
+double CalibrationBundleAdjuster::GetViewReprojError(
+    const theia::ViewId view_id) const {
+  const utils::ViewStatistics* stats = GetViewStatistics(view_id);
+  return stats == nullptr ? std::numeric_limits<double>::max()
+                          : stats->mean_error;
+}
+
+void CalibrationBundleAdjuster::RemoveView(const theia::ViewId view_id) {
+  const auto it = view_residuals_.find(view_id);
+  if (it == view_residuals_.end()) {
+    recon_->RemoveView(view_id);
+    return;
+  }
+  double* intrinsics = it->second.intrinsics;
+  if (it->second.residual_id != nullptr) {
+    problem_->RemoveResidualBlock(it->second.residual_id);
+  }
+  problem_->RemoveParameterBlock(it->second.extrinsics);
+  view_residuals_.erase(it);
+  view_stats_.erase(view_id);
+
+  // the removed view might have been the reference of its intrinsics block
+  auto intr_it = intrinsics_blocks_.find(intrinsics);
+  if (intr_it != intrinsics_blocks_.end() && intr_it->second == view_id) {
+    bool intrinsics_used = false;
+    for (const auto& v : view_residuals_) {
+      if (v.second.intrinsics == intrinsics) {
+        intr_it->second = v.first;
+        intrinsics_used = true;
+        break;
+      }
+    }
+    // theia frees the intrinsics together with the last view of the group
+    if (!intrinsics_used) {
+      problem_->RemoveParameterBlock(intrinsics);
+      intrinsics_blocks_.erase(intr_it);
+      constant_intrinsics_.erase(intrinsics);
+      prior_residual_ids_.erase(intrinsics);
+    }
+  }
+  recon_->RemoveView(view_id);
+}
+
+void CalibrationBundleAdjuster::AddIntrinsicsPrior(double* intrinsics) {
+  // a new prior replaces the old one of the block
+  const auto it = prior_residual_ids_.find(intrinsics);
+  if (it != prior_residual_ids_.end()) {
+    problem_->RemoveResidualBlock(it->second);
+    prior_residual_ids_.erase(it);
+  }
+  if (prior_mean_.size() == 0) {
+    return;
+  }
+  prior_residual_ids_[intrinsics] = problem_->AddResidualBlock(
+      new IntrinsicsPriorCostFunction(prior_mean_, prior_sqrt_information_),
+      nullptr,
+      intrinsics);
+}
+
+void CalibrationBundleAdjuster::SetIntrinsicsPrior(
+    const Eigen::VectorXd& mean,
+    const Eigen::MatrixXd& information) {
+  CHECK_EQ(mean.size(), information.rows());
+  CHECK_EQ(mean.size(), information.cols());
+  // information = V * D * V^T -> sqrt_information = D^(1/2) * V^T, this also
+  // works for the singular information of never optimized parameters
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig(information);
+  const Eigen::VectorXd sqrt_eigenvalues =
+      eig.eigenvalues().cwiseMax(0.0).cwiseSqrt();
+  prior_mean_ = mean;
+  prior_sqrt_information_ =
+      sqrt_eigenvalues.asDiagonal() * eig.eigenvectors().transpose();
+  if (is_built_) {
+    for (const auto& intr : intrinsics_blocks_) {
+      AddIntrinsicsPrior(intr.first);
+    }
+  }
+}
+
+bool CalibrationBundleAdjuster::ComputeIntrinsicsInformation(
+    const theia::ViewId view_id,
+    Eigen::MatrixXd& information,
+    double& variance_factor) {
+  const auto it = view_residuals_.find(view_id);
+  if (!is_built_ || it == view_residuals_.end()) {
+    return false;
+  }
+  double* intrinsics = it->second.intrinsics;
+  const int nr_params = problem_->ParameterBlockSize(intrinsics);
+  information.setZero(nr_params, nr_params);
+  variance_factor = 1.0;
+  if (problem_->IsParameterBlockConstant(intrinsics)) {
+    return true;
+  }
+
+  // Schur complement of the intrinsics, all view poses are eliminated
+  Eigen::MatrixXd local_information;
+  if (!utils::ComputeMarginalInformation(
+          problem_.get(), {intrinsics}, local_information, &variance_factor)) {
+    LOG(WARNING) << "Could not compute the intrinsics information.";
+    return false;
+  }
+
+  // the local coordinates of the subset parameterization are the variable
+  // parameters in increasing order, constant ones get no information
+  const std::vector<int>& constant = constant_intrinsics_[intrinsics];
+  std::vector<int> variable;
+  for (int i = 0; i < nr_params; ++i) {
+    if (std::find(constant.begin(), constant.end(), i) == constant.end()) {
+      variable.push_back(i);
+    }
+  }
+  CHECK_EQ(static_cast<int>(variable.size()), local_information.rows());
+  for (size_t r = 0; r < variable.size(); ++r) {
+    for (size_t c = 0; c < variable.size(); ++c) {
+      information(variable[r], variable[c]) = local_information(r, c);
+    }
+  }
+  return true;
+}
+
+bool CalibrationBundleAdjuster::GetIntrinsicsInformation(
+    const theia::ViewId view_id,
+    Eigen::MatrixXd& information) {
+  double variance_factor;
+  return ComputeIntrinsicsInformation(view_id, information, variance_factor);
+}
+
+bool CalibrationBundleAdjuster::GetIntrinsicsCovariance(
+    const theia::ViewId view_id,
+    Eigen::MatrixXd& covariance) {
+  Eigen::MatrixXd information;
+  double variance_factor;
+  if (!ComputeIntrinsicsInformation(view_id, information, variance_factor)) {
+    return false;
+  }
+  covariance =
+      variance_factor * utils::CovarianceFromInformation(information);
+  return true;
+}
+
+std::map<theia::ViewId, double>
+CalibrationBundleAdjuster::RemoveViewsReprojError(
+    const double max_reproj_error) {
+  if (view_stats_.size() != view_residuals_.size()) {
+    UpdateViewStatistics();
+  }
+  std::map<theia::ViewId, double> ids_to_remove;
+  for (const auto& v : view_residuals_) {
+    const double view_reproj_error = GetViewReprojError(v.first);
+    if (view_reproj_error > max_reproj_error) {
+      ids_to_remove[v.first] = view_reproj_error;
+    }
+  }
+  for (const auto& v_id : ids_to_remove) {
+    RemoveView(v_id.first);
+  }
+  return ids_to_remove;
+}
+
+}  // namespace core
+}  // namespace OpenICC
@@ -22,6 +22,7 @@
 #include <theia/io/write_ply_file.h>
 #include <theia/sfm/bundle_adjustment/bundle_adjuster.h>
 #include <theia/sfm/bundle_adjustment/bundle_adjustment.h>
+#include <theia/sfm/estimators/estimate_calibrated_absolute_pose.h>
 #include <theia/sfm/estimators/estimate_radial_dist_uncalibrated_absolute_pose.h>
 #include <theia/sfm/estimators/estimate_uncalibrated_absolute_pose.h>
 #include <theia/sfm/estimators/feature_correspondence_2d_3d.h>
@@ -34,21 +35,37 @@
 #include <theia/sfm/camera/pinhole_camera_model.h>
 #include <theia/sfm/camera/pinhole_radial_tangential_camera_model.h>
 
+#include "OpenCameraCalibrator/io/calibration_state.h"
 #include "OpenCameraCalibrator/io/read_scene.h"
 #include "OpenCameraCalibrator/io/write_camera_calibration.h"
 #include "OpenCameraCalibrator/utils/intrinsic_initializer.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+#include "OpenCameraCalibrator/utils/planar_initializer.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
 
+#include <algorithm>
+#include <mutex>
 #include <thread>
 
 namespace OpenICC {
 namespace core {
 
+namespace {
+
+// theia's RANSAC samplers share one random generator, calibrators of
+// different cameras of a rig run in parallel
+std::mutex ransac_mutex;
+
+}  // namespace
+
 CameraCalibrator::CameraCalibrator(const std::string& camera_model,
                                    const bool optimize_board_pts)
-    : camera_model_(camera_model), optimize_board_pts_(optimize_board_pts) {
+    : camera_model_(camera_model == utils::KB4_CAMERA_MODEL ? "FISHEYE"
+                                                            : camera_model),
+      optimize_board_pts_(optimize_board_pts) {
   ransac_params_.failure_probability = 0.001;
   ransac_params_.use_mle = true;
   ransac_params_.max_iterations = 1000;
@@ -57,21 +74,48 @@ CameraCalibrator::CameraCalibrator(const std::string& camera_model,
 }
 
 void CameraCalibrator::RemoveViewsReprojError(const double max_reproj_error) {
+  if (bundle_adjuster_ && bundle_adjuster_->IsBuilt()) {
+    // evaluates the residual blocks and drops them from the problem
+    const std::map<theia::ViewId, double> removed_ids =
+        bundle_adjuster_->RemoveViewsReprojError(max_reproj_error);
+    for (const auto& v_id : removed_ids) {
+      LOG(INFO) << "Removed view: " << v_id.first
+                << " with RMSE reproj error: " << v_id.second << "\n";
+    }
+    return;
+  }
   // reproj error per view, remove some views which have a high error
-  std::map<theia::ViewId, double> ids_to_remove;
-  for (int i = 0; i < recon_calib_dataset_.NumViews(); ++i) {
-    const theia::ViewId v_id = recon_calib_dataset_.ViewIds()[i];
-    const double view_reproj_error =
-        utils::GetReprojErrorOfView(recon_calib_dataset_, v_id);
-    if (view_reproj_error > max_reproj_error) {
-      ids_to_remove[v_id] = view_reproj_error;
+  const std::vector<theia::ViewId> view_ids = recon_calib_dataset_.ViewIds();
+  const std::vector<utils::ViewStatistics> view_stats =
+      GetViewStatistics(view_ids);
+  for (size_t i = 0; i < view_ids.size(); ++i) {
+    if (view_stats[i].mean_error > max_reproj_error) {
+      recon_calib_dataset_.RemoveView(view_ids[i]);
+      LOG(INFO) << "Removed view: " << view_ids[i]
+                << " with RMSE reproj error: " << view_stats[i].mean_error
+                << "\n";
     }
   }
-  for (auto v_id : ids_to_remove) {
-    recon_calib_dataset_.RemoveView(v_id.first);
-    LOG(INFO) << "Removed view: " << v_id.first
-              << " with RMSE reproj error: " << v_id.second << "\n";
+}
+
+std::vector<utils::ViewStatistics> CameraCalibrator::GetViewStatistics(
+    const std::vector<theia::ViewId>& view_ids) const {
+  std::vector<utils::ViewStatistics> view_stats(view_ids.size());
+  bool cached = bundle_adjuster_ && bundle_adjuster_->IsBuilt();
+  for (size_t i = 0; cached && i < view_ids.size(); ++i) {
+    const utils::ViewStatistics* stats =
+        bundle_adjuster_->GetViewStatistics(view_ids[i]);
+    if (stats == nullptr) {
+      cached = false;
+    } else {
+      view_stats[i] = *stats;
+    }
   }
+  if (cached) {
+    return view_stats;
+  }
+  return utils::ComputeViewStatistics(
+      recon_calib_dataset_, view_ids, std::thread::hardware_concurrency());
 }
 
 bool CameraCalibrator::AddObservation(const theia::ViewId& view_id,
@@ -128,8 +172,161 @@ theia::ViewId CameraCalibrator::AddView(
   return view_id;
 }
 
+bool CameraCalibrator::LoadCalibrationState(const std::string& state_file) {
+  double prior_reproj_error = 0.0;
+  if (!io::read_calibration_state(state_file,
+                                  prior_camera_,
+                                  prior_information_,
+                                  prior_nr_views_,
+                                  prior_reproj_error,
+                                  prior_view_positions_)) {
+    return false;
+  }
+  const std::string prior_model = theia::CameraIntrinsicsModelTypeToString(
+      prior_camera_.GetCameraIntrinsicsModelType());
+  if (prior_model != camera_model_) {
+    LOG(ERROR) << "Calibration state is a " << prior_model
+               << " model, but calibrating a " << camera_model_ << " model.";
+    prior_nr_views_ = 0;
+    return false;
+  }
+  has_prior_ = true;
+  std::cout << "Continuing calibration from " << prior_nr_views_
+            << " views with reprojection error " << prior_reproj_error
+            << "px.\n";
+  return true;
+}
+
+bool CameraCalibrator::WriteCalibrationState(const std::string& state_file) {
+  if (!bundle_adjuster_ || recon_calib_dataset_.NumViews() == 0) {
+    return false;
+  }
+  Eigen::MatrixXd information;
+  const theia::ViewId view_id = recon_calib_dataset_.ViewIds()[0];
+  if (!bundle_adjuster_->GetIntrinsicsInformation(view_id, information)) {
+    return false;
+  }
+
+  vec3_vector view_positions = prior_view_positions_;
+  const std::vector<theia::ViewId> view_ids = recon_calib_dataset_.ViewIds();
+  const std::vector<utils::ViewStatistics> view_stats =
+      GetViewStatistics(view_ids);
+  double reproj_error = 0.0;
+  for (size_t i = 0; i < view_ids.size(); ++i) {
+    view_positions.push_back(
+        recon_calib_dataset_.View(view_ids[i])->Camera().GetPosition());
+    reproj_error += view_stats[i].mean_error;
+  }
+  reproj_error /= view_ids.size();
+
+  return io::write_calibration_state(
+      state_file,
+      recon_calib_dataset_.View(view_id)->Camera(),
+      information,
+      NumCalibrationViews(),
+      reproj_error,
+      view_positions);
+}
+
+bool CameraCalibrator::EstimateCalibratedPose(
+    const theia::Camera& camera,
+    const utils::UndistortionLookup& undistortion_lookup,
+    const std::vector<int>& board_pt3_ids,
+    const aligned_vector<Eigen::Vector2d>& corners,
+    Eigen::Matrix3d& rotation,
+    Eigen::Vector3d& position) {
+  Eigen::Matrix2Xd pixels(2, corners.size()), normalized;
+  for (size_t i = 0; i < corners.size(); ++i) {
+    pixels.col(i) = corners[i];
+  }
+  undistortion_lookup.Undistort(pixels, normalized);
+
+  std::vector<theia::FeatureCorrespondence2D3D> correspondences(
+      board_pt3_ids.size());
+  for (size_t i = 0; i < board_pt3_ids.size(); ++i) {
+    correspondences[i].feature = normalized.col(i);
+    correspondences[i].world_point =
+        recon_calib_dataset_.Track(board_pt3_ids[i])->Point().hnormalized();
+  }
+
+  // same squared pixel threshold as the uncalibrated initialization, in
+  // normalized image coordinates (theia compares squared errors)
+  const double focal_length = camera.FocalLength();
+  theia::RansacParameters ransac_params = ransac_params_;
+  ransac_params.error_thresh =
+      0.003 * camera.ImageHeight() / (focal_length * focal_length);
+  theia::RansacSummary ransac_summary;
+  if (utils::EstimatePlanarCalibratedPose(correspondences,
+                                          ransac_params.error_thresh,
+                                          rotation,
+                                          position,
+                                          ransac_summary)) {
+    return true;
+  }
+  theia::CalibratedAbsolutePose pose;
+  if (!theia::EstimateCalibratedAbsolutePose(ransac_params,
+                                             theia::RansacType::RANSAC,
+                                             theia::PnPType::DLS,
+                                             correspondences,
+                                             &pose,
+                                             &ransac_summary)) {
+    return false;
+  }
+  rotation = pose.rotation;
+  position = pose.position;
+  return true;
+}
+
+bool CameraCalibrator::RunIncrementalCalibration(
+    theia::BundleAdjustmentOptions& ba_options) {
+  Eigen::VectorXd prior_mean = Eigen::Map<const Eigen::VectorXd>(
+      prior_camera_.intrinsics(),
+      prior_camera_.CameraIntrinsics()->NumParameters());
+  bundle_adjuster_->SetIntrinsicsPrior(prior_mean, prior_information_);
+
+  /////////////////////////////////////////////////
+  /// 1. Poses of the new views with the previous intrinsics
+  /////////////////////////////////////////////////
+  LOG(INFO) << "Optimizing poses of the new views.";
+  ba_options.constant_camera_orientation = false;
+  ba_options.constant_camera_position = false;
+  ba_options.intrinsics_to_optimize = theia::OptimizeIntrinsicsType::NONE;
+  bundle_adjuster_->Optimize(ba_options);
+
+  RemoveViewsReprojError(5.0);
+
+  if (recon_calib_dataset_.NumViews() == 0) {
+    std::cout << "No new views left for calibration!" << std::endl;
+    return false;
+  }
+
+  /////////////////////////////////////////////////
+  /// 2. Short refinement of all parameters against the prior
+  /////////////////////////////////////////////////
+  LOG(INFO) << "Refining intrinsics with the new views.";
+  ba_options.max_num_iterations = incremental_max_iterations_;
+  ba_options.intrinsics_to_optimize =
+      theia::OptimizeIntrinsicsType::PRINCIPAL_POINTS |
+      theia::OptimizeIntrinsicsType::FOCAL_LENGTH |
+      theia::OptimizeIntrinsicsType::ASPECT_RATIO |
+      theia::OptimizeIntrinsicsType::RADIAL_DISTORTION;
+  if (camera_model_ == "PINHOLE_RADIAL_TANGENTIAL") {
+    ba_options.intrinsics_to_optimize |=
+        theia::OptimizeIntrinsicsType::TANGENTIAL_DISTORTION;
+  }
+  bundle_adjuster_->Optimize(ba_options);
+
+  RemoveViewsReprojError(2.0);
+
+  if (recon_calib_dataset_.NumViews() == 0) {
+    std::cout << "No new views left for calibration!" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 bool CameraCalibrator::RunCalibration() {
-  if (recon_calib_dataset_.NumViews() < min_num_view_) {
+  if (NumCalibrationViews() < min_num_view_) {
     LOG(ERROR) << "Not enough views for proper calibration!" << std::endl;
     return false;
   }
@@ -143,6 +340,18 @@ bool CameraCalibrator::RunCalibration() {
   ba_options.robust_loss_width = 1.345;
   ba_options.num_threads = std::thread::hardware_concurrency();
 
+  // the stages remove views, the refinement problem would keep their blocks
+  refine_adjuster_.reset();
+
+  // the problem is built once, the stages below only change which parameter
+  // blocks are constant
+  bundle_adjuster_.reset(new CalibrationBundleAdjuster(&recon_calib_dataset_));
+  bundle_adjuster_->Build(ba_options);
+
+  if (has_prior_) {
+    return RunIncrementalCalibration(ba_options);
+  }
+
   /////////////////////////////////////////////////
   /// 1. Optimize focal length and radial distortion, keep principal point fixed
   /////////////////////////////////////////////////
@@ -156,8 +365,8 @@ bool CameraCalibrator::RunCalibration() {
   }
   LOG(INFO) << "Bundle adjusting focal length and radial distortion.\n";
 
-  theia::BundleAdjustmentSummary summary = BundleAdjustViews(
-      ba_options, recon_calib_dataset_.ViewIds(), &recon_calib_dataset_);
+  theia::BundleAdjustmentSummary summary =
+      bundle_adjuster_->Optimize(ba_options);
 
   RemoveViewsReprojError(5.0);
 
@@ -170,8 +379,7 @@ bool CameraCalibrator::RunCalibration() {
   ba_options.intrinsics_to_optimize =
       theia::OptimizeIntrinsicsType::PRINCIPAL_POINTS;
 
-  summary = theia::BundleAdjustViews(
-      ba_options, recon_calib_dataset_.ViewIds(), &recon_calib_dataset_);
+  summary = bundle_adjuster_->Optimize(ba_options);
 
   if (recon_calib_dataset_.NumViews() < min_num_view_) {
     std::cout << "Not enough views left for proper calibration!" << std::endl;
@@ -195,8 +403,7 @@ bool CameraCalibrator::RunCalibration() {
     ba_options.intrinsics_to_optimize |=
         theia::OptimizeIntrinsicsType::TANGENTIAL_DISTORTION;
   }
-  summary = theia::BundleAdjustViews(
-      ba_options, recon_calib_dataset_.ViewIds(), &recon_calib_dataset_);
+  summary = bundle_adjuster_->Optimize(ba_options);
 
   RemoveViewsReprojError(2.0);
 
@@ -207,28 +414,219 @@ bool CameraCalibrator::RunCalibration() {
 
   if (optimize_board_pts_) {
     LOG(INFO) << "Optimizing board points.";
-    ba_options.use_homogeneous_point_parametrization = true;
     ba_options.verbose = true;
-    theia::BundleAdjustTracks(
-        ba_options, recon_calib_dataset_.TrackIds(), &recon_calib_dataset_);
-    summary = theia::BundleAdjustViews(
-        ba_options, recon_calib_dataset_.ViewIds(), &recon_calib_dataset_);
+    // board points only, cameras are kept fixed by the adjuster
+    bundle_adjuster_->Optimize(ba_options, true);
+    summary = bundle_adjuster_->Optimize(ba_options);
   }
 
   return true;
 }
 
-bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json& scene_json,
-                                               const std::string& output_path) {
+void CameraCalibrator::InitializeScene(const nlohmann::json& scene_json,
+                                       const int image_width,
+                                       const int image_height) {
   io::scene_points_to_calib_dataset(scene_json, recon_calib_dataset_);
+  image_width_ = image_width;
+  image_height_ = image_height;
+
+  // views of a previous calibration also occupy the pose grid
+  saved_poses_ = prior_view_positions_;
+  if (has_prior_) {
+    undistortion_lookup_.reset(new utils::UndistortionLookup(
+        prior_camera_,
+        utils::UNDISTORTION_GRID_STEP_PX,
+        std::thread::hardware_concurrency()));
+  }
+}
 
-  const int image_width = scene_json["image_width"];
-  const int image_height = scene_json["image_height"];
+bool CameraCalibrator::AddFrame(const double timestamp_s,
+                                const std::vector<int>& board_pt3_ids,
+                                const aligned_vector<Eigen::Vector2d>& corners) {
   // initial principal point
-  const double px = static_cast<double>(image_width) / 2.0;
-  const double py = static_cast<double>(image_height) / 2.0;
+  const double px = static_cast<double>(image_width_) / 2.0;
+  const double py = static_cast<double>(image_height_) / 2.0;
+
+  LOG(INFO) << "Initializing view at timestamp: " << timestamp_s << "\n";
+  // initialize cam pose
+  std::vector<theia::FeatureCorrespondence2D3D> correspondences(
+      board_pt3_ids.size());
+  for (size_t i = 0; i < board_pt3_ids.size(); ++i) {
+    const theia::Track* track = recon_calib_dataset_.Track(board_pt3_ids[i]);
+    if (track == nullptr) {
+      LOG(WARNING) << "Unknown board point " << board_pt3_ids[i] << ".";
+      return false;
+    }
+    theia::FeatureCorrespondence2D3D correspondence;
+    correspondence.feature[0] = corners[i][0] - px;
+    correspondence.feature[1] = corners[i][1] - py;
+    correspondence.world_point = track->Point().hnormalized();
+    correspondences[i] = correspondence;
+  }
+
+  // intrinsics new views start from: the running estimate, or a loaded state
+  // before the first refinement
+  const theia::Camera* init_camera =
+      has_running_estimate_ ? &running_camera_
+                            : (has_prior_ ? &prior_camera_ : nullptr);
+
+  theia::RansacSummary ransac_summary;
+  Eigen::Matrix3d rotation;
+  Eigen::Vector3d position;
+  bool success_init = false;
+  double focal_length = 0.0, radial_distortion = 0.0;
+  LOG(INFO) << "Initializing " << camera_model_ << " camera model.\n";
+
+  std::unique_lock<std::mutex> ransac_lock(ransac_mutex);
+  // set error thresh 0.3% from image size
+  ransac_params_.error_thresh = 0.003 * image_height_;
+  if (init_camera != nullptr) {
+    success_init = EstimateCalibratedPose(*init_camera,
+                                          *undistortion_lookup_,
+                                          board_pt3_ids,
+                                          corners,
+                                          rotation,
+                                          position);
+  } else if (camera_model_ == "PINHOLE" ||
+             camera_model_ == "PINHOLE_RADIAL_TANGENTIAL") {
+    success_init = utils::initialize_pinhole_camera(correspondences,
+                                                    ransac_params_,
+                                                    ransac_summary,
+                                                    rotation,
+                                                    position,
+                                                    focal_length,
+                                                    verbose_);
+  } else if (camera_model_ == "DIVISION_UNDISTORTION") {
+    success_init = utils::initialize_radial_undistortion_camera(
+        correspondences,
+        ransac_params_,
+        ransac_summary,
+        cv::Size(image_width_, image_height_),
+        rotation,
+        position,
+        focal_length,
+        radial_distortion,
+        verbose_);
+  } else {
+    success_init = utils::initialize_radial_undistortion_camera(
+        correspondences,
+        ransac_params_,
+        ransac_summary,
+        cv::Size(image_width_, image_height_),
+        rotation,
+        position,
+        focal_length,
+        radial_distortion,
+        verbose_);
+    //        success_init = utils::initialize_doublesphere_model(
+    //                correspondences, board_pt3_ids, cv::Size(9, 7),
+    //                ransac_params_, image_width, image_height,
+    //                ransac_summary, rotation, position, focal_length,
+    //                verbose_);
+  }
+  ransac_lock.unlock();
+
+  // check if a very close by pose is already present
+  bool take_image = true;
+  for (size_t i = 0; i < saved_poses_.size(); ++i) {
+    if ((position - saved_poses_[i]).norm() < grid_size_) {
+      take_image = false;
+      break;
+    }
+  }
+
+  if (!take_image || !success_init) {
+    return false;
+  }
+
+  saved_poses_.push_back(position);
+
+  theia::ViewId view_id = AddView(rotation,
+                                  position,
+                                  focal_length,
+                                  radial_distortion,
+                                  image_width_,
+                                  image_height_,
+                                  timestamp_s);
+  if (init_camera != nullptr) {
+    // the views share one intrinsics block, AddView reset it
+    theia::Camera* cam =
+        recon_calib_dataset_.MutableView(view_id)->MutableCamera();
+    std::copy(init_camera->intrinsics(),
+              init_camera->intrinsics() +
+                  init_camera->CameraIntrinsics()->NumParameters(),
+              cam->mutable_intrinsics());
+  }
+
+  for (size_t i = 0; i < board_pt3_ids.size(); ++i) {
+    AddObservation(view_id, board_pt3_ids[i], corners[i]);
+  }
+  return true;
+}
+
+bool CameraCalibrator::RefineIntrinsics(const int max_iterations) {
+  if (recon_calib_dataset_.NumViews() < min_num_view_) {
+    return false;
+  }
+  theia::BundleAdjustmentOptions ba_options;
+  ba_options.verbose = false;
+  ba_options.loss_function_type = theia::LossFunctionType::HUBER;
+  ba_options.robust_loss_width = 1.345;
+  ba_options.num_threads = std::thread::hardware_concurrency();
+  ba_options.max_num_iterations = max_iterations;
+  ba_options.constant_camera_orientation = false;
+  ba_options.constant_camera_position = false;
+  ba_options.intrinsics_to_optimize =
+      theia::OptimizeIntrinsicsType::FOCAL_LENGTH;
+  if (camera_model_ != "PINHOLE") {
+    ba_options.intrinsics_to_optimize |=
+        theia::OptimizeIntrinsicsType::RADIAL_DISTORTION;
+  }
+  // the principal point is only released once the estimate has settled
+  if (has_running_estimate_ || has_prior_) {
+    ba_options.intrinsics_to_optimize |=
+        theia::OptimizeIntrinsicsType::PRINCIPAL_POINTS |
+        theia::OptimizeIntrinsicsType::ASPECT_RATIO;
+  }
+
+  // no views are removed here, outliers are handled by the final calibration.
+  // The problem is built once, later refinements only add the new views.
+  if (!refine_adjuster_) {
+    refine_adjuster_.reset(
+        new CalibrationBundleAdjuster(&recon_calib_dataset_));
+    refine_adjuster_->Build(ba_options);
+    if (has_prior_) {
+      refine_adjuster_->SetIntrinsicsPrior(
+          Eigen::Map<const Eigen::VectorXd>(
+              prior_camera_.intrinsics(),
+              prior_camera_.CameraIntrinsics()->NumParameters()),
+          prior_information_);
+    }
+  } else {
+    refine_adjuster_->AddNewViews();
+  }
+  const theia::BundleAdjustmentSummary summary =
+      refine_adjuster_->Optimize(ba_options);
+  if (!summary.success) {
+    return false;
+  }
+
+  running_camera_ =
+      recon_calib_dataset_.View(recon_calib_dataset_.ViewIds()[0])->Camera();
+  has_running_estimate_ = true;
+  // new views are initialized with the running estimate from now on
+  undistortion_lookup_.reset(
+      new utils::UndistortionLookup(running_camera_,
+                                    utils::UNDISTORTION_GRID_STEP_PX,
+                                    std::thread::hardware_concurrency()));
+  return true;
+}
+
+bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json& scene_json,
+                                               const std::string& output_path) {
+  InitializeScene(
+      scene_json, scene_json["image_width"], scene_json["image_height"]);
 
-  vec3_vector saved_poses;
   // iterate views and estimate poses
   const auto views = scene_json["views"];
   const size_t total_nr_views = views.size();
@@ -244,101 +642,20 @@ bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json& scene_json,
       corners.push_back(
           Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
     }
+    AddFrame(timestamp_s, board_pt3_ids, corners);
 
-    LOG(INFO) << "Initializing view at timestamp: " << timestamp_s << "\n";
-    // initialize cam pose
-    std::vector<theia::FeatureCorrespondence2D3D> correspondences(
-        board_pt3_ids.size());
-    for (size_t i = 0; i < board_pt3_ids.size(); ++i) {
-      theia::FeatureCorrespondence2D3D correspondence;
-      correspondence.feature[0] = corners[i][0] - px;
-      correspondence.feature[1] = corners[i][1] - py;
-      const Eigen::Vector4d track =
-          recon_calib_dataset_.Track(board_pt3_ids[i])->Point();
-      correspondence.world_point = track.hnormalized();
-      correspondences[i] = correspondence;
-    }
-
-    theia::RansacSummary ransac_summary;
-    Eigen::Matrix3d rotation;
-    Eigen::Vector3d position;
-    bool success_init = false;
-    double focal_length = 0.0, radial_distortion = 0.0;
-    LOG(INFO) << "Initializing " << camera_model_ << " camera model.\n";
-
-    // set error thresh 0.3% from image size
-    ransac_params_.error_thresh = 0.003 * image_height;
-    if (camera_model_ == "PINHOLE" ||
-        camera_model_ == "PINHOLE_RADIAL_TANGENTIAL") {
-      success_init = utils::initialize_pinhole_camera(correspondences,
-                                                      ransac_params_,
-                                                      ransac_summary,
-                                                      rotation,
-                                                      position,
-                                                      focal_length,
-                                                      verbose_);
-    } else if (camera_model_ == "DIVISION_UNDISTORTION") {
-      success_init = utils::initialize_radial_undistortion_camera(
-          correspondences,
-          ransac_params_,
-          ransac_summary,
-          cv::Size(image_width, image_height),
-          rotation,
-          position,
-          focal_length,
-          radial_distortion,
-          verbose_);
-    } else {
-      success_init = utils::initialize_radial_undistortion_camera(
-          correspondences,
-          ransac_params_,
-          ransac_summary,
-          cv::Size(image_width, image_height),
-          rotation,
-          position,
-          focal_length,
-          radial_distortion,
-          verbose_);
-      //        success_init = utils::initialize_doublesphere_model(
-      //                correspondences, board_pt3_ids, cv::Size(9, 7),
-      //                ransac_params_, image_width, image_height,
-      //                ransac_summary, rotation, position, focal_length,
-      //                verbose_);
-    }
     if (views_initialized % 100 == 0) {
       std::cout << "View: " << views_initialized << "/" << total_nr_views
                 << " initialized for calibration.\n";
     }
     ++views_initialized;
-
-    // check if a very close by pose is already present
-    bool take_image = true;
-    for (size_t i = 0; i < saved_poses.size(); ++i) {
-      if ((position - saved_poses[i]).norm() < grid_size_) {
-        take_image = false;
-        break;
-      }
-    }
-
-    if (!take_image || !success_init) {
-      continue;
-    }
-
-    saved_poses.push_back(position);
-
-    theia::ViewId view_id = AddView(rotation,
-                                    position,
-                                    focal_length,
-                                    radial_distortion,
-                                    image_width,
-                                    image_height,
-                                    timestamp_s);
-
-    for (size_t i = 0; i < board_pt3_ids.size(); ++i) {
-      AddObservation(view_id, board_pt3_ids[i], corners[i]);
-    }
   }
 
+  return FinishCalibration(output_path, scene_json["camera_fps"]);
+}
+
+bool CameraCalibrator::FinishCalibration(const std::string& output_path,
+                                         const double fps) {
   theia::WritePlyFile(output_path + "_ransac_poses.ply",
                       recon_calib_dataset_,
                       Eigen::Vector3i(255, 0, 0),
@@ -349,15 +666,17 @@ bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json& scene_json,
     return false;
   }
 
-  // final reprojection error
+  // final reprojection error from the last residual evaluation
+  const std::vector<theia::ViewId> view_ids = recon_calib_dataset_.ViewIds();
+  const std::vector<utils::ViewStatistics> view_stats =
+      GetViewStatistics(view_ids);
   double reproj_error = 0;
-  for (int i = 0; i < recon_calib_dataset_.NumViews(); ++i) {
-    const double view_reproj_error = utils::GetReprojErrorOfView(
-        recon_calib_dataset_, recon_calib_dataset_.ViewIds()[i]);
-    reproj_error += view_reproj_error;
+  for (size_t i = 0; i < view_ids.size(); ++i) {
+    reproj_error += view_stats[i].mean_error;
     if (verbose_) {
-      LOG(INFO) << "View: " << recon_calib_dataset_.ViewIds()[i]
-                << " RMSE reprojection error: " << view_reproj_error << "\n";
+      LOG(INFO) << "View: " << view_ids[i]
+                << " RMSE reprojection error: " << view_stats[i].rmse
+                << " max. error: " << view_stats[i].max_error << "\n";
     }
   }
 
@@ -366,18 +685,39 @@ bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json& scene_json,
   std::cout << "Final camera calibration reprojection error: "
             << total_repro_error << " from " << recon_calib_dataset_.NumViews()
             << " view." << std::endl;
+  if (has_prior_) {
+    std::cout << "Calibration includes " << prior_nr_views_
+              << " views of previous sessions." << std::endl;
+  }
   const theia::Camera cam =
       recon_calib_dataset_.View(recon_calib_dataset_.ViewIds()[0])->Camera();
 
+  // uncertainty of the intrinsics, e.g. to decide if more views are needed
+  Eigen::MatrixXd intrinsics_covariance;
+  if (bundle_adjuster_ &&
+      bundle_adjuster_->GetIntrinsicsCovariance(view_ids[0],
+                                                intrinsics_covariance)) {
+    std::cout << "Intrinsics standard deviation: "
+              << intrinsics_covariance.diagonal().cwiseMax(0.0).cwiseSqrt().transpose()
+              << std::endl;
+  } else {
+    LOG(WARNING) << "Could not compute the intrinsics covariance.";
+    intrinsics_covariance.resize(0, 0);
+  }
+
   if (output_path != "") {
     theia::WriteReconstruction(recon_calib_dataset_,
                                output_path + ".calibdata");
     CHECK(io::write_camera_calibration(output_path + ".json",
                                        cam,
-                                       scene_json["camera_fps"],
+                                       fps,
                                        recon_calib_dataset_.NumViews(),
-                                       total_repro_error))
+                                       total_repro_error,
+                                       intrinsics_covariance))
         << "Could not write calibration file.\n";
+    if (!WriteCalibrationState(output_path + "_state.json")) {
+      LOG(WARNING) << "Could not write calibration state.";
+    }
     theia::WritePlyFile(output_path + "_final_poses.ply",
                         recon_calib_dataset_,
                         Eigen::Vector3i(255, 0, 0),
@@ -434,6 +774,10 @@ void CameraCalibrator::PrintResult() {
         << cam.intrinsics()[theia::FisheyeCameraModel::InternalParametersIndex::
                                 RADIAL_DISTORTION_4]
         << "\n";
+    if (utils::IsKB4Camera(cam)) {
+      std::cout << "KB4 [fx, fy, cx, cy, k1, k2, k3, k4]: "
+                << utils::KB4ParametersFromCamera(cam).transpose() << "\n";
+    }
   } else if (camera_model_ == "PINHOLE_DISTORTION") {
     std::cout
         << "Pinhole with radial-tangential distortion: "
@@ -15,6 +15,10 @@
 
 #include "OpenCameraCalibrator/core/imu_camera_calibrator.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
 namespace OpenICC {
 namespace core {
 
@@ -60,15 +64,69 @@ void ImuCameraCalibrator::BatchInitSpline(
   const int64_t dt_so3_ns = spline_weight_data_.dt_so3 * S_TO_NS;
   const int64_t dt_r3_ns = spline_weight_data_.dt_r3 * S_TO_NS;
 
+  // IMU samples in the spline time range, they also drive the knot placement
+  gyro_measurements_.clear();
+  accl_measurements_.clear();
+  gyro_measurements_.reserve(telemetry_data.gyroscope.size());
+  accl_measurements_.reserve(telemetry_data.accelerometer.size());
+  for (size_t i = 0; i < telemetry_data.accelerometer.size(); ++i) {
+    const double t = telemetry_data.accelerometer[i].timestamp_s() +
+                     time_offset_imu_to_cam;
+    if (t < t0_s_ || t >= tend_s_) continue;
+    gyro_measurements_.emplace_back(t, telemetry_data.gyroscope[i].data());
+    accl_measurements_.emplace_back(t, telemetry_data.accelerometer[i].data());
+  }
+  const auto earlier = [](const std::pair<double, Eigen::Vector3d>& a,
+                          const std::pair<double, Eigen::Vector3d>& b) {
+    return a.first < b.first;
+  };
+  if (!std::is_sorted(
+          accl_measurements_.begin(), accl_measurements_.end(), earlier)) {
+    std::stable_sort(
+        accl_measurements_.begin(), accl_measurements_.end(), earlier);
+    std::stable_sort(
+        gyro_measurements_.begin(), gyro_measurements_.end(), earlier);
+  }
+
   trajectory_.SetTimes(dt_so3_ns, dt_r3_ns, start_t_ns, end_t_ns);
+  nr_knots_so3_ = (end_t_ns - start_t_ns) / dt_so3_ns + SPLINE_N;
+  nr_knots_r3_ = (end_t_ns - start_t_ns) / dt_r3_ns + SPLINE_N;
+  adaptive_knot_times_ns_.clear();
+  if (adaptive_knots_) {
+    // rotation knots follow the gyroscope, position knots the accelerometer
+    // bandwidth, the SEW spacing is the densest one
+    utils::AdaptiveKnotOptions knot_options;
+    knot_options.max_dt_factor = adaptive_knots_max_dt_factor_;
+    const std::vector<int64_t> so3_times_ns =
+        utils::AdaptiveKnotTimes(gyro_measurements_,
+                                 start_t_ns,
+                                 end_t_ns,
+                                 spline_weight_data_.dt_so3,
+                                 knot_options);
+    const std::vector<int64_t> r3_times_ns =
+        utils::AdaptiveKnotTimes(accl_measurements_,
+                                 start_t_ns,
+                                 end_t_ns,
+                                 spline_weight_data_.dt_r3,
+                                 knot_options);
+    trajectory_.SetKnotTimes(so3_times_ns, r3_times_ns);
+    std::set_union(so3_times_ns.begin(),
+                   so3_times_ns.end(),
+                   r3_times_ns.begin(),
+                   r3_times_ns.end(),
+                   std::back_inserter(adaptive_knot_times_ns_));
+    LOG(INFO) << "Adaptive knots instead of " << nr_knots_so3_ << "/"
+              << nr_knots_r3_ << " uniform SO3/R3 knots.";
+    nr_knots_so3_ = so3_times_ns.size() + SPLINE_N - 2;
+    nr_knots_r3_ = r3_times_ns.size() + SPLINE_N - 2;
+  }
+  trajectory_.SetWindowedOptimization(spline_window_s_,
+                                      spline_window_overlap_s_);
 
   LOG(INFO) << "Spline initialized with. Start/End: " << t0_s_ << "/" << tend_s_
             << " knots spacing r3/so3: " << spline_weight_data_.dt_r3 << "/"
             << spline_weight_data_.dt_so3;
 
-  nr_knots_so3_ = (end_t_ns - start_t_ns) / dt_so3_ns + SPLINE_N;
-  nr_knots_r3_ = (end_t_ns - start_t_ns) / dt_r3_ns + SPLINE_N;
-
   std::cout << "Initializing " << nr_knots_so3_ << " SO3 knots.\n";
   std::cout << "Initializing " << nr_knots_r3_ << " R3 knots.\n";
 
@@ -89,40 +147,126 @@ void ImuCameraCalibrator::BatchInitSpline(
   // rolling shutter camera
   if (inital_cam_line_delay_s_ != 0.0) {
     for (const auto& vid : vision_dataset.ViewIds()) {
-      trajectory_.AddRSCameraMeasurement(vision_dataset.View(vid), 0.0);
+      trajectory_.AddRSCameraMeasurement(vision_dataset.View(vid),
+                                         camera_robust_loss_width_);
     }
   } else {
     for (const auto& vid : vision_dataset.ViewIds()) {
-      trajectory_.AddGSCameraMeasurement(vision_dataset.View(vid), 0.0);
+      trajectory_.AddGSCameraMeasurement(vision_dataset.View(vid),
+                                         camera_robust_loss_width_);
     }
   }
   LOG(INFO) << "Added all Vision measurements to the spline estimator";
 
   LOG(INFO) << "Adding IMU measurements to spline";
-  for (size_t i = 0; i < telemetry_data.accelerometer.size(); ++i) {
-    const double t =
-        telemetry_data.accelerometer[i].timestamp_s() + time_offset_imu_to_cam;
-    if (t < t0_s_ || t >= tend_s_) continue;
-    gyro_measurements_[t] = telemetry_data.gyroscope[i].data();
-    accl_measurements_[t] = telemetry_data.accelerometer[i].data();
-    if (!trajectory_.AddAccelerometerMeasurement(
-            telemetry_data.accelerometer[i].data(),
-            t * S_TO_NS,
-            1. / spline_weight_data.std_r3)) {
-      std::cerr << "Failed to add accelerometer measurement at time: " << t
-                << "\n";
-    }
-    if (!trajectory_.AddGyroscopeMeasurement(telemetry_data.gyroscope[i].data(),
-                                             t * S_TO_NS,
-                                             1. / spline_weight_data.std_so3)) {
-      std::cerr << "Failed to add gyroscope measurement at time: " << t << "\n";
+  ImuMeasurements accl_meas, gyro_meas;
+  if (imu_collocation_points_per_knot_ > 0) {
+    CollocateImuMeasurements(accl_meas, gyro_meas);
+  } else {
+    accl_meas.reserve(accl_measurements_.size());
+    gyro_meas.reserve(gyro_measurements_.size());
+    for (size_t i = 0; i < accl_measurements_.size(); ++i) {
+      AppendImuMeasurement(accl_measurements_[i].second,
+                           gyro_measurements_[i].second,
+                           accl_measurements_[i].first,
+                           1.0,
+                           accl_meas,
+                           gyro_meas);
     }
   }
+  nr_imu_residuals_ = trajectory_.AddAccelerometerMeasurements(accl_meas) +
+                      trajectory_.AddGyroscopeMeasurements(gyro_meas);
+  if (nr_imu_residuals_ < accl_meas.size() + gyro_meas.size()) {
+    LOG(WARNING) << "Failed to add "
+                 << accl_meas.size() + gyro_meas.size() - nr_imu_residuals_
+                 << " IMU measurements outside of the spline.";
+  }
   LOG(INFO) << "Added all IMU measurements to the spline estimator";
 
   InitializeGravity(telemetry_data);
 }
 
+void ImuCameraCalibrator::AppendImuMeasurement(
+    const Eigen::Vector3d& accl,
+    const Eigen::Vector3d& gyro,
+    const double t_s,
+    const double weight_scale,
+    ImuMeasurements& accl_meas,
+    ImuMeasurements& gyro_meas) const {
+  const int64_t t_ns = t_s * S_TO_NS;
+  accl_meas.push_back({accl, t_ns, weight_scale / spline_weight_data_.std_r3});
+  gyro_meas.push_back({gyro, t_ns, weight_scale / spline_weight_data_.std_so3});
+}
+
+void ImuCameraCalibrator::CollocateImuMeasurements(
+    ImuMeasurements& accl_meas, ImuMeasurements& gyro_meas) const {
+  // bins are aligned with the knots of the denser spline, adaptive knots
+  // split every segment of the SO3 and R3 knots. The bias of evaluating the
+  // spline at the mean time instead of averaging it over the bin is second
+  // order in the bin width.
+  const int nr_points = imu_collocation_points_per_knot_;
+  const double bin_width_s =
+      std::min(spline_weight_data_.dt_so3, spline_weight_data_.dt_r3) /
+      nr_points;
+  const std::vector<int64_t>& knot_times_ns = adaptive_knot_times_ns_;
+  const auto bin_of = [&](const double t) -> int64_t {
+    if (knot_times_ns.size() < 2) {
+      return static_cast<int64_t>((t - t0_s_) / bin_width_s);
+    }
+    const int64_t t_ns = t * S_TO_NS;
+    const int64_t segment =
+        std::clamp<int64_t>(std::upper_bound(knot_times_ns.begin(),
+                                             knot_times_ns.end(),
+                                             t_ns) -
+                                knot_times_ns.begin(),
+                            1,
+                            knot_times_ns.size() - 1) -
+        1;
+    const double u =
+        static_cast<double>(t_ns - knot_times_ns[segment]) /
+        (knot_times_ns[segment + 1] - knot_times_ns[segment]);
+    return segment * nr_points +
+           std::clamp(static_cast<int>(u * nr_points), 0, nr_points - 1);
+  };
+
+  int64_t current_bin = -1;
+  int nr_samples = 0;
+  double sum_t = 0.0;
+  Eigen::Vector3d sum_accl = Eigen::Vector3d::Zero();
+  Eigen::Vector3d sum_gyro = Eigen::Vector3d::Zero();
+  auto add_bin = [&]() {
+    if (nr_samples == 0) {
+      return;
+    }
+    AppendImuMeasurement(sum_accl / nr_samples,
+                         sum_gyro / nr_samples,
+                         sum_t / nr_samples,
+                         std::sqrt(static_cast<double>(nr_samples)),
+                         accl_meas,
+                         gyro_meas);
+    nr_samples = 0;
+    sum_t = 0.0;
+    sum_accl.setZero();
+    sum_gyro.setZero();
+  };
+
+  for (size_t i = 0; i < accl_measurements_.size(); ++i) {
+    const double t = accl_measurements_[i].first;
+    const int64_t bin = bin_of(t);
+    if (bin != current_bin) {
+      add_bin();
+      current_bin = bin;
+    }
+    sum_t += t;
+    sum_accl += accl_measurements_[i].second;
+    sum_gyro += gyro_measurements_[i].second;
+    ++nr_samples;
+  }
+  add_bin();
+  LOG(INFO) << "Aggregated " << accl_measurements_.size() << " IMU samples to "
+            << accl_meas.size() << " collocation points.";
+}
+
 void ImuCameraCalibrator::SetKnownGravityDir(const Eigen::Vector3d& gravity) {
   trajectory_.SetGravity(gravity);
 }
@@ -164,6 +308,20 @@ double ImuCameraCalibrator::Optimize(const int iterations,
                                      const int optim_flags) {
   ceres::Solver::Summary summary =
       trajectory_.Optimize(iterations, optim_flags);
+  for (int r = 0; r < outlier_rounds_; ++r) {
+    const auto outliers = trajectory_.RemoveReprojectionOutliers(
+        outlier_max_reproj_error_, outlier_min_view_observations_);
+    LOG(INFO) << "Outlier rejection round " << r << ": removed "
+              << outliers.nr_removed_observations << " observations and "
+              << outliers.nr_removed_views << " views.";
+    if (outliers.nr_removed_observations == 0) {
+      break;
+    }
+    nr_removed_observations_ += outliers.nr_removed_observations;
+    nr_removed_views_ += outliers.nr_removed_views;
+    // warm started from the current estimate
+    summary = trajectory_.Optimize(iterations, optim_flags);
+  }
   return trajectory_.GetMeanReprojectionError();
 }
 
@@ -0,0 +1,156 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/core/live_camera_calibrator.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace OpenICC {
+namespace core {
+
+LiveCameraCalibrator::LiveCameraCalibrator(const std::string& camera_model,
+                                           const bool optimize_board_pts)
+    : calibrator_(camera_model, optimize_board_pts) {
+  coverage_map_.setZero(LIVE_COVERAGE_GRID_SIZE, LIVE_COVERAGE_GRID_SIZE);
+}
+
+LiveCameraCalibrator::~LiveCameraCalibrator() {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      stop_ = true;
+    }
+    queue_cond_.notify_one();
+    worker_.join();
+  }
+}
+
+void LiveCameraCalibrator::Start(const nlohmann::json& scene_json) {
+  CHECK(!worker_.joinable()) << "Live calibration is already running.";
+  scene_json_ = scene_json;
+  stop_ = false;
+  worker_ = std::thread(&LiveCameraCalibrator::Run, this);
+}
+
+void LiveCameraCalibrator::PushDetection(const BoardDetection& detection) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    queue_.push_back(detection);
+  }
+  queue_cond_.notify_one();
+}
+
+bool LiveCameraCalibrator::Finish(const std::string& output_path,
+                                  const double fps) {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      stop_ = true;
+    }
+    queue_cond_.notify_one();
+    worker_.join();
+  }
+  if (!scene_initialized_) {
+    LOG(ERROR) << "No board was detected.";
+    return false;
+  }
+  std::cout << "Running final calibration with " << nr_accepted_views_
+            << " views, image coverage: " << GetCoverage() * 100.0 << "%\n";
+  return calibrator_.FinishCalibration(output_path, fps);
+}
+
+bool LiveCameraCalibrator::GetRunningEstimate(theia::Camera& camera) const {
+  std::lock_guard<std::mutex> lock(estimate_mutex_);
+  camera = running_camera_;
+  return has_running_estimate_;
+}
+
+Eigen::MatrixXi LiveCameraCalibrator::GetCoverageMap() const {
+  std::lock_guard<std::mutex> lock(estimate_mutex_);
+  return coverage_map_;
+}
+
+double LiveCameraCalibrator::GetCoverage() const {
+  std::lock_guard<std::mutex> lock(estimate_mutex_);
+  return static_cast<double>((coverage_map_.array() > 0).count()) /
+         coverage_map_.size();
+}
+
+void LiveCameraCalibrator::UpdateCoverage(const BoardDetection& detection) {
+  std::lock_guard<std::mutex> lock(estimate_mutex_);
+  for (const auto& corner : detection.corners) {
+    const int c = std::clamp(static_cast<int>(corner[0] / detection.image_width *
+                                              LIVE_COVERAGE_GRID_SIZE),
+                             0,
+                             LIVE_COVERAGE_GRID_SIZE - 1);
+    const int r = std::clamp(static_cast<int>(corner[1] /
+                                              detection.image_height *
+                                              LIVE_COVERAGE_GRID_SIZE),
+                             0,
+                             LIVE_COVERAGE_GRID_SIZE - 1);
+    ++coverage_map_(r, c);
+  }
+}
+
+void LiveCameraCalibrator::Run() {
+  while (true) {
+    BoardDetection detection;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        // stop_ is set and everything is processed
+        return;
+      }
+      detection = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    if (!scene_initialized_) {
+      calibrator_.InitializeScene(
+          scene_json_, detection.image_width, detection.image_height);
+      scene_initialized_ = true;
+    }
+    if (!calibrator_.AddFrame(
+            detection.timestamp_s, detection.object_pt_ids, detection.corners)) {
+      continue;
+    }
+    ++nr_accepted_views_;
+    UpdateCoverage(detection);
+
+    if (nr_accepted_views_ - views_at_last_refinement_ < refine_interval_ ||
+        !calibrator_.RefineIntrinsics(refine_max_iterations_)) {
+      continue;
+    }
+    views_at_last_refinement_ = nr_accepted_views_;
+    theia::Camera camera;
+    calibrator_.GetRunningEstimate(camera);
+    {
+      std::lock_guard<std::mutex> lock(estimate_mutex_);
+      running_camera_ = camera;
+      has_running_estimate_ = true;
+    }
+    std::cout << "Running estimate from " << nr_accepted_views_
+              << " views: focal length " << camera.FocalLength()
+              << "px, principal point " << camera.PrincipalPointX() << "/"
+              << camera.PrincipalPointY() << "px, image coverage "
+              << GetCoverage() * 100.0 << "%\n";
+  }
+}
+
+}  // namespace core
+}  // namespace OpenICC
@@ -16,7 +16,11 @@
 #include "OpenCameraCalibrator/core/pose_estimator.h"
 
 #include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/utils/planar_initializer.h"
+#include "OpenCameraCalibrator/utils/pose_refinement.h"
+#include "OpenCameraCalibrator/utils/undistortion_lookup.h"
 #include "OpenCameraCalibrator/utils/utils.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
 
 #include <theia/io/reconstruction_reader.h>
 #include <theia/io/reconstruction_writer.h>
@@ -33,11 +37,30 @@
 #include <theia/sfm/camera/pinhole_camera_model.h>
 #include <theia/sfm/camera/pinhole_radial_tangential_camera_model.h>
 
+#include <algorithm>
 #include <thread>
 
 namespace OpenICC {
 namespace core {
 
+// minimal sample size of the calibrated absolute pose solvers
+const int CALIBRATED_SAMPLE_SIZE = 3;
+
+namespace {
+
+// board detections of one image and the pose estimated from them
+struct BoardView {
+  double timestamp_s;
+  std::vector<int> board_pts3_ids;
+  Eigen::Matrix2Xd corners;
+  std::vector<theia::FeatureCorrespondence2D3D> correspondences_undist;
+  theia::CalibratedAbsolutePose pose;
+  std::vector<int> inliers;
+  bool success = false;
+};
+
+}  // namespace
+
 PoseEstimator::PoseEstimator() {
   ransac_params_.failure_probability = 0.001;
   ransac_params_.use_mle = true;
@@ -49,20 +72,86 @@ PoseEstimator::PoseEstimator() {
   ba_options_.loss_function_type = theia::LossFunctionType::HUBER;
   ba_options_.robust_loss_width = 1.345;
   ba_options_.intrinsics_to_optimize = theia::OptimizeIntrinsicsType::NONE;
+
+  num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool PoseEstimator::EstimatePlanarPose(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences_undist,
+    const bool use_ransac,
+    theia::CalibratedAbsolutePose& pose,
+    std::vector<int>& inliers) const {
+  // Closed-form pose from the board homography first. Only if that does not
+  // explain the detections we run PnP RANSAC, with the iteration count
+  // adapted to the inlier ratio of the homography fit.
+  theia::RansacSummary ransac_summary;
+  if (!utils::EstimatePlanarCalibratedPose(correspondences_undist,
+                                           ransac_params_.error_thresh,
+                                           pose.rotation,
+                                           pose.position,
+                                           ransac_summary)) {
+    if (!use_ransac) {
+      return false;
+    }
+    const double inlier_ratio =
+        static_cast<double>(ransac_summary.inliers.size()) /
+        correspondences_undist.size();
+    theia::RansacParameters adapted_params = ransac_params_;
+    utils::AdaptRansacParameters(
+        inlier_ratio, CALIBRATED_SAMPLE_SIZE, adapted_params);
+    theia::EstimateCalibratedAbsolutePose(adapted_params,
+                                          theia::RansacType::RANSAC,
+                                          pnp_type_,
+                                          correspondences_undist,
+                                          &pose,
+                                          &ransac_summary);
+  }
+  inliers = ransac_summary.inliers;
+  return inliers.size() >= min_num_inliers_;
+}
+
+bool PoseEstimator::RefineViewPose(const theia::ViewId view_id) {
+  theia::View* view = pose_dataset_.MutableView(view_id);
+  theia::Camera* cam = view->MutableCamera();
+  const std::vector<theia::TrackId> track_ids = view->TrackIds();
+  std::vector<theia::FeatureCorrespondence2D3D> correspondences(
+      track_ids.size());
+  for (size_t i = 0; i < track_ids.size(); ++i) {
+    correspondences[i].world_point =
+        pose_dataset_.Track(track_ids[i])->Point().hnormalized();
+    const Eigen::Vector2d& feature = view->GetFeature(track_ids[i])->point_;
+    correspondences[i].feature =
+        cam->PixelToNormalizedCoordinates(feature).hnormalized();
+  }
+  Eigen::Matrix3d rotation = cam->GetOrientationAsRotationMatrix();
+  Eigen::Vector3d position = cam->GetPosition();
+  if (!utils::RefinePoseGaussNewton(correspondences,
+                                    {},
+                                    ba_options_.robust_loss_width,
+                                    rotation,
+                                    position)) {
+    return false;
+  }
+  cam->SetPosition(position);
+  cam->SetOrientationFromRotationMatrix(rotation);
+  return true;
 }
 
 bool PoseEstimator::EstimatePosePinhole(
     const theia::ViewId& view_id,
     const std::vector<theia::FeatureCorrespondence2D3D>& correspondences_undist,
     const std::vector<int>& board_pts3_ids) {
-  // Estimate camera pose using
   theia::CalibratedAbsolutePose pose;
-  theia::RansacSummary ransac_summary;
-  theia::EstimateCalibratedAbsolutePose(
-      ransac_params_, theia::RansacType::RANSAC, pnp_type_, correspondences_undist, &pose,
-      &ransac_summary);
-
-  if (ransac_summary.inliers.size() < 6) {
+  std::vector<int> inliers;
+  if (!EstimatePlanarPose(correspondences_undist, true, pose, inliers)) {
+    return false;
+  }
+  // optimize pose
+  if (!utils::RefinePoseGaussNewton(correspondences_undist,
+                                    inliers,
+                                    ba_options_.robust_loss_width,
+                                    pose.rotation,
+                                    pose.position)) {
     return false;
   }
 
@@ -73,8 +162,8 @@ bool PoseEstimator::EstimatePosePinhole(
   cam->SetPosition(pose.position);
   cam->SetOrientationFromRotationMatrix(pose.rotation);
 
-  for (size_t i = 0; i < ransac_summary.inliers.size(); ++i) {
-    int inlier = ransac_summary.inliers[i];
+  for (size_t i = 0; i < inliers.size(); ++i) {
+    int inlier = inliers[i];
 
     pose_dataset_.AddObservation(
         view_id,
@@ -82,11 +171,7 @@ bool PoseEstimator::EstimatePosePinhole(
         theia::Feature(correspondences_undist[inlier].feature));
   }
 
-  // optimize pose
-  theia::BundleAdjustmentSummary summary =
-      theia::BundleAdjustView(ba_options_, view_id, &pose_dataset_);
-
-  return summary.success;
+  return true;
 }
 
 bool PoseEstimator::EstimatePosesFromJson(const nlohmann::json& scene_json,
@@ -112,77 +197,124 @@ bool PoseEstimator::EstimatePosesFromJson(const nlohmann::json& scene_json,
   double total_repro_error = 0.0;
   int processed_frames = 0;
 
+  // collect all detections
+  std::vector<BoardView> board_views;
+  board_views.reserve(views.size());
   for (const auto& view : views.items()) {
     const double timestamp_us = std::stod(view.key());
-    const double timestamp_s = timestamp_us * US_TO_S;  // to seconds
+    BoardView board_view;
+    board_view.timestamp_s = timestamp_us * US_TO_S;  // to seconds
     const auto image_points = view.value()["image_points"];
-    std::vector<int> board_pts3_ids;
-    aligned_vector<Eigen::Vector2d> corners;
-    std::vector<theia::FeatureCorrespondence2D3D> correspondences_undist;
+    if (image_points.size() < min_num_points_) {
+      LOG(INFO) << "Skipping view at timestamp : " << board_view.timestamp_s
+                << "s. Not enough points found.";
+      continue;
+    }
 
+    board_view.corners.resize(2, image_points.size());
+    board_view.correspondences_undist.resize(image_points.size());
+    int pt_idx = 0;
     for (const auto& img_pts : image_points.items()) {
       const int board_pt3_id = std::stoi(img_pts.key());
-      board_pts3_ids.push_back(std::stoi(img_pts.key()));
-      const Eigen::Vector2d corner(
-          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
-      corners.push_back(corner);
-      Eigen::Vector3d undist_pt = camera.PixelToNormalizedCoordinates(corner);
-      undist_pt /= undist_pt[2];
-
+      board_view.board_pts3_ids.push_back(board_pt3_id);
+      board_view.corners.col(pt_idx) =
+          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]);
       const Eigen::Vector4d track = pose_dataset_.Track(board_pt3_id)->Point();
+      board_view.correspondences_undist[pt_idx].world_point =
+          track.hnormalized();
+      ++pt_idx;
+    }
+    board_views.push_back(board_view);
+  }
 
-      theia::FeatureCorrespondence2D3D corr_undist;
-      corr_undist.world_point = track.hnormalized();
-      corr_undist.feature[0] = undist_pt[0];
-      corr_undist.feature[1] = undist_pt[1];
-      correspondences_undist.push_back(corr_undist);
+  // undistort all corners of all views with one lookup grid
+  const utils::UndistortionLookup undistortion_lookup(
+      camera, utils::UNDISTORTION_GRID_STEP_PX, num_threads_);
+  LOG(INFO) << "Undistortion lookup max. sampled error: "
+            << undistortion_lookup.MaxErrorPx() << "px. Using lookup: "
+            << undistortion_lookup.UsesLookup();
+  utils::ParallelFor(board_views.size(), num_threads_, [&](const size_t i) {
+    BoardView& board_view = board_views[i];
+    Eigen::Matrix2Xd undist_pts;
+    undistortion_lookup.Undistort(board_view.corners, undist_pts);
+    for (int j = 0; j < undist_pts.cols(); ++j) {
+      board_view.correspondences_undist[j].feature = undist_pts.col(j);
     }
-    if (correspondences_undist.size() < min_num_points_) {
-      LOG(INFO) << "Skipping view at timestamp : " << timestamp_s
-                << "s. Not enough points found.";
+  });
+
+  // The views are independent. Closed-form poses and their refinement run in
+  // parallel, the few views that need RANSAC are done afterwards as the
+  // theia RANSAC samplers share one random generator.
+  const auto estimate_pose = [&](BoardView& board_view, const bool use_ransac) {
+    board_view.success =
+        EstimatePlanarPose(board_view.correspondences_undist,
+                           use_ransac,
+                           board_view.pose,
+                           board_view.inliers) &&
+        utils::RefinePoseGaussNewton(board_view.correspondences_undist,
+                                     board_view.inliers,
+                                     ba_options_.robust_loss_width,
+                                     board_view.pose.rotation,
+                                     board_view.pose.position);
+  };
+  utils::ParallelFor(board_views.size(), num_threads_, [&](const size_t i) {
+    estimate_pose(board_views[i], false);
+  });
+  for (auto& board_view : board_views) {
+    if (!board_view.success) {
+      estimate_pose(board_view, true);
+    }
+  }
+
+  std::vector<theia::ViewId> added_view_ids;
+  for (const auto& board_view : board_views) {
+    const double timestamp_s = board_view.timestamp_s;
+    if (!board_view.success) {
+      LOG(INFO) << "Pose estimation failed for view at timestamp "
+                << timestamp_s << "s from "
+                << board_view.correspondences_undist.size()
+                << " points. Max reproj error was: "
+                << ransac_params_.error_thresh;
       continue;
     }
     std::string view_name = std::to_string((uint64_t)(timestamp_s * S_TO_US));
     theia::ViewId view_id = pose_dataset_.AddView(view_name, 0, timestamp_s);
 
-    theia::Camera* cam = pose_dataset_.MutableView(view_id)->MutableCamera();
+    theia::View* theia_view = pose_dataset_.MutableView(view_id);
+    theia_view->SetEstimated(true);
+    theia::Camera* cam = theia_view->MutableCamera();
     cam->SetCameraIntrinsicsModelType(
         theia::CameraIntrinsicsModelType::PINHOLE);
     cam->SetFocalLength(1.0);
     cam->SetPrincipalPoint(0.0, 0.0);
     cam->SetImageSize(1.0, 1.0);
-    if (!EstimatePosePinhole(view_id, correspondences_undist, board_pts3_ids)) {
-      LOG(INFO) << "Pose estimation failed for view at timestamp "
-                << timestamp_s << "s from " << correspondences_undist.size()
-                << " points. Max reproj error was: "
-                << ransac_params_.error_thresh;
-      pose_dataset_.RemoveView(view_id);
-      continue;
-    }
-    // test back projection
-    double reproj_error = 0;
-    for (size_t i = 0; i < pose_dataset_.View(view_id)->TrackIds().size();
-         ++i) {
-      theia::TrackId track_id = pose_dataset_.View(view_id)->TrackIds()[i];
-      tracks_to_nr_obs_[track_id] += 1;
-
-      const theia::Track* track = pose_dataset_.Track(track_id);
-      Eigen::Vector2d reproj_point;
-      pose_dataset_.View(view_id)->Camera().ProjectPoint(track->Point(),
-                                                         &reproj_point);
-
-      reproj_error +=
-          (reproj_point -
-           (*pose_dataset_.View(view_id)->GetFeature(track_id)).point_)
-              .norm();
+    cam->SetPosition(board_view.pose.position);
+    cam->SetOrientationFromRotationMatrix(board_view.pose.rotation);
+    for (const int inlier : board_view.inliers) {
+      pose_dataset_.AddObservation(
+          view_id,
+          board_view.board_pts3_ids[inlier],
+          theia::Feature(board_view.correspondences_undist[inlier].feature));
     }
-    const double repro_error_n =
-        reproj_error / pose_dataset_.View(view_id)->TrackIds().size();
+    added_view_ids.push_back(view_id);
+  }
+
+  // test back projection of all views in one batch
+  const std::vector<utils::ViewStatistics> view_stats =
+      utils::ComputeViewStatistics(pose_dataset_, added_view_ids, num_threads_);
+  for (size_t i = 0; i < added_view_ids.size(); ++i) {
+    const theia::ViewId view_id = added_view_ids[i];
+    const double repro_error_n = view_stats[i].mean_error;
     if (repro_error_n > max_reproj_error) {
       LOG(INFO) << "Removing view " << view_id
                 << " due to large reprojection error: " << repro_error_n
                 << "px > " << max_reproj_error << " px\n";
       pose_dataset_.RemoveView(view_id);
+    } else {
+      for (const theia::TrackId track_id :
+           pose_dataset_.View(view_id)->TrackIds()) {
+        tracks_to_nr_obs_[track_id] += 1;
+      }
     }
     total_repro_error += repro_error_n;
     ++processed_frames;
@@ -224,14 +356,12 @@ void PoseEstimator::OptimizeBoardPoints() {
 }
 
 void PoseEstimator::OptimizeAllPoses() {
-  ba_options_.constant_camera_orientation = false;
-  ba_options_.constant_camera_position = false;
-  ba_options_.verbose = false;
   LOG(INFO) << "Optimizing all estimated poses.";
-  for (auto vid : pose_dataset_.ViewIds()) {
-    theia::BundleAdjustView(
-        ba_options_, vid, &pose_dataset_);
-  }
+  // every view only depends on its own pose and the fixed board points
+  const std::vector<theia::ViewId> view_ids = pose_dataset_.ViewIds();
+  utils::ParallelFor(view_ids.size(), num_threads_, [&](const size_t i) {
+    RefineViewPose(view_ids[i]);
+  });
   LOG(INFO) << "Finished optimizing camera poses.";
 }
 
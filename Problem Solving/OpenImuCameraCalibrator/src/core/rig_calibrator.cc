@@ -0,0 +1,591 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/core/rig_calibrator.h"
+
+#include <ceres/ceres.h>
+#include <theia/sfm/bundle_adjustment/bundle_adjustment.h>
+#include <theia/sfm/bundle_adjustment/create_loss_function.h>
+// camera types
+#include <theia/sfm/camera/division_undistortion_camera_model.h>
+#include <theia/sfm/camera/double_sphere_camera_model.h>
+#include <theia/sfm/camera/extended_unified_camera_model.h>
+#include <theia/sfm/camera/fisheye_camera_model.h>
+#include <theia/sfm/camera/pinhole_camera_model.h>
+#include <theia/sfm/camera/pinhole_radial_tangential_camera_model.h>
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "OpenCameraCalibrator/core/calibration_residuals.h"
+#include "OpenCameraCalibrator/core/camera_calibrator.h"
+#include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/io/write_camera_calibration.h"
+#include "OpenCameraCalibrator/io/write_rig_calibration.h"
+#include "OpenCameraCalibrator/utils/planar_initializer.h"
+#include "OpenCameraCalibrator/utils/pose_refinement.h"
+#include "OpenCameraCalibrator/utils/undistortion_lookup.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+// minimum number of board corners of a detection
+const size_t MIN_NUM_BOARD_POINTS = 8;
+
+// squared pose inlier threshold in pixel^2 as fraction of the image height
+// (as for the intrinsics initialization)
+const double POSE_ERROR_THRESH_IMAGE_FRACTION = 0.003;
+
+const double HUBER_LOSS_WIDTH_PX = 1.345;
+
+template <class CameraModel>
+ceres::CostFunction* CreateRigCostFunction(const Eigen::Vector2d& feature,
+                                           const Eigen::Vector3d& point) {
+  return new ceres::AutoDiffCostFunction<RigReprojectionError<CameraModel>,
+                                         2,
+                                         theia::Camera::kExtrinsicsSize,
+                                         theia::Camera::kExtrinsicsSize,
+                                         CameraModel::kIntrinsicsSize>(
+      new RigReprojectionError<CameraModel>(feature, point));
+}
+
+ceres::CostFunction* CreateRigReprojectionCostFunction(
+    const theia::CameraIntrinsicsModelType& cam_model,
+    const Eigen::Vector2d& feature,
+    const Eigen::Vector3d& point) {
+  switch (cam_model) {
+    case theia::CameraIntrinsicsModelType::PINHOLE:
+      return CreateRigCostFunction<theia::PinholeCameraModel>(feature, point);
+    case theia::CameraIntrinsicsModelType::DIVISION_UNDISTORTION:
+      return CreateRigCostFunction<theia::DivisionUndistortionCameraModel>(
+          feature, point);
+    case theia::CameraIntrinsicsModelType::DOUBLE_SPHERE:
+      return CreateRigCostFunction<theia::DoubleSphereCameraModel>(feature,
+                                                                   point);
+    case theia::CameraIntrinsicsModelType::EXTENDED_UNIFIED:
+      return CreateRigCostFunction<theia::ExtendedUnifiedCameraModel>(feature,
+                                                                      point);
+    case theia::CameraIntrinsicsModelType::FISHEYE:
+      return CreateRigCostFunction<theia::FisheyeCameraModel>(feature, point);
+    case theia::CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL:
+      return CreateRigCostFunction<theia::PinholeRadialTangentialCameraModel>(
+          feature, point);
+    default:
+      LOG(FATAL) << "Camera model type not supported for calibration.";
+      return nullptr;
+  }
+}
+
+Eigen::Matrix<double, 6, 1> ToExtrinsics(const Eigen::Matrix3d& rotation,
+                                         const Eigen::Vector3d& position) {
+  Eigen::Matrix<double, 6, 1> extrinsics;
+  const Eigen::AngleAxisd angle_axis(rotation);
+  extrinsics.segment<3>(theia::Camera::POSITION) = position;
+  extrinsics.segment<3>(theia::Camera::ORIENTATION) =
+      angle_axis.angle() * angle_axis.axis();
+  return extrinsics;
+}
+
+void FromExtrinsics(const Eigen::Matrix<double, 6, 1>& extrinsics,
+                    Eigen::Matrix3d& rotation,
+                    Eigen::Vector3d& position) {
+  const Eigen::Vector3d angle_axis =
+      extrinsics.segment<3>(theia::Camera::ORIENTATION);
+  const double angle = angle_axis.norm();
+  rotation = angle < 1e-12
+                 ? Eigen::Matrix3d::Identity()
+                 : Eigen::AngleAxisd(angle, angle_axis / angle)
+                       .toRotationMatrix();
+  position = extrinsics.segment<3>(theia::Camera::POSITION);
+}
+
+// closest rotation to the sum of rotations (chordal L2 mean)
+Eigen::Matrix3d ProjectToRotation(const Eigen::Matrix3d& M) {
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(
+      M, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Matrix3d U = svd.matrixU();
+  if ((U * svd.matrixV().transpose()).determinant() < 0.0) {
+    U.col(2) *= -1.0;
+  }
+  return U * svd.matrixV().transpose();
+}
+
+std::string CameraOutputPath(const std::string& output_path,
+                             const size_t camera) {
+  if (output_path == "") {
+    return "";
+  }
+  return output_path + "_cam" + std::to_string(camera);
+}
+
+}  // namespace
+
+RigCalibrator::RigCalibrator(const std::string& camera_model,
+                             const bool optimize_board_pts)
+    : camera_model_(camera_model), optimize_board_pts_(optimize_board_pts) {}
+
+bool RigCalibrator::CalibrateCameras(
+    const std::vector<nlohmann::json>& scene_jsons,
+    const std::string& output_path) {
+  const size_t nr_cameras = scene_jsons.size();
+  cameras_.resize(nr_cameras);
+  std::vector<char> success(nr_cameras, 0);
+  // the cameras are independent, each calibrator uses its own ceres problem
+  utils::ParallelFor(nr_cameras, nr_cameras, [&](const size_t i) {
+    CameraCalibrator calibrator(camera_model_, optimize_board_pts_);
+    calibrator.SetGridSize(grid_size_);
+    if (verbose_) {
+      calibrator.SetVerbose();
+    }
+    success[i] = calibrator.CalibrateCameraFromJson(
+                     scene_jsons[i], CameraOutputPath(output_path, i)) &&
+                 calibrator.GetCalibratedCamera(cameras_[i]);
+  });
+  for (size_t i = 0; i < nr_cameras; ++i) {
+    if (!success[i]) {
+      LOG(ERROR) << "Intrinsic calibration of camera " << i << " failed.";
+      return false;
+    }
+  }
+  return true;
+}
+
+void RigCalibrator::EstimateBoardPoses(
+    const std::vector<nlohmann::json>& scene_jsons) {
+  const int num_threads = std::max(1u, std::thread::hardware_concurrency());
+  observations_.assign(scene_jsons.size(), {});
+  for (size_t c = 0; c < scene_jsons.size(); ++c) {
+    for (const auto& view : scene_jsons[c]["views"].items()) {
+      const auto image_points = view.value()["image_points"];
+      if (image_points.size() < MIN_NUM_BOARD_POINTS) {
+        continue;
+      }
+      BoardObservation obs;
+      obs.timestamp_s = std::stod(view.key()) * US_TO_S;
+      obs.corners.resize(2, image_points.size());
+      int pt_idx = 0;
+      for (const auto& img_pts : image_points.items()) {
+        obs.board_pt3_ids.push_back(std::stoi(img_pts.key()));
+        obs.corners.col(pt_idx++) =
+            Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]);
+      }
+      observations_[c].push_back(obs);
+    }
+  }
+
+  // closed-form pose and Gauss-Newton refinement for all detections of all
+  // cameras; views without a clean homography are simply dropped, there are
+  // plenty of frames and RANSAC would serialize on theia's random generator
+  for (size_t c = 0; c < cameras_.size(); ++c) {
+    const theia::Camera& camera = cameras_[c];
+    const utils::UndistortionLookup undistortion_lookup(
+        camera, utils::UNDISTORTION_GRID_STEP_PX, num_threads);
+    // squared error in normalized image coordinates
+    const double focal_length = camera.FocalLength();
+    const double error_thresh = POSE_ERROR_THRESH_IMAGE_FRACTION *
+                                camera.ImageHeight() /
+                                (focal_length * focal_length);
+    const double loss_width = HUBER_LOSS_WIDTH_PX / camera.FocalLength();
+    auto& cam_observations = observations_[c];
+    utils::ParallelFor(
+        cam_observations.size(), num_threads, [&](const size_t i) {
+          BoardObservation& obs = cam_observations[i];
+          Eigen::Matrix2Xd normalized;
+          undistortion_lookup.Undistort(obs.corners, normalized);
+          std::vector<theia::FeatureCorrespondence2D3D> correspondences;
+          for (size_t k = 0; k < obs.board_pt3_ids.size(); ++k) {
+            const theia::Track* track = board_.Track(obs.board_pt3_ids[k]);
+            if (track == nullptr) {
+              continue;
+            }
+            theia::FeatureCorrespondence2D3D corr;
+            corr.feature = normalized.col(k);
+            corr.world_point = track->Point().hnormalized();
+            correspondences.push_back(corr);
+          }
+          theia::RansacSummary summary;
+          obs.success =
+              utils::EstimatePlanarCalibratedPose(correspondences,
+                                                  error_thresh,
+                                                  obs.rotation,
+                                                  obs.position,
+                                                  summary) &&
+              summary.inliers.size() >= MIN_NUM_BOARD_POINTS &&
+              utils::RefinePoseGaussNewton(correspondences,
+                                           summary.inliers,
+                                           loss_width,
+                                           obs.rotation,
+                                           obs.position);
+        });
+  }
+}
+
+void RigCalibrator::GroupSynchronizedFrames() {
+  struct Detection {
+    double timestamp_s;
+    int camera;
+    size_t index;
+  };
+  std::vector<Detection> detections;
+  for (size_t c = 0; c < observations_.size(); ++c) {
+    for (size_t i = 0; i < observations_[c].size(); ++i) {
+      if (observations_[c][i].success) {
+        detections.push_back({observations_[c][i].timestamp_s,
+                              static_cast<int>(c),
+                              i});
+      }
+    }
+  }
+  std::sort(detections.begin(),
+            detections.end(),
+            [](const Detection& a, const Detection& b) {
+              return a.timestamp_s < b.timestamp_s;
+            });
+
+  frames_.clear();
+  double frame_start_s = 0.0;
+  for (const auto& det : detections) {
+    if (frames_.empty() ||
+        det.timestamp_s - frame_start_s > sync_tolerance_s_ ||
+        frames_.back().count(det.camera)) {
+      frames_.push_back({});
+      frame_start_s = det.timestamp_s;
+    }
+    frames_.back()[det.camera] = det.index;
+  }
+  // only frames seen by several cameras constrain the rig
+  frames_.erase(std::remove_if(frames_.begin(),
+                               frames_.end(),
+                               [](const std::map<int, size_t>& frame) {
+                                 return frame.size() < 2;
+                               }),
+                frames_.end());
+  std::cout << "Found " << frames_.size()
+            << " frames observed by at least two cameras.\n";
+}
+
+bool RigCalibrator::InitializeRigExtrinsics() {
+  const size_t nr_cameras = cameras_.size();
+  std::vector<Eigen::Matrix3d> rotations_cam_ref(nr_cameras,
+                                                 Eigen::Matrix3d::Identity());
+  std::vector<Eigen::Vector3d> positions_in_ref(nr_cameras,
+                                                Eigen::Vector3d::Zero());
+  std::vector<char> initialized(nr_cameras, 0);
+  initialized[0] = 1;
+
+  // cameras without overlap to the reference camera are chained over
+  // already initialized cameras
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (size_t i = 1; i < nr_cameras; ++i) {
+      if (initialized[i]) {
+        continue;
+      }
+      for (size_t j = 0; j < nr_cameras && !initialized[i]; ++j) {
+        if (!initialized[j]) {
+          continue;
+        }
+        // pose of camera i in camera j averaged over all shared frames
+        Eigen::Matrix3d rotation_sum = Eigen::Matrix3d::Zero();
+        Eigen::Vector3d position_sum = Eigen::Vector3d::Zero();
+        int nr_shared = 0;
+        for (const auto& frame : frames_) {
+          const auto it_i = frame.find(i);
+          const auto it_j = frame.find(j);
+          if (it_i == frame.end() || it_j == frame.end()) {
+            continue;
+          }
+          const BoardObservation& obs_i = observations_[i][it_i->second];
+          const BoardObservation& obs_j = observations_[j][it_j->second];
+          rotation_sum += obs_i.rotation * obs_j.rotation.transpose();
+          position_sum += obs_j.rotation * (obs_i.position - obs_j.position);
+          ++nr_shared;
+        }
+        if (nr_shared < min_num_shared_frames_) {
+          continue;
+        }
+        const Eigen::Matrix3d rotation_i_j = ProjectToRotation(rotation_sum);
+        const Eigen::Vector3d position_i_in_j = position_sum / nr_shared;
+        rotations_cam_ref[i] = rotation_i_j * rotations_cam_ref[j];
+        positions_in_ref[i] = positions_in_ref[j] +
+                              rotations_cam_ref[j].transpose() * position_i_in_j;
+        initialized[i] = 1;
+        progress = true;
+        LOG(INFO) << "Initialized camera " << i << " from camera " << j
+                  << " with " << nr_shared << " shared frames.";
+      }
+    }
+  }
+
+  rig_extrinsics_.resize(nr_cameras);
+  for (size_t i = 0; i < nr_cameras; ++i) {
+    if (!initialized[i]) {
+      LOG(ERROR) << "Camera " << i << " shares less than "
+                 << min_num_shared_frames_
+                 << " frames with the other cameras of the rig.";
+      return false;
+    }
+    rig_extrinsics_[i] =
+        ToExtrinsics(rotations_cam_ref[i], positions_in_ref[i]);
+  }
+  return true;
+}
+
+void RigCalibrator::InitializeFramePoses() {
+  std::vector<std::map<int, size_t>> selected_frames;
+  vec3_vector saved_positions;
+  frame_extrinsics_.clear();
+  for (const auto& frame : frames_) {
+    // board pose in the reference camera from the first camera of the frame
+    const int cam = frame.begin()->first;
+    const BoardObservation& obs = observations_[cam][frame.begin()->second];
+    Eigen::Matrix3d rotation_cam_ref;
+    Eigen::Vector3d position_in_ref;
+    FromExtrinsics(rig_extrinsics_[cam], rotation_cam_ref, position_in_ref);
+    const Eigen::Matrix3d rotation = rotation_cam_ref.transpose() * obs.rotation;
+    const Eigen::Vector3d position =
+        obs.position - rotation.transpose() * position_in_ref;
+
+    // check if a very close by frame is already present
+    bool take_frame = true;
+    for (const auto& saved_position : saved_positions) {
+      if ((position - saved_position).norm() < grid_size_) {
+        take_frame = false;
+        break;
+      }
+    }
+    if (!take_frame) {
+      continue;
+    }
+    saved_positions.push_back(position);
+    selected_frames.push_back(frame);
+    frame_extrinsics_.push_back(ToExtrinsics(rotation, position));
+  }
+  frames_ = selected_frames;
+  std::cout << "Using " << frames_.size() << " frames for rig calibration.\n";
+}
+
+double RigCalibrator::OptimizeRig() {
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  std::unique_ptr<ceres::LossFunction> loss_function =
+      theia::CreateLossFunction(theia::LossFunctionType::HUBER,
+                                HUBER_LOSS_WIDTH_PX);
+
+  // frame poses are eliminated first, the reduced camera system only holds
+  // the rig extrinsics and intrinsics
+  ceres::ParameterBlockOrdering* ordering = new ceres::ParameterBlockOrdering;
+  for (size_t f = 0; f < frames_.size(); ++f) {
+    double* frame_extrinsics = frame_extrinsics_[f].data();
+    for (const auto& cam_obs : frames_[f]) {
+      const int cam = cam_obs.first;
+      const BoardObservation& obs = observations_[cam][cam_obs.second];
+      for (size_t k = 0; k < obs.board_pt3_ids.size(); ++k) {
+        const theia::Track* track = board_.Track(obs.board_pt3_ids[k]);
+        if (track == nullptr) {
+          continue;
+        }
+        problem.AddResidualBlock(
+            CreateRigReprojectionCostFunction(
+                cameras_[cam].GetCameraIntrinsicsModelType(),
+                obs.corners.col(k),
+                track->Point().hnormalized()),
+            loss_function.get(),
+            frame_extrinsics,
+            rig_extrinsics_[cam].data(),
+            cameras_[cam].mutable_intrinsics());
+      }
+    }
+    ordering->AddElementToGroup(frame_extrinsics, 0);
+  }
+
+  theia::OptimizeIntrinsicsType intrinsics_to_optimize =
+      theia::OptimizeIntrinsicsType::PRINCIPAL_POINTS |
+      theia::OptimizeIntrinsicsType::FOCAL_LENGTH |
+      theia::OptimizeIntrinsicsType::ASPECT_RATIO |
+      theia::OptimizeIntrinsicsType::RADIAL_DISTORTION;
+  if (camera_model_ == "PINHOLE_RADIAL_TANGENTIAL") {
+    intrinsics_to_optimize |=
+        theia::OptimizeIntrinsicsType::TANGENTIAL_DISTORTION;
+  }
+  for (size_t c = 0; c < cameras_.size(); ++c) {
+    double* rig_extrinsics = rig_extrinsics_[c].data();
+    double* intrinsics = cameras_[c].mutable_intrinsics();
+    ordering->AddElementToGroup(rig_extrinsics, 1);
+    ordering->AddElementToGroup(intrinsics, 1);
+    const auto intrinsics_model = cameras_[c].CameraIntrinsics();
+    const std::vector<int> constant_intrinsics =
+        intrinsics_model->GetSubsetFromOptimizeIntrinsicsType(
+            intrinsics_to_optimize);
+    if (!constant_intrinsics.empty()) {
+      problem.SetParameterization(
+          intrinsics,
+          new ceres::SubsetParameterization(intrinsics_model->NumParameters(),
+                                            constant_intrinsics));
+    }
+  }
+  // the reference camera defines the rig frame
+  problem.SetParameterBlockConstant(rig_extrinsics_[0].data());
+
+  ceres::Solver::Options solver_options;
+  solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  solver_options.linear_solver_ordering.reset(ordering);
+  solver_options.num_threads = std::thread::hardware_concurrency();
+  solver_options.max_num_iterations = 100;
+  solver_options.minimizer_progress_to_stdout = verbose_;
+  solver_options.logging_type =
+      verbose_ ? ceres::PER_MINIMIZER_ITERATION : ceres::SILENT;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, &problem, &summary);
+  if (verbose_) {
+    LOG(INFO) << summary.FullReport();
+  }
+
+  // mean reprojection error without the robust loss
+  double reproj_error = 0.0;
+  int nr_obs = 0;
+  for (size_t f = 0; f < frames_.size(); ++f) {
+    Eigen::Matrix3d frame_rotation;
+    Eigen::Vector3d frame_position;
+    FromExtrinsics(frame_extrinsics_[f], frame_rotation, frame_position);
+    for (const auto& cam_obs : frames_[f]) {
+      const int cam = cam_obs.first;
+      const BoardObservation& obs = observations_[cam][cam_obs.second];
+      Eigen::Matrix3d rotation_cam_ref;
+      Eigen::Vector3d position_in_ref;
+      FromExtrinsics(rig_extrinsics_[cam], rotation_cam_ref, position_in_ref);
+      theia::Camera camera = cameras_[cam];
+      camera.SetOrientationFromRotationMatrix(rotation_cam_ref *
+                                              frame_rotation);
+      camera.SetPosition(frame_position +
+                         frame_rotation.transpose() * position_in_ref);
+      for (size_t k = 0; k < obs.board_pt3_ids.size(); ++k) {
+        const theia::Track* track = board_.Track(obs.board_pt3_ids[k]);
+        Eigen::Vector2d reprojection;
+        if (track == nullptr ||
+            camera.ProjectPoint(track->Point(), &reprojection) < 0.0) {
+          continue;
+        }
+        reproj_error += (reprojection - obs.corners.col(k)).norm();
+        ++nr_obs;
+      }
+    }
+  }
+  return nr_obs > 0 ? reproj_error / nr_obs : 0.0;
+}
+
+bool RigCalibrator::WriteRigCalibration(
+    const std::string& output_path,
+    const std::vector<nlohmann::json>& scene_jsons,
+    const double total_reproj_error) {
+  std::vector<std::string> camera_calib_files;
+  quat_vector rotations_cam_ref;
+  vec3_vector positions_in_ref;
+  for (size_t c = 0; c < cameras_.size(); ++c) {
+    int nr_frames = 0;
+    for (const auto& frame : frames_) {
+      nr_frames += frame.count(c);
+    }
+    // intrinsics refined by the joint adjustment
+    const std::string calib_file = CameraOutputPath(output_path, c) + ".json";
+    if (!io::write_camera_calibration(calib_file,
+                                      cameras_[c],
+                                      scene_jsons[c]["camera_fps"],
+                                      nr_frames,
+                                      total_reproj_error)) {
+      return false;
+    }
+    camera_calib_files.push_back(calib_file);
+
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d position;
+    FromExtrinsics(rig_extrinsics_[c], rotation, position);
+    rotations_cam_ref.push_back(Eigen::Quaterniond(rotation));
+    positions_in_ref.push_back(position);
+  }
+  return io::write_rig_calibration(output_path + "_rig.json",
+                                   camera_calib_files,
+                                   rotations_cam_ref,
+                                   positions_in_ref,
+                                   frames_.size(),
+                                   total_reproj_error);
+}
+
+bool RigCalibrator::CalibrateRigFromJsons(
+    const std::vector<nlohmann::json>& scene_jsons,
+    const std::string& output_path) {
+  if (scene_jsons.size() < 2) {
+    LOG(ERROR) << "A rig needs at least two cameras.";
+    return false;
+  }
+  io::scene_points_to_calib_dataset(scene_jsons[0], board_);
+
+  LOG(INFO) << "Calibrating intrinsics of " << scene_jsons.size()
+            << " cameras.";
+  if (!CalibrateCameras(scene_jsons, output_path)) {
+    return false;
+  }
+
+  LOG(INFO) << "Estimating board poses of all cameras.";
+  EstimateBoardPoses(scene_jsons);
+  GroupSynchronizedFrames();
+  if (!InitializeRigExtrinsics()) {
+    return false;
+  }
+  InitializeFramePoses();
+
+  LOG(INFO) << "Joint optimization of the rig.";
+  const double total_reproj_error = OptimizeRig();
+  std::cout << "Final rig calibration reprojection error: "
+            << total_reproj_error << "px from " << frames_.size()
+            << " frames." << std::endl;
+
+  if (output_path != "" &&
+      !WriteRigCalibration(output_path, scene_jsons, total_reproj_error)) {
+    LOG(ERROR) << "Could not write rig calibration.";
+    return false;
+  }
+  return true;
+}
+
+void RigCalibrator::PrintResult() const {
+  for (size_t c = 0; c < cameras_.size(); ++c) {
+    std::cout << "Camera " << c << ": Focal Length: "
+              << cameras_[c].FocalLength()
+              << "px Principal Point: " << cameras_[c].PrincipalPointX()
+              << "/" << cameras_[c].PrincipalPointY() << "px.\n";
+    if (c < rig_extrinsics_.size()) {
+      Eigen::Matrix3d rotation;
+      Eigen::Vector3d position;
+      FromExtrinsics(rig_extrinsics_[c], rotation, position);
+      std::cout << "  Position in reference camera: "
+                << position.transpose() << " Rotation reference to camera:\n"
+                << rotation << "\n";
+    }
+  }
+}
+
+}  // namespace core
+}  // namespace OpenICC
@@ -0,0 +1,124 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "OpenCameraCalibrator/io/calibration_state.h"
+#include "OpenCameraCalibrator/utils/json.h"
+
+using nlohmann::json;
+
+namespace OpenICC {
+namespace io {
+
+bool write_calibration_state(const std::string& output_file,
+                             const theia::Camera& camera,
+                             const Eigen::MatrixXd& information,
+                             const int nr_calib_images,
+                             const double total_reproj_error,
+                             const vec3_vector& view_positions) {
+  std::ofstream json_file(output_file);
+  if (!json_file.is_open()) {
+    std::cerr << "Could not open: " << output_file << "\n";
+    return false;
+  }
+  const int nr_params = camera.CameraIntrinsics()->NumParameters();
+  if (information.rows() != nr_params || information.cols() != nr_params) {
+    std::cerr << "Information matrix does not match the intrinsics.\n";
+    return false;
+  }
+
+  json json_obj;
+  json_obj["intrinsic_type"] = theia::CameraIntrinsicsModelTypeToString(
+      camera.GetCameraIntrinsicsModelType());
+  json_obj["image_width"] = camera.ImageWidth();
+  json_obj["image_height"] = camera.ImageHeight();
+  json_obj["nr_calib_images"] = nr_calib_images;
+  json_obj["final_reproj_error"] = total_reproj_error;
+  // raw theia parameters, independent of the camera model
+  json_obj["intrinsics"] = std::vector<double>(
+      camera.intrinsics(), camera.intrinsics() + nr_params);
+  // row major
+  std::vector<double> info_values;
+  for (int r = 0; r < nr_params; ++r) {
+    for (int c = 0; c < nr_params; ++c) {
+      info_values.push_back(information(r, c));
+    }
+  }
+  json_obj["information"] = info_values;
+  json_obj["view_positions"] = json::array();
+  for (const auto& position : view_positions) {
+    json_obj["view_positions"].push_back(
+        {position[0], position[1], position[2]});
+  }
+
+  json_file << std::setw(2) << json_obj << std::endl;
+  json_file.close();
+  return true;
+}
+
+bool read_calibration_state(const std::string& input_file,
+                            theia::Camera& camera,
+                            Eigen::MatrixXd& information,
+                            int& nr_calib_images,
+                            double& total_reproj_error,
+                            vec3_vector& view_positions) {
+  std::ifstream input(input_file);
+  if (!input.is_open()) {
+    std::cerr << "Could not open: " << input_file << "\n";
+    return false;
+  }
+  json json_content;
+  input >> json_content;
+
+  const std::string camera_model_type = json_content["intrinsic_type"];
+  camera.SetCameraIntrinsicsModelType(
+      theia::StringToCameraIntrinsicsModelType(camera_model_type));
+  camera.SetImageSize(json_content["image_width"],
+                      json_content["image_height"]);
+
+  const int nr_params = camera.CameraIntrinsics()->NumParameters();
+  const std::vector<double> intrinsics = json_content["intrinsics"];
+  const std::vector<double> info_values = json_content["information"];
+  if (intrinsics.size() != static_cast<size_t>(nr_params) ||
+      info_values.size() != static_cast<size_t>(nr_params * nr_params)) {
+    std::cerr << "Calibration state does not match the camera model "
+              << camera_model_type << "\n";
+    return false;
+  }
+  std::copy(intrinsics.begin(), intrinsics.end(), camera.mutable_intrinsics());
+  information.resize(nr_params, nr_params);
+  for (int r = 0; r < nr_params; ++r) {
+    for (int c = 0; c < nr_params; ++c) {
+      information(r, c) = info_values[r * nr_params + c];
+    }
+  }
+
+  nr_calib_images = json_content["nr_calib_images"];
+  total_reproj_error = json_content["final_reproj_error"];
+  view_positions.clear();
+  for (const auto& position : json_content["view_positions"]) {
+    view_positions.push_back(
+        Eigen::Vector3d(position[0], position[1], position[2]));
+  }
+  input.close();
+  return true;
+}
+
+}  // namespace io
+}  // namespace OpenICC
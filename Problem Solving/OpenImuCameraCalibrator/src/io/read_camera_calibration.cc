@@ -16,9 +16,11 @@
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <vector>
 
 #include "OpenCameraCalibrator/io/read_camera_calibration.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
 
 #include "theia/sfm/camera/division_undistortion_camera_model.h"
 #include "theia/sfm/camera/double_sphere_camera_model.h"
@@ -45,6 +47,21 @@ bool read_camera_calibration(const std::string& input_json,
 
   std::string camera_model_type = json_content["intrinsic_type"];
 
+  // [fx, fy, cx, cy, k1, k2, k3, k4] calibrations of other tools
+  if (camera_model_type == utils::KB4_CAMERA_MODEL) {
+    const std::vector<double> kb4 = json_content["intrinsics"]["kb4"];
+    if (kb4.size() != 8) {
+      std::cerr << "KB4 calibration needs 8 parameters.\n";
+      return false;
+    }
+    utils::SetKB4Parameters(Eigen::Map<const utils::KB4Parameters>(kb4.data()),
+                            camera);
+    camera.SetImageSize(json_content["image_width"],
+                        json_content["image_height"]);
+    fps = json_content["fps"];
+    return true;
+  }
+
   camera.SetCameraIntrinsicsModelType(
       theia::StringToCameraIntrinsicsModelType(camera_model_type));
 
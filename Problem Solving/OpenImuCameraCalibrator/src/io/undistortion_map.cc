@@ -0,0 +1,112 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "OpenCameraCalibrator/io/binary_io.h"
+#include "OpenCameraCalibrator/io/undistortion_map.h"
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+const char UNDISTORTION_MAP_MAGIC[8] = "OICCMAP";
+
+const uint32_t UNDISTORTION_MAP_VERSION = 1;
+
+// the tables start 64 byte aligned after the header
+const size_t UNDISTORTION_MAP_HEADER_PADDING = 8;
+
+}  // namespace
+
+bool write_undistortion_map(const std::string& output_file,
+                            const utils::UndistortionMap& map) {
+  const size_t nr_pixels = static_cast<size_t>(map.width) * map.height;
+  if (map.map_xy.size() != 2 * nr_pixels ||
+      map.map_interp.size() != nr_pixels) {
+    std::cerr << "Undistortion map does not match its size.\n";
+    return false;
+  }
+  std::ofstream map_file(output_file, std::ios::binary);
+  if (!map_file.is_open()) {
+    std::cerr << "Could not open: " << output_file << "\n";
+    return false;
+  }
+  // field by field, the file is little endian on every host
+  map_file.write(UNDISTORTION_MAP_MAGIC, sizeof(UNDISTORTION_MAP_MAGIC));
+  WriteLittleEndianValue<uint32_t>(map_file, UNDISTORTION_MAP_VERSION);
+  WriteLittleEndianValue<uint32_t>(map_file, map.width);
+  WriteLittleEndianValue<uint32_t>(map_file, map.height);
+  WriteLittleEndianValue<uint32_t>(map_file, map.source_width);
+  WriteLittleEndianValue<uint32_t>(map_file, map.source_height);
+  WriteLittleEndianValue<uint32_t>(map_file,
+                                   utils::UNDISTORTION_MAP_INTER_BITS);
+  WriteLittleEndianValue<double>(map_file, map.focal_length);
+  WriteLittleEndianValue<double>(map_file, map.principal_point_x);
+  WriteLittleEndianValue<double>(map_file, map.principal_point_y);
+  const char padding[UNDISTORTION_MAP_HEADER_PADDING] = {};
+  map_file.write(padding, sizeof(padding));
+
+  WriteLittleEndian(map_file, map.map_xy.data(), map.map_xy.size());
+  WriteLittleEndian(map_file, map.map_interp.data(), map.map_interp.size());
+  return map_file.good();
+}
+
+bool read_undistortion_map(const std::string& input_file,
+                           utils::UndistortionMap& map) {
+  std::ifstream map_file(input_file, std::ios::binary);
+  if (!map_file.is_open()) {
+    std::cerr << "Could not open: " << input_file << "\n";
+    return false;
+  }
+  char magic[sizeof(UNDISTORTION_MAP_MAGIC)];
+  uint32_t version = 0, inter_bits = 0;
+  uint32_t width = 0, height = 0, source_width = 0, source_height = 0;
+  map_file.read(magic, sizeof(magic));
+  ReadLittleEndianValue(map_file, version);
+  ReadLittleEndianValue(map_file, width);
+  ReadLittleEndianValue(map_file, height);
+  ReadLittleEndianValue(map_file, source_width);
+  ReadLittleEndianValue(map_file, source_height);
+  ReadLittleEndianValue(map_file, inter_bits);
+  ReadLittleEndianValue(map_file, map.focal_length);
+  ReadLittleEndianValue(map_file, map.principal_point_x);
+  ReadLittleEndianValue(map_file, map.principal_point_y);
+  map_file.ignore(UNDISTORTION_MAP_HEADER_PADDING);
+  if (!map_file.good() ||
+      std::memcmp(magic, UNDISTORTION_MAP_MAGIC, sizeof(magic)) != 0 ||
+      version != UNDISTORTION_MAP_VERSION ||
+      inter_bits != utils::UNDISTORTION_MAP_INTER_BITS) {
+    std::cerr << "Not a supported undistortion map: " << input_file << "\n";
+    return false;
+  }
+  map.width = width;
+  map.height = height;
+  map.source_width = source_width;
+  map.source_height = source_height;
+
+  const size_t nr_pixels = static_cast<size_t>(map.width) * map.height;
+  map.map_xy.resize(2 * nr_pixels);
+  map.map_interp.resize(nr_pixels);
+  ReadLittleEndian(map_file, map.map_xy.data(), map.map_xy.size());
+  ReadLittleEndian(map_file, map.map_interp.data(), map.map_interp.size());
+  return map_file.good();
+}
+
+}  // namespace io
+}  // namespace OpenICC
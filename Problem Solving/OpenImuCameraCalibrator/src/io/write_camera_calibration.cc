@@ -13,12 +13,16 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <vector>
 
 #include "OpenCameraCalibrator/io/write_camera_calibration.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
 #include "theia/sfm/camera/division_undistortion_camera_model.h"
@@ -35,7 +39,8 @@ bool write_camera_calibration(const std::string& output_file,
                               const theia::Camera& camera,
                               const double fps,
                               const int nr_calib_images,
-                              const double total_reproj_error) {
+                              const double total_reproj_error,
+                              const Eigen::MatrixXd& intrinsics_covariance) {
   std::ofstream json_file(output_file);
   if (!json_file.is_open()) {
     std::cerr << "Could not open: " << output_file << "\n";
@@ -105,6 +110,12 @@ bool write_camera_calibration(const std::string& output_file,
     json_obj["intrinsics"]["radial_distortion_4"] = intrinsics->GetParameter(
         theia::FisheyeCameraModel::InternalParametersIndex::
             RADIAL_DISTORTION_4);
+    if (utils::IsKB4Camera(camera)) {
+      // [fx, fy, cx, cy, k1, k2, k3, k4] as used by our fisheye tooling
+      const utils::KB4Parameters kb4 = utils::KB4ParametersFromCamera(camera);
+      json_obj["intrinsics"]["kb4"] =
+          std::vector<double>(kb4.data(), kb4.data() + kb4.size());
+    }
   } else if (camera.GetCameraIntrinsicsModelType() ==
              theia::CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL) {
     json_obj["intrinsics"]["aspect_ratio"] = intrinsics->GetParameter(
@@ -132,6 +143,19 @@ bool write_camera_calibration(const std::string& output_file,
 
   json_obj["intrinsics"]["focal_length"] = camera.FocalLength();
 
+  if (intrinsics_covariance.size() > 0) {
+    std::vector<std::vector<double>> covariance(intrinsics_covariance.rows());
+    std::vector<double> std_dev(intrinsics_covariance.rows());
+    for (int r = 0; r < intrinsics_covariance.rows(); ++r) {
+      for (int c = 0; c < intrinsics_covariance.cols(); ++c) {
+        covariance[r].push_back(intrinsics_covariance(r, c));
+      }
+      std_dev[r] = std::sqrt(std::max(intrinsics_covariance(r, r), 0.0));
+    }
+    json_obj["intrinsics_covariance"] = covariance;
+    json_obj["intrinsics_std_dev"] = std_dev;
+  }
+
   json_file << std::setw(2) << json_obj << std::endl;
   json_file.close();
   return true;
@@ -0,0 +1,59 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "OpenCameraCalibrator/io/write_rig_calibration.h"
+#include "OpenCameraCalibrator/utils/json.h"
+
+namespace OpenICC {
+namespace io {
+
+bool write_rig_calibration(const std::string& output_file,
+                           const std::vector<std::string>& camera_calib_files,
+                           const quat_vector& rotations_cam_ref,
+                           const vec3_vector& positions_in_ref,
+                           const int nr_frames,
+                           const double total_reproj_error) {
+  std::ofstream json_file(output_file);
+  if (!json_file.is_open()) {
+    std::cerr << "Could not open: " << output_file << "\n";
+    return false;
+  }
+  nlohmann::json json_obj;
+  json_obj["nr_cameras"] = camera_calib_files.size();
+  json_obj["reference_camera"] = 0;
+  json_obj["nr_frames"] = nr_frames;
+  json_obj["final_reproj_error"] = total_reproj_error;
+  json_obj["cameras"] = nlohmann::json::array();
+  for (size_t i = 0; i < camera_calib_files.size(); ++i) {
+    nlohmann::json cam;
+    cam["calibration_file"] = camera_calib_files[i];
+    const Eigen::Quaterniond& q = rotations_cam_ref[i];
+    cam["q_cam_ref"] = {q.w(), q.x(), q.y(), q.z()};
+    const Eigen::Vector3d& p = positions_in_ref[i];
+    cam["p_cam_in_ref"] = {p[0], p[1], p[2]};
+    json_obj["cameras"].push_back(cam);
+  }
+
+  json_file << std::setw(2) << json_obj << std::endl;
+  json_file.close();
+  return true;
+}
+
+}  // namespace io
+}  // namespace OpenICC
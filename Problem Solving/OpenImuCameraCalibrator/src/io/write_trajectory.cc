@@ -0,0 +1,85 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/io/write_trajectory.h"
+
+#include <iostream>
+
+#include "OpenCameraCalibrator/io/binary_io.h"
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+const char TRAJECTORY_TABLE_MAGIC[8] = {'O', 'I', 'C', 'C', 'T', 'A', 'B', '1'};
+
+}  // namespace
+
+bool TrajectoryTableWriter::Open(const std::string& output_file,
+                                 const std::vector<Column>& columns) {
+  file_.open(output_file, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "Could not open: " << output_file << "\n";
+    return false;
+  }
+  columns_ = columns;
+  nr_rows_ = 0;
+  file_.write(TRAJECTORY_TABLE_MAGIC, sizeof(TRAJECTORY_TABLE_MAGIC));
+  WriteLittleEndianValue<uint32_t>(file_, columns_.size());
+  for (const Column& column : columns_) {
+    WriteLittleEndianValue<uint32_t>(file_, column.name.size());
+    file_.write(column.name.data(), column.name.size());
+    WriteLittleEndianValue<uint32_t>(file_, column.width);
+  }
+  return file_.good();
+}
+
+bool TrajectoryTableWriter::WriteBlock(
+    const std::vector<int64_t>& time_ns,
+    const std::vector<Eigen::Ref<const Eigen::MatrixXd>>& values) {
+  if (!file_.is_open() || values.size() != columns_.size()) {
+    return false;
+  }
+  const size_t nr_rows = time_ns.size();
+  for (size_t c = 0; c < columns_.size(); ++c) {
+    if (values[c].rows() != columns_[c].width ||
+        static_cast<size_t>(values[c].cols()) != nr_rows) {
+      std::cerr << "Column " << columns_[c].name
+                << " does not match the table layout.\n";
+      return false;
+    }
+  }
+  WriteLittleEndianValue<uint64_t>(file_, nr_rows);
+  WriteLittleEndian(file_, time_ns.data(), nr_rows);
+  for (const auto& column : values) {
+    // column major, the values of a row are next to each other
+    buffer_ = column.cast<float>();
+    WriteLittleEndian(file_, buffer_.data(), buffer_.size());
+  }
+  nr_rows_ += nr_rows;
+  return file_.good();
+}
+
+bool TrajectoryTableWriter::Close() {
+  if (!file_.is_open()) {
+    return false;
+  }
+  file_.close();
+  return !file_.fail();
+}
+
+}  // namespace io
+}  // namespace OpenICC
@@ -0,0 +1,256 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/adaptive_knots.h"
+
+#include <glog/logging.h>
+#include <unsupported/Eigen/FFT>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// energy per frequency bin 0..n/2 of n samples from begin, summed over the
+// axes, the mean of each axis is removed
+Eigen::VectorXd PowerSpectrum(const timed_vec3_vector& signal,
+                              const size_t begin,
+                              const size_t n,
+                              Eigen::FFT<double>& fft) {
+  Eigen::VectorXd power = Eigen::VectorXd::Zero(n / 2 + 1);
+  std::vector<double> axis(n);
+  std::vector<std::complex<double>> spectrum;
+  for (int a = 0; a < 3; ++a) {
+    double mean = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      axis[i] = signal[begin + i].second[a];
+      mean += axis[i];
+    }
+    mean /= n;
+    for (double& v : axis) {
+      v -= mean;
+    }
+    fft.fwd(spectrum, axis);
+    for (int k = 0; k < power.size(); ++k) {
+      power[k] += std::norm(spectrum[k]);
+    }
+  }
+  return power;
+}
+
+// first bin at which the cumulative energy reaches quality of the total
+double BandwidthBin(const Eigen::VectorXd& power, const double quality) {
+  const double total = power.sum();
+  if (total <= 0.0) {
+    return 0.0;
+  }
+  double energy = 0.0;
+  for (int k = 0; k < power.size(); ++k) {
+    energy += power[k];
+    if (energy >= quality * total) {
+      return k;
+    }
+  }
+  return power.size() - 1;
+}
+
+}  // namespace
+
+std::vector<int64_t> AdaptiveKnotTimes(const timed_vec3_vector& signal,
+                                       const int64_t start_ns,
+                                       const int64_t end_ns,
+                                       const double dt_s,
+                                       const AdaptiveKnotOptions& options) {
+  CHECK_GT(end_ns, start_ns);
+  CHECK_GT(dt_s, 0.0);
+  CHECK_GE(options.max_dt_ratio, 1.0);
+  const double min_dt_s = options.min_dt_factor * dt_s;
+  const double max_dt_s = options.max_dt_factor * dt_s;
+
+  // knot spacing of each window, located at the window center
+  std::vector<double> centers_s, window_dt_s;
+  if (signal.size() > 1 && signal.back().first > signal.front().first) {
+    const double rate = (signal.size() - 1) /
+                        (signal.back().first - signal.front().first);
+    const size_t n =
+        std::max<size_t>(8, 2 * static_cast<size_t>(0.5 * options.window_s *
+                                                     rate));
+    Eigen::FFT<double> fft;
+    fft.SetFlag(Eigen::FFT<double>::HalfSpectrum);
+    std::vector<Eigen::VectorXd> window_power;
+    Eigen::VectorXd mean_power = Eigen::VectorXd::Zero(n / 2 + 1);
+    for (size_t begin = 0; begin + n <= signal.size(); begin += n / 2) {
+      window_power.push_back(PowerSpectrum(signal, begin, n, fft));
+      mean_power += window_power.back();
+      centers_s.push_back(
+          0.5 * (signal[begin].first + signal[begin + n - 1].first));
+    }
+    // all windows have the same length, so the bins are comparable
+    const double bandwidth =
+        BandwidthBin(mean_power, options.energy_quality);
+    for (const auto& power : window_power) {
+      const double window_bandwidth =
+          BandwidthBin(power, options.energy_quality);
+      const double dt = window_bandwidth > 0.0
+                            ? dt_s * bandwidth / window_bandwidth
+                            : max_dt_s;
+      window_dt_s.push_back(std::clamp(dt, min_dt_s, max_dt_s));
+    }
+    // take the minimum with the neighbouring windows, the spacing has to be
+    // dense already before a dynamic segment starts
+    const std::vector<double> dt = window_dt_s;
+    for (size_t w = 0; w < dt.size(); ++w) {
+      if (w > 0) {
+        window_dt_s[w] = std::min(window_dt_s[w], dt[w - 1]);
+      }
+      if (w + 1 < dt.size()) {
+        window_dt_s[w] = std::min(window_dt_s[w], dt[w + 1]);
+      }
+    }
+    // backward pass: the spacing may only shrink by the slope at which the
+    // next segment is at least 1 / max_dt_ratio of the current one
+    const double max_shrink_slope = 1.0 - 1.0 / options.max_dt_ratio;
+    for (size_t w = window_dt_s.size(); w > 1; --w) {
+      const double max_dt =
+          window_dt_s[w - 1] +
+          max_shrink_slope * (centers_s[w - 1] - centers_s[w - 2]);
+      window_dt_s[w - 2] = std::min(window_dt_s[w - 2], max_dt);
+    }
+  }
+
+  // linear interpolation between the window centers
+  const auto local_dt_s = [&](const double t_s) {
+    if (window_dt_s.empty()) {
+      return std::clamp(dt_s, min_dt_s, max_dt_s);
+    }
+    const auto it = std::upper_bound(centers_s.begin(), centers_s.end(), t_s);
+    if (it == centers_s.begin()) {
+      return window_dt_s.front();
+    }
+    if (it == centers_s.end()) {
+      return window_dt_s.back();
+    }
+    const size_t w = it - centers_s.begin();
+    const double a =
+        (t_s - centers_s[w - 1]) / (centers_s[w] - centers_s[w - 1]);
+    return (1.0 - a) * window_dt_s[w - 1] + a * window_dt_s[w];
+  };
+
+  // the growth of the segments is limited here, their shrinking by the
+  // backward pass above
+  const double length_s = (end_ns - start_ns) * NS_TO_S;
+  std::vector<double> segments_s;
+  double total_s = 0.0;
+  double prev_dt_s = local_dt_s(start_ns * NS_TO_S);
+  while (total_s < length_s) {
+    const double dt = std::min(local_dt_s(start_ns * NS_TO_S + total_s),
+                               options.max_dt_ratio * prev_dt_s);
+    segments_s.push_back(dt);
+    total_s += dt;
+    prev_dt_s = dt;
+  }
+  // the last segment overshoots end_ns. Either it is dropped or kept and all
+  // segments are scaled to end at end_ns, whichever scale is closer to 1.
+  // A common scale keeps the ratios of neighbouring segments.
+  if (segments_s.size() > 1 &&
+      length_s / (total_s - segments_s.back()) < total_s / length_s) {
+    total_s -= segments_s.back();
+    segments_s.pop_back();
+  }
+  const double scale = length_s / total_s;
+
+  std::vector<int64_t> knot_times_ns{start_ns};
+  double t_s = 0.0;
+  for (size_t i = 0; i + 1 < segments_s.size(); ++i) {
+    t_s += scale * segments_s[i];
+    knot_times_ns.push_back(start_ns + static_cast<int64_t>(t_s * S_TO_NS));
+  }
+  knot_times_ns.push_back(end_ns);
+  return knot_times_ns;
+}
+
+Eigen::MatrixXd NonUniformBlendingMatrix(
+    const std::vector<int64_t>& knot_times_ns,
+    const size_t segment,
+    const int order,
+    const bool cumulative) {
+  CHECK_GE(knot_times_ns.size(), 2);
+  CHECK_LT(segment + 1, knot_times_ns.size());
+  const int N = order;
+  const int64_t last = knot_times_ns.size() - 1;
+  const double first_dt = knot_times_ns[1] - knot_times_ns[0];
+  const double last_dt = knot_times_ns[last] - knot_times_ns[last - 1];
+  const double t0 = knot_times_ns[segment];
+  const double length = knot_times_ns[segment + 1] - t0;
+
+  // knots t_{segment - N + 1} .. t_{segment + N} in normalized segment time
+  std::vector<double> knots(2 * N);
+  for (int k = 0; k < 2 * N; ++k) {
+    const int64_t i = static_cast<int64_t>(segment) - N + 1 + k;
+    double t;
+    if (i < 0) {
+      t = knot_times_ns[0] + i * first_dt;
+    } else if (i > last) {
+      t = knot_times_ns[last] + (i - last) * last_dt;
+    } else {
+      t = knot_times_ns[i];
+    }
+    knots[k] = (t - t0) / length;
+  }
+
+  // the basis functions are polynomials of degree N - 1 on the segment, so N
+  // samples determine their coefficients
+  Eigen::MatrixXd basis(N, N), powers(N, N);
+  std::vector<double> B(N), left(N), right(N);
+  for (int m = 0; m < N; ++m) {
+    const double u = N > 1 ? static_cast<double>(m) / (N - 1) : 0.0;
+    // Cox-de Boor recursion (The NURBS Book, A2.2) on the span
+    // [knots[N - 1], knots[N])
+    B[0] = 1.0;
+    for (int j = 1; j < N; ++j) {
+      left[j] = u - knots[N - j];
+      right[j] = knots[N - 1 + j] - u;
+      double saved = 0.0;
+      for (int r = 0; r < j; ++r) {
+        const double temp = B[r] / (right[r + 1] + left[j - r]);
+        B[r] = saved + right[r + 1] * temp;
+        saved = left[j - r] * temp;
+      }
+      B[j] = saved;
+    }
+    for (int i = 0; i < N; ++i) {
+      basis(i, m) = B[i];
+      powers(i, m) = std::pow(u, i);
+    }
+  }
+  // basis = M * powers
+  Eigen::MatrixXd M =
+      powers.transpose().partialPivLu().solve(basis.transpose()).transpose();
+  if (cumulative) {
+    for (int i = N - 2; i >= 0; --i) {
+      M.row(i) += M.row(i + 1);
+    }
+  }
+  return M;
+}
+
+}  // namespace utils
+}  // namespace OpenICC
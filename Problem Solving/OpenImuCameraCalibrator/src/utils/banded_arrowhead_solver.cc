@@ -0,0 +1,620 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/banded_arrowhead_solver.h"
+
+#include <glog/logging.h>
+#include <theia/util/timer.h>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <unordered_set>
+
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// same limits of the diagonal regularization as ceres
+const double MIN_DIAGONAL = 1e-6;
+const double MAX_DIAGONAL = 1e32;
+
+const double INITIAL_LAMBDA = 1e-4;
+const double MAX_LAMBDA = 1e16;
+
+// minimum ratio of actual to predicted cost decrease of a successful step
+const double MIN_RELATIVE_DECREASE = 1e-3;
+
+// rows per thread below which the normal equations are built serially
+const int MIN_ROWS_PER_THREAD = 1000;
+
+struct ParameterBlock {
+  double* values;
+  int size;
+  int local_size;
+  const ceres::LocalParameterization* parameterization;
+};
+
+//! Coupling H_bg of one band parameter block (e.g. a knot) with the arrow,
+//! only the arrow columns it shares a residual with are stored.
+struct BandArrowBlock {
+  int begin = 0;
+  std::vector<int> arrow_cols;
+  Eigen::MatrixXd values;
+};
+
+//! normal equations J^T J, J^T r of a contiguous range of band columns
+//! [band_begin, band_begin + H_bb.cols()) and all arrow columns. H_bg is
+//! stored per band block, its memory is linear in the number of band blocks.
+struct NormalEquations {
+  int band_begin = 0;
+  Eigen::MatrixXd H_bb;
+  std::vector<BandArrowBlock> H_bg;
+  //! (band block, position in its arrow_cols) of every arrow column
+  std::vector<std::vector<std::pair<int, int>>> H_bg_cols;
+  Eigen::MatrixXd H_gg;
+  Eigen::VectorXd g_b;
+  Eigen::VectorXd g_g;
+
+  void SetZero(const int begin,
+               const int nr_band,
+               const int bandwidth,
+               const int nr_arrow) {
+    band_begin = begin;
+    H_bb.setZero(bandwidth + 1, nr_band);
+    H_gg.setZero(nr_arrow, nr_arrow);
+    g_b.setZero(nr_band);
+    g_g.setZero(nr_arrow);
+  }
+
+  //! y_g += H_bg^T x_b
+  void MultiplyTransposed(const Eigen::VectorXd& x_b,
+                          Eigen::VectorXd& y_g) const {
+    for (const auto& block : H_bg) {
+      const Eigen::VectorXd v =
+          block.values.transpose() *
+          x_b.segment(block.begin, block.values.rows());
+      for (size_t k = 0; k < block.arrow_cols.size(); ++k) {
+        y_g[block.arrow_cols[k]] += v[k];
+      }
+    }
+  }
+
+  //! y_b += H_bg x_g
+  void Multiply(const Eigen::VectorXd& x_g, Eigen::VectorXd& y_b) const {
+    for (const auto& block : H_bg) {
+      Eigen::VectorXd x(block.arrow_cols.size());
+      for (size_t k = 0; k < block.arrow_cols.size(); ++k) {
+        x[k] = x_g[block.arrow_cols[k]];
+      }
+      y_b.segment(block.begin, block.values.rows()) += block.values * x;
+    }
+  }
+};
+
+void AccumulateRows(const ceres::CRSMatrix& J,
+                    const std::vector<double>& residuals,
+                    const std::vector<int>& rows,
+                    const int nr_band,
+                    NormalEquations& ne) {
+  const int b0 = ne.band_begin;
+  for (const int r : rows) {
+    const int begin = J.rows[r], end = J.rows[r + 1];
+    for (int k = begin; k < end; ++k) {
+      const int ck = J.cols[k];
+      const double vk = J.values[k];
+      if (ck < nr_band) {
+        ne.g_b[ck - b0] += vk * residuals[r];
+      } else {
+        ne.g_g[ck - nr_band] += vk * residuals[r];
+      }
+      for (int l = begin; l < end; ++l) {
+        const int cl = J.cols[l];
+        if (cl > ck) {
+          continue;
+        }
+        const double v = vk * J.values[l];
+        if (ck < nr_band) {
+          // both band, ck >= cl
+          ne.H_bb(ck - cl, cl - b0) += v;
+        } else if (cl >= nr_band) {
+          ne.H_gg(ck - nr_band, cl - nr_band) += v;
+        }
+      }
+    }
+  }
+}
+
+//! H_bg block by block: the arrow columns of a band block are the ones of
+//! the rows that touch it. Blocks are distributed over the threads.
+void BuildBandArrowBlocks(const ceres::CRSMatrix& J,
+                          const std::vector<int>& band_block_begins,
+                          const int nr_threads,
+                          NormalEquations& ne) {
+  const int nr_band = band_block_begins.back();
+  const int nr_arrow = J.num_cols - nr_band;
+  const int nr_blocks = static_cast<int>(band_block_begins.size()) - 1;
+  std::vector<int> band_col_block(nr_band);
+  for (int b = 0; b < nr_blocks; ++b) {
+    std::fill(band_col_block.begin() + band_block_begins[b],
+              band_col_block.begin() + band_block_begins[b + 1],
+              b);
+  }
+  std::vector<std::vector<int>> block_rows(nr_blocks);
+  for (int r = 0; r < J.num_rows; ++r) {
+    for (int k = J.rows[r]; k < J.rows[r + 1]; ++k) {
+      if (J.cols[k] < nr_band) {
+        auto& rows = block_rows[band_col_block[J.cols[k]]];
+        if (rows.empty() || rows.back() != r) {
+          rows.push_back(r);
+        }
+      }
+    }
+  }
+
+  ne.H_bg.assign(nr_blocks, BandArrowBlock());
+  const int nr_chunks = std::max(1, std::min(nr_threads, nr_blocks));
+  ParallelFor(nr_chunks, nr_threads, [&](const size_t c) {
+    // position of an arrow column in the current block, -1 if not in it
+    std::vector<int> arrow_pos(nr_arrow, -1);
+    for (int b = c; b < nr_blocks; b += nr_chunks) {
+      BandArrowBlock& block = ne.H_bg[b];
+      block.begin = band_block_begins[b];
+      const int size = band_block_begins[b + 1] - block.begin;
+      for (const int r : block_rows[b]) {
+        for (int k = J.rows[r]; k < J.rows[r + 1]; ++k) {
+          const int col = J.cols[k] - nr_band;
+          if (col >= 0 && arrow_pos[col] < 0) {
+            arrow_pos[col] = 0;
+            block.arrow_cols.push_back(col);
+          }
+        }
+      }
+      std::sort(block.arrow_cols.begin(), block.arrow_cols.end());
+      for (size_t i = 0; i < block.arrow_cols.size(); ++i) {
+        arrow_pos[block.arrow_cols[i]] = i;
+      }
+      block.values.setZero(size, block.arrow_cols.size());
+      for (const int r : block_rows[b]) {
+        const int begin = J.rows[r], end = J.rows[r + 1];
+        for (int k = begin; k < end; ++k) {
+          const int ck = J.cols[k] - block.begin;
+          if (ck < 0 || ck >= size) {
+            continue;
+          }
+          for (int l = begin; l < end; ++l) {
+            const int cl = J.cols[l] - nr_band;
+            if (cl >= 0) {
+              block.values(ck, arrow_pos[cl]) += J.values[k] * J.values[l];
+            }
+          }
+        }
+      }
+      for (const int col : block.arrow_cols) {
+        arrow_pos[col] = -1;
+      }
+    }
+  });
+
+  ne.H_bg_cols.assign(nr_arrow, {});
+  for (int b = 0; b < nr_blocks; ++b) {
+    const auto& cols = ne.H_bg[b].arrow_cols;
+    for (size_t i = 0; i < cols.size(); ++i) {
+      ne.H_bg_cols[cols[i]].emplace_back(b, i);
+    }
+  }
+}
+
+//! J^T J and J^T r with the rows sorted by their first band column and split
+//! into contiguous chunks, so each thread only accumulates a short range of
+//! the band
+void BuildNormalEquations(const ceres::CRSMatrix& J,
+                          const std::vector<double>& residuals,
+                          const std::vector<int>& band_block_begins,
+                          const int nr_threads,
+                          NormalEquations& ne) {
+  const int nr_band = band_block_begins.back();
+  const int nr_arrow = J.num_cols - nr_band;
+  std::vector<int> first_col(J.num_rows, nr_band), last_col(J.num_rows, -1);
+  int bandwidth = 0;
+  for (int r = 0; r < J.num_rows; ++r) {
+    for (int k = J.rows[r]; k < J.rows[r + 1]; ++k) {
+      if (J.cols[k] < nr_band) {
+        first_col[r] = std::min(first_col[r], J.cols[k]);
+        last_col[r] = std::max(last_col[r], J.cols[k]);
+      }
+    }
+    bandwidth = std::max(bandwidth, last_col[r] - first_col[r]);
+  }
+  std::vector<int> sorted_rows(J.num_rows);
+  std::iota(sorted_rows.begin(), sorted_rows.end(), 0);
+  std::stable_sort(sorted_rows.begin(),
+                   sorted_rows.end(),
+                   [&](const int a, const int b) {
+                     return first_col[a] < first_col[b];
+                   });
+
+  const int nr_chunks = std::max(
+      1, std::min(nr_threads, J.num_rows / MIN_ROWS_PER_THREAD));
+  std::vector<std::vector<int>> chunk_rows(nr_chunks);
+  std::vector<NormalEquations> chunk_ne(nr_chunks);
+  const size_t rows_per_chunk =
+      (sorted_rows.size() + nr_chunks - 1) / nr_chunks;
+  for (int c = 0; c < nr_chunks; ++c) {
+    const size_t begin = std::min(c * rows_per_chunk, sorted_rows.size());
+    const size_t end = std::min(begin + rows_per_chunk, sorted_rows.size());
+    chunk_rows[c].assign(sorted_rows.begin() + begin,
+                         sorted_rows.begin() + end);
+  }
+  ParallelFor(nr_chunks, nr_threads, [&](const size_t c) {
+    int band_begin = nr_band, band_end = 0;
+    for (const int r : chunk_rows[c]) {
+      if (last_col[r] >= 0) {
+        band_begin = std::min(band_begin, first_col[r]);
+        band_end = std::max(band_end, last_col[r] + 1);
+      }
+    }
+    band_begin = std::min(band_begin, band_end);
+    chunk_ne[c].SetZero(
+        band_begin, band_end - band_begin, bandwidth, nr_arrow);
+    AccumulateRows(J, residuals, chunk_rows[c], nr_band, chunk_ne[c]);
+  });
+
+  ne.SetZero(0, nr_band, bandwidth, nr_arrow);
+  for (const auto& c : chunk_ne) {
+    const int n = c.H_bb.cols();
+    ne.H_bb.middleCols(c.band_begin, n) += c.H_bb;
+    ne.g_b.segment(c.band_begin, n) += c.g_b;
+    ne.H_gg += c.H_gg;
+    ne.g_g += c.g_g;
+  }
+  ne.H_gg = ne.H_gg.selfadjointView<Eigen::Lower>();
+  BuildBandArrowBlocks(J, band_block_begins, nr_threads, ne);
+}
+
+//! (H + lambda * D) * delta = -g through the Schur complement of the band
+//!   S = H_gg - H_bg^T H_bb^-1 H_bg
+//! Each column of S takes one band solve with a column of H_bg, no dense
+//! band x arrow matrix is formed.
+bool SolveDamped(const NormalEquations& ne,
+                 const double lambda,
+                 const int nr_threads,
+                 Eigen::VectorXd& delta_b,
+                 Eigen::VectorXd& delta_g) {
+  const int nr_band = ne.H_bb.cols();
+  const int nr_arrow = ne.H_gg.cols();
+
+  Eigen::MatrixXd L = ne.H_bb;
+  L.row(0) += lambda * ne.H_bb.row(0).cwiseMax(MIN_DIAGONAL).cwiseMin(
+                           MAX_DIAGONAL);
+  if (!FactorizeBand(L)) {
+    return false;
+  }
+  // z = H_bb^-1 x in place
+  const auto solve_band = [&L](Eigen::VectorXd& x) {
+    SolveBandLower(L, x.data());
+    SolveBandUpper(L, x.data());
+  };
+
+  Eigen::MatrixXd S = ne.H_gg;
+  S.diagonal() += lambda * ne.H_gg.diagonal().cwiseMax(MIN_DIAGONAL).cwiseMin(
+                               MAX_DIAGONAL);
+  ParallelFor(nr_arrow, nr_threads, [&](const size_t c) {
+    Eigen::VectorXd z = Eigen::VectorXd::Zero(nr_band);
+    for (const auto& entry : ne.H_bg_cols[c]) {
+      const BandArrowBlock& block = ne.H_bg[entry.first];
+      z.segment(block.begin, block.values.rows()) =
+          block.values.col(entry.second);
+    }
+    solve_band(z);
+    Eigen::VectorXd s = Eigen::VectorXd::Zero(nr_arrow);
+    ne.MultiplyTransposed(z, s);
+    S.col(c) -= s;
+  });
+
+  // rhs = g_g - H_bg^T H_bb^-1 g_b
+  Eigen::VectorXd z_b = ne.g_b;
+  solve_band(z_b);
+  Eigen::VectorXd rhs = ne.g_g;
+  Eigen::VectorXd h_z = Eigen::VectorXd::Zero(nr_arrow);
+  ne.MultiplyTransposed(z_b, h_z);
+  rhs -= h_z;
+  delta_g.setZero(nr_arrow);
+  if (nr_arrow > 0) {
+    const Eigen::LDLT<Eigen::MatrixXd> ldlt(S);
+    if (ldlt.info() != Eigen::Success || !ldlt.isPositive()) {
+      return false;
+    }
+    delta_g = -ldlt.solve(rhs);
+  }
+
+  // H_bb delta_b = -(g_b + H_bg delta_g)
+  delta_b = ne.g_b;
+  ne.Multiply(delta_g, delta_b);
+  solve_band(delta_b);
+  delta_b = -delta_b;
+  return delta_b.allFinite() && delta_g.allFinite();
+}
+
+}  // namespace
+
+bool FactorizeBand(Eigen::MatrixXd& band) {
+  const int bw = band.rows() - 1;
+  const int n = band.cols();
+  for (int j = 0; j < n; ++j) {
+    double d = band(0, j);
+    for (int k = std::max(0, j - bw); k < j; ++k) {
+      d -= band(j - k, k) * band(j - k, k);
+    }
+    if (!(d > 0.0)) {
+      return false;
+    }
+    const double l_jj = std::sqrt(d);
+    band(0, j) = l_jj;
+    for (int i = j + 1; i <= std::min(n - 1, j + bw); ++i) {
+      double s = band(i - j, j);
+      for (int k = std::max(0, i - bw); k < j; ++k) {
+        s -= band(i - k, k) * band(j - k, k);
+      }
+      band(i - j, j) = s / l_jj;
+    }
+  }
+  return true;
+}
+
+void SolveBandLower(const Eigen::MatrixXd& band, double* b) {
+  const int bw = band.rows() - 1;
+  const int n = band.cols();
+  for (int i = 0; i < n; ++i) {
+    double s = b[i];
+    for (int k = std::max(0, i - bw); k < i; ++k) {
+      s -= band(i - k, k) * b[k];
+    }
+    b[i] = s / band(0, i);
+  }
+}
+
+void SolveBandUpper(const Eigen::MatrixXd& band, double* b) {
+  const int bw = band.rows() - 1;
+  const int n = band.cols();
+  for (int i = n - 1; i >= 0; --i) {
+    double s = b[i];
+    for (int k = i + 1; k <= std::min(n - 1, i + bw); ++k) {
+      s -= band(k - i, i) * b[k];
+    }
+    b[i] = s / band(0, i);
+  }
+}
+
+bool SolveBandedProblem(const BandedSolverOptions& options,
+                        const std::vector<double*>& band_blocks,
+                        ceres::Problem* problem,
+                        ceres::Solver::Summary* summary) {
+  theia::Timer timer;
+
+  // column order: variable band blocks, then all other variable blocks
+  std::vector<ParameterBlock> blocks;
+  int nr_band = 0, nr_arrow = 0;
+  std::unordered_set<double*> in_band;
+  const auto add_block = [&](double* values) {
+    blocks.push_back({values,
+                      problem->ParameterBlockSize(values),
+                      problem->ParameterBlockLocalSize(values),
+                      problem->GetParameterization(values)});
+    return blocks.back().local_size;
+  };
+  std::vector<int> band_block_begins = {0};
+  for (double* values : band_blocks) {
+    if (problem->HasParameterBlock(values) &&
+        !problem->IsParameterBlockConstant(values) && !in_band.count(values)) {
+      nr_band += add_block(values);
+      band_block_begins.push_back(nr_band);
+      in_band.insert(values);
+    }
+  }
+  std::vector<double*> all_blocks;
+  problem->GetParameterBlocks(&all_blocks);
+  for (double* values : all_blocks) {
+    if (!in_band.count(values) && !problem->IsParameterBlockConstant(values)) {
+      nr_arrow += add_block(values);
+    }
+  }
+  if (nr_arrow > options.max_arrow_size) {
+    LOG(WARNING) << "Arrow part of " << nr_arrow
+                 << " parameters is too large for the banded solver.";
+    return false;
+  }
+
+  ceres::Problem::EvaluateOptions eval_options;
+  eval_options.num_threads = options.num_threads;
+  for (const auto& b : blocks) {
+    eval_options.parameter_blocks.push_back(b.values);
+  }
+
+  // values at entry, restored if the solver fails
+  std::vector<std::vector<double>> initial(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    initial[i].assign(blocks[i].values, blocks[i].values + blocks[i].size);
+  }
+  std::vector<std::vector<double>> saved(blocks.size());
+  const auto save_parameters = [&]() {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      saved[i].assign(blocks[i].values, blocks[i].values + blocks[i].size);
+    }
+  };
+  const auto restore_parameters = [&]() {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      std::copy(saved[i].begin(), saved[i].end(), blocks[i].values);
+    }
+  };
+  // x = x [+] delta in the local parameterization, clamped to the bounds
+  const auto apply_step = [&](const Eigen::VectorXd& delta) {
+    int offset = 0;
+    std::vector<double> x_plus;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      const auto& b = blocks[i];
+      x_plus.resize(b.size);
+      if (b.parameterization) {
+        b.parameterization->Plus(
+            saved[i].data(), delta.data() + offset, x_plus.data());
+      } else {
+        for (int j = 0; j < b.size; ++j) {
+          x_plus[j] = saved[i][j] + delta[offset + j];
+        }
+      }
+      for (int j = 0; j < b.size; ++j) {
+        x_plus[j] =
+            std::min(std::max(x_plus[j],
+                              problem->GetParameterLowerBound(b.values, j)),
+                     problem->GetParameterUpperBound(b.values, j));
+      }
+      std::copy(x_plus.begin(), x_plus.end(), b.values);
+      offset += b.local_size;
+    }
+  };
+
+  double cost = 0.0;
+  std::vector<double> residuals;
+  ceres::CRSMatrix jacobian;
+  if (!problem->Evaluate(eval_options, &cost, &residuals, nullptr, &jacobian)) {
+    return false;
+  }
+  summary->initial_cost = cost;
+  summary->num_successful_steps = 0;
+  summary->num_unsuccessful_steps = 0;
+  summary->termination_type = ceres::NO_CONVERGENCE;
+  summary->message = "Maximum number of iterations reached.";
+
+  NormalEquations ne;
+  BuildNormalEquations(
+      jacobian, residuals, band_block_begins, options.num_threads, ne);
+
+  double lambda = INITIAL_LAMBDA;
+  double lambda_increase = 2.0;
+  Eigen::VectorXd delta_b, delta_g, delta(nr_band + nr_arrow);
+  for (int iter = 0; iter < options.max_num_iterations; ++iter) {
+    const double max_gradient =
+        std::max(ne.g_b.size() ? ne.g_b.cwiseAbs().maxCoeff() : 0.0,
+                 ne.g_g.size() ? ne.g_g.cwiseAbs().maxCoeff() : 0.0);
+    if (max_gradient <= options.gradient_tolerance) {
+      summary->termination_type = ceres::CONVERGENCE;
+      summary->message = "Gradient tolerance reached.";
+      break;
+    }
+
+    if (!SolveDamped(ne, lambda, options.num_threads, delta_b, delta_g)) {
+      ++summary->num_unsuccessful_steps;
+      lambda *= lambda_increase;
+      lambda_increase *= 2.0;
+      if (lambda > MAX_LAMBDA) {
+        summary->termination_type = ceres::FAILURE;
+        summary->message = "Linear solver failed.";
+        break;
+      }
+      continue;
+    }
+    delta << delta_b, delta_g;
+
+    save_parameters();
+    double x_norm = 0.0;
+    for (const auto& s : saved) {
+      for (const double v : s) {
+        x_norm += v * v;
+      }
+    }
+    x_norm = std::sqrt(x_norm);
+    if (delta.norm() <=
+        options.parameter_tolerance * (x_norm + options.parameter_tolerance)) {
+      summary->termination_type = ceres::CONVERGENCE;
+      summary->message = "Parameter tolerance reached.";
+      break;
+    }
+
+    apply_step(delta);
+    double new_cost = 0.0;
+    const bool evaluated = problem->Evaluate(
+        eval_options, &new_cost, nullptr, nullptr, nullptr);
+
+    // model decrease 0.5 * (lambda * delta^T D delta - g^T delta)
+    Eigen::VectorXd D(nr_band + nr_arrow);
+    D << ne.H_bb.row(0).transpose(), ne.H_gg.diagonal();
+    D = D.cwiseMax(MIN_DIAGONAL).cwiseMin(MAX_DIAGONAL);
+    Eigen::VectorXd g(nr_band + nr_arrow);
+    g << ne.g_b, ne.g_g;
+    const double model_decrease =
+        0.5 * (lambda * delta.dot(D.cwiseProduct(delta)) - g.dot(delta));
+    const double rho =
+        model_decrease > 0.0 ? (cost - new_cost) / model_decrease : -1.0;
+
+    if (!evaluated || rho < MIN_RELATIVE_DECREASE) {
+      restore_parameters();
+      ++summary->num_unsuccessful_steps;
+      lambda *= lambda_increase;
+      lambda_increase *= 2.0;
+      if (lambda > MAX_LAMBDA) {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Trust region too small.";
+        break;
+      }
+      continue;
+    }
+
+    ++summary->num_successful_steps;
+    lambda *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+    lambda_increase = 2.0;
+    const double relative_decrease = (cost - new_cost) / cost;
+    if (options.minimizer_progress_to_stdout) {
+      std::cout << "banded LM iter " << iter << " cost " << new_cost
+                << " lambda " << lambda << "\n";
+    }
+    if (!problem->Evaluate(
+            eval_options, &cost, &residuals, nullptr, &jacobian)) {
+      summary->termination_type = ceres::FAILURE;
+      summary->message = "Jacobian evaluation failed.";
+      break;
+    }
+    if (relative_decrease <= options.function_tolerance) {
+      summary->termination_type = ceres::CONVERGENCE;
+      summary->message = "Function tolerance reached.";
+      break;
+    }
+    BuildNormalEquations(
+        jacobian, residuals, band_block_begins, options.num_threads, ne);
+  }
+
+  summary->num_threads_given = options.num_threads;
+  summary->num_threads_used = options.num_threads;
+  summary->total_time_in_seconds = timer.ElapsedTimeInSeconds();
+  if (summary->termination_type == ceres::FAILURE) {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      std::copy(initial[i].begin(), initial[i].end(), blocks[i].values);
+    }
+    summary->final_cost = summary->initial_cost;
+    LOG(WARNING) << "Banded solver: " << summary->message;
+    return false;
+  }
+  summary->final_cost = cost;
+  return true;
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -16,6 +16,7 @@
 #include <opencv2/aruco/charuco.hpp>
 
 #include "OpenCameraCalibrator/utils/intrinsic_initializer.h"
+#include "OpenCameraCalibrator/utils/planar_initializer.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 #include "theia/sfm/camera/division_undistortion_camera_model.h"
 #include "theia/sfm/camera/double_sphere_camera_model.h"
@@ -29,6 +30,8 @@
 #include <opencv2/core/eigen.hpp>
 
 const size_t MIN_NUM_POINTS = 20;
+// minimal sample size of the P4Pf and the radial distortion P4Pfr solvers
+const int UNCALIBRATED_SAMPLE_SIZE = 4;
 
 namespace OpenICC {
 namespace utils {
@@ -45,10 +48,31 @@ bool initialize_pinhole_camera(
     return false;
   }
 
+  // board detections are almost outlier free, so first try the closed-form
+  // solution from the board homography
+  Eigen::Matrix3d H;
+  const double inlier_ratio = FitPlanarHomography(
+      correspondences, ransac_params.error_thresh, H, ransac_summary.inliers);
+  if (inlier_ratio >= MIN_INLIER_RATIO_CLOSED_FORM &&
+      FocalLengthFromPlanarHomography(H, focal_length) &&
+      PoseFromPlanarHomography(H, focal_length, rotation, position)) {
+    ransac_summary.num_iterations = 0;
+    if (verbose) {
+      std::cout << "Estimated focal length from homography: " << focal_length
+                << std::endl;
+      std::cout << "Number of homography inliers: "
+                << ransac_summary.inliers.size() << std::endl;
+    }
+    return ransac_summary.inliers.size() >= MIN_NUM_POINTS;
+  }
+
+  theia::RansacParameters adapted_params = ransac_params;
+  AdaptRansacParameters(inlier_ratio, UNCALIBRATED_SAMPLE_SIZE, adapted_params);
+
   theia::UncalibratedAbsolutePose pose_linear;
   // use -> cv::initCameraMatrix2D()
   const bool success =
-      theia::EstimateUncalibratedAbsolutePose(ransac_params,
+      theia::EstimateUncalibratedAbsolutePose(adapted_params,
                                               theia::RansacType::RANSAC,
                                               correspondences,
                                               &pose_linear,
@@ -84,19 +108,38 @@ bool initialize_radial_undistortion_camera(
   meta_data.max_focal_length = 0.75 * img_size.width + 0.5 * img_size.width;
   meta_data.min_focal_length = 0.75 * img_size.width - 0.5 * img_size.width;
 
-  const bool success = theia::EstimateRadialDistUncalibratedAbsolutePose(
-      ransac_params,
-      theia::RansacType::RANSAC,
-      correspondences,
-      meta_data,
-      &pose_division_undist,
-      &ransac_summary);
-
-  rotation = pose_division_undist.rotation;
-  position = -pose_division_undist.rotation.transpose() *
-             pose_division_undist.translation;
-  radial_distortion = pose_division_undist.radial_distortion;
-  focal_length = pose_division_undist.focal_length;
+  // if the lens is barely distorted the board homography already explains
+  // all corners and we can skip the minimal solver
+  Eigen::Matrix3d H;
+  const double inlier_ratio = FitPlanarHomography(
+      correspondences, ransac_params.error_thresh, H, ransac_summary.inliers);
+  bool success = false;
+  if (inlier_ratio >= MIN_INLIER_RATIO_CLOSED_FORM &&
+      FocalLengthFromPlanarHomography(H, focal_length) &&
+      focal_length > meta_data.min_focal_length &&
+      focal_length < meta_data.max_focal_length &&
+      PoseFromPlanarHomography(H, focal_length, rotation, position)) {
+    ransac_summary.num_iterations = 0;
+    radial_distortion = 0.0;
+    success = true;
+  } else {
+    theia::RansacParameters adapted_params = ransac_params;
+    AdaptRansacParameters(
+        inlier_ratio, UNCALIBRATED_SAMPLE_SIZE, adapted_params);
+    success = theia::EstimateRadialDistUncalibratedAbsolutePose(
+        adapted_params,
+        theia::RansacType::RANSAC,
+        correspondences,
+        meta_data,
+        &pose_division_undist,
+        &ransac_summary);
+
+    rotation = pose_division_undist.rotation;
+    position = -pose_division_undist.rotation.transpose() *
+               pose_division_undist.translation;
+    radial_distortion = pose_division_undist.radial_distortion;
+    focal_length = pose_division_undist.focal_length;
+  }
 
   theia::Camera cam;
   cam.SetCameraIntrinsicsModelType(
@@ -119,10 +162,9 @@ bool initialize_radial_undistortion_camera(
   }
   repro_error /= (double)correspondences.size();
   if (verbose) {
-    std::cout << "Estimated focal length: " << pose_division_undist.focal_length
+    std::cout << "Estimated focal length: " << focal_length << std::endl;
+    std::cout << "Estimated radial distortion: " << radial_distortion
               << std::endl;
-    std::cout << "Estimated radial distortion: "
-              << pose_division_undist.radial_distortion << std::endl;
     std::cout << "Number of Ransac inliers: " << ransac_summary.inliers.size()
               << std::endl;
     std::cout << "Reprojection error: " << repro_error << std::endl
@@ -0,0 +1,218 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+
+#include <theia/sfm/camera/fisheye_camera_model.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+using FisheyeIndex = theia::FisheyeCameraModel::InternalParametersIndex;
+
+// points are processed in blocks of this size, the block arrays stay in
+// registers/L1 and every operation below maps to packet instructions
+const int KB4_BLOCK_SIZE = 64;
+
+using BlockArray = Eigen::Array<double, KB4_BLOCK_SIZE, 1>;
+
+// below this radius the ray is treated as the optical axis
+const double MIN_KB4_RADIUS = 1e-12;
+
+// Branch free atan, std::atan is not vectorized. Range reduction and
+// rational approximation of the cephes library, accurate to 1 ulp.
+BlockArray Atan(const BlockArray& x_in) {
+  const double T3P8 = 2.41421356237309504880;  // tan(3 pi / 8)
+  const double MOREBITS = 6.123233995736765886130e-17;
+  const BlockArray abs_x = x_in.abs();
+  const auto large = abs_x > T3P8;
+  const auto medium = (abs_x > 0.66) && !large;
+  const BlockArray x =
+      large.select(-1.0 / abs_x,
+                   medium.select((abs_x - 1.0) / (abs_x + 1.0), abs_x));
+  const BlockArray y0 =
+      large.select(BlockArray::Constant(M_PI_2 + MOREBITS),
+                   medium.select(BlockArray::Constant(M_PI_4 + 0.5 * MOREBITS),
+                                 BlockArray::Zero()));
+  const BlockArray z = x.square();
+  const BlockArray p =
+    (((-8.750608600031904122785e-1 * z - 1.615753718733365076637e1) * z -
+      7.500855792314704667340e1) * z - 1.228866684490136173410e2) * z -
+      6.485021904942025371773e1;
+  const BlockArray q =
+    ((((z + 2.485846490142306297962e1) * z + 1.650270098316988542046e2) * z +
+      4.328810604912902668951e2) * z + 4.853903996359136964868e2) * z +
+      1.945506571482613964425e2;
+  const BlockArray result = y0 + x + x * z * p / q;
+  return (x_in < 0.0).select(-result, result);
+}
+
+// Branch free tan for angles in [0, pi / 2), cephes range reduction and
+// rational approximation
+BlockArray Tan(const BlockArray& theta) {
+  const double DP1 = 7.853981554508209228515625e-1;
+  const double DP2 = 7.94662735614792836714e-9;
+  const double DP3 = 3.06161699786838294307e-17;
+  // theta > pi / 4 is reduced to theta - pi / 2 and inverted
+  const auto upper = theta > M_PI_4;
+  const BlockArray y = upper.select(BlockArray::Constant(2.0),
+                                    BlockArray::Zero());
+  const BlockArray z = ((theta - y * DP1) - y * DP2) - y * DP3;
+  const BlockArray zz = z.square();
+  const BlockArray p =
+      (-1.30936939181383777646e4 * zz + 1.15351664838587416140e6) * zz -
+      1.79565251976484877988e7;
+  const BlockArray q =
+      (((zz + 1.36812963470692954678e4) * zz - 1.32089234440210967447e6) *
+           zz +
+       2.50083801823357915839e7) *
+          zz -
+      5.38695755929454629881e7;
+  const BlockArray t = z + z * (zz * p / q);
+  return upper.select(-1.0 / t, t);
+}
+
+// theta * (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 + k4 theta^8)
+BlockArray DistortTheta(const KB4Parameters& params, const BlockArray& theta) {
+  const BlockArray theta2 = theta.square();
+  return theta *
+         (1.0 +
+          theta2 *
+              (params[4] +
+               theta2 *
+                   (params[5] + theta2 * (params[6] + theta2 * params[7]))));
+}
+
+}  // namespace
+
+bool IsKB4Camera(const theia::Camera& camera) {
+  return camera.GetCameraIntrinsicsModelType() ==
+             theia::CameraIntrinsicsModelType::FISHEYE &&
+         camera.intrinsics()[FisheyeIndex::SKEW] == 0.0;
+}
+
+KB4Parameters KB4ParametersFromCamera(const theia::Camera& camera) {
+  const double* intr = camera.intrinsics();
+  KB4Parameters params;
+  params << intr[FisheyeIndex::FOCAL_LENGTH],
+      intr[FisheyeIndex::FOCAL_LENGTH] * intr[FisheyeIndex::ASPECT_RATIO],
+      intr[FisheyeIndex::PRINCIPAL_POINT_X],
+      intr[FisheyeIndex::PRINCIPAL_POINT_Y],
+      intr[FisheyeIndex::RADIAL_DISTORTION_1],
+      intr[FisheyeIndex::RADIAL_DISTORTION_2],
+      intr[FisheyeIndex::RADIAL_DISTORTION_3],
+      intr[FisheyeIndex::RADIAL_DISTORTION_4];
+  return params;
+}
+
+void SetKB4Parameters(const KB4Parameters& params, theia::Camera& camera) {
+  camera.SetCameraIntrinsicsModelType(
+      theia::CameraIntrinsicsModelType::FISHEYE);
+  double* intr = camera.mutable_intrinsics();
+  intr[FisheyeIndex::FOCAL_LENGTH] = params[0];
+  intr[FisheyeIndex::ASPECT_RATIO] = params[1] / params[0];
+  intr[FisheyeIndex::SKEW] = 0.0;
+  intr[FisheyeIndex::PRINCIPAL_POINT_X] = params[2];
+  intr[FisheyeIndex::PRINCIPAL_POINT_Y] = params[3];
+  intr[FisheyeIndex::RADIAL_DISTORTION_1] = params[4];
+  intr[FisheyeIndex::RADIAL_DISTORTION_2] = params[5];
+  intr[FisheyeIndex::RADIAL_DISTORTION_3] = params[6];
+  intr[FisheyeIndex::RADIAL_DISTORTION_4] = params[7];
+}
+
+void ProjectKB4(const KB4Parameters& params,
+                const Eigen::Matrix3Xd& points,
+                Eigen::Matrix2Xd& pixels) {
+  const Eigen::Index nr_points = points.cols();
+  pixels.resize(2, nr_points);
+  for (Eigen::Index start = 0; start < nr_points; start += KB4_BLOCK_SIZE) {
+    const Eigen::Index size =
+        std::min<Eigen::Index>(KB4_BLOCK_SIZE, nr_points - start);
+    // the tail block is padded with points on the optical axis
+    BlockArray x = BlockArray::Zero(), y = BlockArray::Zero();
+    BlockArray z = BlockArray::Ones();
+    x.head(size) = points.block(0, start, 1, size).transpose().array();
+    y.head(size) = points.block(1, start, 1, size).transpose().array();
+    z.head(size) = points.block(2, start, 1, size).transpose().array();
+
+    const BlockArray r = (x.square() + y.square()).sqrt();
+    // atan2(r, z) for r >= 0, also behind the camera
+    const BlockArray theta =
+        (z > 0.0).select(Atan(r / z), M_PI_2 - Atan(z / r));
+    const BlockArray theta_d = DistortTheta(params, theta);
+    // theta_d / r -> 1 / z on the optical axis
+    const BlockArray scale =
+        (r > MIN_KB4_RADIUS).select(theta_d / r, z.inverse());
+
+    pixels.block(0, start, 1, size) =
+        (params[0] * scale * x + params[2]).head(size).matrix().transpose();
+    pixels.block(1, start, 1, size) =
+        (params[1] * scale * y + params[3]).head(size).matrix().transpose();
+  }
+}
+
+void UnprojectKB4(const KB4Parameters& params,
+                  const Eigen::Matrix2Xd& pixels,
+                  Eigen::Matrix2Xd& normalized,
+                  const int nr_newton_iterations) {
+  const Eigen::Index nr_pixels = pixels.cols();
+  normalized.resize(2, nr_pixels);
+  for (Eigen::Index start = 0; start < nr_pixels; start += KB4_BLOCK_SIZE) {
+    const Eigen::Index size =
+        std::min<Eigen::Index>(KB4_BLOCK_SIZE, nr_pixels - start);
+    BlockArray x_d = BlockArray::Zero(), y_d = BlockArray::Zero();
+    x_d.head(size) =
+        (pixels.block(0, start, 1, size).transpose().array() - params[2]) /
+        params[0];
+    y_d.head(size) =
+        (pixels.block(1, start, 1, size).transpose().array() - params[3]) /
+        params[1];
+    const BlockArray theta_d = (x_d.square() + y_d.square()).sqrt();
+
+    // solve theta * p(theta^2) = theta_d with the same number of Newton
+    // steps for all pixels, theta_d is a good start value as the distortion
+    // is small compared to theta
+    BlockArray theta = theta_d;
+    for (int i = 0; i < nr_newton_iterations; ++i) {
+      const BlockArray theta2 = theta.square();
+      const BlockArray d_theta_d =
+          1.0 +
+          theta2 * (3.0 * params[4] +
+                    theta2 * (5.0 * params[5] +
+                              theta2 * (7.0 * params[6] +
+                                        theta2 * 9.0 * params[7])));
+      theta -= (DistortTheta(params, theta) - theta_d) / d_theta_d;
+    }
+    // tan(theta) / theta_d -> 1 on the optical axis
+    const BlockArray scale = (theta_d > MIN_KB4_RADIUS)
+                                 .select(Tan(theta) / theta_d,
+                                         BlockArray::Ones());
+
+    normalized.block(0, start, 1, size) =
+        (scale * x_d).head(size).matrix().transpose();
+    normalized.block(1, start, 1, size) =
+        (scale * y_d).head(size).matrix().transpose();
+  }
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,190 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/marginal_covariance.h"
+
+#include <glog/logging.h>
+
+#include <Eigen/Dense>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseCore>
+
+#include <unordered_set>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+using SparseMatrix = Eigen::SparseMatrix<double>;
+
+// relative damping of the nuisance block if it is rank deficient, e.g.
+// spline knots that are only weakly constrained
+const double NUISANCE_DAMPING = 1e-10;
+
+// relative eigenvalue threshold of the pseudo inverse
+const double PSEUDO_INVERSE_EPS = 1e-12;
+
+SparseMatrix CRSToSparse(const ceres::CRSMatrix& crs) {
+  std::vector<Eigen::Triplet<double>> triplets;
+  triplets.reserve(crs.values.size());
+  for (int r = 0; r < crs.num_rows; ++r) {
+    for (int i = crs.rows[r]; i < crs.rows[r + 1]; ++i) {
+      triplets.emplace_back(r, crs.cols[i], crs.values[i]);
+    }
+  }
+  SparseMatrix J(crs.num_rows, crs.num_cols);
+  J.setFromTriplets(triplets.begin(), triplets.end());
+  return J;
+}
+
+bool FactorizeNuisance(const SparseMatrix& H_nn,
+                       Eigen::SimplicialLDLT<SparseMatrix>& ldlt) {
+  ldlt.compute(H_nn);
+  if (ldlt.info() == Eigen::Success && (ldlt.vectorD().array() > 0.0).all()) {
+    return true;
+  }
+  const double damping =
+      NUISANCE_DAMPING * std::max(H_nn.diagonal().cwiseAbs().maxCoeff(), 1.0);
+  LOG(WARNING) << "Nuisance parameters are rank deficient, damping them with "
+               << damping << ".";
+  SparseMatrix identity(H_nn.rows(), H_nn.cols());
+  identity.setIdentity();
+  ldlt.compute(H_nn + damping * identity);
+  return ldlt.info() == Eigen::Success;
+}
+
+}  // namespace
+
+bool ComputeMarginalInformation(
+    ceres::Problem* problem,
+    const std::vector<double*>& parameter_blocks,
+    Eigen::MatrixXd& information,
+    double* variance_factor,
+    const std::vector<ceres::ResidualBlockId>& residual_blocks) {
+  // tangent size and offset of the requested blocks in the output
+  std::vector<int> local_sizes(parameter_blocks.size(), 0);
+  std::vector<int> output_offsets(parameter_blocks.size(), 0);
+  int nr_output = 0;
+  for (size_t i = 0; i < parameter_blocks.size(); ++i) {
+    output_offsets[i] = nr_output;
+    if (problem->HasParameterBlock(parameter_blocks[i])) {
+      local_sizes[i] = problem->ParameterBlockLocalSize(parameter_blocks[i]);
+    }
+    nr_output += local_sizes[i];
+  }
+  information.setZero(nr_output, nr_output);
+
+  // jacobian columns: nuisance blocks first, then the marginal blocks
+  std::vector<double*> all_blocks;
+  ceres::Problem::EvaluateOptions eval_options;
+  if (residual_blocks.empty()) {
+    problem->GetParameterBlocks(&all_blocks);
+  } else {
+    eval_options.residual_blocks = residual_blocks;
+    std::unordered_set<double*> used_blocks;
+    for (const ceres::ResidualBlockId residual_block : residual_blocks) {
+      std::vector<double*> blocks;
+      problem->GetParameterBlocksForResidualBlock(residual_block, &blocks);
+      for (double* block : blocks) {
+        if (used_blocks.insert(block).second) {
+          all_blocks.push_back(block);
+        }
+      }
+    }
+  }
+  const std::unordered_set<double*> marginal_set(parameter_blocks.begin(),
+                                                 parameter_blocks.end());
+  int nr_nuisance = 0;
+  for (double* block : all_blocks) {
+    if (!marginal_set.count(block) && !problem->IsParameterBlockConstant(block)) {
+      eval_options.parameter_blocks.push_back(block);
+      nr_nuisance += problem->ParameterBlockLocalSize(block);
+    }
+  }
+  std::vector<int> marginal_columns;
+  int nr_marginal = 0;
+  for (size_t i = 0; i < parameter_blocks.size(); ++i) {
+    if (local_sizes[i] == 0 ||
+        problem->IsParameterBlockConstant(parameter_blocks[i])) {
+      continue;
+    }
+    eval_options.parameter_blocks.push_back(parameter_blocks[i]);
+    for (int j = 0; j < local_sizes[i]; ++j) {
+      marginal_columns.push_back(output_offsets[i] + j);
+    }
+    nr_marginal += local_sizes[i];
+  }
+  if (nr_marginal == 0) {
+    return true;
+  }
+
+  double cost = 0.0;
+  ceres::CRSMatrix crs_jacobian;
+  if (!problem->Evaluate(eval_options, &cost, nullptr, nullptr, &crs_jacobian)) {
+    LOG(WARNING) << "Could not evaluate the problem jacobian.";
+    return false;
+  }
+  const SparseMatrix J = CRSToSparse(crs_jacobian);
+  const SparseMatrix H = SparseMatrix(J.transpose() * J);
+
+  Eigen::MatrixXd S =
+      Eigen::MatrixXd(H.bottomRightCorner(nr_marginal, nr_marginal));
+  if (nr_nuisance > 0) {
+    const SparseMatrix H_nn = H.topLeftCorner(nr_nuisance, nr_nuisance);
+    const Eigen::MatrixXd H_nm =
+        Eigen::MatrixXd(H.topRightCorner(nr_nuisance, nr_marginal));
+    Eigen::SimplicialLDLT<SparseMatrix> ldlt;
+    if (!FactorizeNuisance(H_nn, ldlt)) {
+      LOG(WARNING) << "Could not factorize the nuisance parameters.";
+      return false;
+    }
+    S -= H_nm.transpose() * ldlt.solve(H_nm);
+  }
+  S = 0.5 * (S + S.transpose());
+
+  for (int r = 0; r < nr_marginal; ++r) {
+    for (int c = 0; c < nr_marginal; ++c) {
+      information(marginal_columns[r], marginal_columns[c]) = S(r, c);
+    }
+  }
+
+  if (variance_factor != nullptr) {
+    const int dof = crs_jacobian.num_rows - crs_jacobian.num_cols;
+    *variance_factor = dof > 0 ? 2.0 * cost / dof : 1.0;
+  }
+  return true;
+}
+
+Eigen::MatrixXd CovarianceFromInformation(const Eigen::MatrixXd& information) {
+  const int nr_params = information.rows();
+  if (nr_params == 0) {
+    return Eigen::MatrixXd();
+  }
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig(information);
+  const double eps =
+      PSEUDO_INVERSE_EPS * eig.eigenvalues().cwiseAbs().maxCoeff();
+  Eigen::VectorXd inv_eigenvalues = Eigen::VectorXd::Zero(nr_params);
+  for (int i = 0; i < nr_params; ++i) {
+    if (eig.eigenvalues()[i] > eps) {
+      inv_eigenvalues[i] = 1.0 / eig.eigenvalues()[i];
+    }
+  }
+  return eig.eigenvectors() * inv_eigenvalues.asDiagonal() *
+         eig.eigenvectors().transpose();
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,276 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/planar_initializer.h"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// maximum deviation of a board point from the z = 0 plane in meter
+const double MAX_BOARD_PLANE_DEVIATION = 1e-6;
+
+// Hartley normalization: centroid to origin, mean distance sqrt(2)
+Eigen::Matrix3d NormalizingTransform(const Eigen::Matrix2Xd& pts) {
+  const Eigen::Vector2d centroid = pts.rowwise().mean();
+  const double mean_dist =
+      (pts.colwise() - centroid).colwise().norm().mean();
+  const double s = mean_dist > 0.0 ? std::sqrt(2.0) / mean_dist : 1.0;
+  Eigen::Matrix3d T;
+  T << s, 0.0, -s * centroid[0], 0.0, s, -s * centroid[1], 0.0, 0.0, 1.0;
+  return T;
+}
+
+bool EstimateHomographyFromIndices(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const std::vector<int>& indices,
+    Eigen::Matrix3d& H) {
+  const size_t nr_pts = indices.size();
+  if (nr_pts < 4) {
+    return false;
+  }
+
+  Eigen::Matrix2Xd board_pts(2, nr_pts), image_pts(2, nr_pts);
+  for (size_t i = 0; i < nr_pts; ++i) {
+    const auto& corr = correspondences[indices[i]];
+    if (std::abs(corr.world_point[2]) > MAX_BOARD_PLANE_DEVIATION) {
+      return false;
+    }
+    board_pts.col(i) = corr.world_point.head<2>();
+    image_pts.col(i) = corr.feature;
+  }
+  const Eigen::Matrix3d T_board = NormalizingTransform(board_pts);
+  const Eigen::Matrix3d T_image = NormalizingTransform(image_pts);
+
+  // accumulate the normal equations of the DLT system instead of building the
+  // full 2n x 9 matrix, the board has at most a few hundred corners
+  Eigen::Matrix<double, 9, 9> AtA = Eigen::Matrix<double, 9, 9>::Zero();
+  for (size_t i = 0; i < nr_pts; ++i) {
+    const Eigen::Vector3d X = T_board * board_pts.col(i).homogeneous();
+    const Eigen::Vector3d x = T_image * image_pts.col(i).homogeneous();
+    Eigen::Matrix<double, 9, 1> a1, a2;
+    a1 << X[0], X[1], X[2], 0.0, 0.0, 0.0, -x[0] * X[0], -x[0] * X[1],
+        -x[0] * X[2];
+    a2 << 0.0, 0.0, 0.0, X[0], X[1], X[2], -x[1] * X[0], -x[1] * X[1],
+        -x[1] * X[2];
+    AtA.noalias() += a1 * a1.transpose() + a2 * a2.transpose();
+  }
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 9, 9>> solver(AtA);
+  if (solver.info() != Eigen::Success) {
+    return false;
+  }
+  // the smallest eigenvalue comes first
+  const Eigen::Matrix<double, 9, 1> h = solver.eigenvectors().col(0);
+  Eigen::Matrix3d H_norm;
+  H_norm << h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], h[8];
+
+  H = T_image.inverse() * H_norm * T_board;
+  if (std::abs(H(2, 2)) < 1e-12) {
+    return false;
+  }
+  H /= H(2, 2);
+  return H.allFinite();
+}
+
+}  // namespace
+
+bool EstimatePlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    Eigen::Matrix3d& H) {
+  std::vector<int> indices(correspondences.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  return EstimateHomographyFromIndices(correspondences, indices, H);
+}
+
+double EvaluatePlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const Eigen::Matrix3d& H,
+    const double error_thresh,
+    std::vector<int>& inliers) {
+  inliers.clear();
+  if (correspondences.empty()) {
+    return 0.0;
+  }
+  for (size_t i = 0; i < correspondences.size(); ++i) {
+    const Eigen::Vector3d x =
+        H * correspondences[i].world_point.head<2>().homogeneous();
+    if (x[2] == 0.0) {
+      continue;
+    }
+    if ((x.hnormalized() - correspondences[i].feature).squaredNorm() <
+        error_thresh) {
+      inliers.push_back(i);
+    }
+  }
+  return static_cast<double>(inliers.size()) / correspondences.size();
+}
+
+double FitPlanarHomography(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const double error_thresh,
+    Eigen::Matrix3d& H,
+    std::vector<int>& inliers) {
+  inliers.clear();
+  if (!EstimatePlanarHomography(correspondences, H)) {
+    return 0.0;
+  }
+  double inlier_ratio =
+      EvaluatePlanarHomography(correspondences, H, error_thresh, inliers);
+  if (inlier_ratio == 1.0 || inliers.size() < 4) {
+    return inlier_ratio;
+  }
+  // one refit on the inliers of the all-points fit; this recovers most frames
+  // with a few bad corners without falling back to RANSAC
+  Eigen::Matrix3d H_refit;
+  std::vector<int> refit_inliers;
+  if (EstimateHomographyFromIndices(correspondences, inliers, H_refit)) {
+    const double refit_ratio = EvaluatePlanarHomography(
+        correspondences, H_refit, error_thresh, refit_inliers);
+    if (refit_ratio > inlier_ratio) {
+      H = H_refit;
+      inliers = refit_inliers;
+      inlier_ratio = refit_ratio;
+    }
+  }
+  return inlier_ratio;
+}
+
+bool FocalLengthFromPlanarHomography(const Eigen::Matrix3d& H,
+                                     double& focal_length) {
+  // With K = diag(f, f, 1) and w = 1 / f^2 the two constraints on the image
+  // of the absolute conic are
+  //   h1^T K^-T K^-1 h2 = 0  and  h1^T K^-T K^-1 h1 = h2^T K^-T K^-1 h2
+  const double a1 = H(0, 0) * H(0, 1) + H(1, 0) * H(1, 1);
+  const double b1 = H(2, 0) * H(2, 1);
+  const double a2 = H(0, 0) * H(0, 0) + H(1, 0) * H(1, 0) -
+                    H(0, 1) * H(0, 1) - H(1, 1) * H(1, 1);
+  const double b2 = H(2, 0) * H(2, 0) - H(2, 1) * H(2, 1);
+  const double denom = a1 * a1 + a2 * a2;
+  if (denom < 1e-20) {
+    return false;
+  }
+  const double w = -(a1 * b1 + a2 * b2) / denom;
+  // w <= 0 happens for fronto-parallel views where f is unobservable
+  if (!(w > 0.0)) {
+    return false;
+  }
+  focal_length = 1.0 / std::sqrt(w);
+  return std::isfinite(focal_length);
+}
+
+bool PoseFromPlanarHomography(const Eigen::Matrix3d& H,
+                              const double focal_length,
+                              Eigen::Matrix3d& rotation,
+                              Eigen::Vector3d& position) {
+  if (focal_length <= 0.0) {
+    return false;
+  }
+  Eigen::Matrix3d M = H;
+  M.row(0) /= focal_length;
+  M.row(1) /= focal_length;
+
+  const double norm_sum = M.col(0).norm() + M.col(1).norm();
+  if (norm_sum < 1e-12) {
+    return false;
+  }
+  double lambda = 2.0 / norm_sum;
+  // board has to be in front of the camera
+  if (M(2, 2) * lambda < 0.0) {
+    lambda = -lambda;
+  }
+
+  Eigen::Matrix3d R;
+  R.col(0) = lambda * M.col(0);
+  R.col(1) = lambda * M.col(1);
+  R.col(2) = R.col(0).cross(R.col(1));
+  const Eigen::Vector3d t = lambda * M.col(2);
+
+  // closest rotation matrix in the Frobenius sense
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(
+      R, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  rotation = svd.matrixU() * svd.matrixV().transpose();
+  if (rotation.determinant() < 0.0) {
+    Eigen::Matrix3d U = svd.matrixU();
+    U.col(2) *= -1.0;
+    rotation = U * svd.matrixV().transpose();
+  }
+  position = -rotation.transpose() * t;
+  return rotation.allFinite() && position.allFinite();
+}
+
+int AdaptiveRansacIterations(const double inlier_ratio,
+                             const int sample_size,
+                             const double failure_probability,
+                             const int min_iterations,
+                             const int max_iterations) {
+  if (inlier_ratio <= 0.0) {
+    return max_iterations;
+  }
+  const double prob_all_inliers = std::pow(inlier_ratio, sample_size);
+  if (prob_all_inliers >= 1.0 - 1e-12) {
+    return min_iterations;
+  }
+  const double nr_iterations = std::log(failure_probability) /
+                               std::log(1.0 - prob_all_inliers);
+  return std::clamp(static_cast<int>(std::ceil(nr_iterations)),
+                    min_iterations,
+                    max_iterations);
+}
+
+void AdaptRansacParameters(const double inlier_ratio,
+                           const int sample_size,
+                           theia::RansacParameters& ransac_params) {
+  ransac_params.max_iterations =
+      AdaptiveRansacIterations(inlier_ratio,
+                               sample_size,
+                               ransac_params.failure_probability,
+                               ransac_params.min_iterations,
+                               ransac_params.max_iterations);
+  ransac_params.min_iterations =
+      std::min(ransac_params.min_iterations, ransac_params.max_iterations);
+  ransac_params.use_lo = inlier_ratio < MIN_INLIER_RATIO_NO_LO;
+}
+
+bool EstimatePlanarCalibratedPose(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const double error_thresh,
+    Eigen::Matrix3d& rotation,
+    Eigen::Vector3d& position,
+    theia::RansacSummary& ransac_summary) {
+  Eigen::Matrix3d H;
+  const double inlier_ratio = FitPlanarHomography(
+      correspondences, error_thresh, H, ransac_summary.inliers);
+  ransac_summary.num_iterations = 0;
+  if (inlier_ratio < MIN_INLIER_RATIO_CLOSED_FORM) {
+    return false;
+  }
+  // features are normalized image coordinates -> K = I
+  if (!PoseFromPlanarHomography(H, 1.0, rotation, position)) {
+    return false;
+  }
+  ransac_summary.confidence = 1.0;
+  return true;
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,180 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/pose_refinement.h"
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include <cmath>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// points closer to the image plane than this are treated as invalid
+const double MIN_DEPTH = 1e-8;
+
+const double MIN_STEP_NORM = 1e-12;
+
+const int MAX_STEP_HALVINGS = 5;
+
+double HuberWeight(const double sq_norm, const double robust_loss_width) {
+  const double norm = std::sqrt(sq_norm);
+  return norm <= robust_loss_width ? 1.0 : robust_loss_width / norm;
+}
+
+double HuberCost(const double sq_norm, const double robust_loss_width) {
+  const double norm = std::sqrt(sq_norm);
+  return norm <= robust_loss_width
+             ? sq_norm
+             : 2.0 * robust_loss_width * norm -
+                   robust_loss_width * robust_loss_width;
+}
+
+// Robust cost of the pose R, t (x_cam = R * X + t). Optionally accumulates the
+// weighted normal equations for a left perturbation
+// x_cam' = x_cam + dtheta x x_cam + dt.
+template <typename Visitor>
+bool ForEachResidual(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const std::vector<int>& indices,
+    const Eigen::Matrix3d& R,
+    const Eigen::Vector3d& t,
+    Visitor visitor) {
+  const size_t nr_pts = indices.empty() ? correspondences.size()
+                                        : indices.size();
+  for (size_t i = 0; i < nr_pts; ++i) {
+    const auto& corr =
+        correspondences[indices.empty() ? i : indices[i]];
+    const Eigen::Vector3d x_cam = R * corr.world_point + t;
+    if (x_cam[2] < MIN_DEPTH) {
+      return false;
+    }
+    visitor(x_cam, x_cam.hnormalized() - corr.feature);
+  }
+  return true;
+}
+
+bool EvaluateCost(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const std::vector<int>& indices,
+    const double robust_loss_width,
+    const Eigen::Matrix3d& R,
+    const Eigen::Vector3d& t,
+    double& cost) {
+  cost = 0.0;
+  return ForEachResidual(
+      correspondences,
+      indices,
+      R,
+      t,
+      [&](const Eigen::Vector3d&, const Eigen::Vector2d& residual) {
+        cost += HuberCost(residual.squaredNorm(), robust_loss_width);
+      });
+}
+
+}  // namespace
+
+bool RefinePoseGaussNewton(
+    const std::vector<theia::FeatureCorrespondence2D3D>& correspondences,
+    const std::vector<int>& indices,
+    const double robust_loss_width,
+    Eigen::Matrix3d& rotation,
+    Eigen::Vector3d& position,
+    const int max_iterations) {
+  const size_t nr_pts = indices.empty() ? correspondences.size()
+                                        : indices.size();
+  // 3 points are the minimum for a pose, use a few more to be safe
+  if (nr_pts < 4) {
+    return false;
+  }
+
+  Eigen::Matrix3d R = rotation;
+  Eigen::Vector3d t = -R * position;
+  double cost = 0.0;
+  if (!EvaluateCost(correspondences, indices, robust_loss_width, R, t, cost)) {
+    return false;
+  }
+
+  for (int iter = 0; iter < max_iterations; ++iter) {
+    Eigen::Matrix<double, 6, 6> JtJ = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> Jtr = Eigen::Matrix<double, 6, 1>::Zero();
+    ForEachResidual(
+        correspondences,
+        indices,
+        R,
+        t,
+        [&](const Eigen::Vector3d& x_cam, const Eigen::Vector2d& residual) {
+          const double inv_z = 1.0 / x_cam[2];
+          Eigen::Matrix<double, 2, 3> d_proj;
+          d_proj << inv_z, 0.0, -x_cam[0] * inv_z * inv_z, 0.0, inv_z,
+              -x_cam[1] * inv_z * inv_z;
+          // d x_cam / d [dtheta, dt] = [-[x_cam]_x, I]
+          Eigen::Matrix<double, 3, 6> d_x_cam;
+          d_x_cam << 0.0, x_cam[2], -x_cam[1], 1.0, 0.0, 0.0, -x_cam[2], 0.0,
+              x_cam[0], 0.0, 1.0, 0.0, x_cam[1], -x_cam[0], 0.0, 0.0, 0.0, 1.0;
+          const Eigen::Matrix<double, 2, 6> J = d_proj * d_x_cam;
+          const double w =
+              HuberWeight(residual.squaredNorm(), robust_loss_width);
+          JtJ.noalias() += w * J.transpose() * J;
+          Jtr.noalias() += w * J.transpose() * residual;
+        });
+
+    Eigen::Matrix<double, 6, 1> delta = JtJ.ldlt().solve(-Jtr);
+    if (!delta.allFinite()) {
+      return false;
+    }
+
+    // halve the step until the robust cost decreases
+    bool step_accepted = false;
+    for (int h = 0; h < MAX_STEP_HALVINGS; ++h) {
+      const Eigen::Vector3d dtheta = delta.head<3>();
+      const double angle = dtheta.norm();
+      const Eigen::Matrix3d dR =
+          angle > 0.0
+              ? Eigen::AngleAxisd(angle, dtheta / angle).toRotationMatrix()
+              : Eigen::Matrix3d::Identity();
+      const Eigen::Matrix3d R_new = dR * R;
+      const Eigen::Vector3d t_new = dR * t + delta.tail<3>();
+      double new_cost = 0.0;
+      if (EvaluateCost(correspondences,
+                       indices,
+                       robust_loss_width,
+                       R_new,
+                       t_new,
+                       new_cost) &&
+          new_cost <= cost) {
+        R = R_new;
+        t = t_new;
+        cost = new_cost;
+        step_accepted = true;
+        break;
+      }
+      delta *= 0.5;
+    }
+    if (!step_accepted || delta.norm() < MIN_STEP_NORM) {
+      break;
+    }
+  }
+
+  rotation = R;
+  position = -R.transpose() * t;
+  return rotation.allFinite() && position.allFinite();
+}
+
+}  // namespace utils
+}  // namespace OpenICC
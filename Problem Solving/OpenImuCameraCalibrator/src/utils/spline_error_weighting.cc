@@ -0,0 +1,182 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/spline_error_weighting.h"
+
+#include <glog/logging.h>
+#include <unsupported/Eigen/FFT>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// kissfft falls back to O(n * p) butterflies for large prime factors p, the
+// few samples we drop to get a 2, 3, 5-smooth length do not change the
+// spectrum noticeably
+size_t SmoothFFTSize(size_t n) {
+  for (; n > 1; --n) {
+    size_t m = n;
+    for (const size_t p : {2, 3, 5}) {
+      while (m % p == 0) {
+        m /= p;
+      }
+    }
+    if (m == 1) {
+      return n;
+    }
+  }
+  return n;
+}
+
+}  // namespace
+
+SplineErrorWeighting::SplineErrorWeighting(const ImuReadings& signal) {
+  if (signal.size() < 2 ||
+      signal.back().timestamp_s() <= signal.front().timestamp_s()) {
+    return;
+  }
+  const double duration_s =
+      signal.back().timestamp_s() - signal.front().timestamp_s();
+  const double sample_rate = (signal.size() - 1) / duration_s;
+  const size_t n = SmoothFFTSize(signal.size());
+  const size_t nr_bins = n / 2 + 1;
+
+  // reference spectrum: norm over the axes / sqrt(3) without DC (sew.py
+  // make_reference_spectrum), only the non-negative frequencies of the
+  // real signal
+  Eigen::FFT<double> fft;
+  fft.SetFlag(Eigen::FFT<double>::HalfSpectrum);
+  std::vector<double> axis(n);
+  std::vector<std::complex<double>> spectrum;
+  power_ = Eigen::ArrayXd::Zero(nr_bins);
+  for (int a = 0; a < 3; ++a) {
+    for (size_t i = 0; i < n; ++i) {
+      axis[i] = signal[i].data()[a];
+    }
+    fft.fwd(spectrum, axis);
+    for (size_t k = 1; k < nr_bins; ++k) {
+      power_[k] += std::norm(spectrum[k]) / 3.0;
+    }
+  }
+  // the negative frequencies mirror the positive ones, only the Nyquist bin
+  // of an even length has no mirror
+  for (size_t k = 1; k < nr_bins; ++k) {
+    if (n % 2 != 0 || k != n / 2) {
+      power_[k] *= 2.0;
+    }
+  }
+
+  freqs_ = Eigen::ArrayXd::LinSpaced(nr_bins, 0.0, nr_bins - 1) *
+           (sample_rate / n);
+  nr_samples_ = n;
+  energy_ = power_.sum() / n;
+}
+
+double SplineErrorWeighting::RemovedEnergy(const double dt) const {
+  // frequency response of cubic B-spline interpolation (Mihajlovic 1999),
+  // normalized to H(0) = 1
+  const Eigen::ArrayXd x = freqs_ * dt;
+  const Eigen::ArrayXd pi_x = M_PI * x;
+  const Eigen::ArrayXd sinc = (x == 0.0).select(1.0, pi_x.sin() / pi_x);
+  const Eigen::ArrayXd H =
+      3.0 * sinc.square().square() / (2.0 + (2.0 * pi_x).cos());
+  return (power_ * (1.0 - H).square()).sum() / nr_samples_;
+}
+
+double SplineErrorWeighting::Quality(const double dt,
+                                     const double quality) const {
+  const double removed = RemovedEnergy(dt);
+  if (removed <= 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return energy_ * (1.0 - quality) / removed;
+}
+
+double SplineErrorWeighting::Variance(const double dt) const {
+  return RemovedEnergy(dt) / nr_samples_;
+}
+
+double SplineErrorWeighting::KnotSpacing(const double quality,
+                                         const double min_dt,
+                                         const double max_dt) const {
+  CHECK(IsValid()) << "Spline error weighting needs at least two samples.";
+  // same search as find_max_quality_dt in sew.py: the endpoint, then
+  // backtrack with halving steps until the quality is reached
+  if (Quality(max_dt, quality) >= 1.0) {
+    return max_dt;
+  }
+  double dt = max_dt;
+  double step = 0.5 * max_dt;
+  double best_quality = 0.0;
+  double best_dt = min_dt;
+  while (true) {
+    dt = std::max(dt - step, min_dt);
+    const double q = Quality(dt, quality);
+    if (q > 1.0) {
+      break;
+    }
+    step *= 0.5;
+    if (q > best_quality) {
+      best_quality = q;
+      best_dt = dt;
+    }
+    if (dt <= min_dt) {
+      LOG(WARNING) << "No knot spacing reaches the quality " << quality
+                   << ", using the best one: " << best_dt << "s.";
+      return best_dt;
+    }
+  }
+  // the quality crosses 1 in [dt, max_dt]. Each evaluation is cheap, so we
+  // bisect instead of using Brent's method
+  double lo = dt, hi = max_dt;
+  while (hi - lo > 1e-9) {
+    const double mid = 0.5 * (lo + hi);
+    if (Quality(mid, quality) >= 1.0) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool ComputeSplineErrorWeighting(const CameraTelemetryData& telemetry_data,
+                                 const SplineErrorWeightingOptions& options,
+                                 SplineWeightingData& spline_weighting) {
+  const SplineErrorWeighting gyro_sew(telemetry_data.gyroscope);
+  const SplineErrorWeighting accl_sew(telemetry_data.accelerometer);
+  if (!gyro_sew.IsValid() || !accl_sew.IsValid()) {
+    return false;
+  }
+  spline_weighting.dt_so3 = gyro_sew.KnotSpacing(
+      options.quality_so3, options.min_dt_so3, options.max_dt_so3);
+  spline_weighting.dt_r3 = accl_sew.KnotSpacing(
+      options.quality_r3, options.min_dt_r3, options.max_dt_r3);
+  spline_weighting.std_so3 =
+      std::sqrt(gyro_sew.Variance(spline_weighting.dt_so3));
+  spline_weighting.std_r3 =
+      std::sqrt(accl_sew.Variance(spline_weighting.dt_r3));
+  return true;
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,291 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/undistortion_lookup.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// rays with a smaller z are too close to 90 deg for normalized coordinates
+const double MIN_RAY_Z = 1e-3;
+
+// number of pixels that are looked up together in the batched undistortion
+const int LOOKUP_BLOCK_SIZE = 256;
+
+// central difference step in normalized coordinates for the node jacobians
+const double JACOBIAN_STEP_EPS = 1e-6;
+
+// Half of the first order expansion of a node towards the pixel at offset
+// (dx, dy). Averaging the bilinear interpolation with the expansions of the
+// nodes cancels its second order error.
+template <typename Node, typename Offset>
+void AddHalfNodeExpansion(Node& node, const Offset& dx, const Offset& dy) {
+  node.row(0) += 0.5 * (node.row(2) * dx + node.row(4) * dy);
+  node.row(1) += 0.5 * (node.row(3) * dx + node.row(5) * dy);
+}
+
+}  // namespace
+
+UndistortionLookup::UndistortionLookup(const theia::Camera& camera,
+                                       const int grid_step_px,
+                                       const int num_threads)
+    : camera_(camera), grid_step_px_(std::max(grid_step_px, 1)) {
+  if (IsKB4Camera(camera_)) {
+    use_kb4_ = true;
+    kb4_params_ = KB4ParametersFromCamera(camera_);
+    return;
+  }
+  nr_cols_ = static_cast<int>(
+                 std::ceil(camera_.ImageWidth() / double(grid_step_px_))) +
+             1;
+  nr_rows_ = static_cast<int>(
+                 std::ceil(camera_.ImageHeight() / double(grid_step_px_))) +
+             1;
+  if (nr_cols_ < 2 || nr_rows_ < 2) {
+    return;
+  }
+  grid_.resize(GridNode::RowsAtCompileTime, nr_cols_ * nr_rows_);
+  valid_.assign(nr_cols_ * nr_rows_, 0);
+  ParallelFor(nr_rows_, num_threads, [&](const size_t r) {
+    for (int c = 0; c < nr_cols_; ++c) {
+      const Eigen::Vector3d ray = camera_.PixelToNormalizedCoordinates(
+          Eigen::Vector2d(c * grid_step_px_, r * grid_step_px_));
+      const int idx = r * nr_cols_ + c;
+      if (!ray.allFinite() || ray[2] <= MIN_RAY_Z) {
+        continue;
+      }
+      const Eigen::Vector2d normalized = ray.hnormalized();
+      // inverse of the projection jacobian, interpolated for the Newton step
+      Eigen::Matrix2d proj_jacobian;
+      for (int k = 0; k < 2; ++k) {
+        const Eigen::Vector2d step =
+            JACOBIAN_STEP_EPS * Eigen::Vector2d::Unit(k);
+        proj_jacobian.col(k) =
+            (Project(normalized + step) - Project(normalized - step)) /
+            (2.0 * JACOBIAN_STEP_EPS);
+      }
+      if (!proj_jacobian.allFinite() ||
+          std::abs(proj_jacobian.determinant()) < 1e-12) {
+        continue;
+      }
+      grid_.col(idx).head<2>() = normalized;
+      Eigen::Map<Eigen::Matrix2d>(grid_.col(idx).data() + 2) =
+          proj_jacobian.inverse();
+      valid_[idx] = 1;
+    }
+  });
+
+  // sample the error at every cell center
+  std::vector<double> max_row_errors(nr_rows_ - 1, 0.0);
+  ParallelFor(nr_rows_ - 1, num_threads, [&](const size_t r) {
+    for (int c = 0; c < nr_cols_ - 1; ++c) {
+      const Eigen::Vector2d pixel((c + 0.5) * grid_step_px_,
+                                  (r + 0.5) * grid_step_px_);
+      Eigen::Vector2d normalized;
+      Eigen::Matrix2d jacobian;
+      if (!Interpolate(pixel, normalized, jacobian)) {
+        continue;
+      }
+      const double error =
+          (Project(UndistortLookup(pixel)) - pixel).norm();
+      max_row_errors[r] = std::max(max_row_errors[r], error);
+    }
+  });
+  max_error_px_ =
+      *std::max_element(max_row_errors.begin(), max_row_errors.end());
+  use_lookup_ = max_error_px_ < MAX_UNDISTORTION_LOOKUP_ERROR_PX;
+}
+
+bool UndistortionLookup::Interpolate(const Eigen::Vector2d& pixel,
+                                     Eigen::Vector2d& normalized,
+                                     Eigen::Matrix2d& jacobian) const {
+  const double gx = pixel[0] / grid_step_px_;
+  const double gy = pixel[1] / grid_step_px_;
+  const int c = static_cast<int>(std::floor(gx));
+  const int r = static_cast<int>(std::floor(gy));
+  if (c < 0 || r < 0 || c >= nr_cols_ - 1 || r >= nr_rows_ - 1) {
+    return false;
+  }
+  const int i00 = r * nr_cols_ + c;
+  const int i10 = i00 + 1;
+  const int i01 = i00 + nr_cols_;
+  const int i11 = i01 + 1;
+  if (!valid_[i00] || !valid_[i10] || !valid_[i01] || !valid_[i11]) {
+    return false;
+  }
+  const double fx = gx - c;
+  const double fy = gy - r;
+  const double dx = fx * grid_step_px_;
+  const double dy = fy * grid_step_px_;
+  const double dx1 = dx - grid_step_px_;
+  const double dy1 = dy - grid_step_px_;
+  GridNode n00 = grid_.col(i00), n10 = grid_.col(i10);
+  GridNode n01 = grid_.col(i01), n11 = grid_.col(i11);
+  AddHalfNodeExpansion(n00, dx, dy);
+  AddHalfNodeExpansion(n10, dx1, dy);
+  AddHalfNodeExpansion(n01, dx, dy1);
+  AddHalfNodeExpansion(n11, dx1, dy1);
+  const GridNode node = (1.0 - fy) * ((1.0 - fx) * n00 + fx * n10) +
+                        fy * ((1.0 - fx) * n01 + fx * n11);
+  normalized = node.head<2>();
+  jacobian = Eigen::Map<const Eigen::Matrix2d>(node.data() + 2);
+  return true;
+}
+
+Eigen::Vector2d UndistortionLookup::UndistortExact(
+    const Eigen::Vector2d& pixel) const {
+  return camera_.PixelToNormalizedCoordinates(pixel).hnormalized();
+}
+
+Eigen::Vector2d UndistortionLookup::Project(
+    const Eigen::Vector2d& normalized) const {
+  return camera_.CameraIntrinsics()->CameraToImageCoordinates(
+      normalized.homogeneous());
+}
+
+Eigen::Vector2d UndistortionLookup::UndistortLookup(
+    const Eigen::Vector2d& pixel) const {
+  Eigen::Vector2d normalized;
+  Eigen::Matrix2d jacobian;
+  if (!Interpolate(pixel, normalized, jacobian)) {
+    return UndistortExact(pixel);
+  }
+  return NewtonStep(pixel, normalized, jacobian);
+}
+
+Eigen::Vector2d UndistortionLookup::NewtonStep(
+    const Eigen::Vector2d& pixel,
+    const Eigen::Vector2d& normalized,
+    const Eigen::Matrix2d& jacobian) const {
+  // one Newton step on the projection with the interpolated inverse
+  // projection jacobian, the camera is projected only once per pixel
+  return normalized + jacobian * (pixel - Project(normalized));
+}
+
+Eigen::Vector2d UndistortionLookup::Undistort(
+    const Eigen::Vector2d& pixel) const {
+  if (use_kb4_) {
+    Eigen::Matrix2Xd normalized;
+    UnprojectKB4(kb4_params_, pixel, normalized);
+    return normalized.col(0);
+  }
+  return use_lookup_ ? UndistortLookup(pixel) : UndistortExact(pixel);
+}
+
+void UndistortionLookup::Undistort(const Eigen::Matrix2Xd& pixels,
+                                   Eigen::Matrix2Xd& normalized) const {
+  if (use_kb4_) {
+    UnprojectKB4(kb4_params_, pixels, normalized);
+    return;
+  }
+  const Eigen::Index nr_pts = pixels.cols();
+  normalized.resize(2, nr_pts);
+  if (!use_lookup_) {
+    for (Eigen::Index i = 0; i < nr_pts; ++i) {
+      normalized.col(i) = UndistortExact(pixels.col(i));
+    }
+    return;
+  }
+
+  for (Eigen::Index start = 0; start < nr_pts; start += LOOKUP_BLOCK_SIZE) {
+    const Eigen::Index block_size =
+        std::min<Eigen::Index>(LOOKUP_BLOCK_SIZE, nr_pts - start);
+    UndistortLookupBlock(pixels.middleCols(start, block_size),
+                         normalized.middleCols(start, block_size));
+  }
+}
+
+void UndistortionLookup::UndistortLookupBlock(
+    const Eigen::Ref<const Eigen::Matrix2Xd>& pixels,
+    Eigen::Ref<Eigen::Matrix2Xd> normalized) const {
+  // stack allocated, a block stays in the L1/L2 cache
+  using BlockArray =
+      Eigen::Array<double, Eigen::Dynamic, 1, 0, LOOKUP_BLOCK_SIZE, 1>;
+  using BlockArrayi =
+      Eigen::Array<int, Eigen::Dynamic, 1, 0, LOOKUP_BLOCK_SIZE, 1>;
+  using BlockArrayb =
+      Eigen::Array<bool, Eigen::Dynamic, 1, 0, LOOKUP_BLOCK_SIZE, 1>;
+  const Eigen::Index nr_pts = pixels.cols();
+
+  // cell indices and bilinear weights of all pixels at once. Grid coordinates
+  // are clamped before the cast, pixels outside of the grid are masked below.
+  const BlockArray px = pixels.row(0).transpose().array();
+  const BlockArray py = pixels.row(1).transpose().array();
+  const BlockArrayb finite = px.isFinite() && py.isFinite();
+  const BlockArray gx = finite.select(px, -1.0) / grid_step_px_;
+  const BlockArray gy = finite.select(py, -1.0) / grid_step_px_;
+  const BlockArray cx = gx.floor().max(-1.0).min(double(nr_cols_));
+  const BlockArray cy = gy.floor().max(-1.0).min(double(nr_rows_));
+  const BlockArrayi c = cx.cast<int>();
+  const BlockArrayi r = cy.cast<int>();
+  const BlockArrayb in_grid =
+      (c >= 0) && (r >= 0) && (c < nr_cols_ - 1) && (r < nr_rows_ - 1);
+  const BlockArrayi i00 = in_grid.select(r * nr_cols_ + c, 0);
+
+  // gather the four nodes of each cell
+  using BlockArray6 =
+      Eigen::Array<double, 6, Eigen::Dynamic, 0, 6, LOOKUP_BLOCK_SIZE>;
+  BlockArray6 a00(6, nr_pts), a10(6, nr_pts), a01(6, nr_pts), a11(6, nr_pts);
+  BlockArrayb cell_valid(nr_pts);
+  for (Eigen::Index i = 0; i < nr_pts; ++i) {
+    const int idx = i00[i];
+    a00.col(i) = grid_.col(idx);
+    a10.col(i) = grid_.col(idx + 1);
+    a01.col(i) = grid_.col(idx + nr_cols_);
+    a11.col(i) = grid_.col(idx + nr_cols_ + 1);
+    cell_valid[i] = in_grid[i] && valid_[idx] && valid_[idx + 1] &&
+                    valid_[idx + nr_cols_] && valid_[idx + nr_cols_ + 1];
+  }
+
+  // normalized coordinates and inverse projection jacobians of all columns
+  const BlockArray fx = gx - cx;
+  const BlockArray fy = gy - cy;
+  const BlockArray dx = fx * grid_step_px_;
+  const BlockArray dy = fy * grid_step_px_;
+  const BlockArray dx1 = dx - grid_step_px_;
+  const BlockArray dy1 = dy - grid_step_px_;
+  AddHalfNodeExpansion(a00, dx.transpose(), dy.transpose());
+  AddHalfNodeExpansion(a10, dx1.transpose(), dy.transpose());
+  AddHalfNodeExpansion(a01, dx.transpose(), dy1.transpose());
+  AddHalfNodeExpansion(a11, dx1.transpose(), dy1.transpose());
+  const BlockArray6 wx = fx.transpose().replicate<6, 1>();
+  const BlockArray6 wy = fy.transpose().replicate<6, 1>();
+  const BlockArray6 nodes = (1.0 - wy) * ((1.0 - wx) * a00 + wx * a10) +
+                            wy * ((1.0 - wx) * a01 + wx * a11);
+
+  // the Newton step goes through the theia projection, one pixel at a time
+  for (Eigen::Index i = 0; i < nr_pts; ++i) {
+    if (!cell_valid[i]) {
+      normalized.col(i) = UndistortExact(pixels.col(i));
+      continue;
+    }
+    normalized.col(i) = NewtonStep(
+        pixels.col(i),
+        nodes.col(i).head<2>().matrix(),
+        Eigen::Map<const Eigen::Matrix2d>(nodes.col(i).data() + 2));
+  }
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -0,0 +1,133 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/undistortion_map.h"
+
+#include <cmath>
+
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+// rays with a smaller z can not be projected by the perspective models
+const double MIN_RAY_Z = 1e-3;
+
+const int16_t INVALID_MAP_COORD = -1;
+
+// models that can project rays at or beyond 90 deg
+bool IsWideAngleModel(const theia::CameraIntrinsicsModelType type) {
+  return type == theia::CameraIntrinsicsModelType::FISHEYE ||
+         type == theia::CameraIntrinsicsModelType::DOUBLE_SPHERE ||
+         type == theia::CameraIntrinsicsModelType::EXTENDED_UNIFIED;
+}
+
+}  // namespace
+
+bool ComputeUndistortionMap(const theia::Camera& camera,
+                            const UndistortionMapOptions& options,
+                            UndistortionMap& map) {
+  map.source_width = camera.ImageWidth();
+  map.source_height = camera.ImageHeight();
+  map.width = options.width > 0 ? options.width : map.source_width;
+  map.height = options.height > 0 ? options.height : map.source_height;
+  if (map.width <= 0 || map.height <= 0) {
+    return false;
+  }
+  if (options.horizontal_fov_deg > 0.0) {
+    if (options.horizontal_fov_deg >= 180.0) {
+      return false;
+    }
+    map.focal_length =
+        0.5 * map.width /
+        std::tan(0.5 * options.horizontal_fov_deg * M_PI / 180.0);
+  } else {
+    // keep the pixel size of the camera at the output resolution
+    map.focal_length =
+        camera.FocalLength() * map.width / static_cast<double>(map.source_width);
+  }
+  map.principal_point_x = 0.5 * (map.width - 1);
+  map.principal_point_y = 0.5 * (map.height - 1);
+
+  const size_t nr_pixels = static_cast<size_t>(map.width) * map.height;
+  map.map_xy.resize(2 * nr_pixels);
+  map.map_interp.resize(nr_pixels);
+
+  const bool use_kb4 = IsKB4Camera(camera);
+  const KB4Parameters kb4_params =
+      use_kb4 ? KB4ParametersFromCamera(camera) : KB4Parameters::Zero();
+  const bool wide_angle =
+      IsWideAngleModel(camera.GetCameraIntrinsicsModelType());
+  const auto intrinsics = camera.CameraIntrinsics();
+
+  // rays of one row are R * [x, y, 1] = R.col(2) + y * R.col(1) + x * R.col(0)
+  const Eigen::RowVectorXd x_normalized =
+      (Eigen::RowVectorXd::LinSpaced(map.width, 0.0, map.width - 1).array() -
+       map.principal_point_x) /
+      map.focal_length;
+
+  ParallelFor(map.height, options.num_threads, [&](const size_t r) {
+    const double y_normalized = (r - map.principal_point_y) / map.focal_length;
+    const Eigen::Vector3d row_offset =
+        options.rotation.col(2) + y_normalized * options.rotation.col(1);
+    const Eigen::Matrix3Xd rays =
+        (options.rotation.col(0) * x_normalized).colwise() + row_offset;
+
+    Eigen::Matrix2Xd pixels(2, map.width);
+    if (use_kb4) {
+      ProjectKB4(kb4_params, rays, pixels);
+    } else {
+      for (int c = 0; c < map.width; ++c) {
+        pixels.col(c) = intrinsics->CameraToImageCoordinates(rays.col(c));
+      }
+    }
+
+    const size_t row_start = r * map.width;
+    for (int c = 0; c < map.width; ++c) {
+      const size_t idx = row_start + c;
+      const double sx = pixels(0, c);
+      const double sy = pixels(1, c);
+      const bool valid = (wide_angle || rays(2, c) > MIN_RAY_Z) &&
+                         sx > -1.0 && sy > -1.0 && sx < map.source_width &&
+                         sy < map.source_height;
+      if (!valid) {
+        map.map_xy[2 * idx + 0] = INVALID_MAP_COORD;
+        map.map_xy[2 * idx + 1] = INVALID_MAP_COORD;
+        map.map_interp[idx] = 0;
+        continue;
+      }
+      // same rounding as cv::convertMaps
+      const int ix =
+          static_cast<int>(std::lrint(sx * UNDISTORTION_MAP_INTER_TAB_SIZE));
+      const int iy =
+          static_cast<int>(std::lrint(sy * UNDISTORTION_MAP_INTER_TAB_SIZE));
+      map.map_xy[2 * idx + 0] =
+          static_cast<int16_t>(ix >> UNDISTORTION_MAP_INTER_BITS);
+      map.map_xy[2 * idx + 1] =
+          static_cast<int16_t>(iy >> UNDISTORTION_MAP_INTER_BITS);
+      map.map_interp[idx] = static_cast<uint16_t>(
+          (iy & (UNDISTORTION_MAP_INTER_TAB_SIZE - 1)) *
+              UNDISTORTION_MAP_INTER_TAB_SIZE +
+          (ix & (UNDISTORTION_MAP_INTER_TAB_SIZE - 1)));
+    }
+  });
+  return true;
+}
+
+}  // namespace utils
+}  // namespace OpenICC
@@ -14,6 +14,7 @@
  */
 
 #include "OpenCameraCalibrator/utils/utils.h"
+#include "OpenCameraCalibrator/utils/view_statistics.h"
 
 #include <opencv2/aruco.hpp>
 #include <opencv2/opencv.hpp>
@@ -23,7 +24,9 @@
 #include <theia/sfm/camera/pinhole_camera_model.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <thread>
 #include <vector>
 
 using namespace cv;
@@ -162,18 +165,7 @@ int GravDirStringToInt(const std::string& string) {
 
 double GetReprojErrorOfView(const theia::Reconstruction& recon_dataset,
                             const theia::ViewId v_id) {
-  const theia::View* v = recon_dataset.View(v_id);
-  std::vector<theia::TrackId> track_ids = v->TrackIds();
-  double view_reproj_error = 0.0;
-  for (size_t t = 0; t < track_ids.size(); ++t) {
-    const theia::Feature* feat = v->GetFeature(track_ids[t]);
-    const theia::Track* track = recon_dataset.Track(track_ids[t]);
-    Eigen::Vector2d pt;
-    v->Camera().ProjectPoint(track->Point(), &pt);
-    view_reproj_error += (pt - (*feat).point_).norm();
-  }
-  view_reproj_error /= track_ids.size();
-  return view_reproj_error;
+  return ComputeViewStatistics(recon_dataset, {v_id})[0].mean_error;
 }
 
 std::vector<std::string> load_images(const std::string& img_dir_path) {
@@ -271,5 +263,31 @@ bool IsPathAFile(const std::string& path) {
   return false;
 }
 
+void ParallelFor(const size_t nr_items,
+                 const int num_threads,
+                 const std::function<void(const size_t)>& func) {
+  const size_t nr_threads =
+      std::min(static_cast<size_t>(std::max(num_threads, 1)), nr_items);
+  if (nr_threads <= 1) {
+    for (size_t i = 0; i < nr_items; ++i) {
+      func(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next_item(0);
+  std::vector<std::thread> threads;
+  threads.reserve(nr_threads);
+  for (size_t t = 0; t < nr_threads; ++t) {
+    threads.emplace_back([&]() {
+      for (size_t i = next_item++; i < nr_items; i = next_item++) {
+        func(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace utils
 }  // namespace OpenICC
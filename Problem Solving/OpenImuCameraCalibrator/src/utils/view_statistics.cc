@@ -0,0 +1,77 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/utils/view_statistics.h"
+
+#include <cmath>
+
+#include "OpenCameraCalibrator/utils/kb4_camera.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+namespace OpenICC {
+namespace utils {
+
+ViewStatistics ViewStatisticsFromResiduals(const Eigen::Matrix2Xd& residuals) {
+  ViewStatistics stats;
+  stats.point_errors = residuals.colwise().norm().transpose();
+  if (stats.point_errors.size() == 0) {
+    return stats;
+  }
+  stats.mean_error = stats.point_errors.mean();
+  stats.rmse = std::sqrt(stats.point_errors.squaredNorm() /
+                         stats.point_errors.size());
+  stats.max_error = stats.point_errors.maxCoeff();
+  return stats;
+}
+
+std::vector<ViewStatistics> ComputeViewStatistics(
+    const theia::Reconstruction& recon,
+    const std::vector<theia::ViewId>& view_ids,
+    const int num_threads) {
+  std::vector<ViewStatistics> view_stats(view_ids.size());
+  ParallelFor(view_ids.size(), num_threads, [&](const size_t i) {
+    const theia::View* view = recon.View(view_ids[i]);
+    const theia::Camera& camera = view->Camera();
+    const std::vector<theia::TrackId> track_ids = view->TrackIds();
+    const int nr_obs = static_cast<int>(track_ids.size());
+
+    Eigen::Matrix4Xd points(4, nr_obs);
+    Eigen::Matrix2Xd residuals(2, nr_obs);
+    for (int j = 0; j < nr_obs; ++j) {
+      points.col(j) = recon.Track(track_ids[j])->Point();
+      residuals.col(j) = -view->GetFeature(track_ids[j])->point_;
+    }
+    // all points to the camera frame at once
+    const Eigen::Matrix3Xd cam_points =
+        camera.GetOrientationAsRotationMatrix() *
+        (points.topRows<3>() - camera.GetPosition() * points.row(3));
+    if (IsKB4Camera(camera)) {
+      Eigen::Matrix2Xd reprojections;
+      ProjectKB4(KB4ParametersFromCamera(camera), cam_points, reprojections);
+      residuals += reprojections;
+    } else {
+      const auto intrinsics = camera.CameraIntrinsics();
+      for (int j = 0; j < nr_obs; ++j) {
+        residuals.col(j) +=
+            intrinsics->CameraToImageCoordinates(cam_points.col(j));
+      }
+    }
+    view_stats[i] = ViewStatisticsFromResiduals(residuals);
+  });
+  return view_stats;
+}
+
+}  // namespace utils
+}  // namespace OpenICC